@@ -24,17 +24,23 @@
 #include <sstream>
 #include <cstdio>
 #include <vector>
+#include <sys/stat.h>
 #include <apt-pkg/algorithms.h>
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/fileutl.h>
 #include <apt-pkg/progress.h>
 #include <apt-pkg/upgrade.h>
 
 #include "apt-utils.h"
 #include "apt-messages.h"
+#include "gst-matcher.h"
+#include "soname-index.h"
 
 using namespace APT;
 
 AptCacheFile::AptCacheFile(PkBackendJob *job)
-    : m_job(job)
+    : m_job(job),
+      m_borrowedDepCache(false)
 {
 }
 
@@ -49,9 +55,50 @@ bool AptCacheFile::Open(bool withLock)
     return pkgCacheFile::Open(&progress, withLock);
 }
 
+bool AptCacheFile::Borrow(const std::shared_ptr<AptCacheFile> &shared, bool privateDepCache)
+{
+    m_shared = shared;
+    Map = shared->Map;
+    Cache = shared->Cache;
+    Policy = shared->Policy;
+    DCache = shared->DCache;
+    m_borrowedDepCache = true;
+
+    return privateDepCache ? ensurePrivateDepCache() : true;
+}
+
+bool AptCacheFile::ensurePrivateDepCache()
+{
+    if (!m_borrowedDepCache)
+        return true;
+
+    OpPackageKitProgress progress(m_job);
+    DCache = new pkgDepCache(Cache, Policy);
+    m_borrowedDepCache = false;
+    return DCache->Init(&progress);
+}
+
 void AptCacheFile::Close()
 {
     m_packageRecords.reset();
+    {
+        // they point into the package cache being closed
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        m_gstCapsIndex.reset();
+        m_sonameIndex.reset();
+    }
+
+    // never free what belongs to the shared cache, but keep it alive
+    // until our own dependency cache is gone
+    auto shared = std::move(m_shared);
+    if (shared) {
+        if (m_borrowedDepCache)
+            DCache = nullptr;
+        Policy = nullptr;
+        Cache = nullptr;
+        Map = nullptr;
+        m_borrowedDepCache = false;
+    }
 
     pkgCacheFile::Close();
 
@@ -60,6 +107,11 @@ void AptCacheFile::Close()
     _error->Discard();
 }
 
+void AptCacheFile::setJob(PkBackendJob *job)
+{
+    m_job = job;
+}
+
 bool AptCacheFile::BuildCaches(bool withLock)
 {
     OpPackageKitProgress progress(m_job);
@@ -239,6 +291,50 @@ void AptCacheFile::ShowBroken(bool Now, PkErrorEnum error)
     pk_backend_job_error_code(m_job, error, "%s", toUtf8(out.str().c_str()));
 }
 
+std::shared_ptr<const GstCapsIndex> AptCacheFile::gstCapsIndex(const bool &cancel)
+{
+    if (m_shared)
+        return m_shared->gstCapsIndex(cancel);
+
+    {
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        if (m_gstCapsIndex)
+            return m_gstCapsIndex;
+    }
+
+    // jobs racing for the index each build it, the first one is kept
+    auto index = std::make_shared<const GstCapsIndex>(*this, cancel);
+    if (cancel)
+        return index;
+
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    if (!m_gstCapsIndex)
+        m_gstCapsIndex = std::move(index);
+    return m_gstCapsIndex;
+}
+
+std::shared_ptr<const SonameIndex> AptCacheFile::sonameIndex(const bool &cancel)
+{
+    if (m_shared)
+        return m_shared->sonameIndex(cancel);
+
+    {
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        if (m_sonameIndex)
+            return m_sonameIndex;
+    }
+
+    const std::string infoDir = flNotFile(_config->FindFile("Dir::State::status")) + "info/";
+    auto index = std::make_shared<const SonameIndex>(*this, infoDir, cancel);
+    if (cancel)
+        return index;
+
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    if (!m_sonameIndex)
+        m_sonameIndex = std::move(index);
+    return m_sonameIndex;
+}
+
 void AptCacheFile::buildPkgRecords()
 {
     if (m_packageRecords) {
@@ -592,6 +688,62 @@ std::string AptCacheFile::debParser(std::string descr)
     return descr;
 }
 
+std::mutex AptSharedCache::s_mutex;
+std::shared_ptr<AptCacheFile> AptSharedCache::s_cache;
+std::vector<int64_t> AptSharedCache::s_stamp;
+
+std::vector<int64_t> AptSharedCache::currentStamp()
+{
+    const std::string files[] = {
+        _config->FindFile("Dir::State::status"),
+        _config->FindFile("Dir::State::extended_states"),
+        _config->FindDir("Dir::State::lists"),
+        _config->FindFile("Dir::Etc::sourcelist"),
+        _config->FindDir("Dir::Etc::sourceparts"),
+        _config->FindFile("Dir::Etc::preferences"),
+        _config->FindDir("Dir::Etc::preferencesparts"),
+    };
+
+    std::vector<int64_t> stamp;
+    for (const auto &file : files) {
+        struct stat st;
+        if (stat(file.c_str(), &st) != 0) {
+            stamp.push_back(-1);
+            continue;
+        }
+        stamp.push_back((int64_t)st.st_mtim.tv_sec * G_GINT64_CONSTANT(1000000000) + st.st_mtim.tv_nsec);
+        stamp.push_back(st.st_size);
+    }
+
+    return stamp;
+}
+
+std::shared_ptr<AptCacheFile> AptSharedCache::get()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_cache && s_stamp != currentStamp()) {
+        g_debug("Dropping shared APT cache: package database changed");
+        s_cache.reset();
+    }
+
+    return s_cache;
+}
+
+void AptSharedCache::set(const std::shared_ptr<AptCacheFile> &cache, const std::vector<int64_t> &stamp)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_cache = cache;
+    s_stamp = stamp;
+}
+
+void AptSharedCache::invalidate(const char *reason)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_cache)
+        g_debug("Dropping shared APT cache: %s", reason);
+    s_cache.reset();
+}
+
 OpPackageKitProgress::OpPackageKitProgress(PkBackendJob *job)
     : m_job(job)
 {
@@ -23,6 +23,8 @@
 #define APT_CACHE_FILE_H
 
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include <apt-pkg/cachefile.h>
 #include <apt-pkg/pkgrecords.h>
@@ -32,6 +34,8 @@
 #include "pkg-list.h"
 
 class pkgProblemResolver;
+class GstCapsIndex;
+class SonameIndex;
 class AptCacheFile : public pkgCacheFile
 {
 public:
@@ -43,11 +47,32 @@ public:
      */
     bool Open(bool withLock = false);
 
+    /**
+     * Use the package cache and policy of the given shared cache instead of
+     * opening them again. The dependency cache is borrowed as well, unless
+     * @privateDepCache is set, in which case a new one is created on top of
+     * the shared package cache so this job can mark packages freely.
+     * The borrowed objects stay alive for as long as this cache is open.
+     */
+    bool Borrow(const std::shared_ptr<AptCacheFile> &shared, bool privateDepCache);
+
+    /**
+     * Replace a borrowed dependency cache with a private one, needs to be
+     * called before marking any packages on a borrowed cache.
+     */
+    bool ensurePrivateDepCache();
+
     /**
      * Closes the package cache
      */
     void Close();
 
+    /**
+     * Set the job progress and errors are reported to, may be nullptr
+     * once the cache is no longer used on behalf of a particular job.
+     */
+    void setJob(PkBackendJob *job);
+
     /**
      * Build caches
      */
@@ -170,12 +195,71 @@ public:
 
     void tryToRemove(pkgProblemResolver &Fix, const PkgInfo &pki);
 
+    /**
+     * The GStreamer capabilities of all packages, built on first use.
+     * A borrowed cache uses the index of the shared cache, so it is only
+     * built once for each package cache.
+     * Parsing every record takes a while, so the index is built without
+     * holding a lock, and one whose build was cancelled through @cancel is
+     * returned incomplete and never kept.
+     */
+    std::shared_ptr<const GstCapsIndex> gstCapsIndex(const bool &cancel);
+
+    /**
+     * The packages providing each shared library, built on first use and
+     * shared with borrowers just like gstCapsIndex(). A build cancelled
+     * through @cancel is returned incomplete and never kept.
+     */
+    std::shared_ptr<const SonameIndex> sonameIndex(const bool &cancel);
+
 private:
     void buildPkgRecords();
     static std::string debParser(std::string descr);
 
     std::unique_ptr<pkgRecords> m_packageRecords;
     PkBackendJob *m_job;
+    std::shared_ptr<AptCacheFile> m_shared;
+    bool m_borrowedDepCache;
+
+    std::mutex m_indexMutex;
+    std::shared_ptr<const GstCapsIndex> m_gstCapsIndex;
+    std::shared_ptr<const SonameIndex> m_sonameIndex;
+};
+
+/**
+ * Daemon-lifetime, read-only cache snapshot that query jobs borrow
+ * instead of opening the package cache each time.
+ */
+class AptSharedCache
+{
+public:
+    /**
+     * The state of all files the package cache is built from, used to
+     * detect changes made behind our back (e.g. by apt-get).
+     */
+    static std::vector<int64_t> currentStamp();
+
+    /**
+     * @returns the shared cache, or nullptr if there is none or the files it
+     * was built from changed since
+     */
+    static std::shared_ptr<AptCacheFile> get();
+
+    /**
+     * Publish @cache as the shared cache, @stamp is the currentStamp() taken
+     * before it was opened.
+     */
+    static void set(const std::shared_ptr<AptCacheFile> &cache, const std::vector<int64_t> &stamp);
+
+    /**
+     * Drop the shared cache, jobs still using it keep their reference.
+     */
+    static void invalidate(const char *reason);
+
+private:
+    static std::mutex s_mutex;
+    static std::shared_ptr<AptCacheFile> s_cache;
+    static std::vector<int64_t> s_stamp;
 };
 
 /**
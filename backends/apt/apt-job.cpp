@@ -48,6 +48,7 @@
 #include <sstream>
 #include <memory>
 #include <fstream>
+#include <shared_mutex>
 #include <dirent.h>
 
 #include "apt-cache-file.h"
@@ -56,6 +57,8 @@
 #include "apt-messages.h"
 #include "acqpkitstatus.h"
 #include "deb-file.h"
+#include "dpkg-file-index.h"
+#include "soname-index.h"
 
 using namespace APT;
 
@@ -72,28 +75,8 @@ AptJob::AptJob(PkBackendJob *job)
       m_terminalTimeout(120),
       m_child_pid(0)
 {
-    const gchar *http_proxy;
-    const gchar *ftp_proxy;
-
-    // set locale
-    setEnvLocaleFromJob();
-
-    // set http proxy
-    http_proxy = pk_backend_job_get_proxy_http(m_job);
-    if (http_proxy != nullptr) {
-        g_autofree gchar *uri = pk_backend_convert_uri(http_proxy);
-        g_setenv("http_proxy", uri, TRUE);
-    }
-
-    // set ftp proxy
-    ftp_proxy = pk_backend_job_get_proxy_ftp(m_job);
-    if (ftp_proxy != nullptr) {
-        g_autofree gchar *uri = pk_backend_convert_uri(ftp_proxy);
-        g_setenv("ftp_proxy", uri, TRUE);
-    }
-
-    // default settings
-    _config->CndSet("APT::Get::AutomaticRemove::Kernels", _config->FindB("APT::Get::AutomaticRemove", true));
+    // the locale and proxy of the job are set by runScheduled(), as jobs
+    // are created on the main thread while others may be running
 }
 
 AptJob::~AptJob() = default;
@@ -132,50 +115,62 @@ bool AptJob::init(gchar **localDebs)
 
     // Create the AptCacheFile class to search for packages
     m_cache = std::make_unique<AptCacheFile>(m_job);
-    if (localDebs) {
-        PkBitfield flags = pk_backend_job_get_transaction_flags(m_job);
-        if (pk_bitfield_contain(flags, PK_TRANSACTION_FLAG_ENUM_ONLY_TRUSTED)) {
-            // We are NOT simulating and have untrusted packages
-            // fail the transaction.
-            pk_backend_job_error_code(
-                m_job,
-                PK_ERROR_ENUM_CANNOT_INSTALL_REPO_UNSIGNED,
-                "Local packages cannot be authenticated");
-            return false;
-        }
 
-        for (guint i = 0; i < g_strv_length(localDebs); ++i)
-            markFileForInstall(localDebs[i]);
-    }
-
-    if (!m_cache->Open(withLock)) {
-        if (!withLock) {
-            show_errors(m_job, PK_ERROR_ENUM_TRANSACTION_ERROR);
+    // Queries borrow the daemon-wide cache instead of opening their own one,
+    // roles which mark packages get a private dependency cache on top of it
+    bool privateDepCache = false;
+    bool shared = localDebs == nullptr && !withLock && !AllowBroken && canUseSharedCache(role, &privateDepCache);
+    if (shared) {
+        if (!borrowSharedCache(privateDepCache))
             return false;
-        }
+    } else {
+        if (localDebs) {
+            PkBitfield flags = pk_backend_job_get_transaction_flags(m_job);
+            if (pk_bitfield_contain(flags, PK_TRANSACTION_FLAG_ENUM_ONLY_TRUSTED)) {
+                // We are NOT simulating and have untrusted packages
+                // fail the transaction.
+                pk_backend_job_error_code(
+                    m_job,
+                    PK_ERROR_ENUM_CANNOT_INSTALL_REPO_UNSIGNED,
+                    "Local packages cannot be authenticated");
+                return false;
+            }
 
-        // wait a bit for the lock to become available
-        int timeout = 60;
-        while (!m_cache->Open(withLock)) {
-            pk_backend_job_set_percentage(m_job, PK_BACKEND_PERCENTAGE_INVALID);
-            pk_backend_job_set_status(m_job, PK_STATUS_ENUM_WAITING_FOR_LOCK);
+            for (guint i = 0; i < g_strv_length(localDebs); ++i)
+                markFileForInstall(localDebs[i]);
+        }
 
-            if (timeout <= 0) {
-                show_errors(m_job, PK_ERROR_ENUM_CANNOT_GET_LOCK);
+        if (!m_cache->Open(withLock)) {
+            if (!withLock) {
+                show_errors(m_job, PK_ERROR_ENUM_TRANSACTION_ERROR);
                 return false;
-            } else {
-                _error->Discard();
-                timeout--;
-                sleep(1);
             }
 
-            // Close the cache if we are going to try again
-            m_cache->Close();
+            // wait a bit for the lock to become available
+            int timeout = 60;
+            while (!m_cache->Open(withLock)) {
+                pk_backend_job_set_percentage(m_job, PK_BACKEND_PERCENTAGE_INVALID);
+                pk_backend_job_set_status(m_job, PK_STATUS_ENUM_WAITING_FOR_LOCK);
+
+                if (timeout <= 0) {
+                    show_errors(m_job, PK_ERROR_ENUM_CANNOT_GET_LOCK);
+                    return false;
+                } else {
+                    _error->Discard();
+                    timeout--;
+                    sleep(1);
+                }
+
+                // Close the cache if we are going to try again
+                m_cache->Close();
+            }
         }
     }
 
+    // Jobs on the shared cache run concurrently and never invoke dpkg,
+    // so leave the global configuration alone for them
     m_interactive = pk_backend_job_get_interactive(m_job);
-    if (!m_interactive) {
+    if (!m_interactive && !shared) {
         // Do not ask about config updates if we are not interactive
         if (!dpkgHasForceConfFileSet()) {
             _config->Set("Dpkg::Options::", "--force-confdef");
@@ -189,10 +184,194 @@ bool AptJob::init(gchar **localDebs)
         g_setenv("APT_LISTBUGS_FRONTEND", "none", TRUE);
     }
 
+    // The shared dependency cache was already checked when it was opened
+    if (shared && !privateDepCache)
+        return true;
+
     // Check if there are half-installed packages and if we can fix them
     return m_cache->CheckDeps(AllowBroken);
 }
 
+bool AptJob::canUseSharedCache(PkRoleEnum role, bool *privateDepCache)
+{
+    switch (role) {
+    case PK_ROLE_ENUM_DEPENDS_ON:
+    case PK_ROLE_ENUM_GET_DETAILS:
+    case PK_ROLE_ENUM_GET_FILES:
+    case PK_ROLE_ENUM_GET_PACKAGES:
+    case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+    case PK_ROLE_ENUM_REQUIRED_BY:
+    case PK_ROLE_ENUM_RESOLVE:
+    case PK_ROLE_ENUM_SEARCH_DETAILS:
+    case PK_ROLE_ENUM_SEARCH_FILE:
+    case PK_ROLE_ENUM_SEARCH_GROUP:
+    case PK_ROLE_ENUM_SEARCH_NAME:
+    case PK_ROLE_ENUM_WHAT_PROVIDES:
+        *privateDepCache = false;
+        return true;
+    case PK_ROLE_ENUM_GET_UPDATES:
+        // marks all packages for a dist-upgrade
+        *privateDepCache = true;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Queries run concurrently on the shared cache, everything else is serialized
+static std::shared_mutex scheduler_rw_lock;
+
+// The locale and proxies are process-wide, so jobs running at the same time
+// have to agree on them. Values a job doesn't set don't matter to it.
+struct JobEnvironment {
+    std::string locale;
+    std::string httpProxy;
+    std::string ftpProxy;
+};
+
+// what was applied last, only changed while holding scheduler_rw_lock exclusively
+static JobEnvironment current_environment;
+
+static JobEnvironment jobEnvironment(PkBackendJob *job)
+{
+    JobEnvironment env;
+    const gchar *locale = pk_backend_job_get_locale(job);
+    const gchar *http_proxy = pk_backend_job_get_proxy_http(job);
+    const gchar *ftp_proxy = pk_backend_job_get_proxy_ftp(job);
+
+    if (locale != nullptr)
+        env.locale = locale;
+    if (http_proxy != nullptr) {
+        g_autofree gchar *uri = pk_backend_convert_uri(http_proxy);
+        env.httpProxy = uri;
+    }
+    if (ftp_proxy != nullptr) {
+        g_autofree gchar *uri = pk_backend_convert_uri(ftp_proxy);
+        env.ftpProxy = uri;
+    }
+    return env;
+}
+
+static bool environmentApplied(const JobEnvironment &env)
+{
+    return (env.locale.empty() || env.locale == current_environment.locale)
+        && (env.httpProxy.empty() || env.httpProxy == current_environment.httpProxy)
+        && (env.ftpProxy.empty() || env.ftpProxy == current_environment.ftpProxy);
+}
+
+static void applyEnvironment(const JobEnvironment &env)
+{
+    if (!env.locale.empty() && env.locale != current_environment.locale) {
+        // set daemon locale
+        setlocale(LC_ALL, env.locale.c_str());
+
+        // processes spawned by APT need to inherit the right locale as well
+        g_setenv("LANG", env.locale.c_str(), TRUE);
+        g_setenv("LANGUAGE", env.locale.c_str(), TRUE);
+        current_environment.locale = env.locale;
+    }
+    if (!env.httpProxy.empty()) {
+        g_setenv("http_proxy", env.httpProxy.c_str(), TRUE);
+        current_environment.httpProxy = env.httpProxy;
+    }
+    if (!env.ftpProxy.empty()) {
+        g_setenv("ftp_proxy", env.ftpProxy.c_str(), TRUE);
+        current_environment.ftpProxy = env.ftpProxy;
+    }
+}
+
+static bool roleChangesSystem(PkRoleEnum role)
+{
+    switch (role) {
+    case PK_ROLE_ENUM_INSTALL_FILES:
+    case PK_ROLE_ENUM_INSTALL_PACKAGES:
+    case PK_ROLE_ENUM_REFRESH_CACHE:
+    case PK_ROLE_ENUM_REMOVE_PACKAGES:
+    case PK_ROLE_ENUM_REPAIR_SYSTEM:
+    case PK_ROLE_ENUM_REPO_ENABLE:
+    case PK_ROLE_ENUM_REPO_REMOVE:
+    case PK_ROLE_ENUM_REPO_SET_DATA:
+    case PK_ROLE_ENUM_UPDATE_PACKAGES:
+    case PK_ROLE_ENUM_UPGRADE_SYSTEM:
+        return true;
+    default:
+        return false;
+    }
+}
+
+template<typename Lock>
+static void waitForLock(PkBackendJob *job, Lock &lock)
+{
+    if (lock.try_lock())
+        return;
+
+    pk_backend_job_set_status(job, PK_STATUS_ENUM_WAITING_FOR_LOCK);
+    lock.lock();
+}
+
+void AptJob::runScheduled(PkBackendJob *job, PkRoleEnum role, const std::function<void()> &func)
+{
+    bool privateDepCache;
+    const JobEnvironment env = jobEnvironment(job);
+
+    if (canUseSharedCache(role, &privateDepCache)) {
+        std::shared_lock<std::shared_mutex> lock(scheduler_rw_lock, std::defer_lock);
+        waitForLock(job, lock);
+
+        // a query with another locale or proxy than the running ones waits
+        // for them to finish, switches and queues up again
+        while (!environmentApplied(env)) {
+            lock.unlock();
+            {
+                std::unique_lock<std::shared_mutex> exclusive(scheduler_rw_lock);
+                applyEnvironment(env);
+            }
+            lock.lock();
+        }
+        func();
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(scheduler_rw_lock, std::defer_lock);
+    waitForLock(job, lock);
+    applyEnvironment(env);
+    func();
+
+    // never hand out a snapshot from before a change we made ourselves
+    if (roleChangesSystem(role))
+        AptSharedCache::invalidate(pk_role_enum_to_string(role));
+}
+
+bool AptJob::borrowSharedCache(bool privateDepCache)
+{
+    auto shared = AptSharedCache::get();
+    if (!shared) {
+        // take the stamp first, so changes made while opening are noticed later
+        const auto stamp = AptSharedCache::currentStamp();
+
+        shared = std::make_shared<AptCacheFile>(m_job);
+        if (!shared->Open(false)) {
+            show_errors(m_job, PK_ERROR_ENUM_TRANSACTION_ERROR);
+            return false;
+        }
+        if (!shared->CheckDeps(false))
+            return false;
+
+        // the shared cache outlives this job
+        shared->setJob(nullptr);
+        AptSharedCache::set(shared, stamp);
+    } else {
+        g_debug("Using shared APT cache");
+    }
+
+    if (!m_cache->Borrow(shared, privateDepCache)) {
+        show_errors(m_job, PK_ERROR_ENUM_TRANSACTION_ERROR);
+        return false;
+    }
+
+    return true;
+}
+
 void AptJob::setEnvLocaleFromJob()
 {
     const gchar *locale = pk_backend_job_get_locale(m_job);
@@ -333,6 +512,10 @@ PkgList AptJob::filterPackages(const PkgList &packages, PkBitfield filters)
     if (pk_bitfield_contain(filters, PK_FILTER_ENUM_DOWNLOADED) && ret.size() > 0) {
         PkgList downloaded;
 
+        // marking packages must not touch a shared dependency cache
+        if (!m_cache->ensurePrivateDepCache() || !m_cache->CheckDeps(true))
+            return downloaded;
+
         pkgProblemResolver Fix(*m_cache);
         {
             pkgDepCache::ActionGroup group(*m_cache);
@@ -452,6 +635,10 @@ void AptJob::emitPackages(PkgList &output, PkBitfield filters, PkInfoEnum state,
     // create array of PK package data to emit
     g_autoptr(GPtrArray) pkgArray = g_ptr_array_new_full(output.size(), (GDestroyNotify)g_object_unref);
 
+    // the versions following two entries of the same package overlap, so
+    // stage every version once: the daemon relies on us for that
+    std::set<map_id_t> staged;
+
     for (const PkgInfo &info : output) {
         if (m_cancel)
             break;
@@ -459,14 +646,16 @@ void AptJob::emitPackages(PkgList &output, PkBitfield filters, PkInfoEnum state,
         auto ver = info.ver;
         // emit only the latest/chosen version if newest is requested
         if (!multiversion || pk_bitfield_contain(filters, PK_FILTER_ENUM_NEWEST)) {
-            stagePackageForEmit(pkgArray, info.ver, state);
+            if (staged.insert(ver->ID).second)
+                stagePackageForEmit(pkgArray, ver, state);
             continue;
         } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_NEWEST) && !ver.end()) {
             ver++;
         }
 
         for (; !ver.end(); ver++) {
-            stagePackageForEmit(pkgArray, ver, state);
+            if (staged.insert(ver->ID).second)
+                stagePackageForEmit(pkgArray, ver, state);
         }
     }
 
@@ -541,50 +730,12 @@ void AptJob::emitUpdates(PkgList &output, PkBitfield filters)
 // search packages which provide a codec (specified in "values")
 void AptJob::providesCodec(PkgList &output, gchar **values)
 {
-    string arch;
     GstMatcher matcher(values);
     if (!matcher.hasMatches()) {
         return;
     }
 
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
-            break;
-        }
-
-        // Ignore packages that exist only due to dependencies.
-        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
-        }
-
-        // Ignore debug packages - these aren't interesting as codec providers,
-        // but they do have apt GStreamer-* metadata.
-        if (ends_with(pkg.Name(), "-dbg") || ends_with(pkg.Name(), "-dbgsym")) {
-            continue;
-        }
-
-        // TODO search in updates packages
-        // Ignore virtual packages
-        pkgCache::VerIterator ver = m_cache->findVer(pkg);
-        if (ver.end()) {
-            ver = m_cache->findCandidateVer(pkg);
-        }
-        if (ver.end()) {
-            continue;
-        }
-
-        arch = string(ver.Arch());
-        bool native = arch == "all" || arch == m_cache->GetPkgCache()->NativeArch();
-
-        pkgCache::VerFileIterator vf = ver.FileList();
-        pkgRecords::Parser &rec = m_cache->GetPkgRecords()->Lookup(vf);
-        const char *start, *stop;
-        rec.GetRec(start, stop);
-        string record(start, stop - start);
-        if (matcher.matches(record, native)) {
-            output.append(ver);
-        }
-    }
+    m_cache->gstCapsIndex(m_cancel)->findProviders(matcher, output, m_cancel);
 }
 
 // search packages which provide the libraries specified in "values"
@@ -603,59 +754,13 @@ void AptJob::providesLibrary(PkgList &output, gchar **values)
         return;
     }
 
-    const char *libreg_str = "^\\(lib.*\\)\\.so\\.[0-9]*";
-    g_debug("RegStr: %s", libreg_str);
-    regex_t libreg;
-    if (regcomp(&libreg, libreg_str, 0) != 0) {
-        g_debug("Error compiling regular expression to match libraries.");
-        return;
-    }
-
-    gchar *value;
+    std::shared_ptr<const SonameIndex> index = m_cache->sonameIndex(m_cancel);
     for (uint i = 0; i < g_strv_length(values); i++) {
-        value = values[i];
-        regmatch_t matches[2];
-        if (regexec(&libreg, value, 2, matches, 0) != REG_NOMATCH) {
-            string libPkgName = string(value, matches[1].rm_so, matches[1].rm_eo - matches[1].rm_so);
-
-            string strvalue = string(value);
-            ssize_t pos = strvalue.find(".so.");
-            if ((pos > 0) && ((size_t)pos != string::npos)) {
-                // If last char is a number, add a "-" (to be policy-compliant)
-                if (g_ascii_isdigit(libPkgName.at(libPkgName.length() - 1))) {
-                    libPkgName.append("-");
-                }
-
-                libPkgName.append(strvalue.substr(pos + 4));
-            }
-
-            g_debug("pkg-name: %s", libPkgName.c_str());
-
-            for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-                // Ignore packages that exist only due to dependencies.
-                if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-                    continue;
-                }
-
-                // TODO: Ignore virtual packages
-                pkgCache::VerIterator ver = m_cache->findVer(pkg);
-                if (ver.end()) {
-                    ver = m_cache->findCandidateVer(pkg);
-                    if (ver.end()) {
-                        continue;
-                    }
-                }
-
-                // Make everything lower-case
-                std::transform(libPkgName.begin(), libPkgName.end(), libPkgName.begin(), ::tolower);
-
-                if (g_strcmp0(pkg.Name(), libPkgName.c_str()) == 0) {
-                    output.append(ver);
-                }
-            }
-        } else {
-            g_debug("libmatcher: Did not match: %s", value);
+        if (m_cancel) {
+            break;
         }
+
+        index->findProviders(values[i], output);
     }
 }
 
@@ -1199,11 +1304,9 @@ PkgList AptJob::searchPackageDetails(const vector<string> &queries)
     return output;
 }
 
-// used to return files it reads, using the info from the files in /var/lib/dpkg/info/
-PkgList AptJob::searchPackageFiles(gchar **values)
+// scans the .list files in the dpkg info directory for paths matching "values"
+void AptJob::scanPackageFiles(gchar **values, const string &infoDir, std::set<string> &packages)
 {
-    PkgList output;
-    vector<string> packages;
     string search;
     regex_t re;
 
@@ -1229,15 +1332,15 @@ PkgList AptJob::searchPackageFiles(gchar **values)
 
     if (regcomp(&re, search.c_str(), REG_NOSUB) != 0) {
         g_debug("Regex compilation error");
-        return output;
+        return;
     }
 
     DIR *dp;
     struct dirent *dirp;
-    if (!(dp = opendir("/var/lib/dpkg/info/"))) {
-        g_debug("Error opening /var/lib/dpkg/info/\n");
+    if (!(dp = opendir(infoDir.c_str()))) {
+        g_debug("Error opening %s", infoDir.c_str());
         regfree(&re);
-        return output;
+        return;
     }
 
     string line;
@@ -1248,7 +1351,7 @@ PkgList AptJob::searchPackageFiles(gchar **values)
 
         if (ends_with(dirp->d_name, ".list")) {
             string file(dirp->d_name);
-            string f = "/var/lib/dpkg/info/" + file;
+            string f = infoDir + file;
             std::ifstream in(f.c_str());
             if (!in) {
                 continue;
@@ -1257,7 +1360,7 @@ PkgList AptJob::searchPackageFiles(gchar **values)
             while (!in.eof()) {
                 getline(in, line);
                 if (regexec(&re, line.c_str(), (size_t)0, nullptr, 0) == 0) {
-                    packages.push_back(file.erase(file.size() - 5, file.size()));
+                    packages.insert(file.erase(file.size() - 5, file.size()));
                     break;
                 }
             }
@@ -1265,6 +1368,27 @@ PkgList AptJob::searchPackageFiles(gchar **values)
     }
     closedir(dp);
     regfree(&re);
+}
+
+// used to return files it reads, using the info from the files in /var/lib/dpkg/info/
+PkgList AptJob::searchPackageFiles(gchar **values)
+{
+    PkgList output;
+    std::set<string> packages;
+
+    const string statusFile = _config->FindFile("Dir::State::status");
+    const string infoDir = flNotFile(statusFile) + "info/";
+
+    // the index only needs to re-read the .list files which changed since
+    // it was last written, so prefer it over scanning all of them
+    DpkgFileIndex index(infoDir, statusFile, PK_DB_DIR "/apt-file-index");
+    if (index.update()) {
+        for (uint i = 0; i < g_strv_length(values); ++i)
+            index.findPackages(values[i], packages);
+    } else {
+        g_debug("dpkg file index is unavailable, scanning file lists");
+        scanPackageFiles(values, infoDir, packages);
+    }
 
     // Resolve the package names now
     for (const string &name : packages) {
@@ -2638,9 +2762,14 @@ bool AptJob::installPackages(PkBitfield flags)
         return false;
     }
 
+    // dpkg is about to change its status file, which is our own doing
+    // and must not be reported as an external change
+    pk_backend_transaction_inhibit_start(backend);
+
     int pty_master;
     m_child_pid = forkpty(&pty_master, nullptr, nullptr, nullptr);
     if (m_child_pid == -1) {
+        pk_backend_transaction_inhibit_end(backend);
         return false;
     }
 
@@ -2742,6 +2871,7 @@ bool AptJob::installPackages(PkBitfield flags)
     close(readFromChildFD[1]);
     close(pty_master);
     _system->LockInner();
+    pk_backend_transaction_inhibit_end(backend);
 
     g_debug("Parent process finished: %d", ret);
 
@@ -23,7 +23,9 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <set>
 #include <vector>
 
 #include <glib.h>
@@ -49,6 +51,19 @@ public:
     ~AptJob();
 
     bool init(gchar **localDebs = nullptr);
+
+    /**
+     * Whether jobs with the given role can work on the shared cache,
+     * @privateDepCache is set if the role needs to mark packages.
+     */
+    static bool canUseSharedCache(PkRoleEnum role, bool *privateDepCache);
+
+    /**
+     * Runs @func for a job with the given role once no conflicting job is
+     * running anymore. Jobs that can use the shared cache run concurrently,
+     * all others run alone and drop the shared cache if they changed the system.
+     */
+    static void runScheduled(PkBackendJob *job, PkRoleEnum role, const std::function<void()> &func);
     void cancel();
     bool cancelled() const;
 
@@ -271,10 +286,12 @@ public:
 
 private:
     void setEnvLocaleFromJob();
+    bool borrowSharedCache(bool privateDepCache);
     bool checkTrusted(pkgAcquire &fetcher, PkBitfield flags);
     bool packageIsSupported(const pkgCache::VerIterator &verIter, std::string component);
     bool isApplication(const pkgCache::VerIterator &verIter);
     bool matchesQueries(const std::vector<std::string> &queries, std::string s);
+    void scanPackageFiles(gchar **values, const std::string &infoDir, std::set<std::string> &packages);
     bool dpkgHasForceConfFileSet();
     PkInfoEnum packageStateFromVer(const pkgCache::VerIterator &ver) const;
     void stagePackageForEmit(
@@ -0,0 +1,452 @@
+/* dpkg-file-index.cpp - Persistent path to package index
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "dpkg-file-index.h"
+
+#include <glib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DPKG_FILE_INDEX_MAGIC   "PKDPKGIX"
+#define DPKG_FILE_INDEX_VERSION 1
+
+struct DpkgFileIndex::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t nPackages;
+    uint32_t nPaths;
+    uint32_t nBuckets;
+    int64_t statusMtime;
+    int64_t dirMtime;
+    uint64_t stringsSize;
+};
+
+struct DpkgFileIndex::Package {
+    int64_t mtime;
+    uint64_t size;
+    uint32_t nameOff;
+    uint32_t nameLen;
+};
+
+struct DpkgFileIndex::Path {
+    uint32_t off;
+    uint32_t len;
+    uint32_t baseLen;
+    uint32_t pkg;
+};
+
+static int64_t statMtime(const struct stat &st)
+{
+    return (int64_t)st.st_mtim.tv_sec * G_GINT64_CONSTANT(1000000000) + st.st_mtim.tv_nsec;
+}
+
+static uint32_t basenameHash(std::string_view base)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : base) {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static size_t basenameLength(std::string_view path)
+{
+    size_t pos = path.rfind('/');
+    return pos == std::string_view::npos ? path.size() : path.size() - pos - 1;
+}
+
+DpkgFileIndex::DpkgFileIndex(const std::string &infoDir, const std::string &statusFile, const std::string &indexFile)
+    : m_infoDir(infoDir),
+      m_statusFile(statusFile),
+      m_indexFile(indexFile),
+      m_data(nullptr),
+      m_size(0),
+      m_mapped(false)
+{
+    static_assert(sizeof(Header) % 8 == 0, "index header must keep the tables aligned");
+    static_assert(sizeof(Package) % 8 == 0, "package table entries must stay aligned");
+    static_assert(sizeof(Path) % 8 == 0, "path table entries must stay aligned");
+}
+
+DpkgFileIndex::~DpkgFileIndex()
+{
+    unload();
+}
+
+const DpkgFileIndex::Header *DpkgFileIndex::header() const
+{
+    return reinterpret_cast<const Header *>(m_data);
+}
+
+const DpkgFileIndex::Package *DpkgFileIndex::packages() const
+{
+    return reinterpret_cast<const Package *>(m_data + sizeof(Header));
+}
+
+const DpkgFileIndex::Path *DpkgFileIndex::paths() const
+{
+    return reinterpret_cast<const Path *>(packages() + header()->nPackages);
+}
+
+const uint32_t *DpkgFileIndex::buckets() const
+{
+    return reinterpret_cast<const uint32_t *>(paths() + header()->nPaths);
+}
+
+const uint32_t *DpkgFileIndex::chain() const
+{
+    return buckets() + header()->nBuckets + 1;
+}
+
+const char *DpkgFileIndex::strings() const
+{
+    return reinterpret_cast<const char *>(chain() + header()->nPaths);
+}
+
+std::string_view DpkgFileIndex::pathAt(uint32_t idx) const
+{
+    const Path &p = paths()[idx];
+    return std::string_view(strings() + p.off, p.len);
+}
+
+std::string_view DpkgFileIndex::packageNameAt(uint32_t idx) const
+{
+    const Package &p = packages()[idx];
+    return std::string_view(strings() + p.nameOff, p.nameLen);
+}
+
+size_t DpkgFileIndex::size() const
+{
+    return m_data == nullptr ? 0 : header()->nPaths;
+}
+
+void DpkgFileIndex::unload()
+{
+    if (m_mapped)
+        munmap(const_cast<char *>(m_data), m_size);
+    m_buffer.clear();
+    m_buffer.shrink_to_fit();
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = false;
+}
+
+bool DpkgFileIndex::load()
+{
+    struct stat st;
+
+    int fd = open(m_indexFile.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header)) {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    unload();
+    m_data = static_cast<const char *>(data);
+    m_size = st.st_size;
+    m_mapped = true;
+
+    if (!validate()) {
+        g_debug("Ignoring invalid dpkg file index %s", m_indexFile.c_str());
+        unload();
+        return false;
+    }
+
+    return true;
+}
+
+bool DpkgFileIndex::validate() const
+{
+    // validate the table sizes against the file size before trusting any offset
+    const Header *h = header();
+    uint64_t expected = sizeof(Header) + (uint64_t)h->nPackages * sizeof(Package)
+                        + (uint64_t)h->nPaths * sizeof(Path) + ((uint64_t)h->nBuckets + 1) * sizeof(uint32_t)
+                        + (uint64_t)h->nPaths * sizeof(uint32_t) + h->stringsSize;
+    if (memcmp(h->magic, DPKG_FILE_INDEX_MAGIC, sizeof(h->magic)) != 0 || h->version != DPKG_FILE_INDEX_VERSION
+        || h->nBuckets == 0 || (h->nBuckets & (h->nBuckets - 1)) != 0 || expected != m_size) {
+        return false;
+    }
+
+    // then every string and table reference, the file may be truncated
+    // or corrupted in place without changing its size
+    for (uint32_t i = 0; i < h->nPackages; i++) {
+        const Package &p = packages()[i];
+        if ((uint64_t)p.nameOff + p.nameLen > h->stringsSize)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < h->nPaths; i++) {
+        const Path &p = paths()[i];
+        if ((uint64_t)p.off + p.len > h->stringsSize || p.baseLen > p.len || p.pkg >= h->nPackages)
+            return false;
+    }
+
+    // the buckets are ascending offsets into the chain, which holds path indices
+    if (buckets()[0] != 0 || buckets()[h->nBuckets] != h->nPaths)
+        return false;
+    for (uint32_t b = 0; b < h->nBuckets; b++) {
+        if (buckets()[b] > buckets()[b + 1])
+            return false;
+    }
+    for (uint32_t i = 0; i < h->nPaths; i++) {
+        if (chain()[i] >= h->nPaths)
+            return false;
+    }
+
+    return true;
+}
+
+bool DpkgFileIndex::isFresh(int64_t statusMtime, int64_t dirMtime) const
+{
+    // dpkg rewrites its status file after every change and renames the
+    // .list files into place, so both stamps together cover all updates
+    return m_data != nullptr && header()->statusMtime == statusMtime && header()->dirMtime == dirMtime;
+}
+
+bool DpkgFileIndex::scanInfoDir(std::vector<ListStamp> &stamps) const
+{
+    DIR *dp = opendir(m_infoDir.c_str());
+    if (dp == nullptr) {
+        g_debug("Error opening %s", m_infoDir.c_str());
+        return false;
+    }
+
+    struct dirent *dirp;
+    while ((dirp = readdir(dp)) != nullptr) {
+        std::string_view name(dirp->d_name);
+        if (name.size() <= 5 || name.substr(name.size() - 5) != ".list")
+            continue;
+
+        struct stat st;
+        if (fstatat(dirfd(dp), dirp->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode))
+            continue;
+
+        stamps.push_back({std::string(name.substr(0, name.size() - 5)), statMtime(st), (uint64_t)st.st_size});
+    }
+    closedir(dp);
+
+    std::sort(stamps.begin(), stamps.end(), [](const ListStamp &a, const ListStamp &b) {
+        return a.name < b.name;
+    });
+    return true;
+}
+
+bool DpkgFileIndex::rebuild(int64_t statusMtime, int64_t dirMtime)
+{
+    std::vector<ListStamp> stamps;
+    if (!scanInfoDir(stamps))
+        return false;
+
+    // map the packages whose .list file is unchanged to their old index
+    std::unordered_map<std::string_view, uint32_t> oldPackages;
+    if (m_data != nullptr) {
+        for (uint32_t i = 0; i < header()->nPackages; i++)
+            oldPackages.emplace(packageNameAt(i), i);
+    }
+
+    std::string blob;
+    std::vector<Package> newPackages;
+    std::vector<Path> newPaths;
+    std::vector<uint32_t> oldToNew(m_data == nullptr ? 0 : header()->nPackages, G_MAXUINT32);
+    std::vector<uint32_t> changed;
+
+    newPackages.reserve(stamps.size());
+    for (const ListStamp &stamp : stamps) {
+        uint32_t idx = newPackages.size();
+        newPackages.push_back({stamp.mtime, stamp.size, (uint32_t)blob.size(), (uint32_t)stamp.name.size()});
+        blob.append(stamp.name);
+
+        auto it = oldPackages.find(stamp.name);
+        if (it != oldPackages.end() && packages()[it->second].mtime == stamp.mtime
+            && packages()[it->second].size == stamp.size) {
+            oldToNew[it->second] = idx;
+        } else {
+            changed.push_back(idx);
+        }
+    }
+
+    auto addPath = [&](std::string_view path, uint32_t pkg) {
+        newPaths.push_back({(uint32_t)blob.size(), (uint32_t)path.size(), (uint32_t)basenameLength(path), pkg});
+        blob.append(path);
+    };
+
+    // carry over the paths of all unchanged packages
+    if (m_data != nullptr) {
+        for (uint32_t i = 0; i < header()->nPaths; i++) {
+            uint32_t pkg = oldToNew[paths()[i].pkg];
+            if (pkg != G_MAXUINT32)
+                addPath(pathAt(i), pkg);
+        }
+    }
+
+    // and read the .list files of everything else
+    std::string line;
+    for (uint32_t idx : changed) {
+        const ListStamp &stamp = stamps[idx];
+        std::ifstream in(m_infoDir + "/" + stamp.name + ".list");
+        if (!in)
+            continue;
+        while (getline(in, line)) {
+            if (!line.empty())
+                addPath(line, idx);
+        }
+    }
+
+    if (blob.size() > G_MAXUINT32) {
+        g_warning("dpkg file list too large to be indexed");
+        return false;
+    }
+
+    g_debug(
+        "Rebuilding dpkg file index: %zu packages, %zu re-read, %zu paths",
+        newPackages.size(),
+        changed.size(),
+        newPaths.size());
+
+    std::sort(newPaths.begin(), newPaths.end(), [&blob](const Path &a, const Path &b) {
+        std::string_view pa(blob.data() + a.off, a.len);
+        std::string_view pb(blob.data() + b.off, b.len);
+        return pa < pb || (pa == pb && a.pkg < b.pkg);
+    });
+
+    // bucket the paths by the hash of their basename
+    uint32_t nBuckets = 1;
+    while (nBuckets < newPaths.size() / 2)
+        nBuckets <<= 1;
+    std::vector<uint32_t> newBuckets(nBuckets + 1, 0);
+    std::vector<uint32_t> hashes(newPaths.size());
+    for (uint32_t i = 0; i < newPaths.size(); i++) {
+        const Path &p = newPaths[i];
+        std::string_view base(blob.data() + p.off + p.len - p.baseLen, p.baseLen);
+        hashes[i] = basenameHash(base) & (nBuckets - 1);
+        newBuckets[hashes[i] + 1]++;
+    }
+    for (uint32_t b = 0; b < nBuckets; b++)
+        newBuckets[b + 1] += newBuckets[b];
+    std::vector<uint32_t> newChain(newPaths.size());
+    std::vector<uint32_t> fill(newBuckets.begin(), newBuckets.end() - 1);
+    for (uint32_t i = 0; i < newPaths.size(); i++)
+        newChain[fill[hashes[i]]++] = i;
+
+    Header h = {};
+    memcpy(h.magic, DPKG_FILE_INDEX_MAGIC, sizeof(h.magic));
+    h.version = DPKG_FILE_INDEX_VERSION;
+    h.nPackages = newPackages.size();
+    h.nPaths = newPaths.size();
+    h.nBuckets = nBuckets;
+    h.statusMtime = statusMtime;
+    h.dirMtime = dirMtime;
+    h.stringsSize = blob.size();
+
+    std::vector<char> buffer;
+    auto append = [&buffer](const void *data, size_t len) {
+        const char *c = static_cast<const char *>(data);
+        buffer.insert(buffer.end(), c, c + len);
+    };
+    buffer.reserve(
+        sizeof(Header) + newPackages.size() * sizeof(Package) + newPaths.size() * sizeof(Path)
+        + newBuckets.size() * sizeof(uint32_t) + newChain.size() * sizeof(uint32_t) + blob.size());
+    append(&h, sizeof(h));
+    append(newPackages.data(), newPackages.size() * sizeof(Package));
+    append(newPaths.data(), newPaths.size() * sizeof(Path));
+    append(newBuckets.data(), newBuckets.size() * sizeof(uint32_t));
+    append(newChain.data(), newChain.size() * sizeof(uint32_t));
+    append(blob.data(), blob.size());
+
+    // persisting is best-effort, e.g. when running unprivileged we simply
+    // keep the index in memory for the lifetime of this object
+    g_autoptr(GError) error = nullptr;
+    if (!g_file_set_contents(m_indexFile.c_str(), buffer.data(), buffer.size(), &error))
+        g_debug("Failed to write dpkg file index: %s", error->message);
+
+    unload();
+    m_buffer = std::move(buffer);
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+
+    return true;
+}
+
+bool DpkgFileIndex::update()
+{
+    struct stat statusSt;
+    struct stat dirSt;
+
+    if (stat(m_statusFile.c_str(), &statusSt) != 0 || stat(m_infoDir.c_str(), &dirSt) != 0)
+        return false;
+
+    if (m_data == nullptr)
+        load();
+    if (isFresh(statMtime(statusSt), statMtime(dirSt)))
+        return true;
+
+    return rebuild(statMtime(statusSt), statMtime(dirSt));
+}
+
+void DpkgFileIndex::findPackages(std::string_view value, std::set<std::string> &result) const
+{
+    if (m_data == nullptr || value.empty())
+        return;
+
+    if (value[0] == '/') {
+        // exact match, binary search on the sorted path table
+        const Path *begin = paths();
+        const Path *end = begin + header()->nPaths;
+        const Path *it = std::lower_bound(begin, end, value, [this](const Path &p, std::string_view v) {
+            return std::string_view(strings() + p.off, p.len) < v;
+        });
+        for (; it != end && std::string_view(strings() + it->off, it->len) == value; ++it)
+            result.emplace(packageNameAt(it->pkg));
+        return;
+    }
+
+    std::string_view base = value.substr(value.size() - basenameLength(value));
+    if (base.empty())
+        return;
+
+    uint32_t bucket = basenameHash(base) & (header()->nBuckets - 1);
+    for (uint32_t i = buckets()[bucket]; i < buckets()[bucket + 1]; i++) {
+        const Path &p = paths()[chain()[i]];
+        if (p.baseLen != base.size() || p.len <= value.size())
+            continue;
+
+        // only match whole trailing path components
+        std::string_view path = pathAt(chain()[i]);
+        if (path.substr(path.size() - value.size()) == value && path[path.size() - value.size() - 1] == '/')
+            result.emplace(packageNameAt(p.pkg));
+    }
+}
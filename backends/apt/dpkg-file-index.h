@@ -0,0 +1,108 @@
+/* dpkg-file-index.h - Persistent path to package index
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DPKG_FILE_INDEX_H
+#define DPKG_FILE_INDEX_H
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Memory-mapped index of all files listed in dpkg's "info/<package>.list" files.
+ *
+ * The index is a single file containing a path table sorted by path (for
+ * exact lookups) and a hash table over the path basenames (for lookups of
+ * trailing path components). It is rebuilt incrementally: only the .list
+ * files whose mtime or size changed since the last build are read again.
+ */
+class DpkgFileIndex
+{
+public:
+    /**
+     * @param infoDir the dpkg info directory, e.g. "/var/lib/dpkg/info"
+     * @param statusFile the dpkg status file, e.g. "/var/lib/dpkg/status"
+     * @param indexFile where the index should be persisted
+     */
+    DpkgFileIndex(const std::string &infoDir, const std::string &statusFile, const std::string &indexFile);
+    ~DpkgFileIndex();
+
+    DpkgFileIndex(const DpkgFileIndex &) = delete;
+    DpkgFileIndex &operator=(const DpkgFileIndex &) = delete;
+
+    /**
+     * Load the index, refreshing it if the dpkg database changed since it
+     * was written.
+     * @returns false if no up-to-date index is available, in which case the
+     * caller should scan the .list files itself
+     */
+    bool update();
+
+    /**
+     * Add the names of all packages owning a file matching @value to @result.
+     * Absolute paths are matched exactly, anything else is matched against
+     * the trailing path components (e.g. "ls" or "bin/ls").
+     * Package names carry an ":arch" suffix if dpkg records one.
+     */
+    void findPackages(std::string_view value, std::set<std::string> &result) const;
+
+    /**
+     * @returns the number of paths in the index
+     */
+    size_t size() const;
+
+private:
+    struct Header;
+    struct Package;
+    struct Path;
+    struct ListStamp {
+        std::string name;
+        int64_t mtime;
+        uint64_t size;
+    };
+
+    bool load();
+    bool validate() const;
+    void unload();
+    bool isFresh(int64_t statusMtime, int64_t dirMtime) const;
+    bool scanInfoDir(std::vector<ListStamp> &stamps) const;
+    bool rebuild(int64_t statusMtime, int64_t dirMtime);
+
+    const Header *header() const;
+    const Package *packages() const;
+    const Path *paths() const;
+    const uint32_t *buckets() const;
+    const uint32_t *chain() const;
+    const char *strings() const;
+    std::string_view pathAt(uint32_t idx) const;
+    std::string_view packageNameAt(uint32_t idx) const;
+
+    std::string m_infoDir;
+    std::string m_statusFile;
+    std::string m_indexFile;
+
+    // either points into the mapped index file or into m_buffer
+    const char *m_data;
+    size_t m_size;
+    bool m_mapped;
+    std::vector<char> m_buffer;
+};
+
+#endif // DPKG_FILE_INDEX_H
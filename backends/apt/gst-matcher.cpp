@@ -19,19 +19,37 @@
  */
 
 #include "gst-matcher.h"
+#include "apt-cache-file.h"
 #include "apt-utils.h"
 
+#include <cstring>
+#include <mutex>
+#include <set>
 #include <regex.h>
 #include <gst/gst.h>
 
-static bool inited = false;
+static std::once_flag gst_inited;
 
-GstMatcher::GstMatcher(gchar **values)
+static void ensureGstInit()
 {
-    if (!inited) {
+    // matchers and indexes may be created by concurrent queries
+    std::call_once(gst_inited, []() {
         gst_init(nullptr, nullptr);
-        inited = true;
-    }
+    });
+}
+
+// the package record fields, in the same order as GstCapsIndex::Field
+static const char *const gstFields[] = {
+    "Gstreamer-Encoders",
+    "Gstreamer-Decoders",
+    "Gstreamer-Uri-Sources",
+    "Gstreamer-Uri-Sinks",
+    "Gstreamer-Elements",
+};
+
+GstMatcher::GstMatcher(gchar **values)
+{
+    ensureGstInit();
 
     // The search term from PackageKit daemon:
     // gstreamer0.10(urisource-foobar)
@@ -56,9 +74,8 @@ GstMatcher::GstMatcher(gchar **values)
             std::string version, type, data, opt;
             bool native = false;
 
-            // Appends the version "0.10"
-            version = "\nGstreamer-Version: ";
-            version.append(std::string(value, matches[1].rm_so, matches[1].rm_eo - matches[1].rm_so));
+            // version "0.10"
+            version = std::string(value, matches[1].rm_so, matches[1].rm_eo - matches[1].rm_so);
 
             // type (encode|decoder...)
             type = std::string(value, matches[3].rm_so, matches[3].rm_eo - matches[3].rm_so);
@@ -98,16 +115,17 @@ GstMatcher::GstMatcher(gchar **values)
                 }
             }
 
+            int field;
             if (type.compare("encoder") == 0) {
-                type = "Gstreamer-Encoders: ";
+                field = GstCapsIndex::Encoders;
             } else if (type.compare("decoder") == 0) {
-                type = "Gstreamer-Decoders: ";
+                field = GstCapsIndex::Decoders;
             } else if (type.compare("urisource") == 0) {
-                type = "Gstreamer-Uri-Sources: ";
+                field = GstCapsIndex::UriSources;
             } else if (type.compare("urisink") == 0) {
-                type = "Gstreamer-Uri-Sinks: ";
-            } else if (type.compare("element") == 0) {
-                type = "Gstreamer-Elements: ";
+                field = GstCapsIndex::UriSinks;
+            } else {
+                field = GstCapsIndex::Elements;
             }
 
             g_autofree gchar *capsString = nullptr;
@@ -122,7 +140,7 @@ GstMatcher::GstMatcher(gchar **values)
                 continue;
 
             mvals.version = version;
-            mvals.type = type;
+            mvals.field = field;
             mvals.data = data;
             mvals.opt = opt;
             mvals.caps = caps;
@@ -147,14 +165,15 @@ bool GstMatcher::matches(std::string record, bool native)
 {
     for (const Match &match : m_matches) {
         // Tries to find "Gstreamer-version: xxx"
-        if (record.find(match.version) != std::string::npos) {
+        if (record.find("\nGstreamer-Version: " + match.version) != std::string::npos) {
             size_t found;
             if (match.native && !native)
                 continue;
-            found = record.find(match.type);
+            const std::string type = std::string(gstFields[match.field]) + ": ";
+            found = record.find(type);
             // Tries to find the type "Gstreamer-Uri-Sinks: "
             if (found != std::string::npos) {
-                found += match.type.size(); // skips the "Gstreamer-Uri-Sinks: " string
+                found += type.size(); // skips the "Gstreamer-Uri-Sinks: " string
                 size_t endOfLine;
                 endOfLine = record.find('\n', found);
 
@@ -181,3 +200,106 @@ bool GstMatcher::hasMatches() const
 {
     return !m_matches.empty();
 }
+
+GstCapsIndex::GstCapsIndex(AptCacheFile &cache, const bool &cancel)
+{
+    ensureGstInit();
+
+    // a parser of our own, the one of the cache may be in use by a query
+    pkgRecords records(cache);
+    const char *nativeArch = cache.GetPkgCache()->NativeArch();
+    for (pkgCache::PkgIterator pkg = cache.GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
+        if (cancel) {
+            g_debug("Indexing GStreamer capabilities cancelled");
+            return;
+        }
+
+        // Ignore packages that exist only due to dependencies.
+        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
+            continue;
+        }
+
+        // Ignore debug packages - these aren't interesting as codec providers,
+        // but they do have apt GStreamer-* metadata.
+        if (ends_with(pkg.Name(), "-dbg") || ends_with(pkg.Name(), "-dbgsym")) {
+            continue;
+        }
+
+        // TODO search in updates packages
+        // Ignore virtual packages
+        pkgCache::VerIterator ver = cache.findVer(pkg);
+        if (ver.end()) {
+            ver = cache.findCandidateVer(pkg);
+        }
+        if (ver.end()) {
+            continue;
+        }
+
+        pkgRecords::Parser &rec = records.Lookup(ver.FileList());
+        const std::string version = rec.RecordField("Gstreamer-Version");
+        if (version.empty()) {
+            continue;
+        }
+
+        const bool native = strcmp(ver.Arch(), "all") == 0 || strcmp(ver.Arch(), nativeArch) == 0;
+        for (int field = 0; field < FieldCount; ++field) {
+            const std::string value = rec.RecordField(gstFields[field]);
+            if (value.empty()) {
+                continue;
+            }
+
+            GstCaps *caps = gst_caps_from_string(value.c_str());
+            if (caps == nullptr) {
+                continue;
+            }
+
+            m_entries[field].push_back({ver, version, native, caps});
+        }
+    }
+
+    size_t count = 0;
+    for (const auto &entries : m_entries) {
+        count += entries.size();
+    }
+    g_debug("Indexed %zu GStreamer capability sets", count);
+}
+
+GstCapsIndex::~GstCapsIndex()
+{
+    for (const auto &entries : m_entries) {
+        for (const Entry &entry : entries) {
+            gst_caps_unref(static_cast<GstCaps *>(entry.caps));
+        }
+    }
+}
+
+void GstCapsIndex::findProviders(const GstMatcher &matcher, PkgList &output, const bool &cancel) const
+{
+    std::set<map_id_t> found;
+    for (const Match &match : matcher.m_matches) {
+        for (const Entry &entry : m_entries[match.field]) {
+            if (cancel) {
+                return;
+            }
+
+            if (match.native && !entry.native) {
+                continue;
+            }
+
+            // "1" matches any 1.x release, as it did in the package record
+            if (!g_str_has_prefix(entry.version.c_str(), match.version.c_str())) {
+                continue;
+            }
+
+            if (found.count(entry.ver->ID) > 0) {
+                continue;
+            }
+
+            // if the record is capable of intersect them we found the package
+            if (gst_caps_can_intersect(static_cast<GstCaps *>(match.caps), static_cast<GstCaps *>(entry.caps))) {
+                found.insert(entry.ver->ID);
+                output.append(entry.ver);
+            }
+        }
+    }
+}
@@ -24,12 +24,19 @@
 
 #include <glib.h>
 
+#include <array>
 #include <vector>
 #include <string>
 
+#include <apt-pkg/pkgcache.h>
+
+#include "pkg-list.h"
+
+class AptCacheFile;
+
 typedef struct {
     std::string version;
-    std::string type;
+    int field;
     std::string data;
     std::string opt;
     void *caps;
@@ -46,7 +53,52 @@ public:
     bool hasMatches() const;
 
 private:
+    friend class GstCapsIndex;
     std::vector<Match> m_matches;
 };
 
+/**
+ * The GStreamer capabilities (Gstreamer-* fields) of all packages in a
+ * package cache, parsed once so codec lookups don't have to read and parse
+ * every package record again.
+ */
+class GstCapsIndex
+{
+public:
+    enum Field {
+        Encoders,
+        Decoders,
+        UriSources,
+        UriSinks,
+        Elements,
+        FieldCount
+    };
+
+    /**
+     * Index the current (or else candidate) version of all packages in @cache,
+     * stopping early once @cancel is set.
+     */
+    GstCapsIndex(AptCacheFile &cache, const bool &cancel);
+    ~GstCapsIndex();
+
+    GstCapsIndex(const GstCapsIndex &) = delete;
+    GstCapsIndex &operator=(const GstCapsIndex &) = delete;
+
+    /**
+     * Add all package versions providing any of the capabilities in @matcher
+     * to @output, stopping early once @cancel is set.
+     */
+    void findProviders(const GstMatcher &matcher, PkgList &output, const bool &cancel) const;
+
+private:
+    struct Entry {
+        pkgCache::VerIterator ver;
+        std::string version;
+        bool native;
+        void *caps;
+    };
+
+    std::array<std::vector<Entry>, FieldCount> m_entries;
+};
+
 #endif
@@ -54,8 +54,41 @@ const gchar *pk_backend_get_author(PkBackend *backend)
 
 gboolean pk_backend_supports_parallelization(PkBackend *backend)
 {
-    // we need to set this to TRUE as soon as the parallelization work is completed!
-    return FALSE;
+    return TRUE;
+}
+
+gboolean pk_backend_emits_unique_packages(PkBackend *backend, PkRoleEnum role)
+{
+    // these roles emit all their results at once through AptJob::emitPackages(),
+    // which already removes duplicates
+    switch (role) {
+    case PK_ROLE_ENUM_DEPENDS_ON:
+    case PK_ROLE_ENUM_GET_PACKAGES:
+    case PK_ROLE_ENUM_REQUIRED_BY:
+    case PK_ROLE_ENUM_RESOLVE:
+    case PK_ROLE_ENUM_SEARCH_DETAILS:
+    case PK_ROLE_ENUM_SEARCH_FILE:
+    case PK_ROLE_ENUM_SEARCH_GROUP:
+    case PK_ROLE_ENUM_SEARCH_NAME:
+    case PK_ROLE_ENUM_WHAT_PROVIDES:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+static void backend_shared_cache_changed_cb(PkBackend *backend, gpointer user_data)
+{
+    AptSharedCache::invalidate(static_cast<const char *>(user_data));
+}
+
+static void backend_dpkg_status_changed_cb(PkBackend *backend, gpointer user_data)
+{
+    // changes made by our own transactions drop the shared cache when the
+    // job finishes and are not announced as external changes
+    if (pk_backend_is_transaction_inhibited(backend))
+        return;
+    pk_backend_installed_db_changed(backend);
 }
 
 void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
@@ -79,16 +112,37 @@ void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
         g_debug("ERROR initializing backend configuration");
     }
 
+    // default settings
+    _config->CndSet("APT::Get::AutomaticRemove::Kernels", _config->FindB("APT::Get::AutomaticRemove", true));
+
     // pkgInitSystem is needed to compare the changelog verstion to
     // current package using DoCmpVersion()
     if (!pkgInitSystem(*_config, _system)) {
         g_debug("ERROR initializing backend system");
     }
+
+    // drop the cache shared by query jobs whenever the package database changes
+    g_signal_connect(
+        backend,
+        "installed-changed",
+        G_CALLBACK(backend_shared_cache_changed_cb),
+        (gpointer)"installed packages changed");
+    g_signal_connect(
+        backend,
+        "repo-list-changed",
+        G_CALLBACK(backend_shared_cache_changed_cb),
+        (gpointer)"repository list changed");
+    pk_backend_watch_file(
+        backend,
+        _config->FindFile("Dir::State::status").c_str(),
+        backend_dpkg_status_changed_cb,
+        nullptr);
 }
 
 void pk_backend_destroy(PkBackend *backend)
 {
     g_debug("APT backend being destroyed");
+    AptSharedCache::invalidate("backend destroyed");
 }
 
 PkBitfield pk_backend_get_groups(PkBackend *backend)
@@ -152,6 +206,23 @@ void pk_backend_start_job(PkBackend *backend, PkBackendJob *job)
     pk_backend_job_set_user_data(job, apt);
 }
 
+static void backend_job_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+    auto func = reinterpret_cast<PkBackendJobThreadFunc>(user_data);
+
+    AptJob::runScheduled(job, pk_backend_job_get_role(job), [&]() {
+        func(job, params, nullptr);
+    });
+}
+
+/**
+ * Runs @func in a new thread once no conflicting job is running anymore.
+ */
+static void backend_thread_create(PkBackendJob *job, PkBackendJobThreadFunc func)
+{
+    pk_backend_job_thread_create(job, backend_job_thread, reinterpret_cast<gpointer>(func), nullptr);
+}
+
 void pk_backend_stop_job(PkBackend *backend, PkBackendJob *job)
 {
     auto apt = static_cast<AptJob *>(pk_backend_job_get_user_data(job));
@@ -227,7 +298,7 @@ void pk_backend_depends_on(
     gchar **package_ids,
     gboolean recursive)
 {
-    pk_backend_job_thread_create(job, backend_depends_on_or_requires_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_depends_on_or_requires_thread);
 }
 
 void pk_backend_required_by(
@@ -237,7 +308,7 @@ void pk_backend_required_by(
     gchar **package_ids,
     gboolean recursive)
 {
-    pk_backend_job_thread_create(job, backend_depends_on_or_requires_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_depends_on_or_requires_thread);
 }
 
 static void backend_get_files_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -278,7 +349,7 @@ static void backend_get_files_thread(PkBackendJob *job, GVariant *params, gpoint
 
 void pk_backend_get_files(PkBackend *backend, PkBackendJob *job, gchar **package_ids)
 {
-    pk_backend_job_thread_create(job, backend_get_files_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_get_files_thread);
 }
 
 static void backend_get_details_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -317,17 +388,17 @@ static void backend_get_details_thread(PkBackendJob *job, GVariant *params, gpoi
 
 void pk_backend_get_update_detail(PkBackend *backend, PkBackendJob *job, gchar **package_ids)
 {
-    pk_backend_job_thread_create(job, backend_get_details_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_get_details_thread);
 }
 
 void pk_backend_get_details(PkBackend *backend, PkBackendJob *job, gchar **package_ids)
 {
-    pk_backend_job_thread_create(job, backend_get_details_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_get_details_thread);
 }
 
 void pk_backend_get_details_local(PkBackend *backend, PkBackendJob *job, gchar **files)
 {
-    pk_backend_job_thread_create(job, backend_get_details_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_get_details_thread);
 }
 
 static void backend_get_files_local_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -342,7 +413,7 @@ static void backend_get_files_local_thread(PkBackendJob *job, GVariant *params,
 
 void pk_backend_get_files_local(PkBackend *backend, PkBackendJob *job, gchar **files)
 {
-    pk_backend_job_thread_create(job, backend_get_files_local_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_get_files_local_thread);
 }
 
 static void backend_get_updates_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -378,7 +449,7 @@ static void backend_get_updates_thread(PkBackendJob *job, GVariant *params, gpoi
 
 void pk_backend_get_updates(PkBackend *backend, PkBackendJob *job, PkBitfield filters)
 {
-    pk_backend_job_thread_create(job, backend_get_updates_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_get_updates_thread);
 }
 
 static void backend_what_provides_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -414,7 +485,7 @@ static void backend_what_provides_thread(PkBackendJob *job, GVariant *params, gp
  */
 void pk_backend_what_provides(PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
 {
-    pk_backend_job_thread_create(job, backend_what_provides_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_what_provides_thread);
 }
 
 /**
@@ -518,7 +589,7 @@ static void pk_backend_download_packages_thread(PkBackendJob *job, GVariant *par
 
 void pk_backend_download_packages(PkBackend *backend, PkBackendJob *job, gchar **package_ids, const gchar *directory)
 {
-    pk_backend_job_thread_create(job, pk_backend_download_packages_thread, nullptr, nullptr);
+    backend_thread_create(job, pk_backend_download_packages_thread);
 }
 
 static void pk_backend_refresh_cache_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -545,7 +616,7 @@ static void pk_backend_refresh_cache_thread(PkBackendJob *job, GVariant *params,
 
 void pk_backend_refresh_cache(PkBackend *backend, PkBackendJob *job, gboolean force)
 {
-    pk_backend_job_thread_create(job, pk_backend_refresh_cache_thread, nullptr, nullptr);
+    backend_thread_create(job, pk_backend_refresh_cache_thread);
 }
 
 static void pk_backend_resolve_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -570,7 +641,7 @@ static void pk_backend_resolve_thread(PkBackendJob *job, GVariant *params, gpoin
 
 void pk_backend_resolve(PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **packages)
 {
-    pk_backend_job_thread_create(job, pk_backend_resolve_thread, nullptr, nullptr);
+    backend_thread_create(job, pk_backend_resolve_thread);
 }
 
 static void pk_backend_search_files_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -601,7 +672,7 @@ static void pk_backend_search_files_thread(PkBackendJob *job, GVariant *params,
 
 void pk_backend_search_files(PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
 {
-    pk_backend_job_thread_create(job, pk_backend_search_files_thread, nullptr, nullptr);
+    backend_thread_create(job, pk_backend_search_files_thread);
 }
 
 static void backend_search_groups_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -627,7 +698,7 @@ static void backend_search_groups_thread(PkBackendJob *job, GVariant *params, gp
 
 void pk_backend_search_groups(PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
 {
-    pk_backend_job_thread_create(job, backend_search_groups_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_search_groups_thread);
 }
 
 static void backend_search_package_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -675,12 +746,12 @@ static void backend_search_package_thread(PkBackendJob *job, GVariant *params, g
 
 void pk_backend_search_names(PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
 {
-    pk_backend_job_thread_create(job, backend_search_package_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_search_package_thread);
 }
 
 void pk_backend_search_details(PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
 {
-    pk_backend_job_thread_create(job, backend_search_package_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_search_package_thread);
 }
 
 static void backend_manage_packages_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -779,7 +850,7 @@ void pk_backend_install_packages(
     PkBitfield transaction_flags,
     gchar **package_ids)
 {
-    pk_backend_job_thread_create(job, backend_manage_packages_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_manage_packages_thread);
 }
 
 void pk_backend_update_packages(
@@ -788,12 +859,12 @@ void pk_backend_update_packages(
     PkBitfield transaction_flags,
     gchar **package_ids)
 {
-    pk_backend_job_thread_create(job, backend_manage_packages_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_manage_packages_thread);
 }
 
 void pk_backend_install_files(PkBackend *backend, PkBackendJob *job, PkBitfield transaction_flags, gchar **full_paths)
 {
-    pk_backend_job_thread_create(job, backend_manage_packages_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_manage_packages_thread);
 }
 
 void pk_backend_remove_packages(
@@ -804,12 +875,12 @@ void pk_backend_remove_packages(
     gboolean allow_deps,
     gboolean autoremove)
 {
-    pk_backend_job_thread_create(job, backend_manage_packages_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_manage_packages_thread);
 }
 
 void pk_backend_repair_system(PkBackend *backend, PkBackendJob *job, PkBitfield transaction_flags)
 {
-    pk_backend_job_thread_create(job, backend_manage_packages_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_manage_packages_thread);
 }
 
 static void backend_repo_manager_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -938,12 +1009,12 @@ static void backend_repo_manager_thread(PkBackendJob *job, GVariant *params, gpo
 
 void pk_backend_get_repo_list(PkBackend *backend, PkBackendJob *job, PkBitfield filters)
 {
-    pk_backend_job_thread_create(job, backend_repo_manager_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_repo_manager_thread);
 }
 
 void pk_backend_repo_enable(PkBackend *backend, PkBackendJob *job, const gchar *repo_id, gboolean enabled)
 {
-    pk_backend_job_thread_create(job, backend_repo_manager_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_repo_manager_thread);
 }
 
 void pk_backend_repo_remove(
@@ -953,7 +1024,7 @@ void pk_backend_repo_remove(
     const gchar *repo_id,
     gboolean autoremove)
 {
-    pk_backend_job_thread_create(job, backend_repo_manager_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_repo_manager_thread);
 }
 
 static void backend_get_packages_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -977,14 +1048,14 @@ static void backend_get_packages_thread(PkBackendJob *job, GVariant *params, gpo
 
 void pk_backend_get_packages(PkBackend *backend, PkBackendJob *job, PkBitfield filters)
 {
-    pk_backend_job_thread_create(job, backend_get_packages_thread, nullptr, nullptr);
+    backend_thread_create(job, backend_get_packages_thread);
 }
 
 /* TODO
 void
 pk_backend_get_categories (PkBackend *backend, PkBackendJob *job)
 {
-    pk_backend_job_thread_create (job, pk_backend_get_categories_thread, nullptr, nullptr);
+    backend_thread_create(job, pk_backend_get_categories_thread);
 }
 */
 
@@ -0,0 +1,217 @@
+/* soname-index.cpp - Shared library to package index
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "soname-index.h"
+#include "apt-cache-file.h"
+#include "apt-utils.h"
+
+#include <glib.h>
+
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#include <dirent.h>
+
+/**
+ * Split "libfoo.so.1.2" into "libfoo", the major version "1" and the full
+ * version "1.2", ignoring anything after the version.
+ */
+static bool splitSoname(std::string_view soname,
+                        std::string_view &base,
+                        std::string_view &major,
+                        std::string_view &version)
+{
+    if (soname.substr(0, 3) != "lib")
+        return false;
+
+    size_t pos = soname.rfind(".so.");
+    if (pos == std::string_view::npos || pos <= 3)
+        return false;
+
+    size_t start = pos + 4;
+    size_t end = start;
+    while (end < soname.size() && g_ascii_isdigit(soname[end]))
+        end++;
+    if (end == start)
+        return false;
+    major = soname.substr(start, end - start);
+
+    while (end < soname.size() && (g_ascii_isdigit(soname[end]) || soname[end] == '.'))
+        end++;
+    while (soname[end - 1] == '.')
+        end--;
+
+    base = soname.substr(0, pos);
+    version = soname.substr(start, end - start);
+    return true;
+}
+
+SonameIndex::SonameIndex(AptCacheFile &cache, const std::string &infoDir, const bool &cancel)
+{
+    for (pkgCache::PkgIterator pkg = cache.GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
+        if (cancel) {
+            g_debug("Indexing sonames cancelled");
+            return;
+        }
+
+        // Ignore packages that exist only due to dependencies.
+        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
+            continue;
+        }
+
+        pkgCache::VerIterator ver = cache.findVer(pkg);
+        if (ver.end()) {
+            ver = cache.findCandidateVer(pkg);
+            if (ver.end()) {
+                continue;
+            }
+        }
+
+        if (g_str_has_prefix(pkg.Name(), "lib")) {
+            m_packages[pkg.Name()].push_back(ver);
+        }
+
+        for (pkgCache::PrvIterator prv = ver.ProvidesList(); !prv.end(); ++prv) {
+            if (g_str_has_prefix(prv.Name(), "lib")) {
+                m_packages[prv.Name()].push_back(ver);
+            }
+        }
+    }
+
+    DIR *dp = opendir(infoDir.c_str());
+    if (dp == nullptr) {
+        g_debug("Error opening %s", infoDir.c_str());
+        return;
+    }
+
+    struct dirent *dirp;
+    while ((dirp = readdir(dp)) != nullptr && !cancel) {
+        if (ends_with(dirp->d_name, ".shlibs")) {
+            addShlibs(infoDir + dirp->d_name);
+        }
+    }
+    closedir(dp);
+
+    g_debug("Indexed %zu library package names and %zu sonames", m_packages.size(), m_shlibs.size());
+}
+
+void SonameIndex::addShlibs(const std::string &path)
+{
+    std::ifstream in(path);
+    std::string line;
+    while (getline(in, line)) {
+        // [<type>: ]<library> <soname version> <dependencies>
+        std::istringstream fields(line);
+        std::string library, version, dependency;
+        if (!(fields >> library >> version >> dependency)) {
+            continue;
+        }
+
+        // comments and udeb entries
+        if (library[0] == '#' || library.back() == ':') {
+            continue;
+        }
+
+        // only the first package of the dependencies provides the library
+        size_t end = dependency.find_first_of(",(|");
+        if (end != std::string::npos) {
+            dependency.erase(end);
+        }
+        if (dependency.empty()) {
+            continue;
+        }
+
+        m_shlibs[library + ".so." + version].push_back(dependency);
+    }
+}
+
+/**
+ * Build the package name of library @base with the soname version @version.
+ */
+static std::string libraryPackageName(std::string_view base, std::string_view version)
+{
+    std::string name(base);
+    // If last char is a number, add a "-" (to be policy-compliant)
+    if (g_ascii_isdigit(name.back())) {
+        name.append("-");
+    }
+    name.append(version);
+
+    // Make everything lower-case
+    for (char &c : name) {
+        c = g_ascii_tolower(c);
+    }
+
+    return name;
+}
+
+std::vector<std::string> SonameIndex::packageNames(std::string_view soname)
+{
+    std::string_view base, major, version;
+    if (!splitSoname(soname, base, major, version)) {
+        return {};
+    }
+
+    std::vector<std::string> names = {libraryPackageName(base, version)};
+    if (version != major) {
+        names.push_back(libraryPackageName(base, major));
+    }
+    return names;
+}
+
+void SonameIndex::findProviders(std::string_view soname, PkgList &output) const
+{
+    std::string_view base, major, version;
+    if (!splitSoname(soname, base, major, version)) {
+        g_debug("libmatcher: Did not match: %.*s", (int)soname.size(), soname.data());
+        return;
+    }
+
+    // the package name with only the major version is a fallback for
+    // libraries whose package doesn't carry the full soname version
+    std::vector<std::string> names;
+    for (std::string &name : packageNames(soname)) {
+        if (m_packages.find(name) != m_packages.end()) {
+            names.push_back(std::move(name));
+            break;
+        }
+    }
+
+    // shlibs files list the whole soname version, e.g. "libfoo 2.0"
+    // for libfoo.so.2.0
+    auto shlibs = m_shlibs.find(std::string(base) + ".so." + std::string(version));
+    if (shlibs != m_shlibs.end()) {
+        names.insert(names.end(), shlibs->second.begin(), shlibs->second.end());
+    }
+
+    std::set<map_id_t> found;
+    for (const std::string &name : names) {
+        g_debug("pkg-name: %s", name.c_str());
+        auto packages = m_packages.find(name);
+        if (packages == m_packages.end()) {
+            continue;
+        }
+
+        for (const pkgCache::VerIterator &ver : packages->second) {
+            if (found.insert(ver->ID).second) {
+                output.append(ver);
+            }
+        }
+    }
+}
@@ -0,0 +1,83 @@
+/* soname-index.h - Shared library to package index
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef SONAME_INDEX_H
+#define SONAME_INDEX_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <apt-pkg/pkgcache.h>
+
+#include "pkg-list.h"
+
+class AptCacheFile;
+
+/**
+ * Index of the packages providing a shared library, built from a package
+ * cache in a single pass.
+ *
+ * A soname such as "libfoo.so.1" is resolved through the shlibs files of
+ * installed packages, and through the Debian library package naming
+ * convention ("libfoo1", "libfoo2-1" for "libfoo2.so.1") matched against
+ * both real package names and Provides.
+ */
+class SonameIndex
+{
+public:
+    /**
+     * Index the current (or else candidate) version of all packages in
+     * @cache, and the shlibs files in the dpkg info directory @infoDir,
+     * stopping early once @cancel is set.
+     */
+    SonameIndex(AptCacheFile &cache, const std::string &infoDir, const bool &cancel);
+
+    SonameIndex(const SonameIndex &) = delete;
+    SonameIndex &operator=(const SonameIndex &) = delete;
+
+    /**
+     * Add all package versions providing @soname to @output.
+     * Anything following the version of the soname, e.g. the "()(64bit)"
+     * suffix of RPM style library dependencies, is ignored.
+     * Shlibs entries must match the full version ("libfoo 2.0" for
+     * "libfoo.so.2.0"), package names are looked up as returned by
+     * packageNames().
+     */
+    void findProviders(std::string_view soname, PkgList &output) const;
+
+    /**
+     * @returns the package names the Debian library packaging policy may
+     * give to the library @soname, most specific first: the name with the
+     * full version ("libssl1.1" for "libssl.so.1.1"), then the one with
+     * only the major version. Empty if @soname isn't a valid "lib*.so.N"
+     * soname.
+     */
+    static std::vector<std::string> packageNames(std::string_view soname);
+
+private:
+    void addShlibs(const std::string &path);
+
+    // lower-cased package or provides name -> providing versions
+    std::unordered_map<std::string, std::vector<pkgCache::VerIterator>> m_packages;
+    // soname -> package names listed in shlibs files
+    std::unordered_map<std::string, std::vector<std::string>> m_shlibs;
+};
+
+#endif // SONAME_INDEX_H
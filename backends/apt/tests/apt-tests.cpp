@@ -18,17 +18,32 @@
  * Boston, MA 02111-1307, USA.
  */
 
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
 #include <memory>
+#include <thread>
 #include <apt-pkg/configuration.h>
+#include <apt-pkg/error.h>
+#include <apt-pkg/init.h>
+#include <apt-pkg/pkgsystem.h>
 
+#include "apt-cache-file.h"
+#include "apt-job.h"
 #include "deb822.h"
 #include "apt-sourceslist.h"
 #include "apt-utils.h"
+#include "dpkg-file-index.h"
 #include "gst-matcher.h"
+#include "soname-index.h"
 
 namespace fs = std::filesystem;
 
+// defined with the other test stubs in definitions.cpp
+extern thread_local PkRoleEnum apt_test_job_role;
+extern thread_local const gchar *apt_test_job_locale;
+
 static std::string testdata_dir = "";
 
 const char *gst_plugins_bad_pkg = R"(Package: gstreamer1.0-plugins-bad
@@ -487,6 +502,96 @@ static void apt_test_source_record_assign(void)
     g_assert_cmpuint(target.Sections.size(), ==, 0);
 }
 
+static void apt_test_dpkg_file_index(void)
+{
+    std::string workDir = testdata_dir + "/dpkg.tmp";
+    std::string infoDir = workDir + "/info";
+    std::string statusFile = workDir + "/status";
+    std::string indexFile = workDir + "/file-index";
+    std::set<std::string> result;
+
+    // create pristine directory to work in
+    if (fs::exists(workDir))
+        fs::remove_all(workDir);
+    fs::create_directories(infoDir);
+    g_assert_true(g_file_set_contents(statusFile.c_str(), "", -1, NULL));
+    g_assert_true(g_file_set_contents((infoDir + "/bash.list").c_str(), "/.\n/bin\n/bin/bash\n/usr/bin/rbash\n", -1, NULL));
+    g_assert_true(g_file_set_contents(
+        (infoDir + "/coreutils:amd64.list").c_str(),
+        "/.\n/bin\n/bin/ls\n/usr/share/doc/coreutils/bash\n",
+        -1,
+        NULL));
+
+    {
+        DpkgFileIndex index(infoDir, statusFile, indexFile);
+        g_assert_true(index.update());
+        g_assert_cmpuint(index.size(), ==, 8);
+        g_assert_true(fs::exists(indexFile));
+
+        // exact paths, shared directories belong to both packages
+        index.findPackages("/bin", result);
+        g_assert_true(_test_string_sets_equal({"bash", "coreutils:amd64"}, result));
+        result.clear();
+        index.findPackages("/bin/bas", result);
+        g_assert_true(result.empty());
+
+        // trailing path components
+        index.findPackages("rbash", result);
+        g_assert_true(_test_string_sets_equal({"bash"}, result));
+        result.clear();
+        index.findPackages("bin/ls", result);
+        g_assert_true(_test_string_sets_equal({"coreutils:amd64"}, result));
+        result.clear();
+        index.findPackages("in/ls", result);
+        g_assert_true(result.empty());
+        index.findPackages("bash", result);
+        g_assert_true(_test_string_sets_equal({"bash", "coreutils:amd64"}, result));
+        result.clear();
+    }
+
+    // install a new package, the index must pick it up on the next load
+    g_assert_true(g_file_set_contents((infoDir + "/zsh.list").c_str(), "/bin/zsh\n", -1, NULL));
+    g_assert_true(g_file_set_contents(statusFile.c_str(), "Package: zsh\n", -1, NULL));
+    {
+        DpkgFileIndex index(infoDir, statusFile, indexFile);
+        g_assert_true(index.update());
+        g_assert_cmpuint(index.size(), ==, 9);
+        index.findPackages("/bin/zsh", result);
+        index.findPackages("/usr/bin/rbash", result);
+        g_assert_true(_test_string_sets_equal({"bash", "zsh"}, result));
+        result.clear();
+    }
+
+    // an index corrupted in place is rebuilt rather than trusted: point
+    // the first path (after the 48 byte header and 3 packages of 24 bytes)
+    // at a package that doesn't exist
+    {
+        gchar *contents = NULL;
+        gsize length = 0;
+        g_assert_true(g_file_get_contents(indexFile.c_str(), &contents, &length, NULL));
+        g_assert_cmpuint(length, >, 48 + 3 * 24 + 16);
+        memset(contents + 48 + 3 * 24 + 12, 0xff, 4);
+        g_assert_true(g_file_set_contents(indexFile.c_str(), contents, length, NULL));
+        g_free(contents);
+
+        DpkgFileIndex index(infoDir, statusFile, indexFile);
+        g_assert_true(index.update());
+        g_assert_cmpuint(index.size(), ==, 9);
+        index.findPackages("/.", result);
+        g_assert_true(_test_string_sets_equal({"bash", "coreutils:amd64"}, result));
+        result.clear();
+    }
+
+    // a missing dpkg database means the index cannot be used
+    {
+        DpkgFileIndex index(workDir + "/nonexistent", statusFile, indexFile);
+        g_assert_false(index.update());
+    }
+
+    // cleanup
+    fs::remove_all(workDir);
+}
+
 static void apt_test_changelog_date(void)
 {
     // Test dates in the format of debian changelog
@@ -506,6 +611,340 @@ static void apt_test_changelog_date(void)
     }
 }
 
+/**
+ * Set up a minimal system in @rootDir whose dpkg status file has @status,
+ * and return a shared cache opened on it.
+ */
+static std::shared_ptr<AptCacheFile> _test_open_aptroot(const std::string &rootDir, const std::string &status)
+{
+    if (fs::exists(rootDir))
+        fs::remove_all(rootDir);
+    fs::create_directories(rootDir + "/var/lib/dpkg/info");
+    fs::create_directories(rootDir + "/var/lib/apt/lists");
+    fs::create_directories(rootDir + "/etc/apt/sources.list.d");
+    fs::create_directories(rootDir + "/etc/apt/preferences.d");
+
+    std::string statusFile = rootDir + "/var/lib/dpkg/status";
+    g_assert_true(g_file_set_contents(statusFile.c_str(), status.c_str(), -1, NULL));
+
+    g_assert_true(pkgInitConfig(*_config));
+    _config->Set("Dir", rootDir);
+    _config->Set("Dir::State::status", statusFile);
+    _config->Set("Dir::Cache::pkgcache", "");
+    _config->Set("Dir::Cache::srcpkgcache", "");
+    g_assert_true(pkgInitSystem(*_config, _system));
+
+    auto shared = std::make_shared<AptCacheFile>(nullptr);
+    g_assert_true(shared->Open(false));
+    g_assert_true(shared->CheckDeps(false));
+    return shared;
+}
+
+static void apt_test_shared_cache_concurrent_queries(void)
+{
+    const guint nPackages = 400;
+    const guint nThreads = 8;
+    const guint nRounds = 25;
+    std::string rootDir = testdata_dir + "/aptroot.tmp";
+    std::string statusFile = rootDir + "/var/lib/dpkg/status";
+
+    // create a minimal system with only installed packages
+    std::string status;
+    for (guint i = 0; i < nPackages; i++) {
+        g_autofree gchar *entry = g_strdup_printf(
+            "Package: pktest-%u\n"
+            "Status: install ok installed\n"
+            "Architecture: all\n"
+            "Version: 1.%u\n"
+            "Maintainer: PackageKit <packagekit@example.org>\n"
+            "Description: Test package %u\n"
+            " Long description.\n\n",
+            i,
+            i,
+            i);
+        status += entry;
+    }
+    auto shared = _test_open_aptroot(rootDir, status);
+    AptSharedCache::set(shared, AptSharedCache::currentStamp());
+
+    // every thread runs jobs through the backend's scheduler: queries borrow
+    // the shared cache concurrently, odd rounds get a private dependency cache
+    // on top of it as GetUpdates does. Every fifth round of the first thread
+    // changes the system, which has to run alone and drops the shared cache.
+    // Threads alternate between two locales, so queries of the same locale
+    // run together and must never see the environment of the other one.
+    std::atomic<guint> queries{0};
+    std::atomic<guint> expected{0};
+    std::atomic<guint> failures{0};
+    std::atomic<guint> running{0};
+    std::atomic<bool> exclusive{false};
+    std::vector<std::thread> threads;
+    for (guint t = 0; t < nThreads; t++) {
+        threads.emplace_back([&, t]() {
+            const gchar *locale = t % 2 == 0 ? "C" : "POSIX";
+            apt_test_job_locale = locale;
+            for (guint round = 0; round < nRounds; round++) {
+                PkRoleEnum role = round % 2 == 1 ? PK_ROLE_ENUM_GET_UPDATES : PK_ROLE_ENUM_RESOLVE;
+                if (t == 0 && round % 5 == 4)
+                    role = PK_ROLE_ENUM_REFRESH_CACHE;
+                apt_test_job_role = role;
+
+                AptJob::runScheduled(nullptr, role, [&]() {
+                    if (role == PK_ROLE_ENUM_REFRESH_CACHE) {
+                        exclusive = true;
+                        if (running > 0)
+                            failures++;
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                        exclusive = false;
+                        return;
+                    }
+
+                    running++;
+                    if (exclusive || g_strcmp0(g_getenv("LANG"), locale) != 0)
+                        failures++;
+
+                    AptJob apt(nullptr);
+                    if (!apt.init()) {
+                        failures++;
+                        running--;
+                        return;
+                    }
+                    AptCacheFile *cache = apt.aptCacheFile();
+
+                    for (guint i = (t + round) % nThreads; i < nPackages; i += nThreads) {
+                        g_autofree gchar *name = g_strdup_printf("pktest-%u", i);
+                        g_autofree gchar *version = g_strdup_printf("1.%u", i);
+                        g_autofree gchar *summary = g_strdup_printf("Test package %u", i);
+
+                        expected++;
+                        pkgCache::PkgIterator pkg = (*cache)->FindPkg(name);
+                        const pkgCache::VerIterator &ver = cache->findVer(pkg);
+                        if (pkg.end() || ver.end() || g_strcmp0(ver.VerStr(), version) != 0
+                            || cache->getShortDescription(ver) != summary) {
+                            failures++;
+                            continue;
+                        }
+                        queries++;
+                    }
+                    if (g_strcmp0(g_getenv("LANG"), locale) != 0)
+                        failures++;
+                    running--;
+                });
+            }
+            apt_test_job_role = PK_ROLE_ENUM_UNKNOWN;
+            apt_test_job_locale = nullptr;
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    g_assert_cmpuint(failures, ==, 0);
+    g_assert_cmpuint(queries, ==, expected);
+    g_assert_cmpuint(queries, >, 0);
+
+    // the last job may have dropped the snapshot
+    AptSharedCache::set(shared, AptSharedCache::currentStamp());
+
+    // invalidating drops the snapshot, but borrowers keep it alive
+    {
+        AptCacheFile cache(nullptr);
+        g_assert_true(cache.Borrow(AptSharedCache::get(), false));
+        AptSharedCache::invalidate("test");
+        g_assert_null(AptSharedCache::get());
+        g_assert_false(cache->FindPkg("pktest-0").end());
+    }
+
+    // changing the package database behind our back is noticed as well
+    AptSharedCache::set(shared, AptSharedCache::currentStamp());
+    g_assert_nonnull(AptSharedCache::get());
+    g_assert_true(g_file_set_contents(statusFile.c_str(), "", -1, NULL));
+    g_assert_null(AptSharedCache::get());
+
+    shared.reset();
+    _error->Discard();
+    fs::remove_all(rootDir);
+}
+
+static void apt_test_gst_caps_index(void)
+{
+    std::string rootDir = testdata_dir + "/aptroot.tmp";
+
+    const char *status =
+        "Package: pktest-good\n"
+        "Status: install ok installed\n"
+        "Architecture: all\n"
+        "Version: 1.0\n"
+        "Description: Good plugins\n"
+        "Gstreamer-Decoders: audio/x-vorbis; audio/x-flac\n"
+        "Gstreamer-Uri-Sources: http, https\n"
+        "Gstreamer-Version: 1.24\n\n"
+        "Package: pktest-good-dbgsym\n"
+        "Status: install ok installed\n"
+        "Architecture: all\n"
+        "Version: 1.0\n"
+        "Description: Good plugins debug symbols\n"
+        "Gstreamer-Decoders: audio/x-vorbis\n"
+        "Gstreamer-Version: 1.24\n\n"
+        "Package: pktest-ugly\n"
+        "Status: install ok installed\n"
+        "Architecture: all\n"
+        "Version: 1.0\n"
+        "Description: Ugly plugins\n"
+        "Gstreamer-Decoders: audio/x-ac3; audio/x-vorbis, channels=(int)2\n"
+        "Gstreamer-Version: 1.24\n\n"
+        "Package: pktest-plain\n"
+        "Status: install ok installed\n"
+        "Architecture: all\n"
+        "Version: 1.0\n"
+        "Description: No plugins at all\n\n";
+    auto shared = _test_open_aptroot(rootDir, status);
+
+    // borrowed caches share the index of the shared cache
+    AptCacheFile cache(nullptr);
+    g_assert_true(cache.Borrow(shared, false));
+
+    // an index whose build was cancelled is incomplete and not kept
+    bool cancel = true;
+    auto cancelled = cache.gstCapsIndex(cancel);
+    cancel = false;
+    auto index = cache.gstCapsIndex(cancel);
+    g_assert_true(index != cancelled);
+    g_assert_true(index == shared->gstCapsIndex(cancel));
+
+    auto find = [&](const char *value) {
+        gchar *values[] = {(gchar *)value, nullptr};
+        GstMatcher matcher(values);
+        PkgList output;
+        index->findProviders(matcher, output, false);
+
+        std::set<std::string> names;
+        for (const PkgInfo &pki : output)
+            names.insert(pki.ver.ParentPkg().Name());
+        return names;
+    };
+
+    g_assert_true(_test_string_sets_equal({"pktest-good", "pktest-ugly"}, find("gstreamer1(decoder-audio/x-vorbis)")));
+    g_assert_true(_test_string_sets_equal({"pktest-ugly"}, find("gstreamer1(decoder-audio/x-ac3)")));
+    g_assert_true(_test_string_sets_equal({"pktest-good"}, find("gstreamer1(urisource-https)")));
+    g_assert_true(find("gstreamer1(encoder-audio/x-vorbis)").empty());
+    g_assert_true(find("gstreamer0.10(decoder-audio/x-vorbis)").empty());
+
+    cache.Close();
+    shared.reset();
+    _error->Discard();
+    fs::remove_all(rootDir);
+}
+
+static void apt_test_soname_index(void)
+{
+    std::string rootDir = testdata_dir + "/aptroot.tmp";
+    std::string infoDir = rootDir + "/var/lib/dpkg/info/";
+
+    // package names following the library packaging policy
+    using Names = std::vector<std::string>;
+    g_assert_true(SonameIndex::packageNames("libfoo.so.1") == Names({"libfoo1"}));
+    g_assert_true(SonameIndex::packageNames("libFoo2.so.3()(64bit)") == Names({"libfoo2-3"}));
+    g_assert_true(SonameIndex::packageNames("libfoo.so.1.2") == Names({"libfoo1.2", "libfoo1"}));
+    g_assert_true(SonameIndex::packageNames("libfoo2.so.1.2") == Names({"libfoo2-1.2", "libfoo2-1"}));
+    g_assert_true(SonameIndex::packageNames("libfoo.so").empty());
+    g_assert_true(SonameIndex::packageNames("foo.so.1").empty());
+
+    const char *status =
+        "Package: libfoo1\n"
+        "Status: install ok installed\n"
+        "Architecture: all\n"
+        "Version: 1.0\n"
+        "Description: Foo library\n\n"
+        "Package: libbar2-3\n"
+        "Status: install ok installed\n"
+        "Architecture: all\n"
+        "Version: 1.0\n"
+        "Description: Bar library\n\n"
+        "Package: libbaz-legacy\n"
+        "Status: install ok installed\n"
+        "Architecture: all\n"
+        "Version: 1.0\n"
+        "Description: Baz library with an unusual name\n\n"
+        "Package: libqux-compat\n"
+        "Status: install ok installed\n"
+        "Architecture: all\n"
+        "Version: 1.0\n"
+        "Provides: libqux5\n"
+        "Description: Qux compatibility library\n\n"
+        "Package: libquux-ng\n"
+        "Status: install ok installed\n"
+        "Architecture: all\n"
+        "Version: 1.0\n"
+        "Description: Quux library with a two part soname\n\n"
+        "Package: libssl1.1\n"
+        "Status: install ok installed\n"
+        "Architecture: all\n"
+        "Version: 1.1\n"
+        "Description: SSL library named after its full soname version\n\n"
+        "Package: libssl1\n"
+        "Status: install ok installed\n"
+        "Architecture: all\n"
+        "Version: 1.0\n"
+        "Description: Older SSL library with only a major soname version\n\n";
+    auto shared = _test_open_aptroot(rootDir, status);
+
+    // the shlibs files are only read when the index is built
+    g_assert_true(g_file_set_contents((infoDir + "libbaz-legacy.shlibs").c_str(),
+                                      "# comment\n"
+                                      "libbaz 7 libbaz-legacy (>= 1.0)\n"
+                                      "udeb: libbaz 7 libbaz-udeb (>= 1.0)\n",
+                                      -1,
+                                      NULL));
+    g_assert_true(g_file_set_contents((infoDir + "libquux-ng.shlibs").c_str(),
+                                      "libquux 2.0 libquux-ng (>= 1.0)\n",
+                                      -1,
+                                      NULL));
+
+    // borrowed caches share the index of the shared cache
+    AptCacheFile cache(nullptr);
+    g_assert_true(cache.Borrow(shared, false));
+    // an index whose build was cancelled is incomplete and not kept
+    bool cancel = true;
+    auto cancelled = cache.sonameIndex(cancel);
+    cancel = false;
+    auto index = cache.sonameIndex(cancel);
+    g_assert_true(index != cancelled);
+    g_assert_true(index == shared->sonameIndex(cancel));
+
+    PkgList none;
+    cancelled->findProviders("libfoo.so.1", none);
+    g_assert_true(none.empty());
+
+    auto find = [&](const char *soname) {
+        PkgList output;
+        index->findProviders(soname, output);
+
+        std::set<std::string> names;
+        for (const PkgInfo &pki : output)
+            names.insert(pki.ver.ParentPkg().Name());
+        return names;
+    };
+
+    g_assert_true(_test_string_sets_equal({"libfoo1"}, find("libfoo.so.1")));
+    g_assert_true(_test_string_sets_equal({"libfoo1"}, find("libfoo.so.1()(64bit)")));
+    g_assert_true(_test_string_sets_equal({"libbar2-3"}, find("libbar2.so.3")));
+    g_assert_true(_test_string_sets_equal({"libbaz-legacy"}, find("libbaz.so.7")));
+    g_assert_true(_test_string_sets_equal({"libqux-compat"}, find("libqux.so.5")));
+    g_assert_true(_test_string_sets_equal({"libquux-ng"}, find("libquux.so.2.0")));
+    g_assert_true(_test_string_sets_equal({"libquux-ng"}, find("libquux.so.2.0()(64bit)")));
+    g_assert_true(_test_string_sets_equal({"libssl1.1"}, find("libssl.so.1.1")));
+    g_assert_true(_test_string_sets_equal({"libssl1"}, find("libssl.so.1")));
+    g_assert_true(_test_string_sets_equal({"libfoo1"}, find("libfoo.so.1.2")));
+    g_assert_true(find("libquux.so.2").empty());
+    g_assert_true(find("libfoo.so.2").empty());
+    g_assert_true(find("libnothere.so.1").empty());
+
+    cache.Close();
+    shared.reset();
+    _error->Discard();
+    fs::remove_all(rootDir);
+}
+
 int main(int argc, char **argv)
 {
     if (argc == 0)
@@ -530,6 +969,10 @@ int main(int argc, char **argv)
     g_test_add_func("/apt/sources/write", apt_test_sources_write);
     g_test_add_func("/apt/sources/source-record-assign", apt_test_source_record_assign);
     g_test_add_func("/apt/utils/changelog-date", apt_test_changelog_date);
+    g_test_add_func("/apt/dpkg-file-index", apt_test_dpkg_file_index);
+    g_test_add_func("/apt/shared-cache/concurrent-queries", apt_test_shared_cache_concurrent_queries);
+    g_test_add_func("/apt/gst-matcher/caps-index", apt_test_gst_caps_index);
+    g_test_add_func("/apt/soname-index", apt_test_soname_index);
 
     return g_test_run();
 }
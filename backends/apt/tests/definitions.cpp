@@ -5,9 +5,12 @@
  * otherwise we can't link it.
  */
 
+// set by tests running jobs with different locales on several threads
+thread_local const gchar *apt_test_job_locale = NULL;
+
 const gchar *pk_backend_job_get_locale(PkBackendJob *job)
 {
-    return NULL;
+    return apt_test_job_locale;
 }
 
 gpointer pk_backend_job_get_user_data(PkBackendJob *job)
@@ -59,9 +62,12 @@ gboolean pk_backend_job_get_interactive(PkBackendJob *job)
 
 void pk_backend_job_set_status(PkBackendJob *job, PkStatusEnum status) {}
 
+// the role of the jobs a test runs on the current thread
+thread_local PkRoleEnum apt_test_job_role = PK_ROLE_ENUM_UNKNOWN;
+
 PkRoleEnum pk_backend_job_get_role(PkBackendJob *job)
 {
-    return PK_ROLE_ENUM_UNKNOWN;
+    return apt_test_job_role;
 }
 
 const gchar *pk_backend_job_get_proxy_ftp(PkBackendJob *job)
@@ -129,3 +135,7 @@ gboolean pk_backend_is_online(PkBackend *backend)
 {
     return TRUE;
 }
+
+void pk_backend_transaction_inhibit_start(PkBackend *backend) {}
+
+void pk_backend_transaction_inhibit_end(PkBackend *backend) {}
@@ -105,3 +105,220 @@ dnf_utils_refresh_repo_appstream (DnfRepo *repo, GError **error)
 	}
 	return TRUE;
 }
+
+/* every repo has a keyring of its own, but the keys are imported with
+ * gpgme, which must not be used from several threads at the same time */
+static GMutex import_pubkey_mutex;
+
+static gboolean
+dnf_utils_refresh_repo (DnfRepo *repo,
+			guint max_cache_age,
+			DnfState *state,
+			GError **error)
+{
+	gboolean ret;
+	gboolean repo_okay;
+	DnfState *state_local;
+	GError *error_local = NULL;
+
+	/* set state */
+	ret = dnf_state_set_steps (state, error,
+				   2, /* check */
+				   98, /* download */
+				   -1);
+	if (!ret)
+		return FALSE;
+
+	/* is the repo up to date? */
+	state_local = dnf_state_get_child (state);
+	repo_okay = dnf_repo_check (repo,
+	                            max_cache_age,
+	                            state_local,
+	                            &error_local);
+	if (!repo_okay) {
+		g_debug ("repo %s not okay [%s], refreshing",
+			 dnf_repo_get_id (repo), error_local->message);
+		g_clear_error (&error_local);
+		if (!dnf_state_finished (state_local, error))
+			return FALSE;
+	}
+
+	/* done */
+	if (!dnf_state_done (state, error))
+		return FALSE;
+
+	/* update repo, TODO: if we have network access */
+	if (!repo_okay) {
+		DnfRepoUpdateFlags flags = DNF_REPO_UPDATE_FLAG_NONE;
+		g_autoptr(GMutexLocker) locker = NULL;
+
+		/* only repos checking the signature of their metadata need
+		 * the keys, the others can be downloaded without waiting */
+		if (dnf_repo_get_gpgcheck_md (repo)) {
+			flags |= DNF_REPO_UPDATE_FLAG_IMPORT_PUBKEY;
+			locker = g_mutex_locker_new (&import_pubkey_mutex);
+		}
+		state_local = dnf_state_get_child (state);
+		ret = dnf_repo_update (repo,
+		                       flags,
+		                       state_local,
+		                       &error_local);
+		if (!ret) {
+			if (g_error_matches (error_local,
+					     DNF_ERROR,
+					     DNF_ERROR_CANNOT_FETCH_SOURCE)) {
+				g_warning ("Skipping refresh of %s: %s",
+					   dnf_repo_get_id (repo),
+					   error_local->message);
+				g_clear_error (&error_local);
+				if (!dnf_state_finished (state_local, error))
+					return FALSE;
+			} else {
+				g_propagate_error (error, error_local);
+				return FALSE;
+			}
+		}
+	}
+
+	/* copy the appstream files somewhere that the GUI will pick them up */
+	if (!dnf_utils_refresh_repo_appstream (repo, error))
+		return FALSE;
+
+	/* done */
+	return dnf_state_done (state, error);
+}
+
+typedef struct {
+	GMutex		 mutex;
+	GCond		 cond;
+	guint		 cache_age;
+	guint		 pending;	/* protected by mutex */
+} DnfUtilsRefresh;
+
+typedef struct {
+	DnfUtilsRefresh	*refresh;
+	DnfRepo		*repo;
+	DnfState	*state;
+	guint		 percentage;	/* protected by refresh->mutex */
+	GError		*error;		/* protected by refresh->mutex */
+} DnfUtilsRefreshItem;
+
+static void
+dnf_utils_refresh_percentage_changed_cb (DnfState *state,
+					 guint percentage,
+					 DnfUtilsRefreshItem *item)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&item->refresh->mutex);
+	item->percentage = percentage;
+	g_cond_signal (&item->refresh->cond);
+}
+
+static void
+dnf_utils_refresh_repo_worker (gpointer data, gpointer user_data)
+{
+	DnfUtilsRefreshItem *item = data;
+	DnfUtilsRefresh *refresh = user_data;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	if (!dnf_utils_refresh_repo (item->repo,
+				     refresh->cache_age,
+				     item->state,
+				     &error_local)) {
+		g_prefix_error (&error_local, "failed to refresh %s: ",
+				dnf_repo_get_id (item->repo));
+	}
+
+	locker = g_mutex_locker_new (&refresh->mutex);
+	item->error = g_steal_pointer (&error_local);
+	item->percentage = 100;
+	refresh->pending--;
+	g_cond_signal (&refresh->cond);
+}
+
+/*
+ * dnf_utils_refresh_repos:
+ *
+ * Checks and downloads all @repos using at most @max_parallel threads,
+ * reporting their average progress on @state.
+ *
+ * Every worker only touches its own #DnfRepo, so the caller has to make
+ * sure nothing else uses @repos until this returns.
+ **/
+gboolean
+dnf_utils_refresh_repos (GPtrArray *repos,
+			 guint cache_age,
+			 guint max_parallel,
+			 GCancellable *cancellable,
+			 DnfState *state,
+			 GError **error)
+{
+	DnfUtilsRefresh refresh = { 0 };
+	g_autofree DnfUtilsRefreshItem *items = NULL;
+	GThreadPool *pool;
+	GError *error_local = NULL;
+	guint i;
+
+	if (repos->len == 0)
+		return dnf_state_finished (state, error);
+
+	g_mutex_init (&refresh.mutex);
+	g_cond_init (&refresh.cond);
+	refresh.cache_age = cache_age;
+
+	items = g_new0 (DnfUtilsRefreshItem, repos->len);
+	for (i = 0; i < repos->len; i++) {
+		items[i].refresh = &refresh;
+		items[i].repo = g_ptr_array_index (repos, i);
+		items[i].state = dnf_state_new ();
+		dnf_state_set_cancellable (items[i].state, cancellable);
+		g_signal_connect (items[i].state, "percentage-changed",
+				  G_CALLBACK (dnf_utils_refresh_percentage_changed_cb),
+				  &items[i]);
+	}
+
+	/* each repo has its own librepo handle, so they can be downloaded
+	 * at the same time */
+	g_debug ("refreshing %u repos, %u at a time", repos->len, max_parallel);
+	pool = g_thread_pool_new (dnf_utils_refresh_repo_worker, &refresh,
+				  (gint) max_parallel, FALSE, &error_local);
+	if (pool != NULL) {
+		g_mutex_lock (&refresh.mutex);
+		refresh.pending = repos->len;
+		g_mutex_unlock (&refresh.mutex);
+		for (i = 0; i < repos->len; i++)
+			g_thread_pool_push (pool, &items[i], NULL);
+
+		/* the progress of the job is the average of all repos */
+		g_mutex_lock (&refresh.mutex);
+		while (refresh.pending > 0) {
+			guint total = 0;
+			g_cond_wait (&refresh.cond, &refresh.mutex);
+			for (i = 0; i < repos->len; i++)
+				total += items[i].percentage;
+			g_mutex_unlock (&refresh.mutex);
+			dnf_state_set_percentage (state, total / repos->len);
+			g_mutex_lock (&refresh.mutex);
+		}
+		g_mutex_unlock (&refresh.mutex);
+		g_thread_pool_free (pool, FALSE, TRUE);
+
+		/* the last repos may have finished while we were busy */
+		dnf_state_set_percentage (state, 100);
+	}
+
+	for (i = 0; i < repos->len; i++) {
+		if (error_local == NULL)
+			error_local = g_steal_pointer (&items[i].error);
+		g_clear_error (&items[i].error);
+		g_object_unref (items[i].state);
+	}
+	g_cond_clear (&refresh.cond);
+	g_mutex_clear (&refresh.mutex);
+
+	if (error_local != NULL) {
+		g_propagate_error (error, error_local);
+		return FALSE;
+	}
+	return TRUE;
+}
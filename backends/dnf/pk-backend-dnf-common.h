@@ -31,6 +31,12 @@ gboolean	pk_backend_setup_dnf_context (DnfContext *context,
 					      const gchar *release_ver,
 					      GError **error);
 gboolean	dnf_utils_refresh_repo_appstream (DnfRepo *repo, GError **error);
+gboolean	dnf_utils_refresh_repos (GPtrArray *repos,
+					 guint cache_age,
+					 guint max_parallel,
+					 GCancellable *cancellable,
+					 DnfState *state,
+					 GError **error);
 
 G_END_DECLS
 
@@ -47,18 +47,49 @@
 #include "pk-backend-dnf-common.h"
 
 #define DNF_SACK_MAX_AGE	600 /* seconds */
+#define DNF_REFRESH_MAX_PARALLEL	4
+#define DNF_SACK_PREWARM_DELAY	2 /* seconds */
 
 typedef struct {
 	DnfSack		*sack;
 	gchar		*key;
+	DnfSackAddFlags	 flags;
 	GTimer		*timer;
 } DnfSackCacheItem;
 
+typedef enum {
+	PK_BACKEND_DNF_CHANGED_SYSTEM	= 1 << 0,	/* the rpmdb */
+	PK_BACKEND_DNF_CHANGED_REPOS	= 1 << 1,	/* repo definitions or metadata */
+} PkBackendDnfChange;
+
+typedef struct {
+	gchar		*token;
+	guint		 generation;
+	PkRoleEnum	 role;
+	PkBitfield	 transaction_flags;
+	GVariant	*params;
+	DnfSack		*sack;
+	HyGoal		 goal;
+} PkBackendDnfSolution;
+
 typedef struct {
 	GKeyFile	*conf;
 	DnfContext	*context;
 	GHashTable	*sack_cache;	/* of DnfSackCacheItem */
 	GMutex		 sack_mutex;
+	guint		 sack_generation;
+	guint		 system_generation;
+	guint		 repos_generation;
+	GArray		*prewarm;	/* of DnfSackAddFlags, protected by sack_mutex */
+	guint		 prewarm_id;	/* protected by sack_mutex */
+	gboolean	 prewarm_running;	/* protected by sack_mutex */
+	gboolean	 prewarm_loading;	/* protected by sack_mutex */
+	DnfSackAddFlags	 prewarm_flags;	/* being loaded, protected by sack_mutex */
+	GCond		 prewarm_cond;	/* signalled when a prewarm load finished */
+	GThread		*prewarm_thread;
+	GCancellable	*prewarm_cancellable;
+	DnfContext	*prewarm_context;	/* only used by prewarm_thread */
+	PkBackendDnfSolution *solution;	/* last simulated goal, protected by sack_mutex */
 	GTimer		*repos_timer;
 	gchar		*release_ver;
 	guint		 sack_expire_id;
@@ -71,13 +102,22 @@ typedef struct {
 	PkBackend	*backend;
 	PkBitfield	 transaction_flags;
 	HyGoal		 goal;
+	gboolean	 goal_solved;
+	DnfSack		*sack;		/* of goal, if the solution can be saved */
+	guint		 generation;	/* of sack */
 } PkBackendDnfJobData;
 
-static GPtrArray * pk_backend_find_refresh_repos (PkBackendJob *job,
+static GPtrArray * pk_backend_find_refresh_repos (guint         cache_age,
 						  DnfState     *state,
 						  GPtrArray    *repos,
 						  gboolean      force,
 						  GError      **error);
+static DnfSack * pk_backend_create_sack (PkBackend       *backend,
+					 DnfContext      *context,
+					 DnfSackAddFlags  flags,
+					 guint            cache_age,
+					 DnfState        *state,
+					 GError         **error);
 
 const gchar *
 pk_backend_get_description (PkBackend *backend)
@@ -120,20 +160,151 @@ pk_backend_sack_expire (gpointer user_data)
 }
 
 static void
-pk_backend_sack_cache_invalidate (PkBackend *backend, const gchar *why)
+pk_backend_dnf_solution_free (PkBackendDnfSolution *solution)
+{
+	if (solution->goal != NULL)
+		hy_goal_free (solution->goal);
+	g_clear_object (&solution->sack);
+	g_variant_unref (solution->params);
+	g_free (solution->token);
+	g_free (solution);
+}
+
+static gpointer
+pk_backend_sack_prewarm_thread (gpointer user_data)
+{
+	PkBackend *backend = user_data;
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	g_autoptr(GError) error = NULL;
+
+	/* the context of the jobs must not be used outside of them */
+	if (priv->prewarm_context == NULL) {
+		g_autoptr(DnfContext) context = dnf_context_new ();
+		if (!pk_backend_setup_dnf_context (context, priv->conf, priv->release_ver, &error)) {
+			g_warning ("failed to setup context for prewarming sacks: %s",
+				   error->message);
+			g_clear_error (&error);
+		} else {
+			priv->prewarm_context = g_steal_pointer (&context);
+		}
+	}
+
+	while (TRUE) {
+		DnfSackAddFlags flags;
+		g_autoptr(DnfSack) sack = NULL;
+		g_autoptr(DnfState) state = NULL;
+
+		g_mutex_lock (&priv->sack_mutex);
+		if (priv->prewarm_context == NULL ||
+		    priv->prewarm->len == 0 ||
+		    g_cancellable_is_cancelled (priv->prewarm_cancellable)) {
+			g_array_set_size (priv->prewarm, 0);
+			priv->prewarm_running = FALSE;
+			g_mutex_unlock (&priv->sack_mutex);
+			break;
+		}
+		flags = g_array_index (priv->prewarm, DnfSackAddFlags, 0);
+		g_array_remove_index (priv->prewarm, 0);
+		priv->prewarm_loading = TRUE;
+		priv->prewarm_flags = flags;
+		g_mutex_unlock (&priv->sack_mutex);
+
+		/* only use the metadata we already have */
+		state = dnf_state_new ();
+		dnf_state_set_cancellable (state, priv->prewarm_cancellable);
+		sack = pk_backend_create_sack (backend, priv->prewarm_context, flags,
+					       G_MAXUINT, state, &error);
+		if (sack == NULL) {
+			g_debug ("failed to prewarm sack: %s", error->message);
+			g_clear_error (&error);
+		}
+
+		/* jobs waiting for this sack look in the cache again */
+		g_mutex_lock (&priv->sack_mutex);
+		priv->prewarm_loading = FALSE;
+		g_cond_broadcast (&priv->prewarm_cond);
+		g_mutex_unlock (&priv->sack_mutex);
+	}
+
+	return NULL;
+}
+
+static gboolean
+pk_backend_sack_prewarm_cb (gpointer user_data)
+{
+	PkBackend *backend = user_data;
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->sack_mutex);
+
+	/* the timeout may have been replaced while we waited for the lock */
+	if (priv->prewarm_id == g_source_get_id (g_main_current_source ()))
+		priv->prewarm_id = 0;
+
+	/* a running thread picks up the new sacks itself */
+	if (priv->prewarm_running)
+		return G_SOURCE_REMOVE;
+	if (priv->prewarm_thread != NULL)
+		g_thread_join (g_steal_pointer (&priv->prewarm_thread));
+
+	priv->prewarm_running = TRUE;
+	priv->prewarm_thread = g_thread_new ("PK-Dnf-Prewarm",
+					     pk_backend_sack_prewarm_thread,
+					     backend);
+	return G_SOURCE_REMOVE;
+}
+
+/*
+ * pk_backend_sack_cache_invalidate:
+ *
+ * Drops the cached sacks which contain something that changed, and schedules
+ * loading them again in the background once things settle down.
+ **/
+static void
+pk_backend_sack_cache_invalidate (PkBackend *backend, PkBackendDnfChange change, const gchar *why)
 {
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->sack_mutex);
+	GHashTableIter iter;
+	DnfSackCacheItem *cache_item;
 
-	/* remove all cached sacks */
-	g_debug ("removing all dnf sack caches");
-	g_hash_table_remove_all (priv->sack_cache);
+	/* every sack contains the system repo, but only some the remote ones */
+	g_debug ("removing dnf sack caches: %s", why);
+	g_hash_table_iter_init (&iter, priv->sack_cache);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &cache_item)) {
+		gboolean found = FALSE;
+
+		if ((change & PK_BACKEND_DNF_CHANGED_SYSTEM) == 0 &&
+		    (cache_item->flags & DNF_SACK_ADD_FLAG_REMOTE) == 0)
+			continue;
+		for (guint i = 0; i < priv->prewarm->len && !found; i++)
+			found = g_array_index (priv->prewarm, DnfSackAddFlags, i) == cache_item->flags;
+		if (!found)
+			g_array_append_val (priv->prewarm, cache_item->flags);
+		g_hash_table_iter_remove (&iter);
+	}
+	if (change & PK_BACKEND_DNF_CHANGED_SYSTEM)
+		priv->system_generation++;
+	if (change & PK_BACKEND_DNF_CHANGED_REPOS)
+		priv->repos_generation++;
+
+	/* and anything solved against them */
+	priv->sack_generation++;
+	g_clear_pointer (&priv->solution, pk_backend_dnf_solution_free);
+
+	/* the rpmdb changes many times during a transaction */
+	if (priv->prewarm->len == 0)
+		return;
+	if (priv->prewarm_id != 0)
+		g_source_remove (priv->prewarm_id);
+	priv->prewarm_id = g_timeout_add_seconds (DNF_SACK_PREWARM_DELAY,
+						  pk_backend_sack_prewarm_cb,
+						  backend);
 }
 
 static void
 pk_backend_yum_repos_changed_cb (DnfRepoLoader *repo_loader, PkBackend *backend)
 {
-	pk_backend_sack_cache_invalidate (backend, "yum.repos.d changed");
+	pk_backend_sack_cache_invalidate (backend, PK_BACKEND_DNF_CHANGED_REPOS, "yum.repos.d changed");
 	pk_backend_repo_list_changed (backend);
 }
 
@@ -151,7 +322,7 @@ pk_backend_context_invalidate_cb (DnfContext *context,
 				 const gchar *message,
 				 PkBackend *backend)
 {
-	pk_backend_sack_cache_invalidate (backend, message);
+	pk_backend_sack_cache_invalidate (backend, PK_BACKEND_DNF_CHANGED_SYSTEM, message);
 	pk_backend_installed_db_changed (backend);
 }
 
@@ -269,14 +440,18 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	 *
 	 * notes:
 	 * - this deals with deallocating the sack when the backend is unloaded
-	 * - all the cached sacks are dropped on any transaction that can
-	 *   modify state or if the repos or rpmdb are changed
+	 * - all the cached sacks are dropped if the rpmdb is changed, and
+	 *   the ones with remote repos if the repos are changed
+	 * - the dropped sacks are loaded again in the background
 	 */
 	g_mutex_init (&priv->sack_mutex);
+	g_cond_init (&priv->prewarm_cond);
 	priv->sack_cache = g_hash_table_new_full (g_str_hash,
 						  g_str_equal,
 						  g_free,
 						  (GDestroyNotify) dnf_sack_cache_item_free);
+	priv->prewarm = g_array_new (FALSE, FALSE, sizeof (DnfSackAddFlags));
+	priv->prewarm_cancellable = g_cancellable_new ();
 
 	priv->sack_expire_id = g_timeout_add_seconds (DNF_SACK_MAX_AGE / 2,
 						      pk_backend_sack_expire,
@@ -296,7 +471,17 @@ pk_backend_destroy (PkBackend *backend)
 		g_object_unref (priv->context);
 	if (priv->sack_expire_id > 0)
 		g_source_remove (priv->sack_expire_id);
+	if (priv->prewarm_id > 0)
+		g_source_remove (priv->prewarm_id);
+	g_cancellable_cancel (priv->prewarm_cancellable);
+	if (priv->prewarm_thread != NULL)
+		g_thread_join (priv->prewarm_thread);
+	g_clear_object (&priv->prewarm_cancellable);
+	g_clear_object (&priv->prewarm_context);
+	g_array_unref (priv->prewarm);
+	g_clear_pointer (&priv->solution, pk_backend_dnf_solution_free);
 	g_timer_destroy (priv->repos_timer);
+	g_cond_clear (&priv->prewarm_cond);
 	g_mutex_clear (&priv->sack_mutex);
 	g_hash_table_unref (priv->sack_cache);
 	g_free (priv->release_ver);
@@ -489,18 +674,19 @@ pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
 		g_object_unref (job_data->context);
 	if (job_data->goal != NULL)
 		hy_goal_free (job_data->goal);
+	g_clear_object (&job_data->sack);
 	g_free (job_data);
 	pk_backend_job_set_user_data (job, NULL);
 }
 
 static gboolean
-dnf_utils_add_remote (PkBackendJob *job,
+dnf_utils_add_remote (DnfContext *context,
+		      guint cache_age,
 		      DnfSack *sack,
 		      DnfSackAddFlags flags,
 		      DnfState *state,
 		      GError **error)
 {
-	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
 	gboolean ret;
 	DnfState *state_local;
 	g_autoptr(GPtrArray) repos = NULL;
@@ -516,7 +702,7 @@ dnf_utils_add_remote (PkBackendJob *job,
 		return FALSE;
 
 	/* ask the context's repo loader for new repos, forcing it to reload them */
-	repos = dnf_repo_loader_get_repos (dnf_context_get_repo_loader (job_data->context), error);
+	repos = dnf_repo_loader_get_repos (dnf_context_get_repo_loader (context), error);
 	if (repos == NULL)
 		return FALSE;
 
@@ -530,7 +716,7 @@ dnf_utils_add_remote (PkBackendJob *job,
 	 * the call to dnf_repo_check() inside dnf_sack_add_repos() - in this case we'll end up
 	 * with stale appstream data until the next metadata refresh.
 	 */
-	refresh_repos = pk_backend_find_refresh_repos (job,
+	refresh_repos = pk_backend_find_refresh_repos (cache_age,
 						       state,
 						       repos,
 						       FALSE /* !force */,
@@ -542,7 +728,7 @@ dnf_utils_add_remote (PkBackendJob *job,
 	state_local = dnf_state_get_child (state);
 	ret = dnf_sack_add_repos (sack,
 	                          repos,
-	                          pk_backend_job_get_cache_age (job),
+	                          cache_age,
 	                          flags,
 	                          state_local,
 	                          error);
@@ -610,75 +796,35 @@ dnf_utils_real_path (const gchar *path)
 	return real;
 }
 
+/*
+ * pk_backend_create_sack:
+ *
+ * Loads a new sack with the repos of @context, and saves it in the cache
+ * unless the system or the repos changed while loading it.
+ **/
 static DnfSack *
-dnf_utils_create_sack_for_filters (PkBackendJob *job,
-				   PkBitfield filters,
-				   DnfCreateSackFlags create_flags,
-				   DnfState *state,
-				   GError **error)
+pk_backend_create_sack (PkBackend *backend,
+			DnfContext *context,
+			DnfSackAddFlags flags,
+			guint cache_age,
+			DnfState *state,
+			GError **error)
 {
 	gboolean ret;
-	DnfSackAddFlags flags = DNF_SACK_ADD_FLAG_FILELISTS;
 	DnfSackCacheItem *cache_item = NULL;
 	DnfState *state_local;
-	PkBackend *backend = pk_backend_job_get_backend (job);
-	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	guint system_generation;
+	guint repos_generation;
 	g_autofree gchar *cache_key = NULL;
 	g_autofree gchar *install_root = NULL;
 	g_autofree gchar *solv_dir = NULL;
 	g_autoptr(DnfSack) sack = NULL;
 
-	/* don't add if we're going to filter out anyway */
-	if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED))
-		flags |= DNF_SACK_ADD_FLAG_REMOTE;
-
-	/* only load updateinfo when required */
-	if (pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATE_DETAIL ||
-	    pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATES)
-		flags |= DNF_SACK_ADD_FLAG_UPDATEINFO;
-
-	/* only use unavailble packages for queries */
-	switch (pk_backend_job_get_role (job)) {
-	case PK_ROLE_ENUM_RESOLVE:
-	case PK_ROLE_ENUM_SEARCH_NAME:
-	case PK_ROLE_ENUM_SEARCH_DETAILS:
-	case PK_ROLE_ENUM_SEARCH_FILE:
-	case PK_ROLE_ENUM_GET_DETAILS:
-	case PK_ROLE_ENUM_WHAT_PROVIDES:
-		flags |= DNF_SACK_ADD_FLAG_UNAVAILABLE;
-		break;
-	default:
-		break;
-	}
-
-	/* media repos could disappear at any time */
-	if ((create_flags & DNF_CREATE_SACK_FLAG_USE_CACHE) > 0 &&
-	    dnf_repo_loader_has_removable_repos (dnf_context_get_repo_loader (job_data->context)) &&
-	    g_timer_elapsed (priv->repos_timer, NULL) > 1.0f) {
-		g_debug ("not reusing sack as media may have disappeared");
-		create_flags &= ~DNF_CREATE_SACK_FLAG_USE_CACHE;
-	}
-	g_timer_reset (priv->repos_timer);
-
-	/* if we've specified a specific cache-age then do not use the cache */
-	if ((flags & DNF_SACK_ADD_FLAG_REMOTE) > 0 &&
-	    pk_backend_job_get_cache_age (job) != G_MAXUINT) {
-		g_debug ("not reusing sack specific cache age requested");
-		create_flags &= ~DNF_CREATE_SACK_FLAG_USE_CACHE;
-	}
-
-	/* do we have anything in the cache */
-	cache_key = dnf_utils_create_cache_key (dnf_context_get_release_ver (job_data->context), flags);
-	if ((create_flags & DNF_CREATE_SACK_FLAG_USE_CACHE) > 0) {
-		g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->sack_mutex);
-		cache_item = g_hash_table_lookup (priv->sack_cache, cache_key);
-		if (cache_item != NULL && cache_item->sack != NULL) {
-			g_debug ("using cached sack %s", cache_key);
-			g_timer_start (cache_item->timer);
-			return g_object_ref (cache_item->sack);
-		}
-	}
+	g_mutex_lock (&priv->sack_mutex);
+	system_generation = priv->system_generation;
+	repos_generation = priv->repos_generation;
+	g_mutex_unlock (&priv->sack_mutex);
 
 	/* update status */
 	dnf_state_action_start (state, DNF_STATE_ACTION_QUERY, NULL);
@@ -696,16 +842,16 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 	}
 
 	/* create empty sack */
-	solv_dir = dnf_utils_real_path (dnf_context_get_solv_dir (job_data->context));
-	install_root = dnf_utils_real_path (dnf_context_get_install_root (job_data->context));
+	solv_dir = dnf_utils_real_path (dnf_context_get_solv_dir (context));
+	install_root = dnf_utils_real_path (dnf_context_get_install_root (context));
 	sack = dnf_sack_new ();
 	dnf_sack_set_cachedir (sack, solv_dir);
 	dnf_sack_set_rootdir (sack, install_root);
 	ret = dnf_sack_setup (sack, DNF_SACK_SETUP_FLAG_MAKE_CACHE_DIR, error);
 	if (!ret) {
 		g_prefix_error (error, "failed to create sack in %s for %s: ",
-				dnf_context_get_solv_dir (job_data->context),
-				dnf_context_get_install_root (job_data->context));
+				dnf_context_get_solv_dir (context),
+				dnf_context_get_install_root (context));
 		return NULL;
 	}
 
@@ -721,10 +867,11 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 	if (!ret)
 		return NULL;
 
-	/* add remote packages */
+	/* add remote packages, these come from the solv files written when
+	 * the repos were last loaded unless their metadata changed since */
 	if ((flags & DNF_SACK_ADD_FLAG_REMOTE) > 0) {
 		state_local = dnf_state_get_child (state);
-		ret = dnf_utils_add_remote (job, sack, flags,
+		ret = dnf_utils_add_remote (context, cache_age, sack, flags,
 					    state_local, error);
 		if (!ret)
 			return NULL;
@@ -735,12 +882,20 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 			return NULL;
 	}
 
-	dnf_sack_filter_modules (sack, dnf_context_get_repos (job_data->context), install_root, NULL);
+	dnf_sack_filter_modules (sack, dnf_context_get_repos (context), install_root, NULL);
 
 	/* save in cache */
+	cache_key = dnf_utils_create_cache_key (dnf_context_get_release_ver (context), flags);
 	g_mutex_lock (&priv->sack_mutex);
+	if (system_generation != priv->system_generation ||
+	    ((flags & DNF_SACK_ADD_FLAG_REMOTE) > 0 && repos_generation != priv->repos_generation)) {
+		g_debug ("not caching sack %s as it changed while loading", cache_key);
+		g_mutex_unlock (&priv->sack_mutex);
+		return g_steal_pointer (&sack);
+	}
 	cache_item = g_slice_new (DnfSackCacheItem);
 	cache_item->key = g_strdup (cache_key);
+	cache_item->flags = flags;
 	cache_item->sack = g_object_ref (sack);
 	cache_item->timer = g_timer_new ();
 	g_debug ("created cached sack %s", cache_item->key);
@@ -750,6 +905,96 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 	return g_steal_pointer (&sack);
 }
 
+static DnfSack *
+dnf_utils_create_sack_for_filters (PkBackendJob *job,
+				   PkBitfield filters,
+				   DnfCreateSackFlags create_flags,
+				   DnfState *state,
+				   GError **error)
+{
+	DnfSackAddFlags flags = DNF_SACK_ADD_FLAG_FILELISTS;
+	DnfSackCacheItem *cache_item = NULL;
+	PkBackend *backend = pk_backend_job_get_backend (job);
+	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	g_autofree gchar *cache_key = NULL;
+
+	/* don't add if we're going to filter out anyway */
+	if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED))
+		flags |= DNF_SACK_ADD_FLAG_REMOTE;
+
+	/* only load updateinfo when required */
+	if (pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATE_DETAIL ||
+	    pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATES)
+		flags |= DNF_SACK_ADD_FLAG_UPDATEINFO;
+
+	/* only use unavailble packages for queries */
+	switch (pk_backend_job_get_role (job)) {
+	case PK_ROLE_ENUM_RESOLVE:
+	case PK_ROLE_ENUM_SEARCH_NAME:
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+	case PK_ROLE_ENUM_SEARCH_FILE:
+	case PK_ROLE_ENUM_GET_DETAILS:
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
+		flags |= DNF_SACK_ADD_FLAG_UNAVAILABLE;
+		break;
+	default:
+		break;
+	}
+
+	/* media repos could disappear at any time */
+	if ((create_flags & DNF_CREATE_SACK_FLAG_USE_CACHE) > 0 &&
+	    dnf_repo_loader_has_removable_repos (dnf_context_get_repo_loader (job_data->context)) &&
+	    g_timer_elapsed (priv->repos_timer, NULL) > 1.0f) {
+		g_debug ("not reusing sack as media may have disappeared");
+		create_flags &= ~DNF_CREATE_SACK_FLAG_USE_CACHE;
+	}
+	g_timer_reset (priv->repos_timer);
+
+	/* if we've specified a specific cache-age then do not use the cache */
+	if ((flags & DNF_SACK_ADD_FLAG_REMOTE) > 0 &&
+	    pk_backend_job_get_cache_age (job) != G_MAXUINT) {
+		g_debug ("not reusing sack specific cache age requested");
+		create_flags &= ~DNF_CREATE_SACK_FLAG_USE_CACHE;
+	}
+
+	/* do we have anything in the cache */
+	cache_key = dnf_utils_create_cache_key (dnf_context_get_release_ver (job_data->context), flags);
+	if ((create_flags & DNF_CREATE_SACK_FLAG_USE_CACHE) > 0) {
+		g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->sack_mutex);
+
+		/* rather than loading the same sack twice, wait for the
+		 * prewarm thread if it is loading this one right now */
+		while (TRUE) {
+			cache_item = g_hash_table_lookup (priv->sack_cache, cache_key);
+			if (cache_item != NULL && cache_item->sack != NULL) {
+				g_debug ("using cached sack %s", cache_key);
+				g_timer_start (cache_item->timer);
+				return g_object_ref (cache_item->sack);
+			}
+			if (!priv->prewarm_loading || priv->prewarm_flags != flags)
+				break;
+			g_debug ("waiting for sack %s to be prewarmed", cache_key);
+			g_cond_wait (&priv->prewarm_cond, &priv->sack_mutex);
+		}
+
+		/* and don't load it again in the background after us */
+		for (guint i = 0; i < priv->prewarm->len; i++) {
+			if (g_array_index (priv->prewarm, DnfSackAddFlags, i) == flags) {
+				g_array_remove_index (priv->prewarm, i);
+				break;
+			}
+		}
+	}
+
+	return pk_backend_create_sack (backend,
+				       job_data->context,
+				       flags,
+				       pk_backend_job_get_cache_age (job),
+				       state,
+				       error);
+}
+
 static GPtrArray *
 dnf_utils_run_query_with_newest_filter (DnfSack *sack, HyQuery query)
 {
@@ -1549,12 +1794,12 @@ pk_backend_refresh_subman (PkBackendJob *job)
 		return;
 	}
 
-	pk_backend_sack_cache_invalidate (backend, "subscription-manager ran");
+	pk_backend_sack_cache_invalidate (backend, PK_BACKEND_DNF_CHANGED_REPOS, "subscription-manager ran");
 	pk_backend_repo_list_changed (backend);
 }
 
 static GPtrArray *
-pk_backend_find_refresh_repos (PkBackendJob *job,
+pk_backend_find_refresh_repos (guint         cache_age,
 			       DnfState     *state,
 			       GPtrArray    *repos,
 			       gboolean      force,
@@ -1596,7 +1841,7 @@ pk_backend_find_refresh_repos (PkBackendJob *job,
 		/* is the repo up to date? */
 		state_loop = dnf_state_get_child (state_local);
 		repo_okay = dnf_repo_check (repo,
-		                            pk_backend_job_get_cache_age (job),
+		                            cache_age,
 		                            state_loop,
 		                            NULL);
 		if (!repo_okay || force)
@@ -1623,16 +1868,16 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
 	PkBackend *backend = pk_backend_job_get_backend (job);
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
-	DnfRepo *repo;
 	DnfState *state_local;
 	gboolean force;
 	gboolean ret;
+	gint max_parallel;
 	guint i;
+	g_autofree guint64 *timestamps = NULL;
 	g_autoptr(DnfSack) sack = NULL;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GPtrArray) refresh_repos = NULL;
 	g_autoptr(GPtrArray) repos = NULL;
-	g_autofree gchar *max_cache_age = NULL;
 
 	/* set state */
 	dnf_state_set_steps (job_data->state, NULL,
@@ -1656,7 +1901,8 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 	}
 
 	/* figure out which repos need refreshing */
-	refresh_repos = pk_backend_find_refresh_repos (job, job_data->state, repos, force, &error);
+	refresh_repos = pk_backend_find_refresh_repos (pk_backend_job_get_cache_age (job),
+						       job_data->state, repos, force, &error);
 	if (refresh_repos == NULL) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		return;
@@ -1669,51 +1915,39 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 		return;
 	}
 
-	/* refresh each repo */
-	state_local = dnf_state_get_child (job_data->state);
-	dnf_state_set_number_steps (state_local, refresh_repos->len);
-	max_cache_age = g_strdup_printf ("%u", pk_backend_job_get_cache_age (job));
-	for (i = 0; i < refresh_repos->len; i++) {
-		gint wait_status;
-		const gchar *refresh[5];
-		repo = g_ptr_array_index (refresh_repos, i);
-
-		/* delete content even if up to date */
-		if (force) {
-			g_debug ("Deleting contents of %s as forced", dnf_repo_get_id (repo));
-			ret = dnf_repo_clean (repo, &error);
-			if (!ret) {
-				pk_backend_job_error_code (job, error->code, "%s", error->message);
-				return;
-			}
-		}
-
-		/* check and download */
-		refresh[0] = LIBEXECDIR "/packagekit-dnf-refresh-repo";
-		refresh[1] = max_cache_age;
-		refresh[2] = dnf_repo_get_id (repo);
-		refresh[3] = priv->release_ver;
-		refresh[4] = NULL;
-		if (!g_spawn_sync (NULL,
-				   (gchar **) refresh,
-				   NULL,
-				   G_SPAWN_DEFAULT,
-				   NULL,
-				   NULL,
-				   NULL,
-				   NULL,
-				   &wait_status,
-				   &error))
-			pk_backend_job_error_code (job, error->code, "%s", "unkown error in pk_backend_refresh_repo");
+	/* remember which metadata we had */
+	timestamps = g_new0 (guint64, refresh_repos->len);
+	for (i = 0; i < refresh_repos->len; i++)
+		timestamps[i] = dnf_repo_get_timestamp_generated (g_ptr_array_index (refresh_repos, i));
 
-		/* done */
-		ret = dnf_state_done (state_local, &error);
+	/* delete content even if up to date */
+	for (i = 0; force && i < refresh_repos->len; i++) {
+		DnfRepo *repo = g_ptr_array_index (refresh_repos, i);
+		g_debug ("Deleting contents of %s as forced", dnf_repo_get_id (repo));
+		ret = dnf_repo_clean (repo, &error);
 		if (!ret) {
 			pk_backend_job_error_code (job, error->code, "%s", error->message);
 			return;
 		}
 	}
 
+	/* check and download all of them at once; the repos belong to the
+	 * shared context, but jobs never run in parallel in this backend and
+	 * the prewarm thread loads its sacks from a context of its own */
+	max_parallel = g_key_file_get_integer (priv->conf, "Daemon", "MaxParallelRefresh", NULL);
+	if (max_parallel <= 0)
+		max_parallel = DNF_REFRESH_MAX_PARALLEL;
+	state_local = dnf_state_get_child (job_data->state);
+	ret = dnf_utils_refresh_repos (refresh_repos,
+				       pk_backend_job_get_cache_age (job),
+				       (guint) max_parallel,
+				       pk_backend_job_get_cancellable (job),
+				       state_local, &error);
+	if (!ret) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		return;
+	}
+
 	/* done */
 	ret = dnf_state_done (job_data->state, &error);
 	if (!ret) {
@@ -1721,8 +1955,17 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 		return;
 	}
 
-	/* invalidate the sack cache after downloading new metadata */
-	pk_backend_sack_cache_invalidate (backend, "downloaded new metadata");
+	/* invalidate the sacks with remote repos if any of them got new
+	 * metadata, the ones with only installed packages stay valid */
+	for (i = 0; i < refresh_repos->len; i++) {
+		DnfRepo *repo = g_ptr_array_index (refresh_repos, i);
+		if (force || dnf_repo_get_timestamp_generated (repo) != timestamps[i]) {
+			pk_backend_sack_cache_invalidate (backend,
+							  PK_BACKEND_DNF_CHANGED_REPOS,
+							  "downloaded new metadata");
+			break;
+		}
+	}
 
 	/* We just downloaded our cache, avoid doing so again */
 	pk_backend_job_set_cache_age(job, G_MAXUINT);
@@ -2743,6 +2986,119 @@ pk_backend_get_download_rpms (HyGoal goal)
 	return g_steal_pointer (&download_rpms);
 }
 
+/* flags that do not change how the goal is solved */
+static PkBitfield
+pk_backend_solution_flags (PkBitfield transaction_flags)
+{
+	pk_bitfield_remove (transaction_flags, PK_TRANSACTION_FLAG_ENUM_SIMULATE);
+	pk_bitfield_remove (transaction_flags, PK_TRANSACTION_FLAG_ENUM_ONLY_DOWNLOAD);
+	pk_bitfield_remove (transaction_flags, PK_TRANSACTION_FLAG_ENUM_ONLY_TRUSTED);
+	return transaction_flags;
+}
+
+/* compares everything but the transaction flags, which come first */
+static gboolean
+pk_backend_solution_params_equal (GVariant *params1, GVariant *params2)
+{
+	gsize n_children;
+
+	if (!g_variant_type_equal (g_variant_get_type (params1),
+				   g_variant_get_type (params2)))
+		return FALSE;
+	n_children = g_variant_n_children (params1);
+	for (gsize i = 1; i < n_children; i++) {
+		g_autoptr(GVariant) child1 = g_variant_get_child_value (params1, i);
+		g_autoptr(GVariant) child2 = g_variant_get_child_value (params2, i);
+		if (!g_variant_equal (child1, child2))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * pk_backend_solution_restore:
+ *
+ * Takes the goal solved by the simulation the client got the solution token
+ * of, if it was for the same request and the sacks did not change since.
+ * Must be called before getting the sack, as it also records the generation
+ * of the sacks for pk_backend_solution_save().
+ **/
+static gboolean
+pk_backend_solution_restore (PkBackendJob *job, GVariant *params)
+{
+	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (job_data->backend);
+	PkBackendDnfSolution *solution;
+	const gchar *token = pk_backend_job_get_solution_token (job);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->sack_mutex);
+
+	job_data->generation = priv->sack_generation;
+
+	/* nothing to reuse */
+	solution = priv->solution;
+	if (token == NULL || solution == NULL)
+		return FALSE;
+	if (pk_bitfield_contain (job_data->transaction_flags,
+				 PK_TRANSACTION_FLAG_ENUM_SIMULATE))
+		return FALSE;
+	if (g_strcmp0 (token, solution->token) != 0) {
+		g_debug ("solution %s is not the last one, resolving again", token);
+		return FALSE;
+	}
+	if (solution->generation != priv->sack_generation ||
+	    solution->role != pk_backend_job_get_role (job) ||
+	    solution->transaction_flags != pk_backend_solution_flags (job_data->transaction_flags) ||
+	    !pk_backend_solution_params_equal (solution->params, params)) {
+		g_debug ("solution %s does not match, resolving again", token);
+		return FALSE;
+	}
+
+	/* a goal can only be committed once */
+	g_debug ("reusing solution %s", token);
+	job_data->goal = g_steal_pointer (&solution->goal);
+	job_data->sack = g_steal_pointer (&solution->sack);
+	job_data->goal_solved = TRUE;
+	g_clear_pointer (&priv->solution, pk_backend_dnf_solution_free);
+	return TRUE;
+}
+
+/*
+ * pk_backend_solution_save:
+ *
+ * Keeps the goal of a successful simulation so that the real transaction can
+ * reuse it, and gives the client a token for it.
+ **/
+static void
+pk_backend_solution_save (PkBackendJob *job)
+{
+	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (job_data->backend);
+	PkBackendDnfSolution *solution;
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	/* the role did not set the sack, so it cannot be reused */
+	if (job_data->sack == NULL)
+		return;
+
+	/* the sacks were invalidated while we were solving */
+	locker = g_mutex_locker_new (&priv->sack_mutex);
+	if (job_data->generation != priv->sack_generation)
+		return;
+
+	solution = g_new0 (PkBackendDnfSolution, 1);
+	solution->token = g_uuid_string_random ();
+	solution->generation = job_data->generation;
+	solution->role = pk_backend_job_get_role (job);
+	solution->transaction_flags = pk_backend_solution_flags (job_data->transaction_flags);
+	solution->params = g_variant_ref (pk_backend_job_get_parameters (job));
+	solution->sack = g_steal_pointer (&job_data->sack);
+	solution->goal = g_steal_pointer (&job_data->goal);
+	g_clear_pointer (&priv->solution, pk_backend_dnf_solution_free);
+	priv->solution = solution;
+
+	pk_backend_job_solution (job, solution->token);
+}
+
 static gboolean
 pk_backend_transaction_run (PkBackendJob *job,
 			    DnfState *state,
@@ -2783,9 +3139,11 @@ pk_backend_transaction_run (PkBackendJob *job,
 	dnf_transaction_set_dont_solve_goal (job_data->transaction, TRUE);
 	if (!dnf_context_get_install_weak_deps ())
 		dnf_flags |= DNF_IGNORE_WEAK_DEPS;
-	ret = dnf_goal_depsolve (job_data->goal, dnf_flags, error);
-	if (!ret)
-		return FALSE;
+	if (!job_data->goal_solved) {
+		ret = dnf_goal_depsolve (job_data->goal, dnf_flags, error);
+		if (!ret)
+			return FALSE;
+	}
 
 	ret = dnf_transaction_depsolve (job_data->transaction,
 					job_data->goal,
@@ -2807,6 +3165,7 @@ pk_backend_transaction_run (PkBackendJob *job,
 						       error);
 		if (!ret)
 			return FALSE;
+		pk_backend_solution_save (job);
 		return dnf_state_done (state, error);
 	}
 
@@ -2830,6 +3189,27 @@ pk_backend_transaction_run (PkBackendJob *job,
 	return dnf_state_done (state, error);
 }
 
+/*
+ * pk_backend_transaction_run_solution:
+ *
+ * Runs the transaction with a goal restored from a simulation.
+ * Returns FALSE if there is none, and the role has to solve the goal itself.
+ **/
+static gboolean
+pk_backend_transaction_run_solution (PkBackendJob *job, GVariant *params)
+{
+	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	g_autoptr(GError) error = NULL;
+
+	if (!pk_backend_solution_restore (job, params))
+		return FALSE;
+
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_RUNNING);
+	if (!pk_backend_transaction_run (job, job_data->state, &error))
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+	return TRUE;
+}
+
 static void
 pk_backend_repo_remove_thread (PkBackendJob *job,
 			       GVariant *params,
@@ -3089,6 +3469,10 @@ pk_backend_remove_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	pk_backend_job_set_percentage (job, 0);
 
+	/* reuse the goal of the simulation if nothing changed since */
+	if (pk_backend_transaction_run_solution (job, params))
+		return;
+
 	/* set state */
 	ret = dnf_state_set_steps (job_data->state, NULL,
 				   3, /* add repos */
@@ -3163,6 +3547,7 @@ pk_backend_remove_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 
 	/* remove packages */
 	job_data->goal = hy_goal_create (sack);
+	job_data->sack = g_object_ref (sack);
 	for (i = 0; package_ids[i] != NULL; i++) {
 		pkg = g_hash_table_lookup (hash, package_ids[i]);
 		if (pkg == NULL) {
@@ -3234,6 +3619,10 @@ pk_backend_install_packages_thread (PkBackendJob *job, GVariant *params, gpointe
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	pk_backend_job_set_percentage (job, 0);
 
+	/* reuse the goal of the simulation if nothing changed since */
+	if (pk_backend_transaction_run_solution (job, params))
+		return;
+
 	/* set state */
 	ret = dnf_state_set_steps (job_data->state, NULL,
 				   3, /* add repos */
@@ -3355,6 +3744,7 @@ pk_backend_install_packages_thread (PkBackendJob *job, GVariant *params, gpointe
 
 	/* install packages */
 	job_data->goal = hy_goal_create (sack);
+	job_data->sack = g_object_ref (sack);
 	for (i = 0; package_ids[i] != NULL; i++) {
 		pkg = g_hash_table_lookup (hash, package_ids[i]);
 		if (pkg == NULL) {
@@ -3534,6 +3924,10 @@ pk_backend_update_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	pk_backend_job_set_percentage (job, 0);
 
+	/* reuse the goal of the simulation if nothing changed since */
+	if (pk_backend_transaction_run_solution (job, params))
+		return;
+
 	/* set state */
 	ret = dnf_state_set_steps (job_data->state, NULL,
 				   9, /* add repos */
@@ -3580,6 +3974,7 @@ pk_backend_update_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 
 	/* install packages */
 	job_data->goal = hy_goal_create (sack);
+	job_data->sack = g_object_ref (sack);
 	for (i = 0; package_ids[i] != NULL; i++) {
 		pkg = g_hash_table_lookup (hash, package_ids[i]);
 		if (pkg == NULL) {
@@ -0,0 +1,175 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libdnf/libdnf.h>
+
+#include "pk-shared.h"
+#include "pk-backend-dnf-common.h"
+
+#define DNF_TEST_REPOS		6
+#define DNF_TEST_MAX_PARALLEL	3
+
+static void
+dnf_test_write_file (const gchar *filename, const gchar *contents)
+{
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *dirname = g_path_get_dirname (filename);
+
+	g_assert_cmpint (g_mkdir_with_parents (dirname, 0755), ==, 0);
+	g_file_set_contents (filename, contents, -1, &error);
+	g_assert_no_error (error);
+}
+
+/* a repo without any packages, which is all librepo needs to download */
+static void
+dnf_test_create_mirror (const gchar *mirror_dir)
+{
+	const gchar *primary =
+		"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<metadata xmlns=\"http://linux.duke.edu/metadata/common\" "
+		"xmlns:rpm=\"http://linux.duke.edu/metadata/rpm\" packages=\"0\">\n"
+		"</metadata>\n";
+	g_autofree gchar *checksum = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *repomd = NULL;
+
+	filename = g_build_filename (mirror_dir, "repodata", "primary.xml", NULL);
+	dnf_test_write_file (filename, primary);
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, primary, -1);
+	repomd = g_strdup_printf ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+				  "<repomd xmlns=\"http://linux.duke.edu/metadata/repo\">\n"
+				  "  <revision>1</revision>\n"
+				  "  <data type=\"primary\">\n"
+				  "    <checksum type=\"sha256\">%s</checksum>\n"
+				  "    <open-checksum type=\"sha256\">%s</open-checksum>\n"
+				  "    <location href=\"repodata/primary.xml\"/>\n"
+				  "    <timestamp>1700000000</timestamp>\n"
+				  "    <size>%" G_GSIZE_FORMAT "</size>\n"
+				  "    <open-size>%" G_GSIZE_FORMAT "</open-size>\n"
+				  "  </data>\n"
+				  "</repomd>\n",
+				  checksum, checksum,
+				  strlen (primary), strlen (primary));
+	g_free (filename);
+	filename = g_build_filename (mirror_dir, "repodata", "repomd.xml", NULL);
+	dnf_test_write_file (filename, repomd);
+}
+
+static void
+dnf_test_refresh_repos_func (void)
+{
+	gboolean ret;
+	const gchar *repos_dir[] = { NULL, NULL };
+	g_autofree gchar *cache_dir = NULL;
+	g_autofree gchar *mirror_dir = NULL;
+	g_autofree gchar *mirrorlist = NULL;
+	g_autofree gchar *mirrorlist_uri = NULL;
+	g_autofree gchar *repo_dir = NULL;
+	g_autofree gchar *solv_dir = NULL;
+	g_autofree gchar *tmp_dir = NULL;
+	g_autoptr(DnfContext) context = NULL;
+	g_autoptr(DnfState) state = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) repos = NULL;
+	g_autoptr(GString) repo_file = g_string_new (NULL);
+
+	tmp_dir = g_dir_make_tmp ("pk-dnf-test-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	/* all repos download from the same mirror, through a mirrorlist so
+	 * that libdnf does not consider them local repos */
+	mirror_dir = g_build_filename (tmp_dir, "mirror", NULL);
+	dnf_test_create_mirror (mirror_dir);
+	mirrorlist = g_build_filename (tmp_dir, "mirrorlist", NULL);
+	mirrorlist_uri = g_strdup_printf ("file://%s\n", mirror_dir);
+	dnf_test_write_file (mirrorlist, mirrorlist_uri);
+	for (guint i = 0; i < DNF_TEST_REPOS; i++) {
+		g_string_append_printf (repo_file,
+					"[pk-test-%u]\n"
+					"name=PackageKit test %u\n"
+					"mirrorlist=file://%s\n"
+					"enabled=1\n"
+					"gpgcheck=0\n"
+					"repo_gpgcheck=0\n\n",
+					i, i, mirrorlist);
+	}
+	repo_dir = g_build_filename (tmp_dir, "yum.repos.d", NULL);
+	{
+		g_autofree gchar *filename = g_build_filename (repo_dir, "pk-test.repo", NULL);
+		dnf_test_write_file (filename, repo_file->str);
+	}
+
+	/* nothing may be read from or written to the real system */
+	context = dnf_context_new ();
+	cache_dir = g_build_filename (tmp_dir, "metadata", NULL);
+	solv_dir = g_build_filename (tmp_dir, "hawkey", NULL);
+	repos_dir[0] = repo_dir;
+	dnf_context_set_install_root (context, tmp_dir);
+	dnf_context_set_cache_dir (context, cache_dir);
+	dnf_context_set_solv_dir (context, solv_dir);
+	dnf_context_set_lock_dir (context, tmp_dir);
+	dnf_context_set_repos_dir (context, repos_dir);
+	dnf_context_set_release_ver (context, "1");
+	ret = dnf_context_setup (context, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+
+	repos = dnf_repo_loader_get_repos (dnf_context_get_repo_loader (context), &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (repos);
+	g_assert_cmpint (repos->len, ==, DNF_TEST_REPOS);
+
+	/* there is no metadata yet, so every repo has to be downloaded */
+	state = dnf_state_new ();
+	ret = dnf_utils_refresh_repos (repos, 0, DNF_TEST_MAX_PARALLEL, NULL, state, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	g_assert_cmpint (dnf_state_get_percentage (state), ==, 100);
+
+	for (guint i = 0; i < repos->len; i++) {
+		DnfRepo *repo = g_ptr_array_index (repos, i);
+		const gchar *primary = dnf_repo_get_filename_md (repo, "primary");
+		g_autoptr(DnfState) state_check = dnf_state_new ();
+
+		g_assert_nonnull (primary);
+		g_assert_true (g_str_has_prefix (primary, cache_dir));
+		g_assert_true (g_file_test (primary, G_FILE_TEST_EXISTS));
+		ret = dnf_repo_check (repo, G_MAXUINT, state_check, &error);
+		g_assert_no_error (error);
+		g_assert_true (ret);
+	}
+
+	pk_directory_remove_contents (tmp_dir);
+	g_assert_cmpint (g_rmdir (tmp_dir), ==, 0);
+}
+
+int
+main (int argc, char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/dnf/refresh-repos", dnf_test_refresh_repos_func);
+
+	return g_test_run ();
+}
@@ -42,12 +42,19 @@ dnf5_query_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 	PkBackendDnf5Private *priv = (PkBackendDnf5Private *) pk_backend_get_user_data (backend);
 	PkRoleEnum role = pk_backend_job_get_role (job);
 
-	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->mutex);
-
-	// Update cache-only mode based on current network state
-	dnf5_update_network_state(priv, pk_backend_is_online(backend));
-
 	try {
+		// Queries only read from the published base, so they run concurrently
+		// with each other and with writers building the next one. Resolving
+		// the updates changes the pool and has to exclude them.
+		auto snapshot = dnf5_get_snapshot(priv);
+		auto base = snapshot->base;
+		g_autoptr(GRWLockReaderLocker) reader_locker = NULL;
+		g_autoptr(GRWLockWriterLocker) writer_locker = NULL;
+		if (role == PK_ROLE_ENUM_GET_UPDATES)
+			writer_locker = g_rw_lock_writer_locker_new (&snapshot->lock);
+		else
+			reader_locker = g_rw_lock_reader_locker_new (&snapshot->lock);
+
 		if (role == PK_ROLE_ENUM_SEARCH_NAME || role == PK_ROLE_ENUM_SEARCH_DETAILS || role == PK_ROLE_ENUM_SEARCH_FILE || role == PK_ROLE_ENUM_RESOLVE || role == PK_ROLE_ENUM_WHAT_PROVIDES) {
 			PkBitfield filters;
 			g_auto(GStrv) values = NULL;
@@ -56,7 +63,7 @@ dnf5_query_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 			g_debug("Query role=%d, filters=%lu", role, (unsigned long)filters);
 			
 			std::vector<libdnf5::rpm::Package> results;
-			libdnf5::rpm::PackageQuery query(*priv->base);
+			libdnf5::rpm::PackageQuery query(*base);
 			
 			std::vector<std::string> search_terms;
 			for (int i = 0; values[i]; i++) search_terms.push_back(values[i]);
@@ -87,12 +94,12 @@ dnf5_query_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 				}
 				query.filter_provides(provides);
 			} else if (role == PK_ROLE_ENUM_SEARCH_DETAILS) {
-				libdnf5::rpm::PackageQuery query_sum(*priv->base);
+				libdnf5::rpm::PackageQuery query_sum(*base);
 				query.filter_description(search_terms, libdnf5::sack::QueryCmp::ICONTAINS);
 				query_sum.filter_summary(search_terms, libdnf5::sack::QueryCmp::ICONTAINS);
 				// Apply filters to both queries before merging
-				dnf5_apply_filters(*priv->base, query, filters);
-				dnf5_apply_filters(*priv->base, query_sum, filters);
+				dnf5_apply_filters(*base, query, filters);
+				dnf5_apply_filters(*base, query_sum, filters);
 				for (auto p : query_sum) {
 					if (dnf5_package_filter(p, filters))
 						results.push_back(p);
@@ -103,7 +110,7 @@ dnf5_query_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 			// Exception: SEARCH_DETAILS already applied filters above
 			if (role != PK_ROLE_ENUM_SEARCH_DETAILS) {
 				g_debug("Before dnf5_apply_filters: query has %zu packages", query.size());
-				dnf5_apply_filters(*priv->base, query, filters);
+				dnf5_apply_filters(*base, query, filters);
 				g_debug("After dnf5_apply_filters: query has %zu packages", query.size());
 			}
 			
@@ -130,10 +137,10 @@ dnf5_query_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 			gboolean recursive;
 			g_variant_get (params, "(t^asb)", &filters, &package_ids, &recursive);
 			
-			auto input_pkgs = dnf5_resolve_package_ids(*priv->base, package_ids);
+			auto input_pkgs = dnf5_resolve_package_ids(*base, package_ids);
 			std::vector<libdnf5::rpm::Package> results;
 			for (const auto &pkg : input_pkgs) {
-				auto deps = dnf5_process_dependency(*priv->base, pkg, role, recursive);
+				auto deps = dnf5_process_dependency(*base, pkg, role, recursive);
 				for (auto dep : deps) {
 					if (dnf5_package_filter(dep, filters))
 						results.push_back(dep);
@@ -145,12 +152,12 @@ dnf5_query_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 			PkBitfield filters;
 			g_variant_get (params, "(t)", &filters);
 			
-			libdnf5::rpm::PackageQuery query(*priv->base);
-			dnf5_apply_filters(*priv->base, query, filters);
+			libdnf5::rpm::PackageQuery query(*base);
+			dnf5_apply_filters(*base, query, filters);
 			
 			if (role == PK_ROLE_ENUM_GET_UPDATES) {
-				libdnf5::Goal goal(*priv->base);
-				if (dnf5_force_distupgrade_on_upgrade (*priv->base))
+				libdnf5::Goal goal(*base);
+				if (dnf5_force_distupgrade_on_upgrade (*base))
 					goal.add_rpm_distro_sync();
 				else
 					goal.add_rpm_upgrade();
@@ -164,8 +171,8 @@ dnf5_query_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 					}
 				}
 				
-				libdnf5::advisory::AdvisoryQuery adv_query(*priv->base);
-				libdnf5::rpm::PackageSet pkg_set(priv->base->get_weak_ptr());
+				libdnf5::advisory::AdvisoryQuery adv_query(*base);
+				libdnf5::rpm::PackageSet pkg_set(base->get_weak_ptr());
 				for (const auto &pkg : update_pkgs) pkg_set.add(pkg);
 				adv_query.filter_packages(pkg_set);
 				
@@ -202,12 +209,15 @@ dnf5_query_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 			if (role == PK_ROLE_ENUM_DOWNLOAD_PACKAGES) {
 				gchar *directory = NULL;
 				g_variant_get (params, "(^as&s)", &package_ids, &directory);
-				auto pkgs = dnf5_resolve_package_ids(*priv->base, package_ids);
-				libdnf5::repo::PackageDownloader downloader(*priv->base);
+				auto pkgs = dnf5_resolve_package_ids(*base, package_ids);
+				g_autoptr(GMutexLocker) download_locker = g_mutex_locker_new (&priv->download_mutex);
+				// Update cache-only mode based on current network state
+				dnf5_update_network_state(*base, pk_backend_is_online(backend));
+				libdnf5::repo::PackageDownloader downloader(*base);
 				uint64_t total_download_size = 0;
 				for (const auto &pkg : pkgs) total_download_size += pkg.get_download_size();
 				
-				priv->base->set_download_callbacks(std::make_unique<Dnf5DownloadCallbacks>(job, total_download_size));
+				base->set_download_callbacks(std::make_unique<Dnf5DownloadCallbacks>(job, total_download_size));
 				for (auto &pkg : pkgs) {
 					dnf5_emit_pkg(job, pkg, PK_INFO_ENUM_DOWNLOADING);
 					downloader.add(pkg, directory);
@@ -228,10 +238,10 @@ dnf5_query_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 				g_variant_get (params, "(^as)", &package_ids);
 			}
 			
-			auto pkgs = dnf5_resolve_package_ids(*priv->base, package_ids);
+			auto pkgs = dnf5_resolve_package_ids(*base, package_ids);
 			if (role == PK_ROLE_ENUM_GET_UPDATE_DETAIL) {
-				libdnf5::advisory::AdvisoryQuery adv_query(*priv->base);
-				libdnf5::rpm::PackageSet pkg_set(priv->base->get_weak_ptr());
+				libdnf5::advisory::AdvisoryQuery adv_query(*base);
+				libdnf5::rpm::PackageSet pkg_set(base->get_weak_ptr());
 				for (const auto &pkg : pkgs) pkg_set.add(pkg);
 				adv_query.filter_packages(pkg_set);
 				
@@ -339,7 +349,7 @@ dnf5_query_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 		} else if (role == PK_ROLE_ENUM_GET_REPO_LIST) {
 			PkBitfield filters;
 			g_variant_get (params, "(t)", &filters);
-			libdnf5::repo::RepoQuery query(*priv->base);
+			libdnf5::repo::RepoQuery query(*base);
 			for (auto repo : query) {
 				std::string id = repo->get_id();
 				if (id == "@System" || id == "@commandline") continue;
@@ -360,23 +370,47 @@ dnf5_transaction_thread (PkBackendJob *job, GVariant *params, gpointer user_data
 	PkBackendDnf5Private *priv = (PkBackendDnf5Private *) pk_backend_get_user_data (backend);
 	PkRoleEnum role = pk_backend_job_get_role (job);
 
-	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->mutex);
-
-	// Update cache-only mode based on current network state
-	dnf5_update_network_state(priv, pk_backend_is_online(backend));
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->write_mutex);
+	gboolean online = pk_backend_is_online(backend);
+	PkBitfield transaction_flags = 0;
+	g_variant_get_child (params, 0, "t", &transaction_flags);
+	gboolean simulate = pk_bitfield_contain (transaction_flags, PK_TRANSACTION_FLAG_ENUM_SIMULATE);
 
 	try {
+		if (role == PK_ROLE_ENUM_REPAIR_SYSTEM) {
+			if (simulate) {
+				pk_backend_job_finished (job);
+				return;
+			}
+			std::filesystem::path rpm_db_path("/var/lib/rpm");
+			if (std::filesystem::exists(rpm_db_path) && std::filesystem::is_directory(rpm_db_path)) {
+				for (const auto& entry : std::filesystem::directory_iterator(rpm_db_path)) {
+					if (entry.is_regular_file() && entry.path().filename().string().starts_with("__db.")) {
+						std::filesystem::remove(entry.path());
+					}
+				}
+			}
+			pk_backend_job_finished (job);
+			return;
+		}
+
+		// Simulations resolve against the published base and only exclude
+		// the readers of that snapshot while the goal is resolved. Anything
+		// that downloads or commits works on a private base instead, as do
+		// command line packages, which change the sack; the published base
+		// is replaced once the transaction has run.
+		std::shared_ptr<Dnf5BaseSnapshot> snapshot;
+		std::shared_ptr<libdnf5::Base> base;
+
 		if (role == PK_ROLE_ENUM_UPGRADE_SYSTEM) {
-			gchar *distro_id = NULL;
-			PkUpgradeKindEnum upgrade_kind;
-			PkBitfield transaction_flags;
-			g_variant_get (params, "(t&su)", &transaction_flags, &distro_id, &upgrade_kind);
+			const gchar *distro_id = NULL;
+			g_variant_get_child (params, 1, "&s", &distro_id);
 			if (distro_id) {
-				dnf5_setup_base(priv, TRUE, TRUE, distro_id);
+				base = dnf5_create_base(priv, TRUE, TRUE, distro_id, online);
 				
 				g_debug("Checking repositories for system upgrade to %s:", distro_id);
 				// ... logging code ...
-				libdnf5::repo::RepoQuery query(*priv->base);
+				libdnf5::repo::RepoQuery query(*base);
 				for (auto repo : query) {
 					// Check if baseurl contains the correct version
 					auto baseurl = repo->get_config().get_baseurl_option().get_value();
@@ -389,20 +423,32 @@ dnf5_transaction_thread (PkBackendJob *job, GVariant *params, gpointer user_data
 			}
 		}
 
-		libdnf5::Goal goal(*priv->base);
-		PkBitfield transaction_flags = 0;
+		g_autoptr(GRWLockReaderLocker) reader_locker = NULL;
+		g_autoptr(GRWLockWriterLocker) writer_locker = NULL;
+		if (!base && (role == PK_ROLE_ENUM_INSTALL_FILES || !simulate)) {
+			base = dnf5_create_base(priv, FALSE, FALSE, nullptr, online);
+		} else if (!base) {
+			snapshot = dnf5_get_snapshot(priv);
+			base = snapshot->base;
+			writer_locker = g_rw_lock_writer_locker_new (&snapshot->lock);
+		}
+
+		libdnf5::Goal goal(*base);
 		
 		if (role == PK_ROLE_ENUM_INSTALL_PACKAGES || role == PK_ROLE_ENUM_UPDATE_PACKAGES || role == PK_ROLE_ENUM_REMOVE_PACKAGES) {
 			g_auto(GStrv) package_ids = NULL;
+			libdnf5::GoalJobSettings remove_settings;
 			if (role == PK_ROLE_ENUM_REMOVE_PACKAGES) {
 				gboolean allow_deps, autoremove;
 				g_variant_get (params, "(t^asbb)", &transaction_flags, &package_ids, &allow_deps, &autoremove);
-				if (autoremove) priv->base->get_config().get_clean_requirements_on_remove_option().set(true);
+				// set per job, the configuration of a shared base must not change
+				if (autoremove)
+					remove_settings.set_clean_requirements_on_remove(libdnf5::GoalSetting::SET_TRUE);
 			} else {
 				g_variant_get (params, "(t^as)", &transaction_flags, &package_ids);
 			}
 			
-			auto pkgs = dnf5_resolve_package_ids(*priv->base, package_ids);
+			auto pkgs = dnf5_resolve_package_ids(*base, package_ids);
 			if (pkgs.empty() && role != PK_ROLE_ENUM_UPDATE_PACKAGES) {
 				pk_backend_job_error_code (job, PK_ERROR_ENUM_PACKAGE_NOT_FOUND, "No packages found");
 				pk_backend_job_finished (job);
@@ -411,11 +457,11 @@ dnf5_transaction_thread (PkBackendJob *job, GVariant *params, gpointer user_data
 			
 			for (auto &pkg : pkgs) {
 				if (role == PK_ROLE_ENUM_INSTALL_PACKAGES) goal.add_rpm_install(pkg);
-				else if (role == PK_ROLE_ENUM_REMOVE_PACKAGES) goal.add_rpm_remove(pkg);
+				else if (role == PK_ROLE_ENUM_REMOVE_PACKAGES) goal.add_rpm_remove(pkg, remove_settings);
 				else if (role == PK_ROLE_ENUM_UPDATE_PACKAGES) goal.add_rpm_upgrade(pkg);
 			}
 			if (role == PK_ROLE_ENUM_UPDATE_PACKAGES && pkgs.empty()) {
-				if (dnf5_force_distupgrade_on_upgrade (*priv->base))
+				if (dnf5_force_distupgrade_on_upgrade (*base))
 					goal.add_rpm_distro_sync();
 				else
 					goal.add_rpm_upgrade();
@@ -426,7 +472,7 @@ dnf5_transaction_thread (PkBackendJob *job, GVariant *params, gpointer user_data
 			g_variant_get (params, "(t^as)", &transaction_flags, &full_paths);
 			std::vector<std::string> paths;
 			for (int i = 0; full_paths[i]; i++) paths.push_back(full_paths[i]);
-			auto added = priv->base->get_repo_sack()->add_cmdline_packages(paths);
+			auto added = base->get_repo_sack()->add_cmdline_packages(paths);
 			for (const auto &p : added) goal.add_rpm_install(p.second);
 		} else if (role == PK_ROLE_ENUM_UPGRADE_SYSTEM) {
 			const gchar *distro_id = NULL;
@@ -438,36 +484,27 @@ dnf5_transaction_thread (PkBackendJob *job, GVariant *params, gpointer user_data
 			goal.set_allow_erasing(true);
 			goal.add_rpm_distro_sync();
 			// System upgrades require processing groups to be upgraded
-			libdnf5::comps::GroupQuery q_groups(*priv->base);
+			libdnf5::comps::GroupQuery q_groups(*base);
 			q_groups.filter_installed(true);
 			for (const auto & grp : q_groups) {
 				goal.add_group_upgrade(grp.get_groupid());
 			}
-			libdnf5::comps::EnvironmentQuery q_environments(*priv->base);
+			libdnf5::comps::EnvironmentQuery q_environments(*base);
 			q_environments.filter_installed(true);
 			for (const auto & env : q_environments) {
 				goal.add_group_upgrade(env.get_environmentid());
             }
-		} else if (role == PK_ROLE_ENUM_REPAIR_SYSTEM) {
-			g_variant_get (params, "(t)", &transaction_flags);
-			if (pk_bitfield_contain (transaction_flags, PK_TRANSACTION_FLAG_ENUM_SIMULATE)) {
-				pk_backend_job_finished (job);
-				return;
-			}
-			std::filesystem::path rpm_db_path("/var/lib/rpm");
-			if (std::filesystem::exists(rpm_db_path) && std::filesystem::is_directory(rpm_db_path)) {
-				for (const auto& entry : std::filesystem::directory_iterator(rpm_db_path)) {
-					if (entry.is_regular_file() && entry.path().filename().string().starts_with("__db.")) {
-						std::filesystem::remove(entry.path());
-					}
-				}
-			}
-			pk_backend_job_finished (job);
-			return;
 		}
 		
 		pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 		auto trans = goal.resolve();
+
+		// the resolved transaction only reads from the pool
+		if (writer_locker != NULL) {
+			g_clear_pointer (&writer_locker, g_rw_lock_writer_locker_free);
+			reader_locker = g_rw_lock_reader_locker_new (&snapshot->lock);
+		}
+
 		auto problems = trans.get_transaction_problems();
 		if (!problems.empty()) {
 			std::string msg;
@@ -482,7 +519,7 @@ dnf5_transaction_thread (PkBackendJob *job, GVariant *params, gpointer user_data
 			g_debug("Transaction item: %s - %d", item.get_package().get_name().c_str(), (int)item.get_action());
 		}
 		
-		if (pk_bitfield_contain (transaction_flags, PK_TRANSACTION_FLAG_ENUM_SIMULATE)) {
+		if (simulate) {
 			std::set<std::string> continuing_names;
 			for (const auto &item : trans.get_transaction_packages()) {
 				auto action = item.get_action();
@@ -526,7 +563,8 @@ dnf5_transaction_thread (PkBackendJob *job, GVariant *params, gpointer user_data
 			}
 		}
 		
-		priv->base->set_download_callbacks(std::make_unique<Dnf5DownloadCallbacks>(job, total_download_size));
+		dnf5_update_network_state(*base, online);
+		base->set_download_callbacks(std::make_unique<Dnf5DownloadCallbacks>(job, total_download_size));
 		trans.download();
 
 		if (pk_bitfield_contain (transaction_flags, PK_TRANSACTION_FLAG_ENUM_ONLY_DOWNLOAD)) {
@@ -558,11 +596,12 @@ dnf5_transaction_thread (PkBackendJob *job, GVariant *params, gpointer user_data
 			pk_backend_job_error_code (job, PK_ERROR_ENUM_TRANSACTION_ERROR, "Transaction failed: %s", msg.c_str());
 		} else {
 			// Update timestamp to inhibit notifications from our own transaction
-			priv->last_notification_timestamp = g_get_monotonic_time ();
+			dnf5_inhibit_notifications (priv);
 		}
 
 		// Post-transaction base re-initialization to ensure state consistency
-		dnf5_setup_base (priv);
+		base.reset();
+		dnf5_setup_base (priv, FALSE, FALSE, nullptr, online);
 		
 	} catch (const std::exception &e) {
 		pk_backend_job_error_code (job, PK_ERROR_ENUM_TRANSACTION_ERROR, "%s", e.what());
@@ -577,13 +616,16 @@ dnf5_repo_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 	PkBackendDnf5Private *priv = (PkBackendDnf5Private *) pk_backend_get_user_data (backend);
 	PkRoleEnum role = pk_backend_job_get_role (job);
 
-	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->mutex);
-
-	// Update cache-only mode based on current network state
-	dnf5_update_network_state(priv, pk_backend_is_online(backend));
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->write_mutex);
+	gboolean online = pk_backend_is_online(backend);
 
 	try {
-		if (role == PK_ROLE_ENUM_REPO_ENABLE || role == PK_ROLE_ENUM_REPO_SET_DATA) {
+		if (role == PK_ROLE_ENUM_REFRESH_CACHE) {
+			gboolean force;
+			g_variant_get (params, "(b)", &force);
+			pk_backend_job_set_status (job, PK_STATUS_ENUM_REFRESH_CACHE);
+			dnf5_refresh_cache (priv, force, online);
+		} else if (role == PK_ROLE_ENUM_REPO_ENABLE || role == PK_ROLE_ENUM_REPO_SET_DATA) {
 			gchar *repo_id = NULL;
 			const gchar *parameter, *value;
 			if (role == PK_ROLE_ENUM_REPO_ENABLE) {
@@ -595,7 +637,11 @@ dnf5_repo_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 				g_variant_get (params, "(&s&s&s)", &repo_id, &parameter, &value);
 			}
 			
-			libdnf5::repo::RepoQuery query(*priv->base);
+			// The published base is only read here, the new repo state is
+			// picked up from the repo file by the base that replaces it
+			auto snapshot = dnf5_get_snapshot(priv);
+			g_autoptr(GRWLockReaderLocker) reader_locker = g_rw_lock_reader_locker_new (&snapshot->lock);
+			libdnf5::repo::RepoQuery query(*snapshot->base);
 			query.filter_id(repo_id);
 			for (auto repo : query) {
 				if (g_strcmp0(parameter, "enabled") == 0) {
@@ -605,21 +651,23 @@ dnf5_repo_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 						pk_backend_job_finished (job);
 						return;
 					}
-					if (enable) repo->enable(); else repo->disable();
 					libdnf5::ConfigParser parser;
 					parser.read(repo->get_repo_file_path());
 					parser.set_value(repo_id, "enabled", value);
 					parser.write(repo->get_repo_file_path(), false);
 				}
 			}
-			dnf5_setup_base (priv);
+			dnf5_setup_base (priv, FALSE, FALSE, nullptr, online);
 		} else if (role == PK_ROLE_ENUM_REPO_REMOVE) {
 			gchar *repo_id = NULL;
 			gboolean autoremove;
 			PkBitfield transaction_flags;
 			g_variant_get (params, "(t&sb)", &transaction_flags, &repo_id, &autoremove);
 			
-			libdnf5::repo::RepoQuery query(*priv->base);
+			// The transaction always runs, so it is resolved on a private
+			// base; the published one is replaced once it is done
+			auto base = dnf5_create_base(priv, FALSE, FALSE, nullptr, online);
+			libdnf5::repo::RepoQuery query(*base);
 			query.filter_id(repo_id);
 			std::string repo_file;
 			for (auto repo : query) {
@@ -637,17 +685,23 @@ dnf5_repo_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 
 			// Find all repos in the same file to track all packages that should be removed
 			std::vector<std::string> all_repo_ids;
-			libdnf5::repo::RepoQuery all_repos_query(*priv->base);
+			libdnf5::repo::RepoQuery all_repos_query(*base);
 			for (auto repo : all_repos_query) {
 				if (repo->get_repo_file_path() == repo_file) {
 					all_repo_ids.push_back(repo->get_id());
 				}
 			}
 
-			libdnf5::Goal goal(*priv->base);
+			libdnf5::Goal goal(*base);
+
+			// Enable unused dependency removal per job, the configuration
+			// of a shared base must not change
+			libdnf5::GoalJobSettings remove_settings;
+			if (autoremove)
+				remove_settings.set_clean_requirements_on_remove(libdnf5::GoalSetting::SET_TRUE);
 			
 			// Remove the owner package(s) of the repo file
-			libdnf5::rpm::PackageQuery owner_query(*priv->base);
+			libdnf5::rpm::PackageQuery owner_query(*base);
 			owner_query.filter_installed();
 			owner_query.filter_file({repo_file});
 			
@@ -658,24 +712,22 @@ dnf5_repo_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 
 			for (auto pkg : owner_query) {
 				g_debug("Adding owner package %s to removal goal", pkg.get_name().c_str());
-				goal.add_remove(pkg.get_name());
+				goal.add_remove(pkg.get_name(), remove_settings);
 			}
 			
 			// If autoremove is true, also remove packages installed from these repos
 			if (autoremove) {
-				libdnf5::rpm::PackageQuery inst_query(*priv->base);
+				libdnf5::rpm::PackageQuery inst_query(*base);
 				inst_query.filter_installed();
 				for (auto pkg : inst_query) {
 					std::string from_repo = pkg.get_from_repo_id();
 					for (const auto &id : all_repo_ids) {
 						if (from_repo == id) {
-							goal.add_remove(pkg.get_name());
+							goal.add_remove(pkg.get_name(), remove_settings);
 							break;
 						}
 					}
 				}
-				// Also enable unused dependency removal
-				priv->base->get_config().get_clean_requirements_on_remove_option().set(true);
 			}
 			
 			pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
@@ -705,6 +757,7 @@ dnf5_repo_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 			if (role == PK_ROLE_ENUM_REPO_REMOVE || !pk_bitfield_contain (transaction_flags, PK_TRANSACTION_FLAG_ENUM_SIMULATE)) {
 				pk_backend_job_set_status (job, PK_STATUS_ENUM_DOWNLOAD);
 				g_debug("Starting transaction download...");
+				base->set_download_callbacks(std::make_unique<Dnf5DownloadCallbacks>(job));
 				trans.download();
 				pk_backend_job_set_status (job, PK_STATUS_ENUM_RUNNING);
 				g_debug("Starting transaction execution...");
@@ -720,9 +773,10 @@ dnf5_repo_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 				} else {
 					g_debug("Transaction completed successfully");
 					// Update timestamp to inhibit notifications from our own transaction
-					priv->last_notification_timestamp = g_get_monotonic_time ();
+					dnf5_inhibit_notifications (priv);
 				}
-				dnf5_setup_base (priv);
+				base.reset();
+				dnf5_setup_base (priv, FALSE, FALSE, nullptr, online);
 			} else {
 				g_debug("Simulation completed, finishing job...");
 			}
@@ -37,16 +37,18 @@
 #include <queue>
 #include <filesystem>
 #include <map>
+#include <stdexcept>
+#include <utility>
 #include "dnf5-backend-vendor.hpp"
 
-void
-dnf5_setup_base (PkBackendDnf5Private *priv, gboolean refresh, gboolean force, const char *releasever, gboolean online)
+std::shared_ptr<libdnf5::Base>
+dnf5_create_base (PkBackendDnf5Private *priv, gboolean refresh, gboolean force, const char *releasever, gboolean online)
 {
-	priv->base = std::make_unique<libdnf5::Base>();
+	auto base = std::make_shared<libdnf5::Base>();
 
-	priv->base->load_config();
+	base->load_config();
 
-	auto &config = priv->base->get_config();
+	auto &config = base->get_config();
 	if (priv->conf != NULL) {
 		g_autofree gchar *destdir = g_key_file_get_string (priv->conf, "Daemon", "DestDir", NULL);
 		if (destdir != NULL) {
@@ -65,7 +67,7 @@ dnf5_setup_base (PkBackendDnf5Private *priv, gboolean refresh, gboolean force, c
 		}
 
 		if (distro_version != NULL) {
-			priv->base->get_vars()->set("releasever", distro_version);
+			base->get_vars()->set("releasever", distro_version);
 			const char *root = (destdir != NULL) ? destdir : "/";
 			g_autofree gchar *cache_dir = g_build_filename (root, "/var/cache/PackageKit", distro_version, "metadata", NULL);
 			g_debug("Using cachedir: %s", cache_dir);
@@ -92,7 +94,7 @@ dnf5_setup_base (PkBackendDnf5Private *priv, gboolean refresh, gboolean force, c
 		config.get_assumeyes_option().set(libdnf5::Option::Priority::COMMANDLINE, true);
 	}
 
-	priv->base->setup();
+	base->setup();
 
 	// Ensure releasever is set AFTER setup() because setup() might run auto-detection and overwrite it.
 	if (priv->conf != NULL) {
@@ -104,7 +106,7 @@ dnf5_setup_base (PkBackendDnf5Private *priv, gboolean refresh, gboolean force, c
 			distro_version = g_strdup(releasever);
 		}
 		if (distro_version != NULL) {
-			priv->base->get_vars()->set("releasever", distro_version);
+			base->get_vars()->set("releasever", distro_version);
 		}
 	}
 
@@ -115,12 +117,12 @@ dnf5_setup_base (PkBackendDnf5Private *priv, gboolean refresh, gboolean force, c
 		config.get_cacheonly_option().set(libdnf5::Option::Priority::RUNTIME, "all");
 	}
 
-	auto repo_sack = priv->base->get_repo_sack();
+	auto repo_sack = base->get_repo_sack();
 	repo_sack->create_repos_from_system_configuration();
 	repo_sack->get_system_repo();
 
 	if (refresh && force) {
-		libdnf5::repo::RepoQuery query(*priv->base);
+		libdnf5::repo::RepoQuery query(*base);
 		for (auto repo : query) {
 			if (repo->is_enabled()) {
 				g_debug("Expiring repository metadata: %s", repo->get_id().c_str());
@@ -132,17 +134,69 @@ dnf5_setup_base (PkBackendDnf5Private *priv, gboolean refresh, gboolean force, c
 	g_debug("Loading repositories");
 	repo_sack->load_repos();
 
-	libdnf5::repo::RepoQuery query(*priv->base);
+	libdnf5::repo::RepoQuery query(*base);
 	query.filter_enabled(true);
 	for (auto repo : query) {
 		g_debug("Enabled repository: %s", repo->get_id().c_str());
 	}
+
+	// libdnf5 computes provides and excludes lazily on the first query;
+	// do it here so that jobs sharing this base only ever read from it
+	libdnf5::rpm::PackageQuery prime(*base);
+	g_debug("Loaded %zu packages", prime.size());
+
+	return base;
+}
+
+Dnf5BaseSnapshot::Dnf5BaseSnapshot(std::shared_ptr<libdnf5::Base> base) : base(std::move(base))
+{
+	g_rw_lock_init (&lock);
+}
+
+Dnf5BaseSnapshot::~Dnf5BaseSnapshot()
+{
+	g_rw_lock_clear (&lock);
+}
+
+std::shared_ptr<Dnf5BaseSnapshot>
+dnf5_get_snapshot (PkBackendDnf5Private *priv)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->mutex);
+	if (!priv->snapshot)
+		throw std::runtime_error("dnf5 base is not initialized");
+	return priv->snapshot;
+}
+
+void
+dnf5_set_base (PkBackendDnf5Private *priv, std::shared_ptr<libdnf5::Base> base)
+{
+	auto snapshot = std::make_shared<Dnf5BaseSnapshot>(std::move(base));
+	std::shared_ptr<Dnf5BaseSnapshot> old;
+	{
+		g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->mutex);
+		old = std::exchange(priv->snapshot, std::move(snapshot));
+	}
+	// the old snapshot is freed here, or by the last job still using it
+}
+
+void
+dnf5_setup_base (PkBackendDnf5Private *priv, gboolean refresh, gboolean force, const char *releasever, gboolean online)
+{
+	dnf5_set_base (priv, dnf5_create_base (priv, refresh, force, releasever, online));
 }
 
 void
-dnf5_update_network_state(PkBackendDnf5Private *priv, gboolean online)
+dnf5_inhibit_notifications (PkBackendDnf5Private *priv)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->mutex);
+	priv->last_notification_timestamp = g_get_monotonic_time ();
+}
+
+
+void
+dnf5_update_network_state(libdnf5::Base &base, gboolean online)
 {
-	auto &config = priv->base->get_config();
+	auto &config = base.get_config();
 	if (online) {
 		g_debug("Clearing cache-only mode (online)");
 		config.get_cacheonly_option().set(libdnf5::Option::Priority::RUNTIME, "none");
@@ -153,9 +207,9 @@ dnf5_update_network_state(PkBackendDnf5Private *priv, gboolean online)
 }
 
 void
-dnf5_refresh_cache(PkBackendDnf5Private *priv, gboolean force)
+dnf5_refresh_cache(PkBackendDnf5Private *priv, gboolean force, gboolean online)
 {
-	dnf5_setup_base(priv, TRUE, force);
+	dnf5_setup_base(priv, TRUE, force, nullptr, online);
 }
 
 PkInfoEnum
@@ -32,17 +32,43 @@
 #include <string>
 #include <vector>
 
+// A published Base and the lock of its libsolv pool. Resolving a goal
+// changes the pool, so it excludes the readers of the same snapshot, but
+// never those of older or newer ones.
+struct Dnf5BaseSnapshot {
+	explicit Dnf5BaseSnapshot(std::shared_ptr<libdnf5::Base> base);
+	~Dnf5BaseSnapshot();
+	Dnf5BaseSnapshot(const Dnf5BaseSnapshot &) = delete;
+	Dnf5BaseSnapshot &operator=(const Dnf5BaseSnapshot &) = delete;
+
+	std::shared_ptr<libdnf5::Base> base;
+	GRWLock lock;		/* held shared by readers, exclusively by goal resolution */
+};
+
 // Private data structures
 typedef struct {
-	std::unique_ptr<libdnf5::Base> base;
+	/* The published snapshot is never reloaded in place: writers build a
+	 * new Base with dnf5_create_base() and swap it in, so queries never
+	 * wait for repos to load. Transactions that run resolve on a private
+	 * Base, so nothing waits for them to download and commit either. */
+	std::shared_ptr<Dnf5BaseSnapshot> snapshot;
 	GKeyFile *conf;
-	GMutex mutex;
-	gint64 last_notification_timestamp;
+	GMutex mutex;		/* protects the snapshot pointer, never held for long */
+	GMutex write_mutex;	/* serialises jobs that replace the base */
+	GMutex download_mutex;	/* serialises downloads, which set the callbacks of a shared base */
+	gint64 last_notification_timestamp;	/* protected by mutex */
+	GThread *rebuild_thread;	/* rebuilds the base after external rpmdb changes */
+	gboolean rebuild_running;	/* protected by mutex */
+	gboolean rebuild_pending;	/* protected by mutex */
 } PkBackendDnf5Private;
 
+std::shared_ptr<libdnf5::Base> dnf5_create_base(PkBackendDnf5Private *priv, gboolean refresh = FALSE, gboolean force = FALSE, const char *releasever = nullptr, gboolean online = TRUE);
+std::shared_ptr<Dnf5BaseSnapshot> dnf5_get_snapshot(PkBackendDnf5Private *priv);
+void dnf5_set_base(PkBackendDnf5Private *priv, std::shared_ptr<libdnf5::Base> base);
 void dnf5_setup_base(PkBackendDnf5Private *priv, gboolean refresh = FALSE, gboolean force = FALSE, const char *releasever = nullptr, gboolean online = TRUE);
-void dnf5_update_network_state(PkBackendDnf5Private *priv, gboolean online);
-void dnf5_refresh_cache(PkBackendDnf5Private *priv, gboolean force);
+void dnf5_inhibit_notifications(PkBackendDnf5Private *priv);
+void dnf5_update_network_state(libdnf5::Base &base, gboolean online);
+void dnf5_refresh_cache(PkBackendDnf5Private *priv, gboolean force, gboolean online = TRUE);
 PkInfoEnum dnf5_advisory_kind_to_info_enum(const std::string &type);
 PkInfoEnum dnf5_update_severity_to_enum(const std::string &severity);
 bool dnf5_force_distupgrade_on_upgrade(libdnf5::Base &base);
@@ -90,6 +90,7 @@ static int
 pk_backend_dnf5_inhibit_notify (PkBackend *backend)
 {
 	PkBackendDnf5Private *priv = (PkBackendDnf5Private *) pk_backend_get_user_data (backend);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->mutex);
 	gint64 current_time = g_get_monotonic_time ();
 	gint64 time_since_last_notification = current_time - priv->last_notification_timestamp;
 
@@ -102,6 +103,39 @@ pk_backend_dnf5_inhibit_notify (PkBackend *backend)
 	return 0;
 }
 
+static gpointer
+pk_backend_dnf5_rebuild_thread (gpointer user_data)
+{
+	PkBackend *backend = PK_BACKEND (user_data);
+	PkBackendDnf5Private *priv = (PkBackendDnf5Private *) pk_backend_get_user_data (backend);
+
+	for (;;) {
+		{
+			g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->write_mutex);
+			gint64 start = g_get_monotonic_time ();
+
+			/* queries keep using the old base until the new one is published */
+			try {
+				dnf5_setup_base (priv, FALSE, FALSE, nullptr, pk_backend_is_online (backend));
+				dnf5_inhibit_notifications (priv);
+				g_debug ("rebuilt dnf5 base in %" G_GINT64_FORMAT " ms",
+					 (g_get_monotonic_time () - start) / 1000);
+			} catch (const std::exception &e) {
+				g_warning ("Failed to invalidate dnf5 base: %s", e.what());
+			}
+		}
+
+		/* run again if another change arrived while we were loading */
+		g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->mutex);
+		if (!priv->rebuild_pending) {
+			priv->rebuild_running = FALSE;
+			break;
+		}
+		priv->rebuild_pending = FALSE;
+	}
+	return NULL;
+}
+
 static void
 pk_backend_context_invalidate_cb (PkBackend *backend, PkBackend *backend_data)
 {
@@ -114,12 +148,17 @@ pk_backend_context_invalidate_cb (PkBackend *backend, PkBackend *backend_data)
 	PkBackendDnf5Private *priv = (PkBackendDnf5Private *) pk_backend_get_user_data (backend);
 	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->mutex);
 
-	try {
-		dnf5_setup_base (priv);
-		priv->last_notification_timestamp = g_get_monotonic_time ();
-	} catch (const std::exception &e) {
-		g_warning ("Failed to invalidate dnf5 base: %s", e.what());
+	/* loading all repos takes seconds, so never do it on the main loop */
+	if (priv->rebuild_running) {
+		priv->rebuild_pending = TRUE;
+		return;
 	}
+	if (priv->rebuild_thread != NULL)
+		g_thread_join (priv->rebuild_thread);
+	priv->rebuild_running = TRUE;
+	priv->rebuild_thread = g_thread_new ("PK-DNF5-Rebuild",
+					     pk_backend_dnf5_rebuild_thread,
+					     backend);
 }
 
 void
@@ -140,6 +179,8 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 		 LIBDNF5_VERSION_PATCH);
 
 	g_mutex_init (&priv->mutex);
+	g_mutex_init (&priv->write_mutex);
+	g_mutex_init (&priv->download_mutex);
 	priv->conf = g_key_file_ref (conf);
 	priv->last_notification_timestamp = 0;
 
@@ -166,10 +207,14 @@ void
 pk_backend_destroy (PkBackend *backend)
 {
 	PkBackendDnf5Private *priv = (PkBackendDnf5Private *) pk_backend_get_user_data (backend);
-	priv->base.reset();
+	if (priv->rebuild_thread != NULL)
+		g_thread_join (priv->rebuild_thread);
+	priv->snapshot.reset();
 	if (priv->conf != NULL)
 		g_key_file_unref (priv->conf);
 	g_mutex_clear (&priv->mutex);
+	g_mutex_clear (&priv->write_mutex);
+	g_mutex_clear (&priv->download_mutex);
 	g_free (priv);
 }
 
@@ -386,15 +431,9 @@ pk_backend_repo_remove (PkBackend *backend, PkBackendJob *job, PkBitfield transa
 void
 pk_backend_refresh_cache (PkBackend *backend, PkBackendJob *job, gboolean force)
 {
-	pk_backend_job_set_status (job, PK_STATUS_ENUM_REFRESH_CACHE);
-	PkBackendDnf5Private *priv = (PkBackendDnf5Private *) pk_backend_get_user_data (backend);
-	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->mutex);
-	try {
-		dnf5_refresh_cache (priv, force);
-	} catch (const std::exception &e) {
-		pk_backend_job_error_code (job, PK_ERROR_ENUM_INTERNAL_ERROR, "%s", e.what());
-	}
-	pk_backend_job_finished (job);
+	g_autoptr(GVariant) params = g_variant_new ("(b)", force);
+	pk_backend_job_set_parameters (job, g_steal_pointer (&params));
+	pk_backend_job_thread_create (job, dnf5_repo_thread, NULL, NULL);
 }
 
 void
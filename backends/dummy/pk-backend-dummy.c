@@ -48,6 +48,8 @@ typedef struct {
 	gchar		**values;
 	PkBitfield	 filters;
 	gboolean	 fake_db_locked;
+	gchar		*solution_token;
+	guint		 solution_count;
 } PkBackendDummyPrivate;
 
 typedef struct {
@@ -74,6 +76,7 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 void
 pk_backend_destroy (PkBackend *backend)
 {
+	g_free (priv->solution_token);
 	g_free (priv);
 }
 
@@ -567,10 +570,20 @@ pk_backend_install_packages (PkBackend *backend, PkBackendJob *job, PkBitfield t
 		pk_backend_job_package (job, PK_INFO_ENUM_UPDATING,
 					"gtkhtml2;2.19.1-4.fc8;i386;fedora", "An HTML widget for GTK+ 2.0");
 
+		/* pretend to keep the solution */
+		g_free (priv->solution_token);
+		priv->solution_token = g_strdup_printf ("dummy-%u", ++priv->solution_count);
+		pk_backend_job_solution (job, priv->solution_token);
+
 		pk_backend_job_finished (job);
 		return;
 	}
 
+	/* the solution can only be used once */
+	if (g_strcmp0 (pk_backend_job_get_solution_token (job), priv->solution_token) == 0)
+		g_debug ("reusing solution %s", priv->solution_token);
+	g_clear_pointer (&priv->solution_token, g_free);
+
 	if (g_strcmp0 (package_ids[0], "vips-doc;7.12.4-2.fc8;noarch;linva") == 0) {
 		if (priv->use_gpg && !priv->has_signature) {
 			pk_backend_job_repo_signature_required (job, package_ids[0], "updates",
@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+#
+# Licensed under the GNU General Public License Version 2
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+
+# Emits packages with the CLOCK_MONOTONIC time in microseconds at which they
+# were written as the summary, so the daemon can measure its output latency.
+# Packages are written as framed records if the daemon offers them, unless
+# "text" is given as the framing.
+# Usage: search-latency.py [count] [delay between packages in seconds] [framing]
+
+import os
+import struct
+from sys import argv, stdout
+from time import monotonic_ns, sleep
+
+def write_line(*fields):
+    stdout.write("\t".join(fields) + "\n")
+    stdout.flush()
+
+def write_record(*fields):
+    payload = b"".join(field.encode('utf-8') + b"\0" for field in fields)
+    stdout.buffer.write(struct.pack('<I', len(payload)) + payload)
+    stdout.buffer.flush()
+
+def main():
+    count = int(argv[1]) if len(argv) > 1 else 100
+    delay = float(argv[2]) if len(argv) > 2 else 0.01
+    framing = argv[3] if len(argv) > 3 else os.environ.get('PK_SPAWN_FRAMING', 'text')
+    write = write_line
+    write("no-percentage-updates")
+    if framing == 'binary':
+        write("framing", "binary")
+        write = write_record
+    for i in range(count):
+        write("package", "available", "latency-%i;1.0;noarch;test" % i,
+              "%i" % (monotonic_ns() // 1000))
+        if delay > 0:
+            sleep(delay)
+
+if __name__ == "__main__":
+    main()
@@ -766,32 +766,39 @@ zypp_is_valid_repo (PkBackendJob *job, RepoInfo repo)
 	return TRUE;
 }
 
+/**
+ * Load the installed packages into the pool, unless they are loaded
+ * already and the rpm database did not change since.
+ */
+static void
+zypp_load_target (ZYpp::Ptr zypp)
+{
+	static Date rpmdb_timestamp;
+
+	Target_Ptr target = zypp->target ();
+	Date timestamp = target->rpmDb ().timestamp ();
+
+	if (timestamp == rpmdb_timestamp &&
+	    !sat::Pool::instance ().reposFind (sat::Pool::systemRepoAlias ()).solvablesEmpty ())
+		return;
+
+	target->load ();
+	rpmdb_timestamp = timestamp;
+}
+
 /**
  * Build and return a ResPool that contains all local resolvables
  * and ones found in the enabled repositories.
+ *
+ * The system repository stays in the pool for all roles, callers which
+ * are only interested in available packages have to skip installed ones.
  */
 static ResPool
-zypp_build_pool (ZYpp::Ptr zypp, gboolean include_local)
+zypp_build_pool (ZYpp::Ptr zypp)
 {
 	static gboolean repos_loaded = FALSE;
 
-	// the target is loaded or unloaded on request
-	if (include_local) {
-		// FIXME have to wait for fix in zypp (repeated loading of target)
-		if (sat::Pool::instance().reposFind( sat::Pool::systemRepoAlias() ).solvablesEmpty ())
-		{
-			// Add local resolvables
-			Target_Ptr target = zypp->target ();
-			target->load ();
-		}
-	} else {
-		if (!sat::Pool::instance().reposFind( sat::Pool::systemRepoAlias() ).solvablesEmpty ())
-		{
-			// Remove local resolvables
-			Repository repository = sat::Pool::instance ().reposFind (sat::Pool::systemRepoAlias());
-			repository.eraseFromPool ();
-		}
-	}
+	zypp_load_target (zypp);
 
 	// we only load repositories once.
 	if (!repos_loaded) {
@@ -941,7 +948,7 @@ zypp_get_packages_by_file (ZYpp::Ptr zypp,
 			   const gchar *search_file,
 			   vector<sat::Solvable> &ret)
 {
-	ResPool pool = zypp_build_pool (zypp, TRUE);
+	ResPool pool = zypp_build_pool (zypp);
 
 	string file (search_file);
 
@@ -1766,7 +1773,7 @@ zypp_refresh_cache (PkBackendJob *job, ZYpp::Ptr zypp, gboolean force)
 		target->rpmDb ().exportTrustedKeysInZyppKeyRing ();
 	}
 	// load installed packages to pool
-	target->load ();
+	zypp_load_target (zypp);
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_REFRESH_CACHE);
 	pk_backend_job_set_percentage (job, 0);
@@ -1969,7 +1976,7 @@ backend_required_by_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 
 	pk_backend_job_set_percentage (job, 10);
 
-	ResPool pool = zypp_build_pool (zypp, true);
+	ResPool pool = zypp_build_pool (zypp);
 	PoolStatusSaver saver;
 	for (uint i = 0; package_ids[i]; i++) {
 		sat::Solvable solvable = zypp_get_package_by_id (package_ids[i]);
@@ -2232,7 +2239,7 @@ backend_get_details_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 		return;
 	}
 
-	zypp_build_pool (zypp, true);
+	zypp_build_pool (zypp);
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
@@ -2546,7 +2553,7 @@ backend_get_updates_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 		return;
 	}
 
-	ResPool pool = zypp_build_pool (zypp, TRUE);
+	ResPool pool = zypp_build_pool (zypp);
 	pk_backend_job_set_percentage (job, 40);
 
 	set<PoolItem> candidates;
@@ -2666,7 +2673,7 @@ backend_install_files_thread (PkBackendJob *job, GVariant *params, gpointer user
 			  job, PK_ERROR_ENUM_INTERNAL_ERROR, "Can't refresh repositories");
 			return;
 		}
-		zypp_build_pool (zypp, true);
+		zypp_build_pool (zypp);
 
 	} catch (const Exception &ex) {
 		zypp_backend_finished_error (
@@ -2725,7 +2732,7 @@ backend_get_update_detail_thread (PkBackendJob *job, GVariant *params, gpointer
 	}
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
-	zypp_build_pool (zypp, TRUE);
+	zypp_build_pool (zypp);
 
 	for (uint i = 0; package_ids[i]; i++) {
 		sat::Solvable solvable = zypp_get_package_by_id (package_ids[i]);
@@ -2832,7 +2839,7 @@ backend_install_packages_thread (PkBackendJob *job, GVariant *params, gpointer u
 
 	try
 	{
-		ResPool pool = zypp_build_pool (zypp, TRUE);
+		ResPool pool = zypp_build_pool (zypp);
 		PoolStatusSaver saver;
 		pk_backend_job_set_percentage (job, 10);
 		vector<PoolItem> items;
@@ -2998,7 +3005,6 @@ backend_remove_packages_thread (PkBackendJob *job, GVariant *params, gpointer us
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_REMOVE);
 	pk_backend_job_set_percentage (job, 0);
 
-	Target_Ptr target;
 	ZyppJob zjob(job);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
@@ -3007,10 +3013,8 @@ backend_remove_packages_thread (PkBackendJob *job, GVariant *params, gpointer us
 	}
 	zypp->resolver()->setCleandepsOnRemove(autoremove);
 
-	target = zypp->target ();
-
 	// Load all the local system "resolvables" (packages)
-	target->load ();
+	zypp_load_target (zypp);
 	pk_backend_job_set_percentage (job, 10);
 
 	PoolStatusSaver saver;
@@ -3094,7 +3098,7 @@ backend_resolve_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
-	zypp_build_pool (zypp, TRUE);
+	zypp_build_pool (zypp);
 
 	for (uint i = 0; search[i]; i++) {
 		MIL << search[i] << " " << pk_filter_bitfield_to_string(_filters) << endl;
@@ -3215,7 +3219,7 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 
 	switch (role) {
 	case PK_ROLE_ENUM_SEARCH_NAME:
-		zypp_build_pool (zypp, TRUE); // seems to be necessary?
+		zypp_build_pool (zypp); // seems to be necessary?
 		q.addKind( ResKind::package );
 		q.addKind( ResKind::srcpackage );
 		q.addAttribute( sat::SolvAttr::name );
@@ -3224,7 +3228,7 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 		// two separate queries.
 		break;
 	case PK_ROLE_ENUM_SEARCH_DETAILS:
-		zypp_build_pool (zypp, TRUE); // seems to be necessary?
+		zypp_build_pool (zypp); // seems to be necessary?
 		q.addKind( ResKind::package );
 		//q.addKind( ResKind::srcpackage );
 		q.addAttribute( sat::SolvAttr::name );
@@ -3235,7 +3239,7 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 	case PK_ROLE_ENUM_SEARCH_FILE: {
 		q.setCaseSensitive( true ); // [<>] But we probably want case sensitive search for the file searches.
 
-		zypp_build_pool (zypp, TRUE);
+		zypp_build_pool (zypp);
 		q.addKind( ResKind::package );
 		q.addAttribute( sat::SolvAttr::name );
 		q.addAttribute( sat::SolvAttr::description );
@@ -3296,7 +3300,7 @@ backend_search_group_thread (PkBackendJob *job, GVariant *params, gpointer user_
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	pk_backend_job_set_percentage (job, 0);
 
-	ResPool pool = zypp_build_pool (zypp, true);
+	ResPool pool = zypp_build_pool (zypp);
 
 	pk_backend_job_set_percentage (job, 30);
 
@@ -3434,7 +3438,7 @@ backend_get_files_thread (PkBackendJob *job, GVariant *params, gpointer user_dat
 		return;
 	}
 
-	zypp_build_pool (zypp, true);
+	zypp_build_pool (zypp);
 
 	for (uint i = 0; package_ids[i]; i++) {
 		pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
@@ -3506,7 +3510,7 @@ backend_get_packages_thread (PkBackendJob *job, GVariant *params, gpointer user_
 
 	vector<sat::Solvable> v;
 
-	zypp_build_pool (zypp, TRUE);
+	zypp_build_pool (zypp);
 	ResPool pool = ResPool::instance ();
 	for (ResPool::byKind_iterator it = pool.byKindBegin (ResKind::package); it != pool.byKindEnd (ResKind::package); ++it) {
 		v.push_back (it->satSolvable ());
@@ -3572,7 +3576,7 @@ backend_update_packages_thread (PkBackendJob *job, GVariant *params, gpointer us
 		return;
 	}
 
-	ResPool pool = zypp_build_pool (zypp, TRUE);
+	ResPool pool = zypp_build_pool (zypp);
 	PkRestartEnum restart = PK_RESTART_ENUM_NONE;
 	PoolStatusSaver saver;
 
@@ -3644,7 +3648,7 @@ pk_backend_upgrade_system_thread (PkBackendJob *job,
 		return;
 	}
 
-	ResPool pool = zypp_build_pool (zypp, TRUE);
+	ResPool pool = zypp_build_pool (zypp);
 	PoolStatusSaver saver;
 
 	if (is_tumbleweed ()) {
@@ -3864,7 +3868,7 @@ backend_what_provides_thread (PkBackendJob *job, GVariant *params, gpointer user
 	}
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
-	ResPool pool = zypp_build_pool (zypp, true);
+	ResPool pool = zypp_build_pool (zypp);
 
 	if(g_ascii_strcasecmp("drivers_for_attached_hardware", values[0]) == 0) {
 		// solver run
@@ -3981,13 +3985,14 @@ backend_download_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 
 	try
 	{
-		ResPool pool = zypp_build_pool (zypp, FALSE);
+		ResPool pool = zypp_build_pool (zypp);
 
 		pk_backend_job_set_status (job, PK_STATUS_ENUM_DOWNLOAD);
 		for (guint i = 0; package_ids[i]; i++) {
 			sat::Solvable solvable = zypp_get_package_by_id (package_ids[i]);
 
-			if (zypp_is_no_solvable(solvable)) {
+			// installed packages cannot be downloaded
+			if (zypp_is_no_solvable(solvable) || solvable.isSystem ()) {
 				zypp_backend_finished_error (job, PK_ERROR_ENUM_PACKAGE_NOT_FOUND,
 							     "couldn't find package");
 				return;
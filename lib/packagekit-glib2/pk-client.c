@@ -38,12 +38,14 @@
 
 #include <packagekit-glib2/pk-client.h>
 #include <packagekit-glib2/pk-client-helper.h>
+#include <packagekit-glib2/pk-client-private.h>
 #include <packagekit-glib2/pk-common.h>
 #include <packagekit-glib2/pk-control.h>
 #include <packagekit-glib2/pk-debug.h>
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-package-id.h>
 #include <packagekit-glib2/pk-package-ids.h>
+#include <packagekit-glib2/pk-package-private.h>
 #include <packagekit-glib2/pk-progress-private.h>
 
 static void     pk_client_finalize	(GObject     *object);
@@ -65,6 +67,8 @@ struct _PkClientPrivate
 	gboolean		 interactive;
 	gboolean		 details_with_deps_size;
 	guint			 cache_age;
+	gboolean		 start_transaction_unsupported;
+	gchar			*solution_token;  /* (nullable): for the next transaction only */
 };
 
 enum {
@@ -155,6 +159,7 @@ struct _PkClientState
 	gchar				*tid;
 	gchar				*distro_id;
 	gchar				*transaction_id;
+	gchar				*solution_token;
 	gchar				*value;
 	gpointer			 user_data;
 	guint				 number;
@@ -173,6 +178,9 @@ struct _PkClientState
 	gint				 remaining_files_to_copy;
 	PkClientHelper			*client_helper;
 	gboolean			 waiting_for_finished;
+	GDBusConnection			*connection;
+	guint				 signal_id;
+	GPtrArray			*early_signals;  /* (element-type GVariant) (owned) */
 
 	/* True if this PkClientState represents a peek at a transaction which
 	 * it doesn’t own, rather than being the owner of the transaction: */
@@ -198,6 +206,21 @@ pk_client_state_unset_proxy (PkClientState *state)
 	}
 }
 
+/*
+ * pk_client_state_unsubscribe:
+ **/
+static void
+pk_client_state_unsubscribe (PkClientState *state)
+{
+	if (state->signal_id > 0) {
+		g_dbus_connection_signal_unsubscribe (state->connection,
+						      state->signal_id);
+		state->signal_id = 0;
+	}
+	g_clear_pointer (&state->early_signals, g_ptr_array_unref);
+	g_clear_object (&state->connection);
+}
+
 static void
 pk_client_state_remove (PkClient *client, PkClientState *state)
 {
@@ -241,6 +264,7 @@ pk_client_state_finish (PkClientState *state, GError *error)
 	}
 
 	pk_client_state_unset_proxy (state);
+	pk_client_state_unsubscribe (state);
 
 	/* remove any socket file */
 	if (state->client_helper != NULL) {
@@ -310,9 +334,11 @@ pk_client_state_finalize (GObject *object)
 	g_free (state->tid);
 	g_free (state->distro_id);
 	g_free (state->transaction_id);
+	g_free (state->solution_token);
 	g_strfreev (state->files);
 	g_strfreev (state->package_ids);
 	pk_client_state_unset_proxy (state);
+	pk_client_state_unsubscribe (state);
 
 	/* results will not exist if the CreateTransaction fails */
 	g_clear_object (&state->results);
@@ -418,10 +444,12 @@ pk_client_state_new (PkClient *client,
 		     PkRoleEnum role,
 		     GCancellable *cancellable)
 {
+	PkClientPrivate *priv = GET_PRIVATE(client);
 	PkClientState *state;
 
 	state = g_object_new (PK_TYPE_CLIENT_STATE, NULL);
 	state->role = role;
+	state->solution_token = g_steal_pointer (&priv->solution_token);
 	state->cancellable = g_cancellable_new ();
 	state->res = g_task_new (client, state->cancellable, callback_ready, user_data);
 	state->client = client;
@@ -882,24 +910,24 @@ pk_client_signal_package (PkClientState *state,
 			  PkInfoEnum info_enum,
 			  PkInfoEnum update_severity,
 			  const gchar *package_id,
-			  const gchar *summary)
+			  const gchar *summary,
+			  GRefString *transaction_id)
 {
 	g_autoptr(GError) error = NULL;
 	g_autoptr(PkPackage) package = NULL;
 
 	/* create virtual package */
-	package = pk_package_new ();
-	if (!pk_package_set_id (package, package_id, &error)) {
+	package = pk_package_new_from_signal (info_enum,
+					      update_severity,
+					      package_id,
+					      summary,
+					      state->role,
+					      transaction_id,
+					      &error);
+	if (package == NULL) {
 		g_warning ("failed to set package id for %s", package_id);
 		return;
 	}
-	g_object_set (package,
-		      "info", info_enum,
-		      "summary", summary,
-		      "update-severity", update_severity,
-		      "role", state->role,
-		      "transaction-id", state->transaction_id,
-		      NULL);
 
 	/* add to results */
 	if (state->results != NULL && info_enum != PK_INFO_ENUM_FINISHED)
@@ -1243,6 +1271,8 @@ pk_client_signal_cb (GDBusProxy *proxy,
 		return;
 	}
 	if (g_strcmp0 (signal_name, "Package") == 0) {
+		GRefString *transaction_id = NULL;
+
 		g_variant_get (parameters,
 			       "(u&s&s)",
 			       &tmp_uint,
@@ -1251,35 +1281,44 @@ pk_client_signal_cb (GDBusProxy *proxy,
 		/* The 'info' and 'update-severity' are encoded in the single value */
 		tmp_uint2 = tmp_uint & 0xFFFF;
 		tmp_uint3 = (tmp_uint >> 16) & 0xFFFF;
+		if (state->transaction_id != NULL)
+			transaction_id = g_ref_string_new_intern (state->transaction_id);
 		pk_client_signal_package (state,
 					  tmp_uint2,
 					  tmp_uint3,
 					  tmp_str[1],
-					  tmp_str[2]);
+					  tmp_str[2],
+					  transaction_id);
+		g_clear_pointer (&transaction_id, g_ref_string_release);
 		return;
 	}
 	if (g_strcmp0 (signal_name, "Packages") == 0) {
-		g_autoptr(GVariantIter) iter = NULL;
+		g_autoptr(GVariant) packages = NULL;
+		GRefString *transaction_id = NULL;
+		GVariantIter iter;
 		guint flags;
-		PkInfoEnum info, severity;
 		const gchar *package_id, *summary;
 
-		g_variant_get (parameters, "(a(uss))", &iter);
+		/* all the packages share one copy of the transaction ID */
+		if (state->transaction_id != NULL)
+			transaction_id = g_ref_string_new_intern (state->transaction_id);
 
-		while (g_variant_iter_loop (iter, "(u&s&s)",
+		/* iterate in place, borrowing the strings from the signal */
+		packages = g_variant_get_child_value (parameters, 0);
+		g_variant_iter_init (&iter, packages);
+		while (g_variant_iter_next (&iter, "(u&s&s)",
 					    &flags,
 					    &package_id,
 					    &summary)) {
 			/* The 'info' and 'update-severity' are encoded in the single value */
-			info = flags & 0xFFFF;
-			severity = (flags >> 16) & 0xFFFF;
 			pk_client_signal_package (state,
-						  info,
-						  severity,
+						  flags & 0xFFFF,
+						  (flags >> 16) & 0xFFFF,
 						  package_id,
-						  summary);
+						  summary,
+						  transaction_id);
 		}
-
+		g_clear_pointer (&transaction_id, g_ref_string_release);
 		return;
 	}
 	if (g_strcmp0 (signal_name, "Details") == 0) {
@@ -1407,6 +1446,11 @@ pk_client_signal_cb (GDBusProxy *proxy,
 		pk_results_add_require_restart (state->results, item);
 		return;
 	}
+	if (g_strcmp0 (signal_name, "Solution") == 0) {
+		g_variant_get (parameters, "(&s)", &tmp_str[0]);
+		pk_results_set_solution_token (state->results, tmp_str[0]);
+		return;
+	}
 	if (g_strcmp0 (signal_name, "Category") == 0) {
 		g_autoptr(PkCategory) item = NULL;
 		g_variant_get (parameters,
@@ -1667,6 +1711,216 @@ pk_client_set_role (PkClientState *state, PkRoleEnum role)
 	pk_progress_set_role (state->progress, role);
 }
 
+/*
+ * pk_client_get_role_method:
+ *
+ * Returns the transaction method that sets the role of @state, and sets
+ * @parameters to a floating tuple of its arguments.
+ **/
+static const gchar *
+pk_client_get_role_method (PkClientState *state, GVariant **parameters)
+{
+	switch (state->role) {
+	case PK_ROLE_ENUM_RESOLVE:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->package_ids);
+		return "Resolve";
+	case PK_ROLE_ENUM_SEARCH_NAME:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->search);
+		return "SearchNames";
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->search);
+		return "SearchDetails";
+	case PK_ROLE_ENUM_SEARCH_GROUP:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->search);
+		return "SearchGroups";
+	case PK_ROLE_ENUM_SEARCH_FILE:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->search);
+		return "SearchFiles";
+	case PK_ROLE_ENUM_GET_DETAILS:
+		*parameters = g_variant_new ("(^a&s)",
+					     state->package_ids);
+		return "GetDetails";
+	case PK_ROLE_ENUM_GET_DETAILS_LOCAL:
+		*parameters = g_variant_new ("(^a&s)",
+					     state->files);
+		return "GetDetailsLocal";
+	case PK_ROLE_ENUM_GET_FILES_LOCAL:
+		*parameters = g_variant_new ("(^a&s)",
+					     state->files);
+		return "GetFilesLocal";
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+		*parameters = g_variant_new ("(^a&s)",
+					     state->package_ids);
+		return "GetUpdateDetail";
+	case PK_ROLE_ENUM_GET_OLD_TRANSACTIONS:
+		*parameters = g_variant_new ("(u)",
+					     state->number);
+		return "GetOldTransactions";
+	case PK_ROLE_ENUM_DOWNLOAD_PACKAGES:
+		*parameters = g_variant_new ("(b^a&s)",
+					     (state->directory == NULL),
+					     state->package_ids);
+		return "DownloadPackages";
+	case PK_ROLE_ENUM_GET_UPDATES:
+		*parameters = g_variant_new ("(t)",
+					     state->filters);
+		return "GetUpdates";
+	case PK_ROLE_ENUM_DEPENDS_ON:
+		*parameters = g_variant_new ("(t^a&sb)",
+					     state->filters,
+					     state->package_ids,
+					     state->recursive);
+		return "DependsOn";
+	case PK_ROLE_ENUM_REQUIRED_BY:
+		*parameters = g_variant_new ("(t^a&sb)",
+					     state->filters,
+					     state->package_ids,
+					     state->recursive);
+		return "RequiredBy";
+	case PK_ROLE_ENUM_GET_PACKAGES:
+		*parameters = g_variant_new ("(t)",
+					     state->filters);
+		return "GetPackages";
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->search);
+		return "WhatProvides";
+	case PK_ROLE_ENUM_GET_DISTRO_UPGRADES:
+		*parameters = g_variant_new ("()");
+		return "GetDistroUpgrades";
+	case PK_ROLE_ENUM_GET_FILES:
+		*parameters = g_variant_new ("(^a&s)",
+					     state->package_ids);
+		return "GetFiles";
+	case PK_ROLE_ENUM_GET_CATEGORIES:
+		*parameters = g_variant_new ("()");
+		return "GetCategories";
+	case PK_ROLE_ENUM_REMOVE_PACKAGES:
+		*parameters = g_variant_new ("(t^a&sbb)",
+					     state->transaction_flags,
+					     state->package_ids,
+					     state->allow_deps,
+					     state->autoremove);
+		return "RemovePackages";
+	case PK_ROLE_ENUM_REFRESH_CACHE:
+		*parameters = g_variant_new ("(b)",
+					     state->force);
+		return "RefreshCache";
+	case PK_ROLE_ENUM_INSTALL_PACKAGES:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->transaction_flags,
+					     state->package_ids);
+		return "InstallPackages";
+	case PK_ROLE_ENUM_INSTALL_SIGNATURE:
+		*parameters = g_variant_new ("(uss)",
+					     state->type,
+					     state->key_id,
+					     state->package_id);
+		return "InstallSignature";
+	case PK_ROLE_ENUM_UPDATE_PACKAGES:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->transaction_flags,
+					     state->package_ids);
+		return "UpdatePackages";
+	case PK_ROLE_ENUM_INSTALL_FILES:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->transaction_flags,
+					     state->files);
+		return "InstallFiles";
+	case PK_ROLE_ENUM_ACCEPT_EULA:
+		*parameters = g_variant_new ("(s)",
+					     state->eula_id);
+		return "AcceptEula";
+	case PK_ROLE_ENUM_GET_REPO_LIST:
+		*parameters = g_variant_new ("(t)",
+					     state->filters);
+		return "GetRepoList";
+	case PK_ROLE_ENUM_REPO_ENABLE:
+		*parameters = g_variant_new ("(sb)",
+					     state->repo_id,
+					     state->enabled);
+		return "RepoEnable";
+	case PK_ROLE_ENUM_REPO_SET_DATA:
+		*parameters = g_variant_new ("(sss)",
+					     state->repo_id,
+					     state->parameter ? state->parameter : "",
+					     state->value ? state->value : "");
+		return "RepoSetData";
+	case PK_ROLE_ENUM_REPO_REMOVE:
+		*parameters = g_variant_new ("(tsb)",
+					     state->transaction_flags,
+					     state->repo_id,
+					     state->autoremove);
+		return "RepoRemove";
+	case PK_ROLE_ENUM_UPGRADE_SYSTEM:
+		*parameters = g_variant_new ("(tsu)",
+					     state->transaction_flags,
+					     state->distro_id,
+					     state->upgrade_kind);
+		return "UpgradeSystem";
+	case PK_ROLE_ENUM_REPAIR_SYSTEM:
+		*parameters = g_variant_new ("(t)",
+					     state->transaction_flags);
+		return "RepairSystem";
+	default:
+		g_assert_not_reached ();
+	}
+	return NULL;
+}
+
+/*
+ * pk_client_state_results_new:
+ **/
+static void
+pk_client_state_results_new (PkClientState *state)
+{
+	g_clear_object (&state->results);
+	state->results = pk_results_new ();
+	g_object_set (state->results,
+		      "role", state->role,
+		      "progress", state->progress,
+		      "transaction-flags", state->transaction_flags,
+		      NULL);
+
+	/* the number of items that were asked for */
+	switch (state->role) {
+	case PK_ROLE_ENUM_RESOLVE:
+	case PK_ROLE_ENUM_GET_DETAILS:
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+	case PK_ROLE_ENUM_DOWNLOAD_PACKAGES:
+	case PK_ROLE_ENUM_DEPENDS_ON:
+	case PK_ROLE_ENUM_REQUIRED_BY:
+	case PK_ROLE_ENUM_GET_FILES:
+	case PK_ROLE_ENUM_REMOVE_PACKAGES:
+	case PK_ROLE_ENUM_INSTALL_PACKAGES:
+	case PK_ROLE_ENUM_UPDATE_PACKAGES:
+		g_object_set (state->results,
+			      "inputs", g_strv_length (state->package_ids),
+			      NULL);
+		break;
+	case PK_ROLE_ENUM_GET_DETAILS_LOCAL:
+	case PK_ROLE_ENUM_GET_FILES_LOCAL:
+	case PK_ROLE_ENUM_INSTALL_FILES:
+		g_object_set (state->results,
+			      "inputs", g_strv_length (state->files),
+			      NULL);
+		break;
+	default:
+		break;
+	}
+}
+
 /*
  * pk_client_set_hints_cb:
  **/
@@ -1676,6 +1930,8 @@ pk_client_set_hints_cb (GObject *source_object,
 			gpointer user_data)
 {
 	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	const gchar *method_name;
+	GVariant *parameters = NULL;
 	g_autoptr(PkClientState) state = PK_CLIENT_STATE (g_steal_pointer (&user_data));
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GVariant) value = NULL;
@@ -1700,369 +1956,17 @@ pk_client_set_hints_cb (GObject *source_object,
 	g_assert (!pk_client_state_is_finished (state));
 
 	/* we'll have results from now on */
-	state->results = pk_results_new ();
-	g_object_set (state->results,
-		      "role", state->role,
-		      "progress", state->progress,
-		      "transaction-flags", state->transaction_flags,
-		      NULL);
+	pk_client_state_results_new (state);
 
 	/* do this async, although this should be pretty fast anyway */
-	if (state->role == PK_ROLE_ENUM_RESOLVE) {
-		g_dbus_proxy_call (state->proxy, "Resolve",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_SEARCH_NAME) {
-		g_dbus_proxy_call (state->proxy, "SearchNames",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_SEARCH_DETAILS) {
-		g_dbus_proxy_call (state->proxy, "SearchDetails",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_SEARCH_GROUP) {
-		g_dbus_proxy_call (state->proxy, "SearchGroups",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_SEARCH_FILE) {
-		g_dbus_proxy_call (state->proxy, "SearchFiles",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_GET_DETAILS) {
-		g_dbus_proxy_call (state->proxy, "GetDetails",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_GET_DETAILS_LOCAL) {
-		g_dbus_proxy_call (state->proxy, "GetDetailsLocal",
-				   g_variant_new ("(^a&s)",
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->files),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_GET_FILES_LOCAL) {
-		g_dbus_proxy_call (state->proxy, "GetFilesLocal",
-				   g_variant_new ("(^a&s)",
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->files),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_GET_UPDATE_DETAIL) {
-		g_dbus_proxy_call (state->proxy, "GetUpdateDetail",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_GET_OLD_TRANSACTIONS) {
-		g_dbus_proxy_call (state->proxy, "GetOldTransactions",
-				   g_variant_new ("(u)",
-						  state->number),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_DOWNLOAD_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "DownloadPackages",
-				   g_variant_new ("(b^a&s)",
-						  (state->directory == NULL),
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_GET_UPDATES) {
-		g_dbus_proxy_call (state->proxy, "GetUpdates",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_DEPENDS_ON) {
-		g_dbus_proxy_call (state->proxy, "DependsOn",
-				   g_variant_new ("(t^a&sb)",
-						  state->filters,
-						  state->package_ids,
-						  state->recursive),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-
-	} else if (state->role == PK_ROLE_ENUM_REQUIRED_BY) {
-		g_dbus_proxy_call (state->proxy, "RequiredBy",
-				   g_variant_new ("(t^a&sb)",
-						  state->filters,
-						  state->package_ids,
-						  state->recursive),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_GET_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "GetPackages",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_WHAT_PROVIDES) {
-		g_dbus_proxy_call (state->proxy, "WhatProvides",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_GET_DISTRO_UPGRADES) {
-		g_dbus_proxy_call (state->proxy, "GetDistroUpgrades",
-				   NULL,
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_GET_FILES) {
-		g_dbus_proxy_call (state->proxy, "GetFiles",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_GET_CATEGORIES) {
-		g_dbus_proxy_call (state->proxy, "GetCategories",
-				   NULL,
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_REMOVE_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "RemovePackages",
-				   g_variant_new ("(t^a&sbb)",
-						  state->transaction_flags,
-						  state->package_ids,
-						  state->allow_deps,
-						  state->autoremove),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_REFRESH_CACHE) {
-		g_dbus_proxy_call (state->proxy, "RefreshCache",
-				   g_variant_new ("(b)",
-						  state->force),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_INSTALL_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "InstallPackages",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_INSTALL_SIGNATURE) {
-		g_dbus_proxy_call (state->proxy, "InstallSignature",
-				   g_variant_new ("(uss)",
-						  state->type,
-						  state->key_id,
-						  state->package_id),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_UPDATE_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "UpdatePackages",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_INSTALL_FILES) {
-		g_dbus_proxy_call (state->proxy, "InstallFiles",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->files),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_ACCEPT_EULA) {
-		g_dbus_proxy_call (state->proxy, "AcceptEula",
-				   g_variant_new ("(s)",
-						  state->eula_id),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_GET_REPO_LIST) {
-		g_dbus_proxy_call (state->proxy, "GetRepoList",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_REPO_ENABLE) {
-		g_dbus_proxy_call (state->proxy, "RepoEnable",
-				   g_variant_new ("(sb)",
-						  state->repo_id,
-						  state->enabled),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_REPO_SET_DATA) {
-		g_dbus_proxy_call (state->proxy, "RepoSetData",
-				   g_variant_new ("(sss)",
-						  state->repo_id,
-						  state->parameter ? state->parameter : "",
-						  state->value ? state->value : ""),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_REPO_REMOVE) {
-		g_dbus_proxy_call (state->proxy, "RepoRemove",
-				   g_variant_new ("(tsb)",
-						  state->transaction_flags,
-						  state->repo_id,
-						  state->autoremove),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_UPGRADE_SYSTEM) {
-		g_dbus_proxy_call (state->proxy, "UpgradeSystem",
-				   g_variant_new ("(tsu)",
-						  state->transaction_flags,
-						  state->distro_id,
-						  state->upgrade_kind),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else if (state->role == PK_ROLE_ENUM_REPAIR_SYSTEM) {
-		g_dbus_proxy_call (state->proxy, "RepairSystem",
-				   g_variant_new ("(t)",
-						  state->transaction_flags),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   g_object_ref (state));
-	} else {
-		g_assert_not_reached ();
-	}
+	method_name = pk_client_get_role_method (state, &parameters);
+	g_dbus_proxy_call (state->proxy, method_name,
+			   parameters,
+			   G_DBUS_CALL_FLAGS_NONE,
+			   PK_CLIENT_DBUS_METHOD_TIMEOUT,
+			   state->cancellable,
+			   pk_client_method_cb,
+			   g_object_ref (state));
 }
 
 /*
@@ -2254,40 +2158,17 @@ pk_client_create_helper_socket (PkClientState *state)
 }
 
 /*
- * pk_client_get_proxy_cb:
+ * pk_client_get_hints:
+ *
+ * Returns a %NULL-terminated array of the hints for the transaction of @state.
  **/
-static void
-pk_client_get_proxy_cb (GObject *object,
-			GAsyncResult *res,
-			gpointer user_data)
+static GPtrArray *
+pk_client_get_hints (PkClientState *state)
 {
 	gchar *hint;
-	g_autoptr(PkClientState) state = PK_CLIENT_STATE (g_steal_pointer (&user_data));
-	g_autoptr(GError) error = NULL;
-	g_autoptr(GPtrArray) array = NULL;
+	GPtrArray *array;
 	PkClientPrivate *priv = pk_client_get_instance_private (state->client);
 
-	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
-	if (state->proxy == NULL) {
-		g_debug ("Cannot connect to PackageKit on %s", state->tid);
-		pk_client_state_finish (state, g_steal_pointer (&error));
-		return;
-	}
-
-	/* Check again for cancellation, as it’s possible the `PkClientState`
-	 * was cancelled and `pk_client_state_finish()` called asynchronously
-	 * while we were waiting for the proxy to be constructed. */
-	if (g_cancellable_set_error_if_cancelled (state->cancellable_client, &error)) {
-		pk_client_state_finish (state, g_steal_pointer (&error));
-		return;
-	}
-
-	g_assert (!pk_client_state_is_finished (state));
-
-	/* connect */
-	pk_client_proxy_connect (state);
-
-	/* get hints */
 	array = g_ptr_array_new_with_free_func (g_free);
 
 	/* locale */
@@ -2316,6 +2197,12 @@ pk_client_get_proxy_cb (GObject *object,
 		g_ptr_array_add (array, hint);
 	}
 
+	/* solution of an earlier simulation */
+	if (state->solution_token != NULL) {
+		hint = g_strdup_printf ("solution-token=%s", state->solution_token);
+		g_ptr_array_add (array, hint);
+	}
+
 	/* Always set the supports-plural-signals hint to get higher performance signals */
 	g_ptr_array_add (array, g_strdup ("supports-plural-signals=true"));
 
@@ -2329,8 +2216,44 @@ pk_client_get_proxy_cb (GObject *object,
 			g_ptr_array_add (array, hint);
 	}
 
-	/* set hints */
 	g_ptr_array_add (array, NULL);
+	return array;
+}
+
+/*
+ * pk_client_get_proxy_cb:
+ **/
+static void
+pk_client_get_proxy_cb (GObject *object,
+			GAsyncResult *res,
+			gpointer user_data)
+{
+	g_autoptr(PkClientState) state = PK_CLIENT_STATE (g_steal_pointer (&user_data));
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+
+	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (state->proxy == NULL) {
+		g_debug ("Cannot connect to PackageKit on %s", state->tid);
+		pk_client_state_finish (state, g_steal_pointer (&error));
+		return;
+	}
+
+	/* Check again for cancellation, as it’s possible the `PkClientState`
+	 * was cancelled and `pk_client_state_finish()` called asynchronously
+	 * while we were waiting for the proxy to be constructed. */
+	if (g_cancellable_set_error_if_cancelled (state->cancellable_client, &error)) {
+		pk_client_state_finish (state, g_steal_pointer (&error));
+		return;
+	}
+
+	g_assert (!pk_client_state_is_finished (state));
+
+	/* connect */
+	pk_client_proxy_connect (state);
+
+	/* set hints */
+	array = pk_client_get_hints (state);
 	g_dbus_proxy_call (state->proxy, "SetHints",
 			   g_variant_new ("(^a&s)",
 					  array->pdata),
@@ -2381,6 +2304,334 @@ pk_client_get_tid_cb (GObject *object, GAsyncResult *res, gpointer user_data)
 				  g_object_ref (state));
 }
 
+/*
+ * pk_client_early_signal_cb:
+ *
+ * Buffers the transaction signals that arrive before the proxy for the
+ * transaction started by StartTransaction() is ready.
+ **/
+static void
+pk_client_early_signal_cb (GDBusConnection *connection,
+			   const gchar *sender_name,
+			   const gchar *object_path,
+			   const gchar *interface_name,
+			   const gchar *signal_name,
+			   GVariant *parameters,
+			   gpointer user_data)
+{
+	GWeakRef *weak_ref = user_data;
+	g_autoptr(PkClientState) state = g_weak_ref_get (weak_ref);
+
+	if (state == NULL || state->early_signals == NULL || sender_name == NULL)
+		return;
+
+	/* until the reply arrives we do not know which transaction is ours */
+	if (state->tid != NULL && g_strcmp0 (object_path, state->tid) != 0)
+		return;
+
+	g_ptr_array_add (state->early_signals,
+			 g_variant_ref_sink (g_variant_new ("(sss@*)",
+							    sender_name,
+							    object_path,
+							    signal_name,
+							    parameters)));
+}
+
+/*
+ * pk_client_prune_early_signals:
+ *
+ * Drops the buffered signals of other transactions as soon as we know
+ * which one is ours.
+ **/
+static void
+pk_client_prune_early_signals (PkClientState *state)
+{
+	if (state->early_signals == NULL)
+		return;
+
+	for (guint i = state->early_signals->len; i > 0; i--) {
+		const gchar *object_path;
+
+		g_variant_get (g_ptr_array_index (state->early_signals, i - 1),
+			       "(&s&s&s@*)",
+			       NULL,
+			       &object_path,
+			       NULL,
+			       NULL);
+		if (g_strcmp0 (object_path, state->tid) != 0)
+			g_ptr_array_remove_index (state->early_signals, i - 1);
+	}
+}
+
+/*
+ * pk_client_replay_early_signals:
+ **/
+static void
+pk_client_replay_early_signals (PkClientState *state)
+{
+	GWeakRef weak_ref;
+	g_autofree gchar *name_owner = NULL;
+	g_autoptr(GPtrArray) early_signals = g_steal_pointer (&state->early_signals);
+
+	if (early_signals == NULL)
+		return;
+
+	/* only the daemon owning the transaction may have sent them; the
+	 * subscription for the well-known name does not guarantee that with
+	 * every GLib version */
+	name_owner = g_dbus_proxy_get_name_owner (state->proxy);
+	if (name_owner == NULL)
+		return;
+
+	g_weak_ref_init (&weak_ref, state);
+	for (guint i = 0; i < early_signals->len; i++) {
+		const gchar *sender_name;
+		const gchar *object_path;
+		const gchar *signal_name;
+		g_autoptr(GVariant) parameters = NULL;
+
+		g_variant_get (g_ptr_array_index (early_signals, i),
+			       "(&s&s&s@*)",
+			       &sender_name,
+			       &object_path,
+			       &signal_name,
+			       &parameters);
+		if (g_strcmp0 (object_path, state->tid) != 0 ||
+		    g_strcmp0 (sender_name, name_owner) != 0)
+			continue;
+
+		/* this may call pk_client_state_finish() */
+		pk_client_signal_cb (state->proxy, PK_DBUS_SERVICE,
+				     signal_name, parameters, &weak_ref);
+		if (pk_client_state_is_finished (state))
+			break;
+	}
+	g_weak_ref_clear (&weak_ref);
+}
+
+/*
+ * pk_client_started_proxy_cb:
+ **/
+static void
+pk_client_started_proxy_cb (GObject *object,
+			    GAsyncResult *res,
+			    gpointer user_data)
+{
+	g_autoptr(PkClientState) state = PK_CLIENT_STATE (g_steal_pointer (&user_data));
+	g_autoptr(GError) error = NULL;
+
+	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (state->proxy == NULL) {
+		g_debug ("Cannot connect to PackageKit on %s", state->tid);
+		pk_client_state_finish (state, g_steal_pointer (&error));
+		return;
+	}
+
+	/* the client gave up while we were waiting for the proxy */
+	if (pk_client_state_is_finished (state)) {
+		g_debug ("cancelling %s", state->tid);
+		g_dbus_proxy_call (state->proxy, "Cancel",
+				   NULL,
+				   G_DBUS_CALL_FLAGS_NONE,
+				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				   NULL, NULL, NULL);
+		pk_client_state_unset_proxy (state);
+		return;
+	}
+
+	/* connect, then catch up on what happened before we did */
+	pk_client_proxy_connect (state);
+	pk_client_replay_early_signals (state);
+	pk_client_state_unsubscribe (state);
+}
+
+static void pk_client_create_transaction (PkClientState *state);
+
+/*
+ * pk_client_start_transaction_cb:
+ **/
+static void
+pk_client_start_transaction_cb (GObject *source_object,
+				GAsyncResult *res,
+				gpointer user_data)
+{
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
+	g_autoptr(PkClientState) state = PK_CLIENT_STATE (g_steal_pointer (&user_data));
+	PkClientPrivate *priv = pk_client_get_instance_private (state->client);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	value = g_dbus_connection_call_finish (connection, res, &error);
+	if (value == NULL) {
+		/* daemon is older than the client, so do it the long way */
+		if (g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD)) {
+			g_debug ("StartTransaction() not supported, falling back");
+			priv->start_transaction_unsupported = TRUE;
+			pk_client_state_unsubscribe (state);
+			g_clear_object (&state->results);
+			if (!pk_client_state_is_finished (state))
+				pk_client_create_transaction (state);
+			return;
+		}
+
+		/* fix up the D-Bus error */
+		pk_client_fixup_dbus_error (error);
+		pk_client_state_finish (state, g_steal_pointer (&error));
+		return;
+	}
+	g_variant_get (value, "(o)", &state->tid);
+
+	/* The call was not cancellable, as the daemon may have started the
+	 * transaction anyway; if the client gave up since then, stop it. */
+	if (pk_client_state_is_finished (state)) {
+		g_debug ("cancelling %s", state->tid);
+		g_dbus_connection_call (connection,
+					PK_DBUS_SERVICE,
+					state->tid,
+					PK_DBUS_INTERFACE_TRANSACTION,
+					"Cancel",
+					NULL,
+					NULL,
+					G_DBUS_CALL_FLAGS_NONE,
+					PK_CLIENT_DBUS_METHOD_TIMEOUT,
+					NULL, NULL, NULL);
+		return;
+	}
+
+	pk_progress_set_transaction_id (state->progress, state->tid);
+	pk_client_prune_early_signals (state);
+
+	/* wait for ::Finished() or ::Destroy() or notify::g-name-owner (if the daemon disappears) */
+	state->waiting_for_finished = TRUE;
+
+	/* get a connection to the transaction interface */
+	g_dbus_proxy_new (connection,
+			  G_DBUS_PROXY_FLAGS_NONE,
+			  NULL,
+			  PK_DBUS_SERVICE,
+			  state->tid,
+			  PK_DBUS_INTERFACE_TRANSACTION,
+			  state->cancellable,
+			  pk_client_started_proxy_cb,
+			  g_object_ref (state));
+}
+
+/*
+ * pk_client_start_transaction:
+ *
+ * Creates the transaction, sets the hints and starts the role with a single
+ * call to the daemon.
+ **/
+static void
+pk_client_start_transaction (PkClientState *state)
+{
+	PkClientPrivate *priv = pk_client_get_instance_private (state->client);
+	const gchar *method_name;
+	GVariant *parameters = NULL;
+	g_autoptr(GPtrArray) hints = NULL;
+
+	/* The transaction may emit signals before we get the reply, and the
+	 * match rule has to be in place before the daemon sees the call. */
+	state->connection = g_object_ref (priv->connection);
+	state->early_signals = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+	state->signal_id = g_dbus_connection_signal_subscribe (state->connection,
+								PK_DBUS_SERVICE,
+								PK_DBUS_INTERFACE_TRANSACTION,
+								NULL,
+								NULL,
+								NULL,
+								G_DBUS_SIGNAL_FLAGS_NONE,
+								pk_client_early_signal_cb,
+								pk_client_weak_ref_new (state),
+								pk_client_weak_ref_free);
+
+	/* we'll have results from now on */
+	pk_client_state_results_new (state);
+
+	hints = pk_client_get_hints (state);
+	method_name = pk_client_get_role_method (state, &parameters);
+	g_dbus_connection_call (state->connection,
+				PK_DBUS_SERVICE,
+				PK_DBUS_PATH,
+				PK_DBUS_INTERFACE,
+				"StartTransaction",
+				g_variant_new ("(^a&ssv)",
+					       hints->pdata,
+					       method_name,
+					       parameters),
+				G_VARIANT_TYPE ("(o)"),
+				G_DBUS_CALL_FLAGS_NONE,
+				PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				NULL,
+				pk_client_start_transaction_cb,
+				g_object_ref (state));
+}
+
+/*
+ * pk_client_get_bus_cb:
+ **/
+static void
+pk_client_get_bus_cb (GObject *source_object,
+		      GAsyncResult *res,
+		      gpointer user_data)
+{
+	g_autoptr(PkClientState) state = PK_CLIENT_STATE (g_steal_pointer (&user_data));
+	PkClientPrivate *priv = pk_client_get_instance_private (state->client);
+	g_autoptr(GDBusConnection) connection = NULL;
+	g_autoptr(GError) error = NULL;
+
+	connection = g_bus_get_finish (res, &error);
+	if (connection == NULL) {
+		pk_client_state_finish (state, g_steal_pointer (&error));
+		return;
+	}
+	if (priv->connection == NULL)
+		priv->connection = g_steal_pointer (&connection);
+
+	if (g_cancellable_set_error_if_cancelled (state->cancellable_client, &error)) {
+		pk_client_state_finish (state, g_steal_pointer (&error));
+		return;
+	}
+
+	g_assert (!pk_client_state_is_finished (state));
+
+	pk_client_start_transaction (state);
+}
+
+/*
+ * pk_client_create_transaction:
+ *
+ * Creates the transaction for @state on the daemon and starts its role.
+ **/
+static void
+pk_client_create_transaction (PkClientState *state)
+{
+	PkClientPrivate *priv = pk_client_get_instance_private (state->client);
+
+	/* The frontend socket is named after the transaction ID, so the roles
+	 * that need one have to get the ID before setting the hints. */
+	if (priv->start_transaction_unsupported ||
+	    state->role == PK_ROLE_ENUM_INSTALL_FILES ||
+	    state->role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
+	    state->role == PK_ROLE_ENUM_REMOVE_PACKAGES ||
+	    state->role == PK_ROLE_ENUM_UPDATE_PACKAGES) {
+		pk_control_get_tid_async (priv->control,
+					  state->cancellable,
+					  (GAsyncReadyCallback) pk_client_get_tid_cb,
+					  g_object_ref (state));
+		return;
+	}
+
+	if (priv->connection == NULL) {
+		g_bus_get (G_BUS_TYPE_SYSTEM,
+			   state->cancellable,
+			   pk_client_get_bus_cb,
+			   g_object_ref (state));
+		return;
+	}
+	pk_client_start_transaction (state);
+}
+
 /**
  * pk_client_generic_finish:
  * @client: a valid #PkClient instance
@@ -2425,7 +2676,6 @@ pk_client_resolve_async (PkClient *client, PkBitfield filters, gchar **packages,
 			 PkProgressCallback progress_callback, gpointer progress_user_data,
 			 GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -2448,11 +2698,8 @@ pk_client_resolve_async (PkClient *client, PkBitfield filters, gchar **packages,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2476,7 +2723,6 @@ pk_client_search_names_async (PkClient *client, PkBitfield filters, gchar **valu
 			     PkProgressCallback progress_callback, gpointer progress_user_data,
 			     GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -2499,11 +2745,8 @@ pk_client_search_names_async (PkClient *client, PkBitfield filters, gchar **valu
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2528,7 +2771,6 @@ pk_client_search_details_async (PkClient *client, PkBitfield filters, gchar **va
 				PkProgressCallback progress_callback, gpointer progress_user_data,
 				GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -2551,11 +2793,8 @@ pk_client_search_details_async (PkClient *client, PkBitfield filters, gchar **va
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2578,7 +2817,6 @@ pk_client_search_groups_async (PkClient *client, PkBitfield filters, gchar **val
 			      PkProgressCallback progress_callback, gpointer progress_user_data,
 			      GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -2601,11 +2839,8 @@ pk_client_search_groups_async (PkClient *client, PkBitfield filters, gchar **val
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2628,7 +2863,6 @@ pk_client_search_files_async (PkClient *client, PkBitfield filters, gchar **valu
 			     PkProgressCallback progress_callback, gpointer progress_user_data,
 			     GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -2651,11 +2885,8 @@ pk_client_search_files_async (PkClient *client, PkBitfield filters, gchar **valu
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2678,7 +2909,6 @@ pk_client_get_details_async (PkClient *client, gchar **package_ids, GCancellable
 			     PkProgressCallback progress_callback, gpointer progress_user_data,
 			     GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -2701,11 +2931,8 @@ pk_client_get_details_async (PkClient *client, gchar **package_ids, GCancellable
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2728,7 +2955,6 @@ pk_client_get_details_local_async (PkClient *client, gchar **files, GCancellable
 				   PkProgressCallback progress_callback, gpointer progress_user_data,
 				   GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -2756,11 +2982,8 @@ pk_client_get_details_local_async (PkClient *client, gchar **files, GCancellable
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2783,7 +3006,6 @@ pk_client_get_files_local_async (PkClient *client, gchar **files, GCancellable *
 				 PkProgressCallback progress_callback, gpointer progress_user_data,
 				 GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -2810,11 +3032,8 @@ pk_client_get_files_local_async (PkClient *client, gchar **files, GCancellable *
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2837,7 +3056,6 @@ pk_client_get_update_detail_async (PkClient *client, gchar **package_ids, GCance
 				   PkProgressCallback progress_callback, gpointer progress_user_data,
 				   GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -2860,11 +3078,8 @@ pk_client_get_update_detail_async (PkClient *client, gchar **package_ids, GCance
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2887,7 +3102,6 @@ pk_client_download_packages_async (PkClient *client, gchar **package_ids, const
 				   PkProgressCallback progress_callback, gpointer progress_user_data,
 				   GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -2911,11 +3125,8 @@ pk_client_download_packages_async (PkClient *client, gchar **package_ids, const
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2937,7 +3148,6 @@ pk_client_get_updates_async (PkClient *client, PkBitfield filters, GCancellable
 			     PkProgressCallback progress_callback, gpointer progress_user_data,
 			     GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -2959,11 +3169,8 @@ pk_client_get_updates_async (PkClient *client, PkBitfield filters, GCancellable
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2985,7 +3192,6 @@ pk_client_get_old_transactions_async (PkClient *client, guint number, GCancellab
 			     PkProgressCallback progress_callback, gpointer progress_user_data,
 			     GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3007,11 +3213,8 @@ pk_client_get_old_transactions_async (PkClient *client, guint number, GCancellab
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3035,7 +3238,6 @@ pk_client_depends_on_async (PkClient *client, PkBitfield filters, gchar **packag
 			     PkProgressCallback progress_callback, gpointer progress_user_data,
 			     GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3060,11 +3262,8 @@ pk_client_depends_on_async (PkClient *client, PkBitfield filters, gchar **packag
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3086,7 +3285,6 @@ pk_client_get_packages_async (PkClient *client, PkBitfield filters, GCancellable
 			      PkProgressCallback progress_callback, gpointer progress_user_data,
 			      GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3108,11 +3306,8 @@ pk_client_get_packages_async (PkClient *client, PkBitfield filters, GCancellable
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3136,7 +3331,6 @@ pk_client_required_by_async (PkClient *client, PkBitfield filters, gchar **packa
 			      PkProgressCallback progress_callback, gpointer progress_user_data,
 			      GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3161,11 +3355,8 @@ pk_client_required_by_async (PkClient *client, PkBitfield filters, gchar **packa
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3193,7 +3384,6 @@ pk_client_what_provides_async (PkClient *client,
 			       PkProgressCallback progress_callback, gpointer progress_user_data,
 			       GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3216,11 +3406,8 @@ pk_client_what_provides_async (PkClient *client,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3242,7 +3429,6 @@ pk_client_get_distro_upgrades_async (PkClient *client, GCancellable *cancellable
 				     PkProgressCallback progress_callback, gpointer progress_user_data,
 				     GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3263,11 +3449,8 @@ pk_client_get_distro_upgrades_async (PkClient *client, GCancellable *cancellable
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3289,7 +3472,6 @@ pk_client_get_files_async (PkClient *client, gchar **package_ids, GCancellable *
 			   PkProgressCallback progress_callback, gpointer progress_user_data,
 			   GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3312,11 +3494,8 @@ pk_client_get_files_async (PkClient *client, gchar **package_ids, GCancellable *
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3337,7 +3516,6 @@ pk_client_get_categories_async (PkClient *client, GCancellable *cancellable,
 				PkProgressCallback progress_callback, gpointer progress_user_data,
 				GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3358,11 +3536,8 @@ pk_client_get_categories_async (PkClient *client, GCancellable *cancellable,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3396,7 +3571,6 @@ pk_client_remove_packages_async (PkClient *client,
 				 GAsyncReadyCallback callback_ready,
 				 gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3422,11 +3596,8 @@ pk_client_remove_packages_async (PkClient *client,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3451,7 +3622,6 @@ pk_client_refresh_cache_async (PkClient *client, gboolean force, GCancellable *c
 			       PkProgressCallback progress_callback, gpointer progress_user_data,
 			       GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3473,11 +3643,8 @@ pk_client_refresh_cache_async (PkClient *client, gboolean force, GCancellable *c
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3500,7 +3667,6 @@ pk_client_install_packages_async (PkClient *client, PkBitfield transaction_flags
 				  PkProgressCallback progress_callback, gpointer progress_user_data,
 				  GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3524,11 +3690,8 @@ pk_client_install_packages_async (PkClient *client, PkBitfield transaction_flags
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3552,7 +3715,6 @@ pk_client_install_signature_async (PkClient *client, PkSigTypeEnum type, const g
 				   PkProgressCallback progress_callback, gpointer progress_user_data,
 				   GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3576,11 +3738,8 @@ pk_client_install_signature_async (PkClient *client, PkSigTypeEnum type, const g
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3608,7 +3767,6 @@ pk_client_update_packages_async (PkClient *client,
 				 GAsyncReadyCallback callback_ready,
 				 gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3632,11 +3790,8 @@ pk_client_update_packages_async (PkClient *client,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /*
@@ -3657,11 +3812,8 @@ pk_client_copy_native_finished_cb (GFile *file, GAsyncResult *res, gpointer user
 	/* no more copies pending? */
 	if (g_atomic_int_dec_and_test (&state->remaining_files_to_copy)) {
 		PkClientPrivate *client_priv = pk_client_get_instance_private (state->client);
-		/* now get tid and continue on our merry way */
-		pk_control_get_tid_async (client_priv->control,
-					  state->cancellable,
-					  (GAsyncReadyCallback) pk_client_get_tid_cb,
-					  g_object_ref (state));
+		/* now create the transaction and continue on our merry way */
+		pk_client_create_transaction (state);
 	}
 }
 
@@ -3737,7 +3889,6 @@ pk_client_install_files_async (PkClient *client,
 			       GAsyncReadyCallback callback_ready,
 			       gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	gboolean ret;
 	guint i;
@@ -3779,11 +3930,8 @@ pk_client_install_files_async (PkClient *client,
 
 	/* nothing to copy, common case */
 	if (g_atomic_int_get (&state->remaining_files_to_copy) == 0) {
-		/* just get tid */
-		pk_control_get_tid_async (priv->control,
-					  cancellable,
-					  (GAsyncReadyCallback) pk_client_get_tid_cb,
-					  g_object_ref (state));
+		/* just create the transaction */
+		pk_client_create_transaction (state);
 		return;
 	}
 
@@ -3810,7 +3958,6 @@ pk_client_accept_eula_async (PkClient *client, const gchar *eula_id, GCancellabl
 			     PkProgressCallback progress_callback, gpointer progress_user_data,
 			     GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3832,11 +3979,8 @@ pk_client_accept_eula_async (PkClient *client, const gchar *eula_id, GCancellabl
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3858,7 +4002,6 @@ pk_client_get_repo_list_async (PkClient *client, PkBitfield filters, GCancellabl
 			       PkProgressCallback progress_callback, gpointer progress_user_data,
 			       GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3880,11 +4023,8 @@ pk_client_get_repo_list_async (PkClient *client, PkBitfield filters, GCancellabl
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3907,7 +4047,6 @@ pk_client_repo_enable_async (PkClient *client, const gchar *repo_id, gboolean en
 			     PkProgressCallback progress_callback,
 			     gpointer progress_user_data, GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3930,11 +4069,8 @@ pk_client_repo_enable_async (PkClient *client, const gchar *repo_id, gboolean en
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3959,7 +4095,6 @@ pk_client_repo_set_data_async (PkClient *client, const gchar *repo_id, const gch
 			       PkProgressCallback progress_callback,
 			       gpointer progress_user_data, GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -3983,11 +4118,8 @@ pk_client_repo_set_data_async (PkClient *client, const gchar *repo_id, const gch
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -4017,7 +4149,6 @@ pk_client_repo_remove_async (PkClient *client,
 			     GAsyncReadyCallback callback_ready,
 			     gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -4041,11 +4172,8 @@ pk_client_repo_remove_async (PkClient *client,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -4076,7 +4204,6 @@ pk_client_upgrade_system_async (PkClient *client,
 				PkProgressCallback progress_callback, gpointer progress_user_data,
 				GAsyncReadyCallback callback_ready, gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -4100,11 +4227,8 @@ pk_client_upgrade_system_async (PkClient *client,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -4135,7 +4259,6 @@ pk_client_repair_system_async (PkClient *client,
 			       GAsyncReadyCallback callback_ready,
 			       gpointer user_data)
 {
-	PkClientPrivate *priv = GET_PRIVATE(client);
 	g_autoptr(PkClientState) state = NULL;
 	g_autoptr(GError) error = NULL;
 
@@ -4157,11 +4280,8 @@ pk_client_repair_system_async (PkClient *client,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  g_steal_pointer (&state));
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**********************************************************************/
@@ -4576,6 +4696,26 @@ pk_client_get_cache_age (PkClient *client)
 	return priv->cache_age;
 }
 
+/*
+ * pk_client_set_solution_token:
+ * @client: a valid #PkClient instance
+ * @solution_token: (nullable): a token from pk_results_get_solution_token()
+ *
+ * Presents @solution_token to the daemon in the next transaction started by
+ * @client, so that the backend can reuse the dependency resolution of the
+ * simulation that returned it.
+ **/
+void
+pk_client_set_solution_token (PkClient *client, const gchar *solution_token)
+{
+	PkClientPrivate *priv = GET_PRIVATE(client);
+
+	g_return_if_fail (PK_IS_CLIENT (client));
+
+	g_free (priv->solution_token);
+	priv->solution_token = g_strdup (solution_token);
+}
+
 /**
  * pk_client_set_details_with_deps_size:
  * @client: a valid #PkClient instance
@@ -4736,7 +4876,9 @@ pk_client_finalize (GObject *object)
 	pk_client_cancel_all_dbus_methods (client);
 
 	g_clear_pointer (&priv->locale, g_free);
+	g_clear_pointer (&priv->solution_token, g_free);
 	g_clear_object (&priv->control);
+	g_clear_object (&priv->connection);
 
 	g_assert (priv->calls->len == 0);
 	g_clear_pointer (&priv->calls, g_ptr_array_unref);
@@ -29,7 +29,37 @@
 
 #include <glib.h>
 
+#include <string.h>
+
 #include <packagekit-glib2/pk-package-id.h>
+#include <packagekit-glib2/pk-package-id-private.h>
+
+/*
+ * pk_package_id_parse:
+ * @package_id: the ; delimited PackageID
+ * @separators: (out): offsets of the three ';' delimiters
+ *
+ * Finds the section boundaries of a PackageID without copying it, checking
+ * the correct number of delimiters are present and the name is not empty.
+ *
+ * Return value: %TRUE if the PackageID has four sections
+ **/
+gboolean
+pk_package_id_parse (const gchar *package_id, gsize separators[3])
+{
+	guint cnt = 0;
+
+	if (package_id == NULL || package_id[0] == ';' || package_id[0] == '\0')
+		return FALSE;
+	for (gsize i = 0; package_id[i] != '\0'; i++) {
+		if (package_id[i] != ';')
+			continue;
+		if (cnt == 3)
+			return FALSE;
+		separators[cnt++] = i;
+	}
+	return cnt == 3;
+}
 
 /**
  * pk_package_id_split:
@@ -45,22 +75,19 @@
 gchar **
 pk_package_id_split (const gchar *package_id)
 {
-	gchar **sections = NULL;
-
-	if (package_id == NULL)
-		goto out;
-
-	/* split by delimeter ';' */
-	sections = g_strsplit (package_id, ";", -1);
-	if (g_strv_length (sections) != 4)
-		goto out;
-
-	/* name has to be valid */
-	if (sections[0][0] != '\0')
-		return sections;
-out:
-	g_strfreev (sections);
-	return NULL;
+	gchar **sections;
+	gsize sep[3];
+
+	if (!pk_package_id_parse (package_id, sep))
+		return NULL;
+
+	sections = g_new (gchar *, 5);
+	sections[PK_PACKAGE_ID_NAME] = g_strndup (package_id, sep[0]);
+	sections[PK_PACKAGE_ID_VERSION] = g_strndup (package_id + sep[0] + 1, sep[1] - sep[0] - 1);
+	sections[PK_PACKAGE_ID_ARCH] = g_strndup (package_id + sep[1] + 1, sep[2] - sep[1] - 1);
+	sections[PK_PACKAGE_ID_DATA] = g_strdup (package_id + sep[2] + 1);
+	sections[4] = NULL;
+	return sections;
 }
 
 /**
@@ -76,23 +103,18 @@ out:
 gboolean
 pk_package_id_check (const gchar *package_id)
 {
-	g_auto(GStrv) sections = NULL;
-	gboolean ret;
+	gsize sep[3];
 
 	/* NULL check */
 	if (package_id == NULL)
 		return FALSE;
 
 	/* UTF8 */
-	ret = g_utf8_validate (package_id, -1, NULL);
-	if (!ret)
+	if (!g_utf8_validate (package_id, -1, NULL))
 		return FALSE;
 
 	/* correct number of sections */
-	sections = pk_package_id_split (package_id);
-	if (sections == NULL)
-		return FALSE;
-	return TRUE;
+	return pk_package_id_parse (package_id, sep);
 }
 
 /**
@@ -125,27 +147,21 @@ pk_package_id_build (const gchar *name, const gchar *version,
  * pk_arch_base_ix86:
  **/
 static gboolean
-pk_arch_base_ix86 (const gchar *arch)
+pk_arch_base_ix86 (const gchar *arch, gsize len)
 {
-	if (g_strcmp0 (arch, "i386") == 0 ||
-	    g_strcmp0 (arch, "i486") == 0 ||
-	    g_strcmp0 (arch, "i586") == 0 ||
-	    g_strcmp0 (arch, "i686") == 0)
-		return TRUE;
-	return FALSE;
+	/* i386, i486, i586 and i686 */
+	return len == 4 && arch[0] == 'i' && arch[1] >= '3' && arch[1] <= '6' &&
+	       arch[2] == '8' && arch[3] == '6';
 }
 
 /*
- * pk_package_id_equal_fuzzy_arch_section:
+ * pk_package_id_section_equal:
  **/
 static gboolean
-pk_package_id_equal_fuzzy_arch_section (const gchar *arch1, const gchar *arch2)
+pk_package_id_section_equal (const gchar *str1, gsize len1,
+			     const gchar *str2, gsize len2)
 {
-	if (g_strcmp0 (arch1, arch2) == 0)
-		return TRUE;
-	if (pk_arch_base_ix86 (arch1) && pk_arch_base_ix86 (arch2))
-		return TRUE;
-	return FALSE;
+	return len1 == len2 && memcmp (str1, str2, len1) == 0;
 }
 
 /**
@@ -163,16 +179,29 @@ pk_package_id_equal_fuzzy_arch_section (const gchar *arch1, const gchar *arch2)
 gboolean
 pk_package_id_equal_fuzzy_arch (const gchar *package_id1, const gchar *package_id2)
 {
-	g_auto(GStrv) sections1 = NULL;
-	g_auto(GStrv) sections2 = NULL;
-
-	sections1 = pk_package_id_split (package_id1);
-	sections2 = pk_package_id_split (package_id2);
-	if (g_strcmp0 (sections1[0], sections2[0]) == 0 &&
-	    g_strcmp0 (sections1[1], sections2[1]) == 0 &&
-	    pk_package_id_equal_fuzzy_arch_section (sections1[2], sections2[2]))
+	gsize sep1[3];
+	gsize sep2[3];
+	const gchar *arch1;
+	const gchar *arch2;
+	gsize arch1_len;
+	gsize arch2_len;
+
+	if (!pk_package_id_parse (package_id1, sep1) ||
+	    !pk_package_id_parse (package_id2, sep2))
+		return FALSE;
+
+	/* name and version, including the trailing ';' */
+	if (!pk_package_id_section_equal (package_id1, sep1[1],
+					  package_id2, sep2[1]))
+		return FALSE;
+
+	arch1 = package_id1 + sep1[1] + 1;
+	arch2 = package_id2 + sep2[1] + 1;
+	arch1_len = sep1[2] - sep1[1] - 1;
+	arch2_len = sep2[2] - sep2[1] - 1;
+	if (pk_package_id_section_equal (arch1, arch1_len, arch2, arch2_len))
 		return TRUE;
-	return FALSE;
+	return pk_arch_base_ix86 (arch1, arch1_len) && pk_arch_base_ix86 (arch2, arch2_len);
 }
 
 /**
@@ -188,31 +217,26 @@ pk_package_id_equal_fuzzy_arch (const gchar *package_id1, const gchar *package_i
 gchar *
 pk_package_id_to_printable (const gchar *package_id)
 {
-	g_auto(GStrv) parts = NULL;
-	gchar *value = NULL;
-	GString *string = NULL;
+	GString *string;
+	gsize sep[3];
 
 	/* invalid */
-	if (package_id == NULL)
-		goto out;
-
-	/* split */
-	parts = pk_package_id_split (package_id);
-	if (parts == NULL)
-		goto out;
+	if (!pk_package_id_parse (package_id, sep))
+		return NULL;
 
 	/* name */
-	string = g_string_new (parts[PK_PACKAGE_ID_NAME]);
+	string = g_string_new_len (package_id, sep[0]);
 
 	/* version if present */
-	if (parts[PK_PACKAGE_ID_VERSION][0] != '\0')
-		g_string_append_printf (string, "_%s", parts[PK_PACKAGE_ID_VERSION]);
+	if (sep[1] > sep[0] + 1) {
+		g_string_append_c (string, '_');
+		g_string_append_len (string, package_id + sep[0] + 1, sep[1] - sep[0] - 1);
+	}
 
 	/* arch if present */
-	if (parts[PK_PACKAGE_ID_ARCH][0] != '\0')
-		g_string_append_printf (string, ".%s", parts[PK_PACKAGE_ID_ARCH]);
-out:
-	if (string != NULL)
-		value = g_string_free (string, FALSE);
-	return value;
+	if (sep[2] > sep[1] + 1) {
+		g_string_append_c (string, '.');
+		g_string_append_len (string, package_id + sep[1] + 1, sep[2] - sep[1] - 1);
+	}
+	return g_string_free (string, FALSE);
 }
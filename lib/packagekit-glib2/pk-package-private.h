@@ -0,0 +1,46 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (__PACKAGEKIT_H_INSIDE__) && !defined (PK_COMPILATION)
+#error "Only <packagekit.h> can be included directly."
+#endif
+
+#ifndef __PK_PACKAGE_PRIVATE_H
+#define __PK_PACKAGE_PRIVATE_H
+
+#include <glib.h>
+
+#include <packagekit-glib2/pk-package.h>
+
+G_BEGIN_DECLS
+
+guint		 pk_package_get_info_generation		(void);
+void		 pk_package_add_to_sack			(PkPackage	*package);
+void		 pk_package_remove_from_sack		(PkPackage	*package);
+PkPackage	*pk_package_new_from_signal		(PkInfoEnum	 info,
+							 PkInfoEnum	 update_severity,
+							 const gchar	*package_id,
+							 const gchar	*summary,
+							 PkRoleEnum	 role,
+							 GRefString	*transaction_id,
+							 GError		**error);
+
+G_END_DECLS
+
+#endif /* __PK_PACKAGE_PRIVATE_H */
@@ -32,6 +32,7 @@
 
 #include <glib-object.h>
 #include <gio/gio.h>
+#include <string.h>
 
 #include <packagekit-glib2/pk-package-sack.h>
 #include <packagekit-glib2/pk-client.h>
@@ -39,6 +40,8 @@
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-results.h>
 #include <packagekit-glib2/pk-package-id.h>
+#include <packagekit-glib2/pk-package-id-private.h>
+#include <packagekit-glib2/pk-package-private.h>
 
 static void     pk_package_sack_finalize	(GObject     *object);
 
@@ -52,6 +55,10 @@ struct _PkPackageSackPrivate
 	GHashTable		*table;
 	GPtrArray		*array;
 	PkClient		*client;
+	GHashTable		*name_index;	/* name : GPtrArray of PkPackage */
+	GPtrArray		*info_index[PK_INFO_ENUM_LAST];
+	gboolean		 info_index_valid;
+	guint			 info_generation;
 };
 
 enum {
@@ -62,6 +69,116 @@ enum {
 G_DEFINE_TYPE_WITH_PRIVATE (PkPackageSack, pk_package_sack, G_TYPE_OBJECT)
 #define GET_PRIVATE(o) (pk_package_sack_get_instance_private (o))
 
+/*
+ * pk_package_sack_release_package:
+ **/
+static void
+pk_package_sack_release_package (gpointer data)
+{
+	PkPackage *package = PK_PACKAGE (data);
+
+	pk_package_remove_from_sack (package);
+	g_object_unref (package);
+}
+
+/*
+ * pk_package_sack_index_add:
+ **/
+static void
+pk_package_sack_index_add (PkPackageSackPrivate *priv, PkPackage *package)
+{
+	const gchar *name = pk_package_get_name (package);
+	PkInfoEnum info;
+	GPtrArray *bucket;
+
+	if (name != NULL) {
+		bucket = g_hash_table_lookup (priv->name_index, name);
+		if (bucket == NULL) {
+			/* the name is an interned string owned by PkPackage */
+			bucket = g_ptr_array_new ();
+			g_hash_table_insert (priv->name_index,
+					     g_ref_string_acquire ((GRefString *) name),
+					     bucket);
+		}
+		g_ptr_array_add (bucket, package);
+	}
+
+	/* the info index is built on demand */
+	if (!priv->info_index_valid)
+		return;
+	info = pk_package_get_info (package);
+	if (info >= PK_INFO_ENUM_LAST) {
+		priv->info_index_valid = FALSE;
+		return;
+	}
+	g_ptr_array_add (priv->info_index[info], package);
+}
+
+/*
+ * pk_package_sack_index_remove:
+ **/
+static void
+pk_package_sack_index_remove (PkPackageSackPrivate *priv, PkPackage *package)
+{
+	const gchar *name = pk_package_get_name (package);
+	PkInfoEnum info;
+	GPtrArray *bucket;
+
+	if (name != NULL) {
+		bucket = g_hash_table_lookup (priv->name_index, name);
+		if (bucket != NULL) {
+			g_ptr_array_remove (bucket, package);
+			if (bucket->len == 0)
+				g_hash_table_remove (priv->name_index, name);
+		}
+	}
+
+	if (!priv->info_index_valid)
+		return;
+	info = pk_package_get_info (package);
+	if (info >= PK_INFO_ENUM_LAST ||
+	    !g_ptr_array_remove (priv->info_index[info], package))
+		priv->info_index_valid = FALSE;
+}
+
+/*
+ * pk_package_sack_ensure_info_index:
+ *
+ * Packages can change their info while in the sack, e.g. when resolving, so
+ * rebuild the index if the info of any package changed since it was built.
+ **/
+static void
+pk_package_sack_ensure_info_index (PkPackageSackPrivate *priv)
+{
+	guint generation = pk_package_get_info_generation ();
+
+	if (priv->info_index_valid && priv->info_generation == generation)
+		return;
+
+	for (guint i = 0; i < PK_INFO_ENUM_LAST; i++)
+		g_ptr_array_set_size (priv->info_index[i], 0);
+	for (guint i = 0; i < priv->array->len; i++) {
+		PkPackage *package = g_ptr_array_index (priv->array, i);
+		PkInfoEnum info = pk_package_get_info (package);
+		if (info < PK_INFO_ENUM_LAST)
+			g_ptr_array_add (priv->info_index[info], package);
+	}
+	priv->info_generation = generation;
+	priv->info_index_valid = TRUE;
+}
+
+/*
+ * pk_package_sack_rebuild_index:
+ **/
+static void
+pk_package_sack_rebuild_index (PkPackageSackPrivate *priv)
+{
+	g_hash_table_remove_all (priv->name_index);
+	priv->info_index_valid = FALSE;
+	for (guint i = 0; i < priv->array->len; i++)
+		pk_package_sack_index_add (priv, g_ptr_array_index (priv->array, i));
+}
+
 /**
  * pk_package_sack_clear:
  * @sack: a valid #PkPackageSack instance
@@ -79,6 +196,8 @@ pk_package_sack_clear (PkPackageSack *sack)
 
 	g_ptr_array_set_size (priv->array, 0);
 	g_hash_table_remove_all (priv->table);
+	g_hash_table_remove_all (priv->name_index);
+	priv->info_index_valid = FALSE;
 }
 
 /**
@@ -168,22 +287,20 @@ pk_package_sack_filter_by_info (PkPackageSack *sack, PkInfoEnum info)
 {
 	PkPackageSackPrivate *priv = GET_PRIVATE(sack);
 	PkPackageSack *results;
-	PkPackage *package;
-	PkInfoEnum info_tmp;
-	guint i;
+	GPtrArray *bucket;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), NULL);
 
 	/* create new sack */
 	results = pk_package_sack_new ();
+	if (info >= PK_INFO_ENUM_LAST)
+		return results;
 
 	/* add each that matches the info enum */
-	for (i = 0; i < priv->array->len; i++) {
-		package = g_ptr_array_index (priv->array, i);
-		info_tmp = pk_package_get_info (package);
-		if (info_tmp == info)
-			pk_package_sack_add_package (results, package);
-	}
+	pk_package_sack_ensure_info_index (priv);
+	bucket = priv->info_index[info];
+	for (guint i = 0; i < bucket->len; i++)
+		pk_package_sack_add_package (results, g_ptr_array_index (bucket, i));
 
 	return results;
 }
@@ -245,9 +362,11 @@ pk_package_sack_add_package (PkPackageSack *sack, PkPackage *package)
 
 	/* add to array */
 	g_ptr_array_add (priv->array, g_object_ref (package));
+	pk_package_add_to_sack (package);
 	g_hash_table_insert (priv->table,
 			     (gpointer) pk_package_get_id (package),
 			     (gpointer) package);
+	pk_package_sack_index_add (priv, package);
 
 	return TRUE;
 }
@@ -421,13 +540,18 @@ gboolean
 pk_package_sack_remove_package (PkPackageSack *sack, PkPackage *package)
 {
 	PkPackageSackPrivate *priv = GET_PRIVATE(sack);
+	guint idx;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 	g_return_val_if_fail (PK_IS_PACKAGE (package), FALSE);
 
 	/* remove from array */
+	if (!g_ptr_array_find (priv->array, package, &idx))
+		return FALSE;
 	g_hash_table_remove (priv->table, pk_package_get_id (package));
-	return g_ptr_array_remove (priv->array, package);
+	pk_package_sack_index_remove (priv, package);
+	g_ptr_array_remove_index (priv->array, idx);
+	return TRUE;
 }
 
 /**
@@ -448,21 +572,14 @@ pk_package_sack_remove_package_by_id (PkPackageSack *sack,
 {
 	PkPackageSackPrivate *priv = GET_PRIVATE(sack);
 	PkPackage *package;
-	guint i;
-	GPtrArray *array;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 	g_return_val_if_fail (package_id != NULL, FALSE);
 
-	array = priv->array;
-	for (i = 0; i < array->len; i++) {
-		package = g_ptr_array_index (array, i);
-		if (g_strcmp0 (package_id, pk_package_get_id (package)) == 0) {
-			pk_package_sack_remove_package (sack, package);
-			return TRUE;
-		}
-	}
-	return FALSE;
+	package = g_hash_table_lookup (priv->table, package_id);
+	if (package == NULL)
+		return FALSE;
+	return pk_package_sack_remove_package (sack, package);
 }
 
 /**
@@ -486,22 +603,28 @@ pk_package_sack_remove_by_filter (PkPackageSack *sack,
 	PkPackageSackPrivate *priv = GET_PRIVATE(sack);
 	gboolean ret = FALSE;
 	PkPackage *package;
-	gint i;
+	gsize len = 0;
+	g_autofree gpointer *packages = NULL;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 	g_return_val_if_fail (filter_cb != NULL, FALSE);
 
-	/* add each that matches the info enum */
-	for (i = 0; i < (gint) priv->array->len; i++) {
-		package = g_ptr_array_index (priv->array, i);
-		if (!filter_cb (package, user_data)) {
-			ret = TRUE;
-			pk_package_sack_remove_package (sack, package);
-
-			/* ensure we pick up subsequent matches */
-			i--;
+	/* rebuild the array in one pass rather than removing from the middle */
+	packages = g_ptr_array_steal (priv->array, &len);
+	for (gsize i = 0; i < len; i++) {
+		package = packages[i];
+		if (filter_cb (package, user_data)) {
+			g_ptr_array_add (priv->array, package);
+			continue;
 		}
+		ret = TRUE;
+		g_hash_table_remove (priv->table, pk_package_get_id (package));
+		pk_package_sack_release_package (package);
 	}
+
+	/* removing from the index buckets one by one would be quadratic */
+	if (ret)
+		pk_package_sack_rebuild_index (priv);
 	return ret;
 }
 
@@ -550,24 +673,34 @@ pk_package_sack_find_by_id_name_arch (PkPackageSack *sack, const gchar *package_
 {
 	PkPackageSackPrivate *priv = GET_PRIVATE(sack);
 	PkPackage *pkg_tmp;
-	guint i;
-	g_auto(GStrv) split = NULL;
+	GPtrArray *bucket;
+	gsize sep[3];
+	const gchar *arch;
+	gsize arch_len;
+	g_autofree gchar *name = NULL;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), NULL);
 	g_return_val_if_fail (package_id != NULL, NULL);
 
 	/* does the package name feature in the array */
-	split = pk_package_id_split (package_id);
-	if (split == NULL)
+	if (!pk_package_id_parse (package_id, sep))
 		return NULL;
-	for (i = 0; i < priv->array->len; i++) {
-		pkg_tmp = g_ptr_array_index (priv->array, i);
-		if (g_strcmp0 (pk_package_get_name (pkg_tmp),
-			       split[PK_PACKAGE_ID_NAME]) == 0 &&
-		    g_strcmp0 (pk_package_get_arch (pkg_tmp),
-			       split[PK_PACKAGE_ID_ARCH]) == 0) {
+	name = g_strndup (package_id, sep[0]);
+	bucket = g_hash_table_lookup (priv->name_index, name);
+	if (bucket == NULL)
+		return NULL;
+
+	/* only a few architectures per name */
+	arch = package_id + sep[1] + 1;
+	arch_len = sep[2] - sep[1] - 1;
+	for (guint i = 0; i < bucket->len; i++) {
+		const gchar *arch_tmp;
+
+		pkg_tmp = g_ptr_array_index (bucket, i);
+		arch_tmp = pk_package_get_arch (pkg_tmp);
+		if (strncmp (arch_tmp, arch, arch_len) == 0 &&
+		    arch_tmp[arch_len] == '\0')
 			return g_object_ref (pkg_tmp);
-		}
 	}
 	return NULL;
 }
@@ -578,16 +711,7 @@ pk_package_sack_find_by_id_name_arch (PkPackageSack *sack, const gchar *package_
 static gint
 pk_package_sack_sort_compare_name_func (PkPackage **a, PkPackage **b)
 {
-	const gchar *package_id1;
-	const gchar *package_id2;
-	g_auto(GStrv) split1 = NULL;
-	g_auto(GStrv) split2 = NULL;
-
-	package_id1 = pk_package_get_id (*a);
-	package_id2 = pk_package_get_id (*b);
-	split1 = pk_package_id_split (package_id1);
-	split2 = pk_package_id_split (package_id2);
-	return g_strcmp0 (split1[PK_PACKAGE_ID_NAME], split2[PK_PACKAGE_ID_NAME]);
+	return g_strcmp0 (pk_package_get_name (*a), pk_package_get_name (*b));
 }
 
 /*
@@ -657,6 +781,9 @@ pk_package_sack_sort (PkPackageSack *sack, PkPackageSackSortType type)
 		g_ptr_array_sort (priv->array, (GCompareFunc) pk_package_sack_sort_compare_summary_func);
 	else if (type == PK_PACKAGE_SACK_SORT_TYPE_INFO)
 		g_ptr_array_sort (priv->array, (GCompareFunc) pk_package_sack_sort_compare_info_func);
+
+	/* keep lookups returning the first match in array order */
+	pk_package_sack_rebuild_index (priv);
 }
 
 /**
@@ -1085,8 +1212,13 @@ pk_package_sack_init (PkPackageSack *sack)
 
 	sack->priv = priv;
 	priv->table = g_hash_table_new (g_str_hash, g_str_equal);
-	priv->array = g_ptr_array_new_with_free_func (g_object_unref);
+	priv->array = g_ptr_array_new_with_free_func (pk_package_sack_release_package);
 	priv->client = pk_client_new ();
+	priv->name_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+						  (GDestroyNotify) g_ref_string_release,
+						  (GDestroyNotify) g_ptr_array_unref);
+	for (guint i = 0; i < PK_INFO_ENUM_LAST; i++)
+		priv->info_index[i] = g_ptr_array_new ();
 }
 
 /*
@@ -1100,6 +1232,9 @@ pk_package_sack_finalize (GObject *object)
 
 	g_clear_pointer (&priv->array, g_ptr_array_unref);
 	g_clear_pointer (&priv->table, g_hash_table_unref);
+	g_clear_pointer (&priv->name_index, g_hash_table_unref);
+	for (guint i = 0; i < PK_INFO_ENUM_LAST; i++)
+		g_clear_pointer (&priv->info_index[i], g_ptr_array_unref);
 	g_clear_object (&priv->client);
 
 	G_OBJECT_CLASS (pk_package_sack_parent_class)->finalize (object);
@@ -31,12 +31,16 @@
 #include "config.h"
 
 #include <glib-object.h>
+#include <string.h>
 
 #include <packagekit-glib2/pk-package.h>
 #include <packagekit-glib2/pk-common.h>
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-enum-types.h>
 #include <packagekit-glib2/pk-package-id.h>
+#include <packagekit-glib2/pk-package-id-private.h>
+#include <packagekit-glib2/pk-package-private.h>
+#include <packagekit-glib2/pk-source-private.h>
 
 static void     pk_package_finalize	(GObject     *object);
 
@@ -48,9 +52,8 @@ static void     pk_package_finalize	(GObject     *object);
 struct _PkPackagePrivate
 {
 	PkInfoEnum		 info;
-	gchar			*package_id;
-	gchar			*package_id_data;
-	const gchar		*package_id_split[4];
+	gchar			*package_id;		/* "<package_id>\0<version>\0" */
+	const gchar		*package_id_split[4];	/* name, arch and data are interned */
 	gchar			*summary;
 	gchar			*license;
 	PkGroupEnum		 group;
@@ -69,6 +72,7 @@ struct _PkPackagePrivate
 	gchar			*update_issued;
 	gchar			*update_updated;
 	PkInfoEnum	 	 update_severity;
+	gint			 sack_count;		/* atomic, sacks holding the package */
 };
 
 enum {
@@ -105,6 +109,9 @@ static guint signals [SIGNAL_LAST] = { 0 };
 
 static GParamSpec *obj_properties[PROP_LAST] = { NULL, };
 
+/* bumped whenever the info of a package held by any sack changes */
+static guint info_generation = 0;
+
 G_DEFINE_TYPE_WITH_PRIVATE (PkPackage, pk_package, PK_TYPE_SOURCE)
 #define GET_PRIVATE(o) (pk_package_get_instance_private (o))
 
@@ -156,6 +163,95 @@ pk_package_equal_id (PkPackage *package1, PkPackage *package2)
 	return (g_strcmp0 (priv1->package_id, priv2->package_id) == 0);
 }
 
+/*
+ * pk_package_intern_section:
+ *
+ * Names, architectures and repository IDs are shared between many packages,
+ * so keep a single refcounted copy of each rather than one per package.
+ **/
+static const gchar *
+pk_package_intern_section (const gchar *str, gsize len)
+{
+	gchar buf[128];
+	g_autofree gchar *tmp = NULL;
+
+	if (len < sizeof (buf)) {
+		memcpy (buf, str, len);
+		buf[len] = '\0';
+		return g_ref_string_new_intern (buf);
+	}
+	tmp = g_strndup (str, len);
+	return g_ref_string_new_intern (tmp);
+}
+
+/*
+ * pk_package_clear_id:
+ **/
+static void
+pk_package_clear_id (PkPackagePrivate *priv)
+{
+	if (priv->package_id_split[PK_PACKAGE_ID_NAME] != NULL)
+		g_ref_string_release ((GRefString *) priv->package_id_split[PK_PACKAGE_ID_NAME]);
+	if (priv->package_id_split[PK_PACKAGE_ID_ARCH] != NULL)
+		g_ref_string_release ((GRefString *) priv->package_id_split[PK_PACKAGE_ID_ARCH]);
+	if (priv->package_id_split[PK_PACKAGE_ID_DATA] != NULL)
+		g_ref_string_release ((GRefString *) priv->package_id_split[PK_PACKAGE_ID_DATA]);
+	g_clear_pointer (&priv->package_id, g_free);
+	priv->package_id_split[PK_PACKAGE_ID_NAME] = NULL;
+	priv->package_id_split[PK_PACKAGE_ID_VERSION] = NULL;
+	priv->package_id_split[PK_PACKAGE_ID_ARCH] = NULL;
+	priv->package_id_split[PK_PACKAGE_ID_DATA] = NULL;
+}
+
+/*
+ * pk_package_set_id_internal:
+ *
+ * Sets the ID of a package that has none, without notifying.
+ **/
+static gboolean
+pk_package_set_id_internal (PkPackagePrivate *priv, const gchar *package_id, GError **error)
+{
+	gsize sep[3];
+	gsize len;
+	gsize version_len;
+
+	if (!pk_package_id_parse (package_id, sep)) {
+		guint cnt = 0;
+
+		if (package_id == NULL) {
+			g_set_error_literal (error, 1, 0, "no package_id");
+			return FALSE;
+		}
+		for (guint i = 0; package_id[i] != '\0'; i++) {
+			if (package_id[i] == ';')
+				cnt++;
+		}
+		if (cnt != 3)
+			g_set_error (error, 1, 0, "invalid number of sections %i", cnt);
+		else
+			g_set_error_literal (error, 1, 0, "name invalid");
+		return FALSE;
+	}
+
+	/* keep the package-id and a terminated copy of the version in one
+	 * allocation, everything else is shared with other packages */
+	len = strlen (package_id);
+	version_len = sep[1] - sep[0] - 1;
+	priv->package_id = g_malloc (len + 1 + version_len + 1);
+	memcpy (priv->package_id, package_id, len + 1);
+	memcpy (priv->package_id + len + 1, package_id + sep[0] + 1, version_len);
+	priv->package_id[len + 1 + version_len] = '\0';
+
+	priv->package_id_split[PK_PACKAGE_ID_NAME] =
+		pk_package_intern_section (package_id, sep[0]);
+	priv->package_id_split[PK_PACKAGE_ID_VERSION] = priv->package_id + len + 1;
+	priv->package_id_split[PK_PACKAGE_ID_ARCH] =
+		pk_package_intern_section (package_id + sep[1] + 1, sep[2] - sep[1] - 1);
+	priv->package_id_split[PK_PACKAGE_ID_DATA] =
+		pk_package_intern_section (package_id + sep[2] + 1, len - sep[2] - 1);
+	return TRUE;
+}
+
 /**
  * pk_package_set_id:
  * @package: a valid #PkPackage instance
@@ -172,8 +268,6 @@ gboolean
 pk_package_set_id (PkPackage *package, const gchar *package_id, GError **error)
 {
 	PkPackagePrivate *priv = GET_PRIVATE(package);
-	guint cnt = 0;
-	guint i;
 
 	g_return_val_if_fail (PK_IS_PACKAGE (package), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
@@ -182,44 +276,13 @@ pk_package_set_id (PkPackage *package, const gchar *package_id, GError **error)
 		return TRUE;
 
 	/* free old data */
-	g_free (priv->package_id);
-	g_free (priv->package_id_data);
-
-	/* copy the package-id into package_id_data, change the ';' into '\0'
-	 * and reference the pointers in the const gchar * array */
-	priv->package_id = g_strdup (package_id);
-	priv->package_id_data = g_strdup (package_id);
-	priv->package_id_split[PK_PACKAGE_ID_NAME] = priv->package_id_data;
-	for (i = 0; priv->package_id_data[i] != '\0'; i++) {
-		if (package_id[i] == ';') {
-			if (++cnt > 3)
-				continue;
-			priv->package_id_split[cnt] = &priv->package_id_data[i+1];
-			priv->package_id_data[i] = '\0';
-		}
-	}
-	if (cnt != 3) {
-		g_set_error (error, 1, 0, "invalid number of sections %i", cnt);
-		goto out;
-	}
+	pk_package_clear_id (priv);
 
-	/* name has to be valid */
-	if (priv->package_id_split[PK_PACKAGE_ID_NAME][0] == '\0') {
-		g_set_error_literal (error, 1, 0, "name invalid");
-		goto out;
-	}
+	if (!pk_package_set_id_internal (priv, package_id, error))
+		return FALSE;
 
 	g_object_notify_by_pspec (G_OBJECT(package), obj_properties[PROP_PACKAGE_ID]);
 	return TRUE;
-
-out:
-	g_clear_pointer (&priv->package_id, g_free);
-	g_clear_pointer (&priv->package_id_data, g_free);
-	priv->package_id_split[PK_PACKAGE_ID_NAME] = NULL;
-	priv->package_id_split[PK_PACKAGE_ID_VERSION] = NULL;
-	priv->package_id_split[PK_PACKAGE_ID_ARCH] = NULL;
-	priv->package_id_split[PK_PACKAGE_ID_DATA] = NULL;
-	return FALSE;
 }
 
 /**
@@ -298,9 +361,46 @@ pk_package_set_info (PkPackage *package, PkInfoEnum info)
 		return;
 
 	priv->info = info;
+	if (g_atomic_int_get (&priv->sack_count) > 0)
+		g_atomic_int_inc (&info_generation);
 	g_object_notify_by_pspec (G_OBJECT(package), obj_properties[PROP_INFO]);
 }
 
+/*
+ * pk_package_get_info_generation:
+ *
+ * Gets a counter that changes every time the info of a #PkPackage held by a
+ * #PkPackageSack is changed, so that sacks can cache data derived from it.
+ **/
+guint
+pk_package_get_info_generation (void)
+{
+	return (guint) g_atomic_int_get (&info_generation);
+}
+
+/*
+ * pk_package_add_to_sack:
+ *
+ * Records that a #PkPackageSack holds the package. Info changes of packages
+ * that no sack holds do not affect the info generation.
+ **/
+void
+pk_package_add_to_sack (PkPackage *package)
+{
+	PkPackagePrivate *priv = GET_PRIVATE(package);
+	g_atomic_int_inc (&priv->sack_count);
+}
+
+/*
+ * pk_package_remove_from_sack:
+ **/
+void
+pk_package_remove_from_sack (PkPackage *package)
+{
+	PkPackagePrivate *priv = GET_PRIVATE(package);
+	g_atomic_int_add (&priv->sack_count, -1);
+}
+
 /**
  * pk_package_set_summary:
  * @package: a valid #PkPackage instance
@@ -557,7 +657,11 @@ pk_package_set_property (GObject *object, guint prop_id, const GValue *value, GP
 
 	switch (prop_id) {
 	case PROP_INFO:
-		priv->info = g_value_get_enum (value);
+		if (priv->info != (PkInfoEnum) g_value_get_enum (value)) {
+			priv->info = g_value_get_enum (value);
+			if (g_atomic_int_get (&priv->sack_count) > 0)
+				g_atomic_int_inc (&info_generation);
+		}
 		break;
 	case PROP_SUMMARY:
 		g_free (priv->summary);
@@ -909,7 +1013,7 @@ pk_package_finalize (GObject *object)
 	PkPackage *package = PK_PACKAGE (object);
 	PkPackagePrivate *priv = GET_PRIVATE(package);
 
-	g_clear_pointer (&priv->package_id, g_free);
+	pk_package_clear_id (priv);
 	g_clear_pointer (&priv->summary, g_free);
 	g_clear_pointer (&priv->license, g_free);
 	g_clear_pointer (&priv->description, g_free);
@@ -923,7 +1027,6 @@ pk_package_finalize (GObject *object)
 	g_clear_pointer (&priv->update_changelog, g_free);
 	g_clear_pointer (&priv->update_issued, g_free);
 	g_clear_pointer (&priv->update_updated, g_free);
-	g_clear_pointer (&priv->package_id_data, g_free);
 
 	G_OBJECT_CLASS (pk_package_parent_class)->finalize (object);
 }
@@ -943,6 +1046,65 @@ pk_package_new (void)
 	return PK_PACKAGE (package);
 }
 
+/*
+ * pk_package_update_severity_is_valid:
+ **/
+static gboolean
+pk_package_update_severity_is_valid (PkInfoEnum update_severity)
+{
+	return update_severity == PK_INFO_ENUM_UNKNOWN ||
+	       update_severity == PK_INFO_ENUM_LOW ||
+	       update_severity == PK_INFO_ENUM_ENHANCEMENT ||
+	       update_severity == PK_INFO_ENUM_NORMAL ||
+	       update_severity == PK_INFO_ENUM_BUGFIX ||
+	       update_severity == PK_INFO_ENUM_IMPORTANT ||
+	       update_severity == PK_INFO_ENUM_SECURITY ||
+	       update_severity == PK_INFO_ENUM_CRITICAL;
+}
+
+/*
+ * pk_package_new_from_signal:
+ * @info: the #PkInfoEnum
+ * @update_severity: the #PkInfoEnum severity of an update
+ * @package_id: the package ID
+ * @summary: the package summary
+ * @role: the #PkRoleEnum of the transaction
+ * @transaction_id: (nullable): the interned ID of the transaction
+ * @error: a #GError, or %NULL
+ *
+ * Creates a package for one row of a Package or Packages signal. Nothing
+ * can be listening to the new object yet, so this sets the fields directly
+ * rather than going through the property machinery for each of them.
+ *
+ * Returns: (transfer full) (nullable): a new #PkPackage, or %NULL if the
+ * package ID is invalid
+ **/
+PkPackage *
+pk_package_new_from_signal (PkInfoEnum info,
+			    PkInfoEnum update_severity,
+			    const gchar *package_id,
+			    const gchar *summary,
+			    PkRoleEnum role,
+			    GRefString *transaction_id,
+			    GError **error)
+{
+	PkPackagePrivate *priv;
+	g_autoptr(PkPackage) package = g_object_new (PK_TYPE_PACKAGE, NULL);
+
+	priv = GET_PRIVATE(package);
+	if (!pk_package_set_id_internal (priv, package_id, error))
+		return NULL;
+
+	/* no sack holds a new package, so the info generation is unchanged */
+	if (info != PK_INFO_ENUM_UNKNOWN)
+		priv->info = info;
+	if (pk_package_update_severity_is_valid (update_severity))
+		priv->update_severity = update_severity;
+	priv->summary = g_strdup (summary);
+	pk_source_set_origin (PK_SOURCE (package), role, transaction_id);
+	return g_steal_pointer (&package);
+}
+
 /**
  * pk_package_get_update_severity:
  * @package: a #PkPackage
@@ -987,14 +1149,7 @@ pk_package_set_update_severity (PkPackage *package,
 	PkPackagePrivate *priv = GET_PRIVATE(package);
 
 	g_return_if_fail (PK_IS_PACKAGE (package));
-	g_return_if_fail (update_severity == PK_INFO_ENUM_UNKNOWN ||
-			  update_severity == PK_INFO_ENUM_LOW ||
-			  update_severity == PK_INFO_ENUM_ENHANCEMENT ||
-			  update_severity == PK_INFO_ENUM_NORMAL ||
-			  update_severity == PK_INFO_ENUM_BUGFIX ||
-			  update_severity == PK_INFO_ENUM_IMPORTANT ||
-			  update_severity == PK_INFO_ENUM_SECURITY ||
-			  update_severity == PK_INFO_ENUM_CRITICAL);
+	g_return_if_fail (pk_package_update_severity_is_valid (update_severity));
 
 	if (priv->update_severity == update_severity)
 		return;
@@ -52,6 +52,7 @@ struct _PkResultsPrivate
 	PkProgress		*progress;
 	PkExitEnum		 exit_enum;
 	PkError			*error_code;
+	gchar			*solution_token;
 	GPtrArray		*details_array;
 	GPtrArray		*update_detail_array;
 	GPtrArray		*category_array;
@@ -515,6 +516,28 @@ pk_results_set_error_code (PkResults *results, PkError *item)
 	return TRUE;
 }
 
+/**
+ * pk_results_set_solution_token:
+ * @results: a valid #PkResults instance
+ * @solution_token: (nullable): the token, or %NULL
+ *
+ * Sets the token the backend returned for the dependency resolution of a
+ * simulated transaction.
+ *
+ * Return value: %TRUE if the value was set
+ *
+ * Since: 1.3.8
+ **/
+gboolean
+pk_results_set_solution_token (PkResults *results, const gchar *solution_token)
+{
+	PkResultsPrivate *priv = GET_PRIVATE(results);
+
+	g_return_val_if_fail (PK_IS_RESULTS (results), FALSE);
+
+	return g_set_str (&priv->solution_token, solution_token);
+}
+
 /**
  * pk_results_get_exit_code:
  * @results: a valid #PkResults instance
@@ -536,6 +559,28 @@ pk_results_get_exit_code (PkResults *results)
 	return priv->exit_enum;
 }
 
+/**
+ * pk_results_get_solution_token:
+ * @results: a valid #PkResults instance
+ *
+ * Gets the token of the dependency resolution of a simulated transaction.
+ * Running the same transaction with this token in the `solution-token` hint
+ * lets the backend skip resolving the dependencies again if nothing changed.
+ *
+ * Return value: the token, or %NULL if the backend did not return one
+ *
+ * Since: 1.3.8
+ **/
+const gchar *
+pk_results_get_solution_token (PkResults *results)
+{
+	PkResultsPrivate *priv = GET_PRIVATE(results);
+
+	g_return_val_if_fail (PK_IS_RESULTS (results), NULL);
+
+	return priv->solution_token;
+}
+
 /**
  * pk_results_get_role:
  * @results: a valid #PkResults instance
@@ -1013,6 +1058,7 @@ pk_results_finalize (GObject *object)
 	g_clear_object (&priv->package_sack);
 	g_clear_object (&priv->progress);
 	g_clear_object (&priv->error_code);
+	g_clear_pointer (&priv->solution_token, g_free);
 
 	G_OBJECT_CLASS (pk_results_parent_class)->finalize (object);
 }
@@ -88,6 +88,8 @@ gboolean	 pk_results_set_role	 		(PkResults		*results,
 							 PkRoleEnum		 role);
 gboolean	 pk_results_set_error_code 		(PkResults		*results,
 							 PkError		*item);
+gboolean	 pk_results_set_solution_token		(PkResults		*results,
+							 const gchar		*solution_token);
 
 /* add */
 gboolean	 pk_results_add_package			(PkResults		*results,
@@ -121,6 +123,7 @@ PkPackageSack	*pk_results_get_package_sack		(PkResults		*results);
 PkError		*pk_results_get_error_code		(PkResults		*results);
 PkRoleEnum	 pk_results_get_role			(PkResults		*results);
 PkBitfield	 pk_results_get_transaction_flags	(PkResults		*results);
+const gchar	*pk_results_get_solution_token		(PkResults		*results);
 PkRestartEnum	 pk_results_get_require_restart_worst	(PkResults		*results);
 
 /* get array objects */
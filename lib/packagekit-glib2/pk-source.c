@@ -32,6 +32,7 @@
 #include <glib-object.h>
 
 #include <packagekit-glib2/pk-source.h>
+#include <packagekit-glib2/pk-source-private.h>
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-enum-types.h>
 
@@ -45,7 +46,7 @@ static void     pk_source_finalize	(GObject     *object);
 struct _PkSourcePrivate
 {
 	PkRoleEnum			 role;
-	gchar				*transaction_id;
+	GRefString			*transaction_id;	/* interned, as shared by all results */
 };
 
 enum {
@@ -94,8 +95,9 @@ pk_source_set_property (GObject *object, guint prop_id, const GValue *value, GPa
 		priv->role = g_value_get_enum (value);
 		break;
 	case PROP_TRANSACTION_ID:
-		g_free (priv->transaction_id);
-		priv->transaction_id = g_value_dup_string (value);
+		g_clear_pointer (&priv->transaction_id, g_ref_string_release);
+		if (g_value_get_string (value) != NULL)
+			priv->transaction_id = g_ref_string_new_intern (g_value_get_string (value));
 		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -154,11 +156,31 @@ pk_source_finalize (GObject *object)
 	PkSource *source = PK_SOURCE (object);
 	PkSourcePrivate *priv = GET_PRIVATE(source);
 
-	g_clear_pointer (&priv->transaction_id, g_free);
+	g_clear_pointer (&priv->transaction_id, g_ref_string_release);
 
 	G_OBJECT_CLASS (pk_source_parent_class)->finalize (object);
 }
 
+/*
+ * pk_source_set_origin:
+ * @source: a new #PkSource
+ * @role: the #PkRoleEnum of the transaction
+ * @transaction_id: (nullable): the interned ID of the transaction
+ *
+ * Sets the role and the transaction ID without notifying, for objects that
+ * were only just created.
+ **/
+void
+pk_source_set_origin (PkSource *source, PkRoleEnum role, GRefString *transaction_id)
+{
+	PkSourcePrivate *priv = GET_PRIVATE(source);
+
+	priv->role = role;
+	g_clear_pointer (&priv->transaction_id, g_ref_string_release);
+	if (transaction_id != NULL)
+		priv->transaction_id = g_ref_string_acquire (transaction_id);
+}
+
 /**
  * pk_source_new:
  *
@@ -30,6 +30,7 @@
 #include <gio/gio.h>
 
 #include <packagekit-glib2/pk-task.h>
+#include <packagekit-glib2/pk-client-private.h>
 #include <packagekit-glib2/pk-common.h>
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-results.h>
@@ -94,6 +95,7 @@ typedef struct {
 	gchar				**packages;
 	gchar				*repo_id;
 	gchar				*transaction_id;
+	gchar				*solution_token;
 	gchar				**values;
 	PkBitfield			 filters;
 	PkUpgradeKindEnum		 upgrade_kind;
@@ -143,6 +145,7 @@ pk_task_state_free (gpointer task_state)
 	g_free (state->distro_id);
 	g_free (state->repo_id);
 	g_free (state->transaction_id);
+	g_free (state->solution_token);
 	g_strfreev (state->files);
 	g_strfreev (state->package_ids);
 	g_strfreev (state->packages);
@@ -180,6 +183,10 @@ pk_task_do_async_action (GTask *gtask)
 				PK_TRANSACTION_FLAG_ENUM_ALLOW_DOWNGRADE);
 	}
 
+	/* let the backend reuse the dependency resolution of the simulation */
+	if (state->solution_token != NULL)
+		pk_client_set_solution_token (PK_CLIENT(task), state->solution_token);
+
 	/* do the correct action */
 	if (state->role == PK_ROLE_ENUM_INSTALL_PACKAGES) {
 		pk_client_install_packages_async (PK_CLIENT(task), transaction_flags, state->package_ids,
@@ -357,6 +364,10 @@ pk_task_simulate_ready_cb (GObject *source_object, GAsyncResult *res, gpointer u
 		return;
 	}
 
+	/* the backend may be able to reuse this for the real transaction */
+	g_free (state->solution_token);
+	state->solution_token = g_strdup (pk_results_get_solution_token (state->results));
+
 	/* get data */
 	sack = pk_results_get_package_sack (state->results);
 
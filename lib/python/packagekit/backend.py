@@ -25,6 +25,7 @@
 from __future__ import print_function
 
 import sys
+import struct
 import traceback
 import os.path
 
@@ -62,13 +63,24 @@ class PackageKitBaseBackend:
         installExceptionHandler(self)
         self.cmds = cmds
         self._locked = False
+        self.percentage_old = 0
+        self._read_environment()
+
+        # write framed records if the daemon can parse them
+        self._records = None
+        if os.environ.get('PK_SPAWN_FRAMING') == 'binary':
+            self._start_records()
+
+    def _read_environment(self):
+        '''
+        Get the settings the daemon passes in the environment
+        '''
         self.lang = "C"
         self.has_network = False
         self.uid = 0
         self.background = False
         self.interactive = False
         self.cache_age = 0
-        self.percentage_old = 0
 
         # try to get LANG
         try:
@@ -109,6 +121,47 @@ class PackageKitBaseBackend:
         except KeyError as e:
             pass
 
+    def _set_environment(self, items):
+        '''
+        Replace the environment, which the daemon sends before a command
+        when it reuses this dispatcher for another transaction. It never
+        does so when the locale or proxies change, as those are applied
+        when the dispatcher starts.
+        @param items: KEY=VALUE strings
+        '''
+        os.environ.clear()
+        for item in items:
+            key, sep, value = item.partition('=')
+            if sep:
+                os.environ[key] = value
+        self._read_environment()
+        self.percentage_old = 0
+
+    def _start_records(self):
+        '''
+        Switch from lines to framed records, which are not escaped or split
+        again by the daemon. Anything else written to stdout from now on,
+        also by child processes, goes to stderr so it cannot end up in the
+        middle of a record.
+        '''
+        sys.stdout.write("framing\tbinary\n")
+        sys.stdout.flush()
+        self._records = os.fdopen(os.dup(1), 'wb')
+        os.dup2(2, 1)
+
+    def _write(self, *fields):
+        '''
+        Send one command to the daemon, as a tab separated line or as a record
+        of a 32 bit little endian size followed by NUL terminated fields
+        '''
+        if self._records is None:
+            sys.stdout.write(_to_utf8("\t".join(str(field) for field in fields) + "\n"))
+            sys.stdout.flush()
+            return
+        payload = b"".join(str(field).encode('utf-8', 'replace') + b"\0" for field in fields)
+        self._records.write(struct.pack('<I', len(payload)) + payload)
+        self._records.flush()
+
     def doLock(self):
         ''' Generic locking, overide and extend in child class'''
         self._locked = True
@@ -126,19 +179,17 @@ class PackageKitBaseBackend:
         @param percent: Progress percentage (int preferred)
         '''
         if percent == None:
-            sys.stdout.write(_to_utf8("no-percentage-updates\n"))
+            self._write("no-percentage-updates")
         elif percent == 0 or percent > self.percentage_old:
-            sys.stdout.write(_to_utf8("percentage\t%i\n" % percent))
+            self._write("percentage", "%i" % percent)
             self.percentage_old = percent
-        sys.stdout.flush()
 
     def speed(self, bps=0):
         '''
         Write progress speed
         @param bps: Progress speed (int, bytes per second)
         '''
-        sys.stdout.write(_to_utf8("speed\t%i\n" % bps))
-        sys.stdout.flush()
+        self._write("speed", "%i" % bps)
 
     def item_progress(self, package_id, status, percent=None):
         '''
@@ -146,8 +197,7 @@ class PackageKitBaseBackend:
         @param package_id: The package ID name, e.g. openoffice-clipart;2.6.22;ppc64;fedora
         @param percent: percentage of the current item (int preferred)
         '''
-        sys.stdout.write(_to_utf8("item-progress\t%s\t%s\t%i\n" % (package_id, status, percent)))
-        sys.stdout.flush()
+        self._write("item-progress", package_id, status, "%i" % percent)
 
     def error(self, err, description, exit=True):
         '''
@@ -161,8 +211,7 @@ class PackageKitBaseBackend:
             self.unLock()
 
         # this should be fast now
-        sys.stdout.write(_to_utf8("error\t%s\t%s\n" % (err, description)))
-        sys.stdout.flush()
+        self._write("error", err, description)
         if exit:
             # Paradoxically, we don't want to print "finished" to stdout here.
             # Python takes an _enormous_ amount of time to exit, and leaves a
@@ -176,8 +225,7 @@ class PackageKitBaseBackend:
         send 'message' signal
         @param typ: MESSAGE_BROKEN_MIRROR
         '''
-        sys.stdout.write(_to_utf8("message\t%s\t%s\n" % (typ, msg)))
-        sys.stdout.flush()
+        self._write("message", typ, msg)
 
     def package(self, package_id, status, summary):
         '''
@@ -186,8 +234,7 @@ class PackageKitBaseBackend:
         @param package_id: The package ID name, e.g. openoffice-clipart;2.6.22;ppc64;fedora
         @param summary: The package Summary
         '''
-        sys.stdout.write(_to_utf8("package\t%s\t%s\t%s\n" % (status, package_id, summary)))
-        sys.stdout.flush()
+        self._write("package", status, package_id, summary)
 
     def media_change_required(self, mtype, id, text):
         '''
@@ -196,8 +243,7 @@ class PackageKitBaseBackend:
         @param id: the localised label of the media
         @param text: the localised text describing the media
         '''
-        sys.stdout.write(_to_utf8("media-change-required\t%s\t%s\t%s\n" % (mtype, id, text)))
-        sys.stdout.flush()
+        self._write("media-change-required", mtype, id, text)
 
     def distro_upgrade(self, dtype, name, summary):
         '''
@@ -206,16 +252,14 @@ class PackageKitBaseBackend:
         @param name: The distro name, e.g. "fedora-9"
         @param summary: The localised distribution name and description
         '''
-        sys.stdout.write(_to_utf8("distro-upgrade\t%s\t%s\t%s\n" % (dtype, name, summary)))
-        sys.stdout.flush()
+        self._write("distro-upgrade", dtype, name, summary)
 
     def status(self, state):
         '''
         send 'status' signal
         @param state: STATUS_DOWNLOAD, STATUS_INSTALL, STATUS_UPDATE, STATUS_REMOVE, STATUS_WAIT
         '''
-        sys.stdout.write(_to_utf8("status\t%s\n" % state))
-        sys.stdout.flush()
+        self._write("status", state)
 
     def repo_detail(self, repoid, name, state):
         '''
@@ -223,16 +267,14 @@ class PackageKitBaseBackend:
         @param repoid: The repo id tag
         @param state: false is repo is disabled else true.
         '''
-        sys.stdout.write(_to_utf8("repo-detail\t%s\t%s\t%s\n" % (repoid, name, _bool_to_string(state))))
-        sys.stdout.flush()
+        self._write("repo-detail", repoid, name, _bool_to_string(state))
 
     def data(self, data):
         '''
         send 'data' signal:
         @param data:  The current worked on package
         '''
-        sys.stdout.write(_to_utf8("data\t%s\n" % data))
-        sys.stdout.flush()
+        self._write("data", data)
 
     def details(self, package_id, summary, package_license, group, desc, url, bytes: int | None = None, download_bytes: int | None = None):
         '''
@@ -253,16 +295,14 @@ class PackageKitBaseBackend:
         if download_bytes is None:
             download_bytes = MAXUINT64
 
-        sys.stdout.write(_to_utf8("details\t%s\t%s\t%s\t%s\t%s\t%s\t%ld\t%ld\n" % (package_id, summary, package_license, group, desc, url, bytes, download_bytes)))
-        sys.stdout.flush()
+        self._write("details", package_id, summary, package_license, group, desc, url, "%ld" % bytes, "%ld" % download_bytes)
 
     def files(self, package_id, file_list):
         '''
         Send 'files' signal
         @param file_list: List of the files in the package, separated by ';'
         '''
-        sys.stdout.write(_to_utf8("files\t%s\t%s\n" % (package_id, file_list)))
-        sys.stdout.flush()
+        self._write("files", package_id, file_list)
 
     def category(self, parent_id, cat_id, name, summary, icon):
         '''
@@ -273,15 +313,13 @@ class PackageKitBaseBackend:
         summery   : a summary of the category in current locale.
         icon      : an icon name to represent the category
         '''
-        sys.stdout.write(_to_utf8("category\t%s\t%s\t%s\t%s\t%s\n" % (parent_id, cat_id, name, summary, icon)))
-        sys.stdout.flush()
+        self._write("category", parent_id, cat_id, name, summary, icon)
 
     def finished(self):
         '''
         Send 'finished' signal
         '''
-        sys.stdout.write(_to_utf8("finished\n"))
-        sys.stdout.flush()
+        self._write("finished")
 
     def update_detail(self, package_id, updates, obsoletes, vendor_url, bugzilla_url, cve_url, restart, update_text, changelog, state, issued, updated):
         '''
@@ -299,8 +337,7 @@ class PackageKitBaseBackend:
         @param issued:
         @param updated:
         '''
-        sys.stdout.write(_to_utf8("updatedetail\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n" % (package_id, updates, obsoletes, vendor_url, bugzilla_url, cve_url, restart, update_text, changelog, state, issued, updated)))
-        sys.stdout.flush()
+        self._write("updatedetail", package_id, updates, obsoletes, vendor_url, bugzilla_url, cve_url, restart, update_text, changelog, state, issued, updated)
 
     def require_restart(self, restart_type, details):
         '''
@@ -308,8 +345,7 @@ class PackageKitBaseBackend:
         @param restart_type: RESTART_SYSTEM, RESTART_APPLICATION, RESTART_SESSION
         @param details: Optional details about the restart
         '''
-        sys.stdout.write(_to_utf8("requirerestart\t%s\t%s\n" % (restart_type, details)))
-        sys.stdout.flush()
+        self._write("requirerestart", restart_type, details)
 
     def allow_cancel(self, allow):
         '''
@@ -320,8 +356,7 @@ class PackageKitBaseBackend:
             data = 'true'
         else:
             data = 'false'
-        sys.stdout.write(_to_utf8("allow-cancel\t%s\n" % data))
-        sys.stdout.flush()
+        self._write("allow-cancel", data)
 
     def repo_signature_required(self, package_id, repo_name, key_url, key_userid, key_id, key_fingerprint, key_timestamp, sig_type):
         '''
@@ -335,10 +370,9 @@ class PackageKitBaseBackend:
         @param key_timestamp:   Key timestamp
         @param sig_type:        Key type (GPG)
         '''
-        sys.stdout.write(_to_utf8("repo-signature-required\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n" % (
+        self._write("repo-signature-required",
             package_id, repo_name, key_url, key_userid, key_id, key_fingerprint, key_timestamp, sig_type
-            )))
-        sys.stdout.flush()
+            )
 
     def eula_required(self, eula_id, package_id, vendor_name, license_agreement):
         '''
@@ -348,10 +382,9 @@ class PackageKitBaseBackend:
         @param vendor_name:     Name of the vendor that wrote the EULA
         @param license_agreement: The license text
         '''
-        sys.stdout.write(_to_utf8("eula-required\t%s\t%s\t%s\t%s\n" % (
+        self._write("eula-required",
             eula_id, package_id, vendor_name, license_agreement
-            )))
-        sys.stdout.flush()
+            )
 
 #
 # Backend Action Methods
@@ -735,6 +768,8 @@ class PackageKitBaseBackend:
             self.finished()
 
     def dispatcher(self, args):
+        # the daemon can send a new environment rather than starting us again
+        self._write("environment", "stdin")
         if len(args) > 0:
             self.dispatch_command(args[0], args[1:])
         while True:
@@ -747,6 +782,9 @@ class PackageKitBaseBackend:
             if not line or line == 'exit':
                 break
             args = line.split('\t')
+            if args[0] == 'environment':
+                self._set_environment(args[1:])
+                continue
             self.dispatch_command(args[0], args[1:])
 
         # unlock backend and exit with success
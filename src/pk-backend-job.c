@@ -58,6 +58,15 @@
  */
 #define PK_BACKEND_CANCEL_ACTION_TIMEOUT	2000 /* ms */
 
+/**
+ * PK_BACKEND_JOB_VFUNC_BATCH_MAX:
+ *
+ * The maximum number of queued vfunc events delivered in one main loop
+ * iteration, so a backend emitting a huge number of results does not
+ * starve other sources.
+ */
+#define PK_BACKEND_JOB_VFUNC_BATCH_MAX		500
+
 typedef struct {
 	gboolean		 enabled;
 	PkBackendJobVFunc	 vfunc;
@@ -82,6 +91,7 @@ struct _PkBackendJob
 	gchar			*proxy_http;
 	gchar			*proxy_https;
 	gchar			*proxy_socks;
+	gchar			*solution_token;
 	gpointer		 user_data;
 	guint64			 download_size_remaining;
 	guint			 cache_age;
@@ -102,12 +112,17 @@ struct _PkBackendJob
 	gboolean		 interactive;
 	gboolean		 details_with_deps_size;
 	gboolean		 locked;
-	GHashTable		*emitted;
+	GHashTable		*emitted;		/* (nullable): package-id → info and summary stamp */
+	GStringChunk		*emitted_ids;		/* (nullable): keys of @emitted */
+	gboolean		 unique_packages;
 	PkErrorEnum		 last_error_code;
 	PkRoleEnum		 role;
 	PkStatusEnum		 status;
 	GTimer			*timer;
 	gboolean		 started;
+	GMutex			 vfunc_mutex;
+	GQueue			 vfunc_queue;
+	GSource			*vfunc_source;
 };
 
 G_DEFINE_TYPE (PkBackendJob, pk_backend_job, G_TYPE_OBJECT)
@@ -477,6 +492,35 @@ pk_backend_job_set_cache_age (PkBackendJob *job, guint cache_age)
 	job->cache_age = cache_age;
 }
 
+/**
+ * pk_backend_job_get_solution_token:
+ *
+ * Gets the token the client got from simulating the same transaction, so the
+ * backend can reuse the dependency resolution it did then.
+ *
+ * Return value: the token, or %NULL if the client did not present one
+ **/
+const gchar *
+pk_backend_job_get_solution_token (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), NULL);
+
+	return job->solution_token;
+}
+
+void
+pk_backend_job_set_solution_token (PkBackendJob *job, const gchar *solution_token)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+
+	if (g_strcmp0 (job->solution_token, solution_token) == 0)
+		return;
+
+	g_debug ("solution-token changed to %s", solution_token);
+	g_free (job->solution_token);
+	job->solution_token = g_strdup (solution_token);
+}
+
 void
 pk_backend_job_set_user_data (PkBackendJob *job, gpointer user_data)
 {
@@ -572,6 +616,7 @@ pk_backend_job_get_is_error_set (PkBackendJob *job)
 
 /* used to call vfuncs in the main daemon thread */
 typedef struct {
+	GList			 link;
 	PkBackendJob		*job;
 	PkBackendJobSignal	 signal_kind;
 	GObject			*object;
@@ -625,6 +670,8 @@ pk_backend_job_signal_to_string (PkBackendJobSignal id)
 		return "UpdateDetails";
 	if (id == PK_BACKEND_SIGNAL_CATEGORY)
 		return "Category";
+	if (id == PK_BACKEND_SIGNAL_SOLUTION)
+		return "Solution";
 	return NULL;
 }
 
@@ -637,28 +684,67 @@ pk_backend_job_vfunc_event_free (PkBackendJobVFuncHelper *helper)
 	g_free (helper);
 }
 
-static gboolean
-pk_backend_job_call_vfunc_idle_cb (gpointer user_data)
+static void
+pk_backend_job_vfunc_event_dispatch (PkBackendJob *job,
+				     PkBackendJobVFuncHelper *helper)
 {
-	PkBackendJobVFuncHelper *helper = (PkBackendJobVFuncHelper *) user_data;
 	PkBackendJobVFuncItem *item;
 
 	/* call transaction vfunc on main thread */
-	item = &helper->job->vfunc_items[helper->signal_kind];
+	item = &job->vfunc_items[helper->signal_kind];
 	if (item != NULL && item->vfunc != NULL) {
-		item->vfunc (helper->job, helper->object, item->user_data);
+		item->vfunc (job, helper->object, item->user_data);
 	} else {
 		g_warning ("tried to do signal %s when no longer connected",
 			   pk_backend_job_signal_to_string (helper->signal_kind));
 	}
+}
+
+static gboolean
+pk_backend_job_call_vfunc_idle_cb (gpointer user_data)
+{
+	PkBackendJobVFuncHelper *helper = (PkBackendJobVFuncHelper *) user_data;
+	pk_backend_job_vfunc_event_dispatch (helper->job, helper);
 	return FALSE;
 }
 
+static gboolean
+pk_backend_job_dispatch_vfuncs_cb (gpointer user_data)
+{
+	PkBackendJob *job = PK_BACKEND_JOB (user_data);
+	GQueue batch = G_QUEUE_INIT;
+	GList *link;
+	gboolean ret = G_SOURCE_CONTINUE;
+
+	/* take a batch off the queue so that backend threads can keep
+	 * emitting while the vfuncs run */
+	g_mutex_lock (&job->vfunc_mutex);
+	while (batch.length < PK_BACKEND_JOB_VFUNC_BATCH_MAX &&
+	       (link = g_queue_pop_head_link (&job->vfunc_queue)) != NULL)
+		g_queue_push_tail_link (&batch, link);
+	if (g_queue_is_empty (&job->vfunc_queue)) {
+		job->vfunc_source = NULL;
+		ret = G_SOURCE_REMOVE;
+	}
+	g_mutex_unlock (&job->vfunc_mutex);
+
+	while ((link = g_queue_pop_head_link (&batch)) != NULL) {
+		PkBackendJobVFuncHelper *helper = link->data;
+		pk_backend_job_vfunc_event_dispatch (job, helper);
+		pk_backend_job_vfunc_event_free (helper);
+	}
+	return ret;
+}
+
 /**
  * pk_backend_job_call_vfunc:
  *
  * This method can be called in any thread, and the vfunc is guaranteed
  * to be called idle in the main thread.
+ *
+ * Events are queued on the job and delivered in order, in batches, by a
+ * single idle source. Finished is sent from its own low priority source
+ * so it always arrives after everything that was emitted before it.
  **/
 static void
 pk_backend_job_call_vfunc (PkBackendJob *job,
@@ -668,7 +754,6 @@ pk_backend_job_call_vfunc (PkBackendJob *job,
 {
 	PkBackendJobVFuncHelper *helper;
 	PkBackendJobVFuncItem *item;
-	guint priority = G_PRIORITY_DEFAULT_IDLE;
 	g_autoptr(GSource) source = NULL;
 
 	/* call transaction vfunc if not disabled and set */
@@ -676,24 +761,41 @@ pk_backend_job_call_vfunc (PkBackendJob *job,
 	if (!item->enabled || item->vfunc == NULL)
 		return;
 
-	/* order this last if others are still pending */
-	if (signal_kind == PK_BACKEND_SIGNAL_FINISHED)
-		priority = G_PRIORITY_LOW;
-
-	/* emit idle */
 	helper = g_new0 (PkBackendJobVFuncHelper, 1);
-	helper->job = g_object_ref (job);
+	helper->link.data = helper;
 	helper->signal_kind = signal_kind;
 	helper->object = object;
 	helper->destroy_func = destroy_func;
-	source = g_idle_source_new ();
-	g_source_set_priority (source, priority);
-	g_source_set_callback (source,
-			       pk_backend_job_call_vfunc_idle_cb,
-			       helper,
-			       (GDestroyNotify) pk_backend_job_vfunc_event_free);
-	g_source_set_name (source, "[PkBackendJob] idle_event_cb");
-	g_source_attach (source, NULL);
+
+	/* order this last if others are still pending */
+	if (signal_kind == PK_BACKEND_SIGNAL_FINISHED) {
+		helper->job = g_object_ref (job);
+		source = g_idle_source_new ();
+		g_source_set_priority (source, G_PRIORITY_LOW);
+		g_source_set_callback (source,
+				       pk_backend_job_call_vfunc_idle_cb,
+				       helper,
+				       (GDestroyNotify) pk_backend_job_vfunc_event_free);
+		g_source_set_name (source, "[PkBackendJob] idle_event_cb");
+		g_source_attach (source, NULL);
+		return;
+	}
+
+	/* queue, and wake up the main loop only if nothing is pending yet */
+	g_mutex_lock (&job->vfunc_mutex);
+	g_queue_push_tail_link (&job->vfunc_queue, &helper->link);
+	if (job->vfunc_source == NULL) {
+		source = g_idle_source_new ();
+		g_source_set_priority (source, G_PRIORITY_DEFAULT_IDLE);
+		g_source_set_callback (source,
+				       pk_backend_job_dispatch_vfuncs_cb,
+				       g_object_ref (job),
+				       (GDestroyNotify) g_object_unref);
+		g_source_set_name (source, "[PkBackendJob] dispatch_vfuncs_cb");
+		g_source_attach (source, NULL);
+		job->vfunc_source = source;
+	}
+	g_mutex_unlock (&job->vfunc_mutex);
 }
 
 /**
@@ -734,6 +836,8 @@ pk_backend_job_set_role (PkBackendJob *job, PkRoleEnum role)
 
 	g_timer_reset (job->timer);
 	job->role = role;
+	if (job->backend != NULL)
+		job->unique_packages = pk_backend_emits_unique_packages (job->backend, role);
 	job->status = PK_STATUS_ENUM_WAIT;
 	pk_backend_job_call_vfunc (job,
 				   PK_BACKEND_SIGNAL_STATUS_CHANGED,
@@ -741,6 +845,22 @@ pk_backend_job_set_role (PkBackendJob *job, PkRoleEnum role)
 				   NULL);
 }
 
+/**
+ * pk_backend_job_set_unique_packages:
+ *
+ * Set if your backend job never emits the same package twice, so the
+ * job does not need to keep track of every emitted package to filter out
+ * duplicates. This defaults to the value returned by the backend's
+ * pk_backend_emits_unique_packages() for the job role.
+ **/
+void
+pk_backend_job_set_unique_packages (PkBackendJob *job, gboolean unique_packages)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+
+	job->unique_packages = unique_packages;
+}
+
 /**
  * pk_backend_job_set_locked:
  *
@@ -1026,6 +1146,45 @@ pk_backend_job_package (PkBackendJob *job,
 	pk_backend_job_package_full (job, info, package_id, summary, PK_INFO_ENUM_UNKNOWN);
 }
 
+/* Returns %TRUE if a package with the same ID, info and summary was already
+ * emitted by this job. Only the ID is stored, together with a 32 bit stamp
+ * of the info and summary, rather than a reference to the package, which
+ * would keep every result of the job alive until it is finalized. */
+static gboolean
+pk_backend_job_package_emitted (PkBackendJob *job, PkPackage *item)
+{
+	const gchar *package_id = pk_package_get_id (item);
+	const gchar *summary = pk_package_get_summary (item);
+	gpointer key;
+	gpointer value;
+	guint32 stamp;
+
+	/* the backend does not emit duplicates for this role */
+	if (job->unique_packages)
+		return FALSE;
+
+	G_STATIC_ASSERT (PK_INFO_ENUM_LAST <= 0xff);
+	stamp = (g_str_hash (summary != NULL ? summary : "") & ~0xffu) |
+		(pk_package_get_info (item) & 0xffu);
+
+	if (job->emitted == NULL) {
+		job->emitted = g_hash_table_new (g_str_hash, g_str_equal);
+		job->emitted_ids = g_string_chunk_new (64 * 1024);
+	}
+
+	if (g_hash_table_lookup_extended (job->emitted, package_id, &key, &value)) {
+		if (GPOINTER_TO_UINT (value) == stamp)
+			return TRUE;
+		g_hash_table_insert (job->emitted, key, GUINT_TO_POINTER (stamp));
+		return FALSE;
+	}
+
+	g_hash_table_insert (job->emitted,
+			     g_string_chunk_insert (job->emitted_ids, package_id),
+			     GUINT_TO_POINTER (stamp));
+	return FALSE;
+}
+
 void
 pk_backend_job_package_full (PkBackendJob *job,
 			     PkInfoEnum info,
@@ -1033,7 +1192,6 @@ pk_backend_job_package_full (PkBackendJob *job,
 			     const gchar *summary,
 			     PkInfoEnum update_severity)
 {
-	PkPackage *emitted_item;
 	gboolean ret;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(PkPackage) item = NULL;
@@ -1054,15 +1212,9 @@ pk_backend_job_package_full (PkBackendJob *job,
 	pk_package_set_summary (item, summary);
 
 	/* already emitted? */
-	emitted_item = g_hash_table_lookup (job->emitted, pk_package_get_id (item));
-	if (emitted_item != NULL && pk_package_equal (emitted_item, item))
+	if (pk_backend_job_package_emitted (job, item))
 		return;
 
-	/* update the emitted package table */
-	g_hash_table_insert (job->emitted,
-	                     g_strdup (pk_package_get_id (item)),
-	                     g_object_ref (item));
-
 	/* have we already set an error? */
 	if (job->set_error) {
 		g_warning ("already set error: package %s", package_id);
@@ -1103,18 +1255,11 @@ pk_backend_job_packages (PkBackendJob *job,
 	for (guint i = 0; i < packages->len; i++) {
 		PkPackage *item = g_ptr_array_index (packages, i);
 		PkInfoEnum info = pk_package_get_info (item);
-		PkPackage *emitted_item;
 
 		/* already emitted? */
-		emitted_item = g_hash_table_lookup (job->emitted, pk_package_get_id (item));
-		if (emitted_item != NULL && pk_package_equal (emitted_item, item))
+		if (pk_backend_job_package_emitted (job, item))
 			continue;
 
-		/* update the emitted package table */
-		g_hash_table_insert (job->emitted,
-			             g_strdup (pk_package_get_id (item)),
-			             g_object_ref (item));
-
 		/* have we already set an error? */
 		if (job->set_error) {
 			g_warning ("already set error: package %s", pk_package_get_id (item));
@@ -1530,6 +1675,41 @@ pk_backend_job_media_change_required (PkBackendJob *job,
 				   g_object_unref);
 }
 
+/**
+ * pk_backend_job_solution:
+ *
+ * Tells the client that the backend kept the result of the dependency
+ * resolution of this simulation. If the client presents @solution_token when
+ * running the same transaction for real, the backend can skip resolving the
+ * dependencies again if the package database and the repositories did not
+ * change in the meantime.
+ **/
+void
+pk_backend_job_solution (PkBackendJob *job, const gchar *solution_token)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	g_return_if_fail (solution_token != NULL);
+
+	/* have we already set an error? */
+	if (job->set_error) {
+		g_warning ("already set error: solution %s", solution_token);
+		return;
+	}
+
+	/* only a simulation can be reused */
+	if (!pk_bitfield_contain (job->transaction_flags,
+				  PK_TRANSACTION_FLAG_ENUM_SIMULATE)) {
+		g_warning ("not a simulation, ignoring solution %s", solution_token);
+		return;
+	}
+
+	/* emit */
+	pk_backend_job_call_vfunc (job,
+				   PK_BACKEND_SIGNAL_SOLUTION,
+				   g_strdup (solution_token),
+				   g_free);
+}
+
 void
 pk_backend_job_repo_detail (PkBackendJob *job,
 			    const gchar *repo_id,
@@ -1797,6 +1977,37 @@ pk_backend_job_finished (PkBackendJob *job)
 				   NULL);
 }
 
+/**
+ * pk_backend_job_reset:
+ *
+ * Makes a finished job ready to run another role, keeping whatever the
+ * backend set up in its job_start() vfunc. The next role has to be set
+ * with pk_backend_job_set_role() before it is run.
+ **/
+void
+pk_backend_job_reset (PkBackendJob *job)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	g_return_if_fail (job->finished);
+
+	job->finished = FALSE;
+	job->role = PK_ROLE_ENUM_UNKNOWN;
+	job->has_sent_package = FALSE;
+	job->set_error = FALSE;
+	job->set_eula = FALSE;
+	job->set_signature = FALSE;
+	job->unique_packages = FALSE;
+	job->download_files = 0;
+	job->percentage = PK_BACKEND_PERCENTAGE_INVALID;
+	job->exit = PK_EXIT_ENUM_UNKNOWN;
+	job->last_error_code = PK_ERROR_ENUM_UNKNOWN;
+	job->status = PK_STATUS_ENUM_SETUP;
+
+	/* the same package may be a result of the next role too */
+	g_clear_pointer (&job->emitted, g_hash_table_unref);
+	g_clear_pointer (&job->emitted_ids, g_string_chunk_free);
+}
+
 static void
 pk_backend_job_finalize (GObject *object)
 {
@@ -1818,11 +2029,14 @@ pk_backend_job_finalize (GObject *object)
 	g_clear_pointer (&job->cmdline, g_free);
 	g_clear_pointer (&job->locale, g_free);
 	g_clear_pointer (&job->frontend_socket, g_free);
+	g_clear_pointer (&job->solution_token, g_free);
 	g_clear_pointer (&job->emitted, g_hash_table_unref);
+	g_clear_pointer (&job->emitted_ids, g_string_chunk_free);
 	g_clear_pointer (&job->params, g_variant_unref);
 	g_clear_pointer (&job->timer, g_timer_destroy);
 	g_clear_pointer (&job->conf, g_key_file_unref);
 	g_clear_object (&job->cancellable);
+	g_mutex_clear (&job->vfunc_mutex);
 
 	G_OBJECT_CLASS (pk_backend_job_parent_class)->finalize (object);
 }
@@ -1846,8 +2060,8 @@ pk_backend_job_init (PkBackendJob *job)
 	job->exit = PK_EXIT_ENUM_UNKNOWN;
 	job->role = PK_ROLE_ENUM_UNKNOWN;
 	job->status = PK_STATUS_ENUM_UNKNOWN;
-	job->emitted = g_hash_table_new_full (g_str_hash, g_str_equal,
-	                                      g_free, (GDestroyNotify) g_object_unref);
+	g_mutex_init (&job->vfunc_mutex);
+	g_queue_init (&job->vfunc_queue);
 }
 
 /**
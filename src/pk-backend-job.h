@@ -64,6 +64,7 @@ typedef enum {
 	PK_BACKEND_SIGNAL_UPDATE_DETAIL,
 	PK_BACKEND_SIGNAL_UPDATE_DETAILS,
 	PK_BACKEND_SIGNAL_CATEGORY,
+	PK_BACKEND_SIGNAL_SOLUTION,
 	PK_BACKEND_SIGNAL_LAST
 } PkBackendJobSignal;
 
@@ -92,6 +93,8 @@ void		 pk_backend_job_set_interactive		(PkBackendJob	*job,
 							 gboolean	 interactive);
 void		 pk_backend_job_set_locked		(PkBackendJob	*job,
 							 gboolean	 locked);
+void		 pk_backend_job_set_unique_packages	(PkBackendJob	*job,
+							 gboolean	 unique_packages);
 gboolean	 pk_backend_job_get_locked		(PkBackendJob	*job);
 void		 pk_backend_job_set_role		(PkBackendJob	*job,
 							 PkRoleEnum	 role);
@@ -102,6 +105,7 @@ void		 pk_backend_job_set_exit_code		(PkBackendJob	*job,
 gboolean	 pk_backend_job_has_set_error_code	(PkBackendJob	*job);
 guint		 pk_backend_job_get_runtime		(PkBackendJob	*job);
 gboolean	 pk_backend_job_get_is_finished		(PkBackendJob	*job);
+void		 pk_backend_job_reset			(PkBackendJob	*job);
 gboolean	 pk_backend_job_get_is_error_set	(PkBackendJob	*job);
 gboolean	 pk_backend_job_get_allow_cancel	(PkBackendJob	*job);
 void		 pk_backend_job_set_proxy		(PkBackendJob	*job,
@@ -123,6 +127,8 @@ void		 pk_backend_job_set_frontend_socket	(PkBackendJob	*job,
 							 const gchar	*frontend_socket);
 void		 pk_backend_job_set_cache_age		(PkBackendJob	*job,
 							 guint		 cache_age);
+void		 pk_backend_job_set_solution_token	(PkBackendJob	*job,
+							 const gchar	*solution_token);
 const gchar	*pk_backend_job_get_proxy_ftp		(PkBackendJob	*job);
 const gchar	*pk_backend_job_get_proxy_http		(PkBackendJob	*job);
 const gchar	*pk_backend_job_get_proxy_https		(PkBackendJob	*job);
@@ -132,6 +138,7 @@ const gchar	*pk_backend_job_get_pac			(PkBackendJob	*job);
 const gchar	*pk_backend_job_get_locale		(PkBackendJob	*job);
 const gchar	*pk_backend_job_get_frontend_socket	(PkBackendJob	*job);
 guint		 pk_backend_job_get_cache_age		(PkBackendJob	*job);
+const gchar	*pk_backend_job_get_solution_token	(PkBackendJob	*job);
 gboolean	 pk_backend_job_get_details_with_deps_size
 							(PkBackendJob	*job);
 void		 pk_backend_job_set_details_with_deps_size
@@ -233,6 +240,8 @@ void		 pk_backend_job_media_change_required	(PkBackendJob	*job,
 							 PkMediaTypeEnum media_type,
 							 const gchar    *media_id,
 							 const gchar    *media_text);
+void		 pk_backend_job_solution		(PkBackendJob	*job,
+							 const gchar	*solution_token);
 void		 pk_backend_job_category		(PkBackendJob	*job,
 							 const gchar	*parent_id,
 							 const gchar	*cat_id,
@@ -51,6 +51,66 @@
 
 #define	PK_UNSAFE_DELIMITERS	"\\\f\r\t"
 
+/* more than any command takes, so the size check still fails for longer lines */
+#define PK_BACKEND_SPAWN_SECTIONS_MAX	16
+
+typedef enum {
+	PK_BACKEND_SPAWN_COMMAND_UNKNOWN,
+	PK_BACKEND_SPAWN_COMMAND_PACKAGE,
+	PK_BACKEND_SPAWN_COMMAND_DETAILS,
+	PK_BACKEND_SPAWN_COMMAND_FINISHED,
+	PK_BACKEND_SPAWN_COMMAND_FILES,
+	PK_BACKEND_SPAWN_COMMAND_REPO_DETAIL,
+	PK_BACKEND_SPAWN_COMMAND_UPDATEDETAIL,
+	PK_BACKEND_SPAWN_COMMAND_PERCENTAGE,
+	PK_BACKEND_SPAWN_COMMAND_ITEM_PROGRESS,
+	PK_BACKEND_SPAWN_COMMAND_ERROR,
+	PK_BACKEND_SPAWN_COMMAND_REQUIRERESTART,
+	PK_BACKEND_SPAWN_COMMAND_STATUS,
+	PK_BACKEND_SPAWN_COMMAND_SPEED,
+	PK_BACKEND_SPAWN_COMMAND_DOWNLOAD_SIZE_REMAINING,
+	PK_BACKEND_SPAWN_COMMAND_ALLOW_CANCEL,
+	PK_BACKEND_SPAWN_COMMAND_NO_PERCENTAGE_UPDATES,
+	PK_BACKEND_SPAWN_COMMAND_REPO_SIGNATURE_REQUIRED,
+	PK_BACKEND_SPAWN_COMMAND_EULA_REQUIRED,
+	PK_BACKEND_SPAWN_COMMAND_MEDIA_CHANGE_REQUIRED,
+	PK_BACKEND_SPAWN_COMMAND_DISTRO_UPGRADE,
+	PK_BACKEND_SPAWN_COMMAND_CATEGORY,
+} PkBackendSpawnCommand;
+
+typedef struct {
+	const gchar		*name;
+	PkBackendSpawnCommand	 command;
+} PkBackendSpawnCommandItem;
+
+/* every command has its own slot, so a lookup is one hash and one compare;
+ * keep this collision free when adding commands */
+#define PK_BACKEND_SPAWN_COMMAND_HASH(str, len) \
+	(((len) * 2 + (guchar) (str)[0] + (guchar) (str)[(len) - 1] * 18) & 63)
+
+static const PkBackendSpawnCommandItem pk_backend_spawn_commands[64] = {
+	[5] = { "speed", PK_BACKEND_SPAWN_COMMAND_SPEED },
+	[6] = { "files", PK_BACKEND_SPAWN_COMMAND_FILES },
+	[7] = { "eula-required", PK_BACKEND_SPAWN_COMMAND_EULA_REQUIRED },
+	[8] = { "details", PK_BACKEND_SPAWN_COMMAND_DETAILS },
+	[16] = { "download-size-remaining", PK_BACKEND_SPAWN_COMMAND_DOWNLOAD_SIZE_REMAINING },
+	[17] = { "allow-cancel", PK_BACKEND_SPAWN_COMMAND_ALLOW_CANCEL },
+	[21] = { "status", PK_BACKEND_SPAWN_COMMAND_STATUS },
+	[24] = { "package", PK_BACKEND_SPAWN_COMMAND_PACKAGE },
+	[25] = { "item-progress", PK_BACKEND_SPAWN_COMMAND_ITEM_PROGRESS },
+	[26] = { "distro-upgrade", PK_BACKEND_SPAWN_COMMAND_DISTRO_UPGRADE },
+	[30] = { "percentage", PK_BACKEND_SPAWN_COMMAND_PERCENTAGE },
+	[31] = { "media-change-required", PK_BACKEND_SPAWN_COMMAND_MEDIA_CHANGE_REQUIRED },
+	[32] = { "repo-detail", PK_BACKEND_SPAWN_COMMAND_REPO_DETAIL },
+	[37] = { "updatedetail", PK_BACKEND_SPAWN_COMMAND_UPDATEDETAIL },
+	[40] = { "repo-signature-required", PK_BACKEND_SPAWN_COMMAND_REPO_SIGNATURE_REQUIRED },
+	[46] = { "no-percentage-updates", PK_BACKEND_SPAWN_COMMAND_NO_PERCENTAGE_UPDATES },
+	[51] = { "error", PK_BACKEND_SPAWN_COMMAND_ERROR },
+	[53] = { "category", PK_BACKEND_SPAWN_COMMAND_CATEGORY },
+	[54] = { "requirerestart", PK_BACKEND_SPAWN_COMMAND_REQUIRERESTART },
+	[62] = { "finished", PK_BACKEND_SPAWN_COMMAND_FINISHED },
+};
+
 struct _PkBackendSpawn
 {
 	GObject			parent;
@@ -60,12 +120,15 @@ struct _PkBackendSpawn
 	PkBackendJob		*job;
 	gchar			*name;
 	guint			 kill_id;
+	guint			 warm_id;
 	GKeyFile		*conf;
 	gboolean		 finished;
 	gboolean		 allow_sigkill;
 	gboolean		 is_busy;
+	gboolean		 is_warm;
 	PkBackendSpawnFilterFunc stdout_func;
 	PkBackendSpawnFilterFunc stderr_func;
+	GString			*line_buf;
 };
 
 G_DEFINE_TYPE (PkBackendSpawn, pk_backend_spawn, G_TYPE_OBJECT)
@@ -125,13 +188,83 @@ pk_backend_spawn_start_kill_timer (PkBackendSpawn *backend_spawn)
 }
 
 static gboolean
-pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
-			       PkBackendJob *job,
-			       const gchar *line,
-			       GError **error)
+pk_backend_spawn_warm_cb (gpointer user_data)
+{
+	PkBackendSpawn *backend_spawn = PK_BACKEND_SPAWN (user_data);
+	g_autoptr(GError) error = NULL;
+
+	backend_spawn->warm_id = 0;
+	if (backend_spawn->is_busy || pk_spawn_is_running (backend_spawn->spawn))
+		return G_SOURCE_REMOVE;
+	if (!pk_spawn_prestart (backend_spawn->spawn, &error)) {
+		g_debug ("not starting warm helper: %s", error->message);
+		return G_SOURCE_REMOVE;
+	}
+
+	/* it has no job, and is stopped like any other idle dispatcher */
+	backend_spawn->is_warm = TRUE;
+	if (backend_spawn->kill_id == 0)
+		pk_backend_spawn_start_kill_timer (backend_spawn);
+	return G_SOURCE_REMOVE;
+}
+
+/*
+ * pk_backend_spawn_start_warm:
+ *
+ * Start the dispatcher again after it exited at the end of a transaction,
+ * e.g. after an error or when cancelled, so the next transaction does not
+ * have to wait for the interpreter and the package manager to load.
+ **/
+static void
+pk_backend_spawn_start_warm (PkBackendSpawn *backend_spawn)
+{
+	g_autoptr(GError) error = NULL;
+
+	if (g_key_file_has_key (backend_spawn->conf, "Daemon", "WarmHelpers", NULL) &&
+	    !g_key_file_get_boolean (backend_spawn->conf, "Daemon", "WarmHelpers", &error)) {
+		if (error != NULL)
+			g_warning ("failed to read WarmHelpers: %s", error->message);
+		return;
+	}
+
+	/* the job may start another helper as it finishes */
+	if (backend_spawn->warm_id == 0) {
+		backend_spawn->warm_id = g_idle_add (pk_backend_spawn_warm_cb, backend_spawn);
+		g_source_set_name_by_id (backend_spawn->warm_id, "[PkBackendSpawn] warm");
+	}
+}
+
+static PkBackendSpawnCommand
+pk_backend_spawn_command_from_string (const gchar *command)
+{
+	const PkBackendSpawnCommandItem *item;
+	gsize len = strlen (command);
+
+	if (len == 0)
+		return PK_BACKEND_SPAWN_COMMAND_UNKNOWN;
+	item = &pk_backend_spawn_commands[PK_BACKEND_SPAWN_COMMAND_HASH (command, len)];
+	if (item->name == NULL || strcmp (item->name, command) != 0)
+		return PK_BACKEND_SPAWN_COMMAND_UNKNOWN;
+	return item->command;
+}
+
+/*
+ * pk_backend_spawn_parse_sections:
+ * @sections: the fields of one line or record, which may be modified
+ * @size: the number of fields, only the first PK_BACKEND_SPAWN_SECTIONS_MAX
+ * of which are set
+ * @is_record: if the fields came from a framed record rather than a line
+ **/
+static gboolean
+pk_backend_spawn_parse_sections (PkBackendSpawn *backend_spawn,
+				 PkBackendJob *job,
+				 gchar **sections,
+				 guint size,
+				 gboolean is_record,
+				 GError **error)
 {
-	guint size;
 	gchar *command;
+	PkBackendSpawnCommand cmd;
 	gchar *text;
 	guint64 speed;
 	guint64 download_size_remaining;
@@ -148,27 +281,18 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 	PkUpdateStateEnum update_state_enum;
 	PkMediaTypeEnum media_type_enum;
 	PkDistroUpgradeEnum distro_upgrade_enum;
-	g_auto(GStrv) sections = NULL;
-
-	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
-
-	/* check if output line */
-	if (line == NULL)
-		return FALSE;
 
-	/* split by tab */
-	sections = g_strsplit (line, "\t", 0);
 	command = sections[0];
+	cmd = pk_backend_spawn_command_from_string (command);
 
-	/* get size */
-	size = g_strv_length (sections);
-
-	if (g_strcmp0 (command, "package") == 0) {
+	if (cmd == PK_BACKEND_SPAWN_COMMAND_PACKAGE) {
 		if (size != 4) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
 		}
-		if (pk_package_id_check (sections[2]) == FALSE) {
+		/* the job checks the ID again when it creates the package, so
+		 * only lines, which may be a mix of anything, are checked first */
+		if (!is_record && pk_package_id_check (sections[2]) == FALSE) {
 			g_set_error_literal (error, 1, 0, "invalid package_id");
 			return FALSE;
 		}
@@ -185,7 +309,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			return FALSE;
 		}
 		pk_backend_job_package (job, info, sections[2], sections[3]);
-	} else if (g_strcmp0 (command, "details") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_DETAILS) {
 		if (size != 9) {
 			g_set_error (error, 1, 0,
 				     "invalid command'%s', size %i",
@@ -221,7 +345,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		pk_backend_job_details (job, sections[1], sections[2], sections[3],
 					group, text, sections[6], package_size, download_size);
 		g_free (text);
-	} else if (g_strcmp0 (command, "finished") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_FINISHED) {
 		if (size != 1) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -232,7 +356,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		/* from this point on, we can start the kill timer */
 		pk_backend_spawn_start_kill_timer (backend_spawn);
 
-	} else if (g_strcmp0 (command, "files") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_FILES) {
 		g_auto(GStrv) tmp = NULL;
 		if (size != 3) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
@@ -240,7 +364,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		}
 		tmp = g_strsplit (sections[2], ";", -1);
 		pk_backend_job_files (job, sections[1], tmp);
-	} else if (g_strcmp0 (command, "repo-detail") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_REPO_DETAIL) {
 		if (size != 4) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -260,7 +384,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			g_set_error (error, 1, 0, "invalid qualifier '%s'", sections[3]);
 			return FALSE;
 		}
-	} else if (g_strcmp0 (command, "updatedetail") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_UPDATEDETAIL) {
 		g_auto(GStrv) updates = NULL;
 		g_auto(GStrv) obsoletes = NULL;
 		g_auto(GStrv) vendor_urls = NULL;
@@ -304,7 +428,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 					  update_state_enum,
 					  sections[11],
 					  sections[12]);
-	} else if (g_strcmp0 (command, "percentage") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_PERCENTAGE) {
 		if (size != 2) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -318,7 +442,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		} else {
 			pk_backend_job_set_percentage (job, percentage);
 		}
-	} else if (g_strcmp0 (command, "item-progress") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_ITEM_PROGRESS) {
 		if (size != 4) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -344,7 +468,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 						  sections[1],
 						  status_enum,
 						  percentage);
-	} else if (g_strcmp0 (command, "error") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_ERROR) {
 		if (size != 3) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -365,7 +489,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 
 		pk_backend_job_error_code (job, error_enum, "%s", text);
 		g_free (text);
-	} else if (g_strcmp0 (command, "requirerestart") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_REQUIRERESTART) {
 		if (size != 3) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -380,7 +504,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			return FALSE;
 		}
 		pk_backend_job_require_restart (job, restart_enum, sections[2]);
-	} else if (g_strcmp0 (command, "status") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_STATUS) {
 		if (size != 2) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -391,7 +515,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			return FALSE;
 		}
 		pk_backend_job_set_status (job, status_enum);
-	} else if (g_strcmp0 (command, "speed") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_SPEED) {
 		if (size != 2) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -403,7 +527,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			return FALSE;
 		}
 		pk_backend_job_set_speed (job, speed);
-	} else if (g_strcmp0 (command, "download-size-remaining") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_DOWNLOAD_SIZE_REMAINING) {
 		if (size != 2) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -415,7 +539,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			return FALSE;
 		}
 		pk_backend_job_set_download_size_remaining (job, download_size_remaining);
-	} else if (g_strcmp0 (command, "allow-cancel") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_ALLOW_CANCEL) {
 		if (size != 2) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
@@ -428,13 +552,13 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			g_set_error (error, 1, 0, "invalid section '%s'", sections[1]);
 			return FALSE;
 		}
-	} else if (g_strcmp0 (command, "no-percentage-updates") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_NO_PERCENTAGE_UPDATES) {
 		if (size != 1) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
 		}
 		pk_backend_job_set_percentage (job, PK_BACKEND_PERCENTAGE_INVALID);
-	} else if (g_strcmp0 (command, "repo-signature-required") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_REPO_SIGNATURE_REQUIRED) {
 
 		if (size != 9) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
@@ -459,7 +583,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		pk_backend_job_repo_signature_required (job, sections[1],
 							  sections[2], sections[3], sections[4],
 							  sections[5], sections[6], sections[7], sig_type);
-	} else if (g_strcmp0 (command, "eula-required") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_EULA_REQUIRED) {
 
 		if (size != 5) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
@@ -482,7 +606,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		}
 
 		pk_backend_job_eula_required (job, sections[1], sections[2], sections[3], sections[4]);
-	} else if (g_strcmp0 (command, "media-change-required") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_MEDIA_CHANGE_REQUIRED) {
 
 		if (size != 4) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
@@ -496,7 +620,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		}
 
 		pk_backend_job_media_change_required (job, media_type_enum, sections[2], sections[3]);
-	} else if (g_strcmp0 (command, "distro-upgrade") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_DISTRO_UPGRADE) {
 
 		if (size != 4) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
@@ -517,7 +641,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 		}
 
 		pk_backend_job_distro_upgrade (job, distro_upgrade_enum, sections[2], sections[3]);
-	} else if (g_strcmp0 (command, "category") == 0) {
+	} else if (cmd == PK_BACKEND_SPAWN_COMMAND_CATEGORY) {
 
 		if (size != 6) {
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
@@ -564,6 +688,13 @@ pk_backend_spawn_exit_cb (PkSpawn *spawn, PkSpawnExitType exit_enum, PkBackendSp
 	gboolean ret;
 	g_return_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn));
 
+	/* a warm helper that was never used has no job to finish */
+	if (backend_spawn->is_warm) {
+		g_debug ("warm helper exited");
+		backend_spawn->is_warm = FALSE;
+		return;
+	}
+
 	/* reset the busy flag */
 	backend_spawn->is_busy = FALSE;
 
@@ -592,6 +723,36 @@ pk_backend_spawn_exit_cb (PkSpawn *spawn, PkSpawnExitType exit_enum, PkBackendSp
 		}
 		pk_backend_job_finished (backend_spawn->job);
 	}
+
+	pk_backend_spawn_start_warm (backend_spawn);
+}
+
+static gboolean
+pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
+			       PkBackendJob *job,
+			       const gchar *line,
+			       GError **error)
+{
+	guint size;
+	gchar *sections[PK_BACKEND_SPAWN_SECTIONS_MAX];
+
+	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
+
+	/* check if output line */
+	if (line == NULL)
+		return FALSE;
+
+	/* split by tab in place, in a buffer reused for every line */
+	g_string_assign (backend_spawn->line_buf, line);
+	sections[0] = backend_spawn->line_buf->str;
+	size = 1;
+	for (gchar *tab = strchr (sections[0], '\t'); tab != NULL; tab = strchr (tab + 1, '\t')) {
+		*tab = '\0';
+		if (size < PK_BACKEND_SPAWN_SECTIONS_MAX)
+			sections[size] = tab + 1;
+		size++;
+	}
+	return pk_backend_spawn_parse_sections (backend_spawn, job, sections, size, FALSE, error);
 }
 
 gboolean
@@ -616,6 +777,12 @@ pk_backend_spawn_stdout_cb (PkBackendSpawn *spawn, const gchar *line, PkBackendS
 {
 	gboolean ret;
 	g_autoptr(GError) error = NULL;
+
+	/* output of a warm helper does not belong to any job */
+	if (backend_spawn->is_warm) {
+		g_debug ("ignoring output of warm helper: %s", line);
+		return;
+	}
 	ret = pk_backend_spawn_inject_data (backend_spawn,
 					    backend_spawn->job,
 					    line,
@@ -624,12 +791,44 @@ pk_backend_spawn_stdout_cb (PkBackendSpawn *spawn, const gchar *line, PkBackendS
 		g_warning ("failed to parse: %s: %s", line, error->message);
 }
 
+static void
+pk_backend_spawn_stdout_record_cb (PkSpawn *spawn, gchar **record, PkBackendSpawn *backend_spawn)
+{
+	g_autoptr(GError) error = NULL;
+
+	if (backend_spawn->is_warm) {
+		g_debug ("ignoring record of warm helper: %s", record[0]);
+		return;
+	}
+
+	/* filter funcs only know about lines */
+	if (backend_spawn->stdout_func != NULL) {
+		g_autofree gchar *line = g_strjoinv ("\t", record);
+		if (!backend_spawn->stdout_func (backend_spawn->job, line))
+			return;
+	}
+
+	/* the fields are already split and are never copied */
+	if (!pk_backend_spawn_parse_sections (backend_spawn,
+					      backend_spawn->job,
+					      record,
+					      g_strv_length (record),
+					      TRUE,
+					      &error))
+		g_warning ("failed to parse record %s: %s", record[0], error->message);
+}
+
 static void
 pk_backend_spawn_stderr_cb (PkBackendSpawn *spawn, const gchar *line, PkBackendSpawn *backend_spawn)
 {
 	gboolean ret;
 	g_return_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn));
 
+	if (backend_spawn->is_warm) {
+		g_debug ("STDERR of warm helper: %s", line);
+		return;
+	}
+
 	/* do we ignore with a filter func ? */
 	if (backend_spawn->stderr_func != NULL) {
 		ret = backend_spawn->stderr_func (backend_spawn->job, line);
@@ -745,6 +944,11 @@ pk_backend_spawn_get_envp (PkBackendSpawn *backend_spawn)
 	ret = pk_backend_is_online (backend_spawn->backend);
 	g_hash_table_replace (env_table, g_strdup ("NETWORK"), g_strdup (ret ? "TRUE" : "FALSE"));
 
+	/* we can parse framed records */
+	g_hash_table_replace (env_table,
+			      g_strdup (PK_SPAWN_FRAMING_ENV),
+			      g_strdup (PK_SPAWN_FRAMING_BINARY));
+
 	/* BACKGROUND */
 	ret = pk_backend_job_get_background (backend_spawn->job);
 	g_hash_table_replace (env_table, g_strdup ("BACKGROUND"), g_strdup (ret ? "TRUE" : "FALSE"));
@@ -961,6 +1165,7 @@ gboolean
 pk_backend_spawn_exit (PkBackendSpawn *backend_spawn)
 {
 	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
+	g_clear_handle_id (&backend_spawn->warm_id, g_source_remove);
 	pk_spawn_exit (backend_spawn->spawn);
 	return TRUE;
 }
@@ -977,8 +1182,10 @@ pk_backend_spawn_helper (PkBackendSpawn *backend_spawn,
 	g_return_val_if_fail (first_element != NULL, FALSE);
 	g_return_val_if_fail (backend_spawn->name != NULL, FALSE);
 
-	/* save this */
+	/* save this, a warm helper now belongs to this job */
 	backend_spawn->is_busy = TRUE;
+	backend_spawn->is_warm = FALSE;
+	g_clear_handle_id (&backend_spawn->warm_id, g_source_remove);
 	backend_spawn->job = job;
 	backend_spawn->backend = g_object_ref (pk_backend_job_get_backend (job));
 
@@ -1011,10 +1218,12 @@ pk_backend_spawn_finalize (GObject *object)
 	PkBackendSpawn *backend_spawn = PK_BACKEND_SPAWN (object);
 
 	g_clear_handle_id (&backend_spawn->kill_id, g_source_remove);
+	g_clear_handle_id (&backend_spawn->warm_id, g_source_remove);
 	g_clear_pointer (&backend_spawn->name, g_free);
 	g_clear_pointer (&backend_spawn->conf, g_key_file_unref);
 	g_clear_object (&backend_spawn->spawn);
 	g_clear_object (&backend_spawn->backend);
+	g_string_free (backend_spawn->line_buf, TRUE);
 
 	G_OBJECT_CLASS (pk_backend_spawn_parent_class)->finalize (object);
 }
@@ -1029,6 +1238,7 @@ pk_backend_spawn_class_init (PkBackendSpawnClass *klass)
 static void
 pk_backend_spawn_init (PkBackendSpawn *backend_spawn)
 {
+	backend_spawn->line_buf = g_string_new (NULL);
 }
 
 PkBackendSpawn *
@@ -1042,6 +1252,8 @@ pk_backend_spawn_new (GKeyFile *conf)
 			  G_CALLBACK (pk_backend_spawn_exit_cb), backend_spawn);
 	g_signal_connect (backend_spawn->spawn, "stdout",
 			  G_CALLBACK (pk_backend_spawn_stdout_cb), backend_spawn);
+	g_signal_connect (backend_spawn->spawn, "stdout-record",
+			  G_CALLBACK (pk_backend_spawn_stdout_record_cb), backend_spawn);
 	g_signal_connect (backend_spawn->spawn, "stderr",
 			  G_CALLBACK (pk_backend_spawn_stderr_cb), backend_spawn);
 	return PK_BACKEND_SPAWN (backend_spawn);
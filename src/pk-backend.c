@@ -56,6 +56,8 @@ typedef struct {
 	PkBitfield	(*get_provides)			(PkBackend	*backend);
 	gchar		**(*get_mime_types)		(PkBackend	*backend);
 	gboolean	(*supports_parallelization)	(PkBackend	*backend);
+	gboolean	(*emits_unique_packages)	(PkBackend	*backend,
+							 PkRoleEnum	 role);
 	void		(*job_start)			(PkBackend	*backend,
 							 PkBackendJob	*job);
 	void		(*job_stop)			(PkBackend	*backend,
@@ -252,6 +254,23 @@ pk_backend_supports_parallelization (PkBackend	*backend)
 	return backend->desc->supports_parallelization (backend);
 }
 
+/**
+ * pk_backend_emits_unique_packages:
+ *
+ * Backends that never emit the same package twice for @role can say so, and
+ * the job then does not need to remember every package it emitted.
+ **/
+gboolean
+pk_backend_emits_unique_packages (PkBackend *backend, PkRoleEnum role)
+{
+	g_return_val_if_fail (PK_IS_BACKEND (backend), FALSE);
+
+	/* not compulsory */
+	if (backend->desc == NULL || backend->desc->emits_unique_packages == NULL)
+		return FALSE;
+	return backend->desc->emits_unique_packages (backend, role);
+}
+
 void
 pk_backend_thread_start (PkBackend *backend, PkBackendJob *job, gpointer func)
 {
@@ -512,6 +531,7 @@ pk_backend_load (PkBackend *backend, GError **error)
 		g_module_symbol (handle, "pk_backend_get_groups", (gpointer *)&desc->get_groups);
 		g_module_symbol (handle, "pk_backend_get_mime_types", (gpointer *)&desc->get_mime_types);
 		g_module_symbol (handle, "pk_backend_supports_parallelization", (gpointer *)&desc->supports_parallelization);
+		g_module_symbol (handle, "pk_backend_emits_unique_packages", (gpointer *)&desc->emits_unique_packages);
 		g_module_symbol (handle, "pk_backend_get_packages", (gpointer *)&desc->get_packages);
 		g_module_symbol (handle, "pk_backend_get_repo_list", (gpointer *)&desc->get_repo_list);
 		g_module_symbol (handle, "pk_backend_required_by", (gpointer *)&desc->required_by);
@@ -40,6 +40,7 @@
 #include <gio/gunixfdlist.h>
 #include <packagekit-glib2/pk-offline.h>
 #include <packagekit-glib2/pk-offline-private.h>
+#include <packagekit-glib2/pk-package-id.h>
 #include <packagekit-glib2/pk-version.h>
 #include <polkit/polkit.h>
 
@@ -1117,173 +1118,126 @@ pk_engine_daemon_get_property (GDBusConnection *connection_, const gchar *sender
 	return NULL;
 }
 
-static gboolean
-pk_engine_package_name_in_strv (gchar **strv, PkPackage *pkg)
-{
-	guint i;
-	for (i = 0; strv[i] != NULL; i++) {
-		if (g_strcmp0 (strv[i], pk_package_get_name (pkg)) == 0)
-			return TRUE;
-	}
-	return FALSE;
-}
-
 static GVariant *
-pk_engine_get_package_history_pkg (PkTransactionPast *item, PkPackage *pkg)
+pk_engine_get_package_history_pkg (PkTransactionDbHistoryItem *item)
 {
 	GVariantBuilder builder;
+	g_auto(GStrv) split = NULL;
+
+	split = pk_package_id_split (item->package_id);
+	if (split == NULL)
+		return NULL;
 	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
 	g_variant_builder_add (&builder, "{sv}", "info",
-			       g_variant_new_uint32 (pk_package_get_info (pkg)));
+			       g_variant_new_uint32 (item->info));
 	g_variant_builder_add (&builder, "{sv}", "source",
-			       g_variant_new_string (pk_package_get_data (pkg)));
+			       g_variant_new_string (split[PK_PACKAGE_ID_DATA]));
 	g_variant_builder_add (&builder, "{sv}", "version",
-			       g_variant_new_string (pk_package_get_version (pkg)));
+			       g_variant_new_string (split[PK_PACKAGE_ID_VERSION]));
 	g_variant_builder_add (&builder, "{sv}", "timestamp",
-			       g_variant_new_uint64 (pk_transaction_past_get_timestamp (item)));
+			       g_variant_new_uint64 (item->timestamp));
 	g_variant_builder_add (&builder, "{sv}", "user-id",
-			       g_variant_new_uint32 (pk_transaction_past_get_uid (item)));
+			       g_variant_new_uint32 (item->uid));
 	return g_variant_builder_end (&builder);
 }
 
-static gboolean
-pk_engine_is_package_history_interesing (PkPackage *package)
+/* the history of each package is read in turn, off the main thread */
+typedef struct {
+	PkEngine		*engine;
+	GDBusMethodInvocation	*invocation;
+	GPtrArray		*names;		/* unique package names */
+	guint			 max_size;
+	guint			 idx;
+	GVariantBuilder		 builder;
+} PkEngineHistoryHelper;
+
+static void
+pk_engine_history_helper_free (PkEngineHistoryHelper *helper)
 {
-	gboolean ret;
+	g_object_unref (helper->engine);
+	g_object_unref (helper->invocation);
+	g_ptr_array_unref (helper->names);
+	g_variant_builder_clear (&helper->builder);
+	g_free (helper);
+}
 
-	switch (pk_package_get_info (package)) {
-	case PK_INFO_ENUM_INSTALLING:
-	case PK_INFO_ENUM_REMOVING:
-	case PK_INFO_ENUM_UPDATING:
-		ret = TRUE;
-		break;
-	default:
-		ret = FALSE;
-		break;
+static void pk_engine_get_package_history_next (PkEngineHistoryHelper *helper);
+
+static void
+pk_engine_get_package_history_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	PkEngineHistoryHelper *helper = (PkEngineHistoryHelper *) user_data;
+	const gchar *name = g_ptr_array_index (helper->names, helper->idx);
+	GVariantBuilder builder_pkg;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+
+	array = pk_transaction_db_get_package_history_finish (PK_TRANSACTION_DB (source), res, &error);
+	if (array == NULL) {
+		g_dbus_method_invocation_return_error (helper->invocation,
+						       PK_ENGINE_ERROR,
+						       PK_ENGINE_ERROR_NOT_SUPPORTED,
+						       "history for package name %s failed: %s",
+						       name, error->message);
+		pk_engine_history_helper_free (helper);
+		return;
 	}
-	return ret;
+	if (array->len > 0) {
+		g_variant_builder_init (&builder_pkg, G_VARIANT_TYPE ("aa{sv}"));
+		for (guint j = 0; j < array->len; j++) {
+			GVariant *value;
+			value = pk_engine_get_package_history_pkg (g_ptr_array_index (array, j));
+			if (value != NULL)
+				g_variant_builder_add_value (&builder_pkg, value);
+		}
+		g_variant_builder_add (&helper->builder, "{saa{sv}}", name, &builder_pkg);
+	}
+	helper->idx++;
+	pk_engine_get_package_history_next (helper);
 }
 
-static GVariant *
+static void
+pk_engine_get_package_history_next (PkEngineHistoryHelper *helper)
+{
+	GVariant *value;
+
+	if (helper->idx < helper->names->len) {
+		pk_transaction_db_get_package_history_async (helper->engine->transaction_db,
+							     g_ptr_array_index (helper->names, helper->idx),
+							     helper->max_size,
+							     NULL,
+							     pk_engine_get_package_history_cb,
+							     helper);
+		return;
+	}
+	value = g_variant_builder_end (&helper->builder);
+	g_dbus_method_invocation_return_value (helper->invocation,
+					       g_variant_new_tuple (&value, 1));
+	pk_engine_history_helper_free (helper);
+}
+
+static void
 pk_engine_get_package_history (PkEngine *engine,
 			       gchar **package_names,
 			       guint max_size,
-			       GError **error)
+			       GDBusMethodInvocation *invocation)
 {
-	const gchar *data;
-	const gchar *pkgname;
-	gboolean ret;
-	gchar *key;
-	gint64 timestamp;
-	GList *l;
-	GList *list;
-	GPtrArray *array = NULL;
-	guint i;
-	GVariantBuilder builder;
-	GVariant *value = NULL;
-	PkTransactionPast *item;
-	g_autoptr(GHashTable) deduplicate_hash = NULL;
+	PkEngineHistoryHelper *helper;
 	g_autoptr(GHashTable) pkgname_hash = NULL;
-	g_autoptr(GList) keys = NULL;
-	g_autoptr(PkPackage) package_tmp = NULL;
-
-	list = pk_transaction_db_get_list (engine->transaction_db, max_size);
-
-	/* simplify the loop */
-	if (max_size == 0)
-		max_size = G_MAXUINT;
-
-	pkgname_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
-	deduplicate_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-	package_tmp = pk_package_new ();
-	for (l = list; l != NULL; l = l->next) {
-		g_auto(GStrv) package_lines = NULL;
-		item = PK_TRANSACTION_PAST (l->data);
-
-		/* ignore anything that failed */
-		if (!pk_transaction_past_get_succeeded (item))
-			continue;
-
-		/* split up data */
-		data = pk_transaction_past_get_data (item);
-		if (data == NULL)
-			continue;
-		package_lines = g_strsplit (data, "\n", -1);
-		for (i = 0; package_lines[i] != NULL; i++) {
-			g_autoptr(GError) error_local = NULL;
-			ret = pk_package_parse (package_tmp,
-						package_lines[i],
-						&error_local);
-			if (!ret) {
-				g_warning ("Failed to parse package: '%s': %s",
-					   package_lines[i], error_local->message);
-				continue;
-			}
-
-			/* not the package we care about */
-			if (!pk_engine_package_name_in_strv (package_names, package_tmp))
-				continue;
-
-			/* not a state we care about */
-			if (!pk_engine_is_package_history_interesing (package_tmp))
-				continue;
-
-			/* transactions without a timestamp are not interesting */
-			timestamp = pk_transaction_past_get_timestamp (item);
-			if (timestamp == 0)
-				continue;
-
-			/* de-duplicate the entry, in the case of multiarch */
-			key = g_strdup_printf ("%s-%" G_GINT64_FORMAT,
-					       pk_package_get_name (package_tmp),
-					       timestamp);
-			if (g_hash_table_lookup (deduplicate_hash, key) != NULL) {
-				g_free (key);
-				continue;
-			}
-			g_hash_table_insert (deduplicate_hash, key, package_lines[i]);
-
-			/* get the blob for this data item */
-			value = pk_engine_get_package_history_pkg (item, package_tmp);
-			if (value == NULL)
-				continue;
-
-			/* find the array */
-			pkgname = pk_package_get_name (package_tmp);
-			array = g_hash_table_lookup (pkgname_hash, pkgname);
-			if (array == NULL) {
-				array = g_ptr_array_new ();
-				g_hash_table_insert (pkgname_hash,
-						     g_strdup (pkgname),
-						     array);
-			}
-			g_ptr_array_add (array, value);
-		}
-	}
 
-	/* no history returns an empty array */
-	if (g_hash_table_size (pkgname_hash) == 0) {
-		value = g_variant_new_array (G_VARIANT_TYPE ("{saa{sv}}"), NULL, 0);
-		goto out;
+	/* the history is indexed by name, so only the results are read */
+	helper = g_new0 (PkEngineHistoryHelper, 1);
+	helper->engine = g_object_ref (engine);
+	helper->invocation = g_object_ref (invocation);
+	helper->names = g_ptr_array_new_with_free_func (g_free);
+	helper->max_size = max_size;
+	g_variant_builder_init (&helper->builder, G_VARIANT_TYPE ("a{saa{sv}}"));
+	pkgname_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	for (guint i = 0; package_names[i] != NULL; i++) {
+		if (g_hash_table_add (pkgname_hash, package_names[i]))
+			g_ptr_array_add (helper->names, g_strdup (package_names[i]));
 	}
-
-	/* we have a hash of pkgname:GPtrArray where the GPtrArray is an array
-	 * of GVariants of type a{sv} */
-	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
-	keys = g_hash_table_get_keys (pkgname_hash);
-	for (l = keys; l != NULL; l = l->next) {
-		pkgname = l->data;
-		array = g_hash_table_lookup (pkgname_hash, pkgname);
-		/* create aa{sv} */
-		value = g_variant_new_array (NULL,
-					     (GVariant * const *) array->pdata,
-					     MIN (array->len, max_size));
-		g_variant_builder_add (&builder, "{s@aa{sv}}", pkgname, value);
-	}
-	value = g_variant_builder_end (&builder);
-out:
-	g_list_free_full (list, (GDestroyNotify) g_object_unref);
-	return value;
+	pk_engine_get_package_history_next (helper);
 }
 
 static void
@@ -1296,7 +1250,6 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 	gboolean ret;
 	guint time_since;
 	GVariant *value = NULL;
-	GVariant *tuple = NULL;
 	PkAuthorizeEnum result_enum;
 	PkEngine *engine = PK_ENGINE (user_data);
 	PkRoleEnum role;
@@ -1339,18 +1292,7 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 							       "history for package name invalid");
 			return;
 		}
-		value = pk_engine_get_package_history (engine, package_names, size, &error);
-		if (value == NULL) {
-			g_dbus_method_invocation_return_error (invocation,
-							       PK_ENGINE_ERROR,
-							       PK_ENGINE_ERROR_NOT_SUPPORTED,
-							       "history for package name %s failed: %s",
-							       package_names[0],
-							       error->message);
-			return;
-		}
-		tuple = g_variant_new_tuple (&value, 1);
-		g_dbus_method_invocation_return_value (invocation, tuple);
+		pk_engine_get_package_history (engine, package_names, size, invocation);
 		return;
 	}
 
@@ -1377,6 +1319,36 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 		return;
 	}
 
+	if (g_strcmp0 (method_name, "StartTransaction") == 0) {
+		g_autofree gchar **hints = NULL;
+		const gchar *role_method = NULL;
+		g_autoptr(GVariant) role_parameters = NULL;
+		PkTransaction *transaction;
+
+		g_variant_get (parameters, "(^a&s&sv)",
+			       &hints, &role_method, &role_parameters);
+		g_debug ("StartTransaction method called: %s", role_method);
+		data = pk_transaction_db_generate_id (engine->transaction_db);
+		g_assert (data != NULL);
+		ret = pk_scheduler_create (engine->scheduler,
+					   data, sender, &error);
+		if (!ret) {
+			g_dbus_method_invocation_return_error (invocation,
+							       PK_ENGINE_ERROR,
+							       PK_ENGINE_ERROR_CANNOT_CHECK_AUTH,
+							       "could not create transaction %s: %s",
+							       data,
+							       error->message);
+			return;
+		}
+
+		/* this returns the object path unless the role fails */
+		transaction = pk_scheduler_get_transaction (engine->scheduler, data);
+		pk_transaction_start (transaction, hints, role_method,
+				      role_parameters, invocation);
+		return;
+	}
+
 	if (g_strcmp0 (method_name, "GetTransactionList") == 0) {
 		g_auto(GStrv) transaction_list = NULL;
 		transaction_list = pk_scheduler_get_array (engine->scheduler);
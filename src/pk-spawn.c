@@ -39,14 +39,16 @@
 #include <fcntl.h>
 
 #include <glib/gi18n.h>
+#include <glib-unix.h>
 
 #include "pk-spawn.h"
 #include "pk-shared.h"
 
 static void     pk_spawn_finalize	(GObject       *object);
 
-#define PK_SPAWN_POLL_DELAY	50 /* ms */
-#define PK_SPAWN_SIGKILL_DELAY	5000 /* ms */
+#define PK_SPAWN_EXIT_POLL_DELAY	10 /* ms */
+#define PK_SPAWN_RECORD_SIZE_MAX	(16 * 1024 * 1024)
+#define PK_SPAWN_SIGKILL_DELAY		5000 /* ms */
 
 struct _PkSpawn
 {
@@ -56,7 +58,9 @@ struct _PkSpawn
 	gint			 stdin_fd;
 	gint			 stdout_fd;
 	gint			 stderr_fd;
-	guint			 poll_id;
+	guint			 stdout_id;
+	guint			 stderr_id;
+	guint			 child_watch_id;
 	guint			 kill_id;
 	gboolean		 finished;
 	gboolean		 background;
@@ -65,15 +69,21 @@ struct _PkSpawn
 	gboolean		 allow_sigkill;
 	PkSpawnExitType		 exit;
 	GString			*stdout_buf;
+	gsize			 stdout_scanned;
+	gboolean		 is_emitting_stdout;
+	gboolean		 is_framed;
+	GPtrArray		*record;
 	GString			*stderr_buf;
 	gchar			*last_argv0;
 	gchar			**last_envp;
+	gchar			*dispatcher_argv0;
 	GKeyFile		*conf;
 };
 
 enum {
 	SIGNAL_EXIT,
 	SIGNAL_STDOUT,
+	SIGNAL_STDOUT_RECORD,
 	SIGNAL_STDERR,
 	SIGNAL_LAST
 };
@@ -89,51 +99,125 @@ static guint signals [SIGNAL_LAST] = { 0 };
 
 G_DEFINE_TYPE (PkSpawn, pk_spawn, G_TYPE_OBJECT)
 
+/* returns FALSE once the other end has been closed */
 static gboolean
 pk_spawn_read_fd_into_buffer (gint fd, GString *string)
 {
-	gint bytes_read;
+	gssize bytes_read;
 	gchar buffer[BUFSIZ];
 
-	/* ITS4: ignore, we manually NULL terminate and GString cannot overflow */
-	while ((bytes_read = read (fd, buffer, BUFSIZ-1)) > 0) {
-		buffer[bytes_read] = '\0';
-		g_string_append (string, buffer);
-	}
+	if (fd < 0)
+		return FALSE;
 
-	return TRUE;
+	/* ITS4: ignore, GString cannot overflow; NUL bytes are kept as they
+	 * separate the fields of framed records, text lines end at the first */
+	while ((bytes_read = read (fd, buffer, sizeof (buffer))) > 0)
+		g_string_append_len (string, buffer, bytes_read);
+	if (bytes_read == 0)
+		return FALSE;
+	if (errno == EAGAIN || errno == EINTR)
+		return TRUE;
+	return FALSE;
+}
+
+/* the helper reads commands and environment updates from stdin, which is
+ * remembered past its exit so it is also used when it is started again */
+static void
+pk_spawn_set_dispatcher (PkSpawn *spawn)
+{
+	if (g_strcmp0 (spawn->dispatcher_argv0, spawn->last_argv0) == 0)
+		return;
+	g_debug ("%s accepts environment updates", spawn->last_argv0);
+	g_free (spawn->dispatcher_argv0);
+	spawn->dispatcher_argv0 = g_strdup (spawn->last_argv0);
+}
+
+/*
+ * pk_spawn_emit_records:
+ *
+ * Once a helper has sent PK_SPAWN_FRAMING_HANDSHAKE it writes records rather
+ * than lines: a 32 bit little endian payload size, then the payload, which
+ * is each field of the record followed by a NUL. The fields are emitted in
+ * place, and the offset of the first incomplete record is returned.
+ **/
+static gsize
+pk_spawn_emit_records (PkSpawn *spawn, GString *string, gsize start)
+{
+	while (string->len - start >= sizeof (guint32)) {
+		guint32 size;
+		gchar *payload;
+		gchar *end;
+
+		memcpy (&size, string->str + start, sizeof (size));
+		size = GUINT32_FROM_LE (size);
+		if (size == 0 || size > PK_SPAWN_RECORD_SIZE_MAX) {
+			g_warning ("invalid record size %u, dropping output", size);
+			return string->len;
+		}
+		if (string->len - start - sizeof (guint32) < size)
+			break;
+		payload = string->str + start + sizeof (guint32);
+		end = payload + size;
+		start += sizeof (guint32) + size;
+		if (end[-1] != '\0') {
+			g_warning ("record is not terminated, ignoring");
+			continue;
+		}
+
+		g_ptr_array_set_size (spawn->record, 0);
+		for (gchar *field = payload; field < end; field += strlen (field) + 1)
+			g_ptr_array_add (spawn->record, field);
+		if (spawn->record->len == 2 &&
+		    strcmp (spawn->record->pdata[0], PK_SPAWN_ENVIRONMENT) == 0 &&
+		    strcmp (spawn->record->pdata[1], PK_SPAWN_ENVIRONMENT_STDIN) == 0) {
+			pk_spawn_set_dispatcher (spawn);
+			continue;
+		}
+		g_ptr_array_add (spawn->record, NULL);
+		g_signal_emit (spawn, signals [SIGNAL_STDOUT_RECORD], 0, spawn->record->pdata);
+	}
+	return start;
 }
 
 static gboolean
 pk_spawn_emit_whole_lines (PkSpawn *spawn, GString *string)
 {
-	guint i;
-	guint size;
-	guint bytes_processed;
-	g_auto(GStrv) lines = NULL;
+	gsize start = 0;
+	gchar *eol;
 
-	/* if nothing then don't emit */
-	if (pk_strzero (string->str))
+	/* a handler reading more output will have it emitted by the loop below */
+	if (spawn->is_emitting_stdout)
 		return FALSE;
 
-	/* split into lines - the last line may be incomplete */
-	lines = g_strsplit (string->str, "\n", 0);
-	if (lines == NULL)
-		return FALSE;
-
-	/* find size */
-	size = g_strv_length (lines);
-
-	bytes_processed = 0;
-	/* we only emit n-1 strings */
-	for (i = 0; i < (size-1); i++) {
-		g_signal_emit (spawn, signals [SIGNAL_STDOUT], 0, lines[i]);
-		/* ITS4: ignore, g_strsplit always NULL terminates */
-		bytes_processed += strlen (lines[i]) + 1;
+	/* emit each complete line in place, the last line may be incomplete
+	 * and the part of it we have already scanned is not searched again */
+	spawn->is_emitting_stdout = TRUE;
+	while (!spawn->is_framed &&
+	       (eol = memchr (string->str + spawn->stdout_scanned, '\n',
+			      string->len - spawn->stdout_scanned)) != NULL) {
+		*eol = '\0';
+		spawn->stdout_scanned = eol - string->str + 1;
+		if (strcmp (string->str + start, PK_SPAWN_FRAMING_HANDSHAKE) == 0) {
+			g_debug ("helper switched to framed records");
+			spawn->is_framed = TRUE;
+		} else if (strcmp (string->str + start, PK_SPAWN_ENVIRONMENT_HANDSHAKE) == 0) {
+			pk_spawn_set_dispatcher (spawn);
+		} else {
+			g_signal_emit (spawn, signals [SIGNAL_STDOUT], 0, string->str + start);
+		}
+		start = spawn->stdout_scanned;
 	}
+	if (spawn->is_framed)
+		start = pk_spawn_emit_records (spawn, string, start);
+	spawn->is_emitting_stdout = FALSE;
 
-	/* remove the text we've processed */
-	g_string_erase (string, 0, bytes_processed);
+	/* remove the text we've processed, which only moves the partial line */
+	if (start == 0) {
+		spawn->stdout_scanned = string->len;
+		return FALSE;
+	}
+	g_string_erase (string, 0, start);
+	spawn->stdout_scanned = string->len;
 	return TRUE;
 }
 
@@ -155,59 +239,43 @@ pk_spawn_exit_type_enum_to_string (PkSpawnExitType type)
 	return "unknown";
 }
 
-static gboolean
-pk_spawn_check_child (PkSpawn *spawn)
+static void
+pk_spawn_emit_stderr (PkSpawn *spawn)
 {
-	pid_t pid;
-	int status;
-	gint retval;
-	static guint limit_printing = 0;
-
-	/* this shouldn't happen */
-	if (spawn->finished) {
-		g_warning ("finished twice!");
-		spawn->poll_id = 0;
-		return FALSE;
-	}
-
-	pk_spawn_read_fd_into_buffer (spawn->stdout_fd, spawn->stdout_buf);
-	pk_spawn_read_fd_into_buffer (spawn->stderr_fd, spawn->stderr_buf);
-
 	/* emit all lines on standard out in one callback, as it's all probably
 	* related to the error that just happened */
 	if (spawn->stderr_buf->len != 0) {
 		g_signal_emit (spawn, signals [SIGNAL_STDERR], 0, spawn->stderr_buf->str);
 		g_string_set_size (spawn->stderr_buf, 0);
 	}
+}
+
+static void
+pk_spawn_read_output (PkSpawn *spawn)
+{
+	pk_spawn_read_fd_into_buffer (spawn->stdout_fd, spawn->stdout_buf);
+	pk_spawn_read_fd_into_buffer (spawn->stderr_fd, spawn->stderr_buf);
+	pk_spawn_emit_stderr (spawn);
 
 	/* all usual output goes on standard out, only bad libraries bitch to stderr */
 	pk_spawn_emit_whole_lines (spawn, spawn->stdout_buf);
+}
 
-	/* Only print one in twenty times to avoid filling the screen */
-	if (limit_printing++ % 20 == 0)
-		g_debug ("polling child_pid=%ld (1/20)", (long)spawn->child_pid);
+static void
+pk_spawn_remove_sources (PkSpawn *spawn)
+{
+	g_clear_handle_id (&spawn->stdout_id, g_source_remove);
+	g_clear_handle_id (&spawn->stderr_id, g_source_remove);
+	g_clear_handle_id (&spawn->child_watch_id, g_source_remove);
+}
 
-	/* check if the child exited */
-	pid = waitpid (spawn->child_pid, &status, WNOHANG);
-	if (pid == -1) {
-		g_warning ("failed to get the child PID data for %ld", (long)spawn->child_pid);
-		return TRUE;
-	}
-	if (pid == 0) {
-		/* process still exist, but has not changed state */
-		return TRUE;
-	}
-	if (pid != spawn->child_pid) {
-		g_warning ("some other process id was returned: got %ld and wanted %ld",
-			     (long)pid, (long)spawn->child_pid);
-		return TRUE;
-	}
+static void
+pk_spawn_child_exited (PkSpawn *spawn, gint status)
+{
+	gint retval;
 
-	/* disconnect the poll as there will be no more updates */
-	if (spawn->poll_id > 0) {
-		g_source_remove (spawn->poll_id);
-		spawn->poll_id = 0;
-	}
+	/* there will be no more updates */
+	pk_spawn_remove_sources (spawn);
 
 	/* child exited, close resources */
 	close (spawn->stdin_fd);
@@ -231,13 +299,11 @@ pk_spawn_check_child (PkSpawn *spawn)
 			g_warning ("the child process was terminated by signal %i", WTERMSIG (status));
 			spawn->exit = PK_SPAWN_EXIT_TYPE_SIGKILL;
 		}
+	} else if (!WIFEXITED (status)) {
+		g_warning ("the process did not exit, but waitpid() returned!");
+		if (spawn->exit == PK_SPAWN_EXIT_TYPE_UNKNOWN)
+			spawn->exit = PK_SPAWN_EXIT_TYPE_FAILED;
 	} else {
-		/* check we are dead and buried */
-		if (!WIFEXITED (status)) {
-			g_warning ("the process did not exit, but waitpid() returned!");
-			return TRUE;
-		}
-
 		/* get the exit code */
 		retval = WEXITSTATUS (status);
 		if (retval == 0) {
@@ -272,11 +338,105 @@ pk_spawn_check_child (PkSpawn *spawn)
 	/* don't emit if we just closed an invalid dispatcher */
 	g_debug ("emitting exit %s", pk_spawn_exit_type_enum_to_string (spawn->exit));
 	g_signal_emit (spawn, signals [SIGNAL_EXIT], 0, spawn->exit);
+}
+
+/*
+ * pk_spawn_check_child:
+ *
+ * Reaps the child synchronously, which is only used when we have to block
+ * in pk_spawn_exit(). The event sources must have been removed beforehand
+ * so that the child watch does not try to reap it as well.
+ *
+ * Returns: %TRUE if the child is still running
+ **/
+static gboolean
+pk_spawn_check_child (PkSpawn *spawn)
+{
+	pid_t pid;
+	int status;
 
-	spawn->poll_id = 0;
+	/* this shouldn't happen */
+	if (spawn->finished) {
+		g_warning ("finished twice!");
+		return FALSE;
+	}
+
+	pk_spawn_read_output (spawn);
+
+	/* check if the child exited */
+	pid = waitpid (spawn->child_pid, &status, WNOHANG);
+	if (pid == -1) {
+		g_warning ("failed to get the child PID data for %ld", (long)spawn->child_pid);
+		return TRUE;
+	}
+	if (pid == 0) {
+		/* process still exist, but has not changed state */
+		return TRUE;
+	}
+	if (pid != spawn->child_pid) {
+		g_warning ("some other process id was returned: got %ld and wanted %ld",
+			     (long)pid, (long)spawn->child_pid);
+		return TRUE;
+	}
+	pk_spawn_child_exited (spawn, status);
 	return FALSE;
 }
 
+static gboolean
+pk_spawn_stdout_cb (gint fd, GIOCondition condition, gpointer user_data)
+{
+	PkSpawn *spawn = PK_SPAWN (user_data);
+	guint id = spawn->stdout_id;
+	gboolean ret;
+
+	ret = pk_spawn_read_fd_into_buffer (fd, spawn->stdout_buf);
+	pk_spawn_emit_whole_lines (spawn, spawn->stdout_buf);
+
+	/* a handler may have exited this instance and spawned a new one */
+	if (spawn->stdout_id != id)
+		return G_SOURCE_REMOVE;
+	if (!ret) {
+		spawn->stdout_id = 0;
+		return G_SOURCE_REMOVE;
+	}
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+pk_spawn_stderr_cb (gint fd, GIOCondition condition, gpointer user_data)
+{
+	PkSpawn *spawn = PK_SPAWN (user_data);
+	guint id = spawn->stderr_id;
+	gboolean ret;
+
+	ret = pk_spawn_read_fd_into_buffer (fd, spawn->stderr_buf);
+	pk_spawn_emit_stderr (spawn);
+
+	/* a handler may have exited this instance and spawned a new one */
+	if (spawn->stderr_id != id)
+		return G_SOURCE_REMOVE;
+	if (!ret) {
+		spawn->stderr_id = 0;
+		return G_SOURCE_REMOVE;
+	}
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+pk_spawn_child_watch_cb (GPid pid, gint status, gpointer user_data)
+{
+	PkSpawn *spawn = PK_SPAWN (user_data);
+
+	/* the source is destroyed when this returns */
+	spawn->child_watch_id = 0;
+
+	/* pick up anything written just before exiting */
+	pk_spawn_read_output (spawn);
+	if (spawn->finished || pid != spawn->child_pid)
+		return;
+	pk_spawn_child_exited (spawn, status);
+}
+
 static gboolean
 pk_spawn_sigkill_cb (PkSpawn *spawn)
 {
@@ -414,6 +574,56 @@ pk_spawn_send_stdin (PkSpawn *spawn, const gchar *command)
 	return TRUE;
 }
 
+/* the locale and proxies are applied when the dispatcher starts, e.g. by
+ * setlocale(), gettext or the package manager reading its configuration, so
+ * a change of any of them needs a new instance */
+static const gchar *pk_spawn_startup_env[] = {
+	"LANG",
+	"http_proxy",
+	"https_proxy",
+	"ftp_proxy",
+	"all_proxy",
+	"no_proxy",
+	"pac",
+	NULL };
+
+/*
+ * pk_spawn_send_environment:
+ *
+ * Replace the environment of a running dispatcher, which is sent on stdin
+ * before the next command rather than starting a new instance for it
+ **/
+static gboolean
+pk_spawn_send_environment (PkSpawn *spawn, gchar **envp)
+{
+	g_autofree gchar *joined = NULL;
+	g_autofree gchar *command = NULL;
+
+	if (g_strcmp0 (spawn->dispatcher_argv0, spawn->last_argv0) != 0)
+		return FALSE;
+	if (envp == NULL)
+		return FALSE;
+	for (guint i = 0; pk_spawn_startup_env[i] != NULL; i++) {
+		if (g_strcmp0 (g_environ_getenv (spawn->last_envp, pk_spawn_startup_env[i]),
+			       g_environ_getenv (envp, pk_spawn_startup_env[i])) != 0) {
+			g_debug ("%s changed", pk_spawn_startup_env[i]);
+			return FALSE;
+		}
+	}
+	for (guint i = 0; envp[i] != NULL; i++) {
+		if (strpbrk (envp[i], "\t\n") != NULL)
+			return FALSE;
+	}
+
+	joined = g_strjoinv ("\t", envp);
+	command = g_strdup_printf (PK_SPAWN_ENVIRONMENT "\t%s", joined);
+	if (!pk_spawn_send_stdin (spawn, command))
+		return FALSE;
+	g_strfreev (spawn->last_envp);
+	spawn->last_envp = g_strdupv (envp);
+	return TRUE;
+}
+
 /**
  * pk_spawn_exit:
  *
@@ -442,14 +652,15 @@ pk_spawn_exit (PkSpawn *spawn)
 		goto out;
 	}
 
-	/* block until the previous script exited */
+	/* block until the previous script exited, reaping the child ourselves */
+	pk_spawn_remove_sources (spawn);
 	do {
 		g_debug ("waiting for exit");
 		/* Usleep rather than g_main_loop_run -- we have to block.
 		 * If we run the loop, other idle events can be processed,
 		 * and this includes sending data to a new instance,
 		 * which of course will fail as the 'old' script is exiting */
-		g_usleep (10*1000); /* 10 ms */
+		g_usleep (PK_SPAWN_EXIT_POLL_DELAY * 1000);
 		ret = pk_spawn_check_child (spawn);
 	} while (ret && count++ < 500);
 
@@ -556,14 +767,16 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 	/* we can reuse the dispatcher if:
 	 *  - it's still running
 	 *  - argv[0] (executable name is the same)
-	 *  - all of envp are the same (proxy and locale settings) */
+	 *  - all of envp are the same (proxy and locale settings), or it
+	 *    accepts the new environment on stdin */
 	if (spawn->stdin_fd != -1) {
 		if (g_strcmp0 (spawn->last_argv0, argv[0]) != 0) {
 			g_debug ("argv did not match, not reusing");
-		} else if (!pk_strvequal (spawn->last_envp, envp)) {
-			g_debug ("envp did not match, not reusing");
 		} else if ((flags & PK_SPAWN_ARGV_FLAGS_NEVER_REUSE) > 0) {
 			g_debug ("not re-using instance due to policy");
+		} else if (!pk_strvequal (spawn->last_envp, envp) &&
+			   !pk_spawn_send_environment (spawn, envp)) {
+			g_debug ("envp did not match, not reusing");
 		} else {
 			/* join with tabs, as spaces could be in file name */
 			g_autofree gchar *command = g_strjoinv ("\t", &argv[1]);
@@ -584,17 +797,16 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 		ret = pk_spawn_exit (spawn);
 		if (!ret) {
 			g_warning ("failed to exit previous instance");
-			/* remove poll, as we can't reply on pk_spawn_check_child() */
-			if (spawn->poll_id != 0) {
-				g_source_remove (spawn->poll_id);
-				spawn->poll_id = 0;
-			}
+			/* remove sources, as we can't rely on pk_spawn_check_child() */
+			pk_spawn_remove_sources (spawn);
 		}
 		spawn->is_changing_dispatcher = FALSE;
 	}
 
-	/* create spawned object for tracking */
+	/* create spawned object for tracking, which writes text until it
+	 * asks for framed records */
 	spawn->finished = FALSE;
+	spawn->is_framed = FALSE;
 	g_debug ("creating new instance of %s", argv[0]);
 	ret = g_spawn_async_with_pipes (NULL, argv, envp,
 				 G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_SEARCH_PATH,
@@ -635,7 +847,7 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 	g_strfreev (spawn->last_envp);
 	spawn->last_envp = g_strdupv (envp);
 
-	/* install an idle handler to check if the child returnd successfully. */
+	/* the readiness callbacks drain the pipes without blocking */
 	rc = fcntl (spawn->stdout_fd, F_SETFL, O_NONBLOCK);
 	if (rc < 0) {
 		ret = FALSE;
@@ -650,18 +862,56 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 	}
 
 	/* sanity check */
-	if (spawn->poll_id != 0) {
-		g_warning ("trying to set timeout when already set");
-		g_source_remove (spawn->poll_id);
+	if (spawn->stdout_id != 0 || spawn->stderr_id != 0 || spawn->child_watch_id != 0) {
+		g_warning ("trying to watch child when already watching");
+		pk_spawn_remove_sources (spawn);
 	}
 
-	/* poll quickly */
-	spawn->poll_id = g_timeout_add (PK_SPAWN_POLL_DELAY, (GSourceFunc) pk_spawn_check_child, spawn);
-	g_source_set_name_by_id (spawn->poll_id, "[PkSpawn] main poll");
+	/* wake up when there is output and when the child exits */
+	spawn->stdout_id = g_unix_fd_add (spawn->stdout_fd, G_IO_IN | G_IO_HUP | G_IO_ERR,
+					  pk_spawn_stdout_cb, spawn);
+	g_source_set_name_by_id (spawn->stdout_id, "[PkSpawn] stdout");
+	spawn->stderr_id = g_unix_fd_add (spawn->stderr_fd, G_IO_IN | G_IO_HUP | G_IO_ERR,
+					  pk_spawn_stderr_cb, spawn);
+	g_source_set_name_by_id (spawn->stderr_id, "[PkSpawn] stderr");
+	spawn->child_watch_id = g_child_watch_add (spawn->child_pid, pk_spawn_child_watch_cb, spawn);
+	g_source_set_name_by_id (spawn->child_watch_id, "[PkSpawn] child watch");
 out:
 	return ret;
 }
 
+/**
+ * pk_spawn_prestart:
+ *
+ * Start the last helper again without a command if it is a dispatcher,
+ * so the next pk_spawn_argv() for it does not have to wait for it to
+ * start. Nothing is done if it is still running.
+ **/
+gboolean
+pk_spawn_prestart (PkSpawn *spawn, GError **error)
+{
+	gchar *argv[] = { NULL, NULL };
+	g_autofree gchar *argv0 = NULL;
+	g_auto(GStrv) envp = NULL;
+
+	g_return_val_if_fail (PK_IS_SPAWN (spawn), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	if (spawn->stdin_fd != -1)
+		return TRUE;
+	if (spawn->last_argv0 == NULL ||
+	    g_strcmp0 (spawn->dispatcher_argv0, spawn->last_argv0) != 0) {
+		g_set_error_literal (error, 1, 0, "last helper is not a dispatcher");
+		return FALSE;
+	}
+
+	/* these are replaced when the new instance is started */
+	argv0 = g_strdup (spawn->last_argv0);
+	envp = g_strdupv (spawn->last_envp);
+	argv[0] = argv0;
+	return pk_spawn_argv (spawn, argv, envp, PK_SPAWN_ARGV_FLAGS_NONE, error);
+}
+
 static void
 pk_spawn_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
 {
@@ -736,7 +986,12 @@ pk_spawn_class_init (PkSpawnClass *klass)
 		g_signal_new ("stdout",
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
 			      0, NULL, NULL, g_cclosure_marshal_VOID__STRING,
-			      G_TYPE_NONE, 1, G_TYPE_STRING);
+			      G_TYPE_NONE, 1, G_TYPE_STRING | G_SIGNAL_TYPE_STATIC_SCOPE);
+	signals [SIGNAL_STDOUT_RECORD] =
+		g_signal_new ("stdout-record",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__BOXED,
+			      G_TYPE_NONE, 1, G_TYPE_STRV | G_SIGNAL_TYPE_STATIC_SCOPE);
 	signals [SIGNAL_STDERR] =
 		g_signal_new ("stderr",
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
@@ -751,7 +1006,9 @@ pk_spawn_init (PkSpawn *spawn)
 	spawn->stdout_fd = -1;
 	spawn->stderr_fd = -1;
 	spawn->stdin_fd = -1;
-	spawn->poll_id = 0;
+	spawn->stdout_id = 0;
+	spawn->stderr_id = 0;
+	spawn->child_watch_id = 0;
 	spawn->kill_id = 0;
 	spawn->finished = FALSE;
 	spawn->is_sending_exit = FALSE;
@@ -764,6 +1021,7 @@ pk_spawn_init (PkSpawn *spawn)
 
 	spawn->stdout_buf = g_string_new ("");
 	spawn->stderr_buf = g_string_new ("");
+	spawn->record = g_ptr_array_new ();
 }
 
 static void
@@ -771,8 +1029,8 @@ pk_spawn_finalize (GObject *object)
 {
 	PkSpawn *spawn = PK_SPAWN (object);
 
-	/* disconnect the poll in case we were cancelled before completion */
-	g_clear_handle_id (&spawn->poll_id, g_source_remove);
+	/* disconnect the watches in case we were cancelled before completion */
+	pk_spawn_remove_sources (spawn);
 
 	/* disconnect the SIGKILL check */
 	g_clear_handle_id (&spawn->kill_id, g_source_remove);
@@ -789,8 +1047,10 @@ pk_spawn_finalize (GObject *object)
 	/* free the buffers */
 	g_string_free (spawn->stdout_buf, TRUE);
 	g_string_free (spawn->stderr_buf, TRUE);
+	g_ptr_array_unref (spawn->record);
 	g_clear_pointer (&spawn->last_argv0, g_free);
 	g_clear_pointer (&spawn->last_envp, g_strfreev);
+	g_clear_pointer (&spawn->dispatcher_argv0, g_free);
 	g_clear_pointer (&spawn->conf, g_key_file_unref);
 
 	G_OBJECT_CLASS (pk_spawn_parent_class)->finalize (object);
@@ -47,6 +47,18 @@ typedef enum {
 	PK_SPAWN_EXIT_TYPE_UNKNOWN
 } PkSpawnExitType;
 
+/* the environment variable offering framed records to helpers, and the
+ * line a helper writes to accept them */
+#define PK_SPAWN_FRAMING_ENV		"PK_SPAWN_FRAMING"
+#define PK_SPAWN_FRAMING_BINARY		"binary"
+#define PK_SPAWN_FRAMING_HANDSHAKE	"framing\t" PK_SPAWN_FRAMING_BINARY
+
+/* the line or record a dispatcher writes to accept a new environment on
+ * stdin, which is sent as "environment\tKEY=VALUE\t..." before a command */
+#define PK_SPAWN_ENVIRONMENT		"environment"
+#define PK_SPAWN_ENVIRONMENT_STDIN	"stdin"
+#define PK_SPAWN_ENVIRONMENT_HANDSHAKE	PK_SPAWN_ENVIRONMENT "\t" PK_SPAWN_ENVIRONMENT_STDIN
+
 typedef enum {
 	PK_SPAWN_ARGV_FLAGS_NONE,
 	PK_SPAWN_ARGV_FLAGS_NEVER_REUSE,
@@ -61,6 +73,8 @@ gboolean	 pk_spawn_argv				(PkSpawn	*spawn,
 							 PkSpawnArgvFlags flags,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 pk_spawn_prestart			(PkSpawn	*spawn,
+							 GError		**error);
 gboolean	 pk_spawn_is_running			(PkSpawn	*spawn);
 gboolean	 pk_spawn_kill				(PkSpawn	*spawn);
 gboolean	 pk_spawn_exit				(PkSpawn	*spawn);
@@ -48,6 +48,52 @@ static void     pk_transaction_db_finalize	(GObject        *object);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (sqlite3_stmt, sqlite3_finalize);
 
+#define PK_TRANSACTION_DB_HISTORY_INSERT \
+	"INSERT INTO package_history (name, timestamp, info, package_id, tid) " \
+	"VALUES (?1, ?2, ?3, ?4, ?5)"
+
+/* statements of the writer thread, which are prepared once */
+typedef enum {
+	PK_TRANSACTION_DB_STMT_INSERT,
+	PK_TRANSACTION_DB_STMT_UPDATE,
+	PK_TRANSACTION_DB_STMT_LAST_ACTION,
+	PK_TRANSACTION_DB_STMT_JOB_COUNT,
+	PK_TRANSACTION_DB_STMT_PROXY_UPDATE,
+	PK_TRANSACTION_DB_STMT_PROXY_INSERT,
+	PK_TRANSACTION_DB_STMT_EMPTY,
+	PK_TRANSACTION_DB_STMT_HISTORY_TIMESPEC,
+	PK_TRANSACTION_DB_STMT_HISTORY_DELETE,
+	PK_TRANSACTION_DB_STMT_HISTORY_INSERT,
+	PK_TRANSACTION_DB_STMT_HISTORY_EMPTY,
+	PK_TRANSACTION_DB_STMT_HISTORY_SELECT,
+	PK_TRANSACTION_DB_STMT_LAST
+} PkTransactionDbStmt;
+
+static const gchar *pk_transaction_db_stmt_sql[] = {
+	"INSERT INTO transactions (transaction_id, timespec, role, uid, cmdline, data, succeeded, duration) "
+	"VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8)",
+	"UPDATE transactions SET role = COALESCE(?3, role), uid = COALESCE(?4, uid), "
+	"cmdline = COALESCE(?5, cmdline), data = COALESCE(?6, data), "
+	"succeeded = COALESCE(?7, succeeded), duration = COALESCE(?8, duration) "
+	"WHERE transaction_id = ?1",
+	"INSERT OR REPLACE INTO last_action (role, timespec) VALUES (?1, ?2)",
+	"UPDATE config SET value = ?1 WHERE key = 'job_count'",
+	"UPDATE proxy SET proxy_http = ?4, proxy_https = ?5, proxy_ftp = ?6, "
+	"proxy_socks = ?7, no_proxy = ?8, pac = ?9 WHERE uid = ?2 AND session = ?3",
+	"INSERT INTO proxy (created, uid, session, proxy_http, proxy_https, proxy_ftp, "
+	"proxy_socks, no_proxy, pac) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9)",
+	"DELETE FROM transactions",
+	"SELECT timespec FROM transactions WHERE transaction_id = ?1",
+	"DELETE FROM package_history WHERE tid = ?1",
+	PK_TRANSACTION_DB_HISTORY_INSERT,
+	"DELETE FROM package_history",
+	"SELECT h.package_id, h.info, h.timestamp, t.uid "
+	"FROM package_history h JOIN transactions t ON t.transaction_id = h.tid "
+	"WHERE h.name = ?1 AND t.succeeded = 1 "
+	"GROUP BY h.timestamp ORDER BY h.timestamp DESC LIMIT ?2",
+};
+G_STATIC_ASSERT (G_N_ELEMENTS (pk_transaction_db_stmt_sql) == PK_TRANSACTION_DB_STMT_LAST);
+
 struct _PkTransactionDb
 {
 	GObject			 parent;
@@ -55,7 +101,21 @@ struct _PkTransactionDb
 	gboolean		 loaded;
 	sqlite3			*db;
 	guint			 job_count;
-	guint			 database_save_id;
+	GHashTable		*last_action;	/* role text : timespec */
+	GHashTable		*proxies;	/* uid and session : PkTransactionDbProxyItem */
+
+	/* writes are merged on the main thread until it is idle, and then
+	 * written in one SQL transaction by the writer thread, which also
+	 * answers the reads queued after them */
+	GPtrArray		*pending;
+	guint			 submit_id;
+	sqlite3			*writer_db;
+	sqlite3_stmt		*writer_stmts[PK_TRANSACTION_DB_STMT_LAST];
+	GThread			*writer;
+	GMutex			 writer_mutex;
+	GCond			 writer_cond;
+	GQueue			 writes;
+	gboolean		 writer_stop;
 };
 
 G_DEFINE_TYPE (PkTransactionDb, pk_transaction_db, G_TYPE_OBJECT)
@@ -70,6 +130,45 @@ typedef struct {
 	gboolean	set;
 } PkTransactionDbProxyItem;
 
+typedef enum {
+	PK_TRANSACTION_DB_WRITE_TRANSACTION,
+	PK_TRANSACTION_DB_WRITE_LAST_ACTION,
+	PK_TRANSACTION_DB_WRITE_JOB_COUNT,
+	PK_TRANSACTION_DB_WRITE_PROXY,
+	PK_TRANSACTION_DB_WRITE_EMPTY,
+	PK_TRANSACTION_DB_READ_LIST,
+	PK_TRANSACTION_DB_READ_HISTORY,
+	PK_TRANSACTION_DB_READ_PRINT,
+} PkTransactionDbWriteKind;
+
+/* the columns of a transaction that were set */
+typedef enum {
+	PK_TRANSACTION_DB_FIELD_ADD		= 1 << 0,
+	PK_TRANSACTION_DB_FIELD_ROLE		= 1 << 1,
+	PK_TRANSACTION_DB_FIELD_UID		= 1 << 2,
+	PK_TRANSACTION_DB_FIELD_CMDLINE		= 1 << 3,
+	PK_TRANSACTION_DB_FIELD_DATA		= 1 << 4,
+	PK_TRANSACTION_DB_FIELD_FINISHED	= 1 << 5,
+} PkTransactionDbField;
+
+typedef struct {
+	PkTransactionDbWriteKind kind;
+	guint			 fields;
+	gchar			*key;		/* tid, role or uid and session */
+	gchar			*timespec;
+	gchar			*session;
+	const gchar		*role;
+	guint			 uid;
+	gchar			*cmdline;
+	gchar			*data;
+	gboolean		 succeeded;
+	guint			 duration;
+	guint			 job_count;
+	guint			 limit;
+	PkTransactionDbProxyItem *proxy;
+	GTask			*task;		/* of a read */
+} PkTransactionDbWrite;
+
 static gint
 pk_transaction_db_add_transaction_cb (void *data,
 				      gint argc,
@@ -128,44 +227,6 @@ pk_transaction_db_add_transaction_cb (void *data,
 	return 0;
 }
 
-static gboolean
-pk_transaction_db_sql_statement (PkTransactionDb *tdb, const gchar *sql)
-{
-	gchar *error_msg = NULL;
-	gint rc;
-
-	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
-	g_return_val_if_fail (tdb->db != NULL, FALSE);
-
-	rc = sqlite3_exec (tdb->db, sql, NULL, tdb, &error_msg);
-	if (rc != SQLITE_OK) {
-		g_warning ("SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
-		return FALSE;
-	}
-
-	return TRUE;
-}
-
-static gint
-pk_time_action_sqlite_callback (void *data, gint argc, gchar **argv, gchar **col_name)
-{
-	gint i;
-	gchar *col;
-	gchar *value;
-	gchar **timespec = (gchar**) data;
-
-	for (i = 0; i < argc; i++) {
-		col = col_name[i];
-		value = argv[i];
-		if (g_strcmp0 (col, "timespec") == 0)
-			*timespec = g_strdup (value);
-		else
-			g_warning ("%s = %s", col, value);
-	}
-	return 0;
-}
-
 /**
  * pk_transaction_db_iso8601_difference:
  * @isodate: The ISO8601 date to compare
@@ -201,25 +262,13 @@ pk_transaction_db_iso8601_difference (const gchar *isodate)
 guint
 pk_transaction_db_action_time_since (PkTransactionDb *tdb, PkRoleEnum role)
 {
-	gchar *error_msg = NULL;
-	gint rc;
-	const gchar *role_text;
-	g_autofree gchar *statement = NULL;
-	g_autofree gchar *timespec = NULL;
+	const gchar *timespec;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), 0);
 	g_return_val_if_fail (tdb->db != NULL, 0);
 
-	role_text = pk_role_enum_to_string (role);
-
-	statement = g_strdup_printf ("SELECT timespec FROM last_action WHERE role = '%s'", role_text);
-	rc = sqlite3_exec (tdb->db, statement,
-			   pk_time_action_sqlite_callback, &timespec, &error_msg);
-	if (rc != SQLITE_OK) {
-		g_warning ("SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
-		return G_MAXUINT;
-	}
+	/* the table is read when loading and then kept up to date */
+	timespec = g_hash_table_lookup (tdb->last_action, pk_role_enum_to_string (role));
 	if (timespec == NULL)
 		return G_MAXUINT;
 
@@ -227,255 +276,425 @@ pk_transaction_db_action_time_since (PkTransactionDb *tdb, PkRoleEnum role)
 	return pk_transaction_db_iso8601_difference (timespec);
 }
 
-gboolean
-pk_transaction_db_action_time_reset (PkTransactionDb *tdb, PkRoleEnum role)
+/*
+ * pk_transaction_db_write_new:
+ *
+ * Returns the pending write of @kind for @key, merging with one that has
+ * not been handed to the writer thread yet.
+ **/
+static PkTransactionDbWrite *
+pk_transaction_db_write_new (PkTransactionDb *tdb, PkTransactionDbWriteKind kind, const gchar *key)
 {
-	gchar *error_msg = NULL;
-	gint rc;
-	const gchar *role_text;
-	guint since;
-	g_autofree gchar *statement = NULL;
-	g_autofree gchar *timespec = NULL;
+	PkTransactionDbWrite *write;
 
-	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
-	g_return_val_if_fail (tdb->db != NULL, FALSE);
+	for (guint i = 0; i < tdb->pending->len; i++) {
+		write = g_ptr_array_index (tdb->pending, i);
+		if (write->kind == kind && g_strcmp0 (write->key, key) == 0)
+			return write;
+	}
+	write = g_new0 (PkTransactionDbWrite, 1);
+	write->kind = kind;
+	write->key = g_strdup (key);
+	g_ptr_array_add (tdb->pending, write);
+	return write;
+}
 
-	timespec = pk_iso8601_present ();
-	role_text = pk_role_enum_to_string (role);
+static void
+pk_transaction_db_proxy_item_free (PkTransactionDbProxyItem *item);
 
-	/* get the previous entry */
-	since = pk_transaction_db_action_time_since (tdb, role);
-	if (since == G_MAXUINT) {
-		statement = g_strdup_printf ("INSERT INTO last_action (role, timespec) VALUES ('%s', '%s')", role_text, timespec);
-	} else {
-		statement = g_strdup_printf ("UPDATE last_action SET timespec = '%s' WHERE role = '%s'", timespec, role_text);
-	}
+static void
+pk_transaction_db_write_free (PkTransactionDbWrite *write)
+{
+	g_free (write->key);
+	g_free (write->timespec);
+	g_free (write->session);
+	g_free (write->cmdline);
+	g_free (write->data);
+	pk_transaction_db_proxy_item_free (write->proxy);
+	g_clear_object (&write->task);
+	g_free (write);
+}
 
-	/* update or insert the entry */
-	rc = sqlite3_exec (tdb->db, statement, NULL, NULL, &error_msg);
-	if (rc != SQLITE_OK) {
-		g_warning ("SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
-		return FALSE;
+static void
+pk_transaction_db_submit (PkTransactionDb *tdb)
+{
+	g_clear_handle_id (&tdb->submit_id, g_source_remove);
+	if (tdb->pending->len == 0)
+		return;
+
+	/* not loaded! */
+	if (tdb->writer == NULL) {
+		g_warning ("PkTransactionDb not loaded, dropping %u writes", tdb->pending->len);
+		g_ptr_array_set_size (tdb->pending, 0);
+		return;
 	}
-	return TRUE;
+
+	/* the writes are now owned by the writer thread */
+	g_mutex_lock (&tdb->writer_mutex);
+	for (guint i = 0; i < tdb->pending->len; i++)
+		g_queue_push_tail (&tdb->writes, g_ptr_array_index (tdb->pending, i));
+	g_cond_broadcast (&tdb->writer_cond);
+	g_mutex_unlock (&tdb->writer_mutex);
+	g_free (g_ptr_array_steal (tdb->pending, NULL));
 }
 
-GList *
-pk_transaction_db_get_list (PkTransactionDb *tdb, guint limit)
+static gboolean
+pk_transaction_db_submit_cb (gpointer user_data)
 {
-	gchar *error_msg = NULL;
-	gint rc;
-	GList *list = NULL;
-	g_autofree gchar *statement = NULL;
+	PkTransactionDb *tdb = PK_TRANSACTION_DB (user_data);
+	tdb->submit_id = 0;
+	pk_transaction_db_submit (tdb);
+	return G_SOURCE_REMOVE;
+}
 
-	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), NULL);
+/* everything set while handling one request is merged before writing */
+static void
+pk_transaction_db_schedule (PkTransactionDb *tdb)
+{
+	if (tdb->submit_id != 0)
+		return;
+	tdb->submit_id = g_idle_add_full (G_PRIORITY_LOW, pk_transaction_db_submit_cb, tdb, NULL);
+	g_source_set_name_by_id (tdb->submit_id, "[PkTransactionDb] submit");
+}
 
-	if (limit == 0) {
-		statement = g_strdup ("SELECT transaction_id, timespec, succeeded, duration, role, data, uid, cmdline "
-				      "FROM transactions ORDER BY timespec DESC");
-	} else {
-		statement = g_strdup_printf ("SELECT transaction_id, timespec, succeeded, duration, role, data, uid, cmdline "
-					     "FROM transactions ORDER BY timespec DESC LIMIT %i", limit);
-	}
-	rc = sqlite3_exec (tdb->db,
-			   statement,
-			   pk_transaction_db_add_transaction_cb,
-			   &list,
-			   &error_msg);
-	if (rc != SQLITE_OK) {
-		g_warning ("SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
-		goto out;
-	}
-out:
-	return list;
+/*
+ * pk_transaction_db_read:
+ *
+ * Queues a read of @kind behind everything that was set, so that it sees
+ * all of it, and hands it to the writer thread right away. The answer is
+ * returned through @task, or an empty one if the database is not loaded.
+ **/
+static PkTransactionDbWrite *
+pk_transaction_db_read (PkTransactionDb *tdb, PkTransactionDbWriteKind kind, GTask *task)
+{
+	PkTransactionDbWrite *write = g_new0 (PkTransactionDbWrite, 1);
+	write->kind = kind;
+	if (task != NULL)
+		write->task = g_object_ref (task);
+	g_ptr_array_add (tdb->pending, write);
+	return write;
 }
 
-static gboolean
-pk_transaction_db_prepare (PkTransactionDb *tdb, const gchar *sql, sqlite3_stmt **statement)
+/*
+ * pk_transaction_db_add_package_history:
+ *
+ * Adds the packages that were changed according to the @data of a
+ * transaction to package_history, using the prepared @insert statement.
+ * The lines of @data are "info\tpackage_id\tsummary".
+ **/
+static void
+pk_transaction_db_add_package_history (sqlite3 *db,
+				       sqlite3_stmt *insert,
+				       const gchar *tid,
+				       const gchar *timespec,
+				       const gchar *data)
 {
-	gint rc = 0;
-	*statement = NULL;
+	gint64 timestamp = 0;
+	g_autoptr(GDateTime) datetime = NULL;
+
+	/* transactions without a timestamp are not interesting */
+	if (timespec != NULL)
+		datetime = pk_iso8601_to_datetime (timespec);
+	if (datetime != NULL)
+		timestamp = g_date_time_to_unix (datetime);
+	if (timestamp == 0)
+		return;
 
-	if ((rc = sqlite3_prepare_v2 (tdb->db,
-				      sql,
-				      -1,
-				      statement,
-				      NULL) != SQLITE_OK)) {
-		g_warning ("(%s) prepare error: %d: %s", sql, rc, sqlite3_errmsg (tdb->db));
-		return FALSE;
-	}
+	for (const gchar *line = data; line != NULL && *line != '\0';) {
+		const gchar *line_end = strchr (line, '\n');
+		const gchar *package_id;
+		const gchar *package_id_end;
+		const gchar *name_end;
+		PkInfoEnum info;
+		g_autofree gchar *info_text = NULL;
+
+		if (line_end == NULL)
+			line_end = line + strlen (line);
+		package_id = memchr (line, '\t', line_end - line);
+		if (package_id == NULL)
+			goto next;
+		info_text = g_strndup (line, package_id - line);
+		package_id++;
+		package_id_end = memchr (package_id, '\t', line_end - package_id);
+		if (package_id_end == NULL)
+			package_id_end = line_end;
+		name_end = memchr (package_id, ';', package_id_end - package_id);
+		if (name_end == NULL || name_end == package_id) {
+			g_warning ("Failed to parse package: '%.*s'",
+				   (gint) (line_end - line), line);
+			goto next;
+		}
 
-	return TRUE;
+		/* only the packages that were changed are recorded */
+		info = pk_info_enum_from_string (info_text);
+		if (info != PK_INFO_ENUM_INSTALLING &&
+		    info != PK_INFO_ENUM_REMOVING &&
+		    info != PK_INFO_ENUM_UPDATING)
+			goto next;
+
+		sqlite3_reset (insert);
+		sqlite3_bind_text (insert, 1, package_id, name_end - package_id, SQLITE_STATIC);
+		sqlite3_bind_int64 (insert, 2, timestamp);
+		sqlite3_bind_int (insert, 3, info);
+		sqlite3_bind_text (insert, 4, package_id, package_id_end - package_id, SQLITE_STATIC);
+		sqlite3_bind_text (insert, 5, tid, -1, SQLITE_STATIC);
+		if (sqlite3_step (insert) != SQLITE_DONE)
+			g_warning ("failed to add package history: %s", sqlite3_errmsg (db));
+next:
+		line = *line_end == '\n' ? line_end + 1 : line_end;
+	}
 }
 
-static gboolean
-pk_transaction_db_step (sqlite3 *db, sqlite3_stmt *statement)
+void
+pk_transaction_db_history_item_free (PkTransactionDbHistoryItem *item)
 {
-	gint rc = 0;
+	if (item == NULL)
+		return;
+	g_free (item->package_id);
+	g_free (item);
+}
 
-	rc = sqlite3_step (statement);
+static void
+pk_transaction_db_list_free (GList *list)
+{
+	g_list_free_full (list, (GDestroyNotify) g_object_unref);
+}
 
-	if (rc != SQLITE_OK && rc != SQLITE_DONE) {
-		g_warning ("SQL error: %d: %s", rc, sqlite3_errmsg (db));
-		return FALSE;
+/**
+ * pk_transaction_db_get_package_history_async:
+ * @tdb: the #PkTransactionDb instance
+ * @name: the package name
+ * @limit: the maximum number of entries, or 0 for all
+ *
+ * Gets the changes of a package by transactions that succeeded, newest
+ * first. Changes with the same timestamp, e.g. of several architectures,
+ * are only returned once. The query runs on the writer thread, after
+ * everything that was set before.
+ **/
+void
+pk_transaction_db_get_package_history_async (PkTransactionDb *tdb,
+					     const gchar *name,
+					     guint limit,
+					     GCancellable *cancellable,
+					     GAsyncReadyCallback callback,
+					     gpointer user_data)
+{
+	PkTransactionDbWrite *write;
+	g_autoptr(GTask) task = NULL;
+
+	g_return_if_fail (PK_IS_TRANSACTION_DB (tdb));
+	g_return_if_fail (name != NULL);
+
+	task = g_task_new (tdb, cancellable, callback, user_data);
+	g_task_set_source_tag (task, pk_transaction_db_get_package_history_async);
+	if (tdb->writer == NULL) {
+		g_task_return_pointer (task,
+				       g_ptr_array_new_with_free_func ((GDestroyNotify) pk_transaction_db_history_item_free),
+				       (GDestroyNotify) g_ptr_array_unref);
+		return;
 	}
+	write = pk_transaction_db_read (tdb, PK_TRANSACTION_DB_READ_HISTORY, task);
+	write->key = g_strdup (name);
+	write->limit = limit;
+	pk_transaction_db_submit (tdb);
+}
 
-	return TRUE;
+/**
+ * pk_transaction_db_get_package_history_finish:
+ *
+ * Return value: (element-type PkTransactionDbHistoryItem): the changes
+ **/
+GPtrArray *
+pk_transaction_db_get_package_history_finish (PkTransactionDb *tdb,
+					      GAsyncResult *res,
+					      GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, tdb), NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
 }
 
-static gboolean
-pk_transaction_db_set_strings (PkTransactionDb *tdb, const gchar *sql, const gchar *first, const gchar *second)
+gboolean
+pk_transaction_db_action_time_reset (PkTransactionDb *tdb, PkRoleEnum role)
 {
-	g_autoptr (sqlite3_stmt) statement = NULL;
-	gint rc = 0;
+	PkTransactionDbWrite *write;
+	const gchar *role_text;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 	g_return_val_if_fail (tdb->db != NULL, FALSE);
-	g_return_val_if_fail (sql != NULL, FALSE);
-	g_return_val_if_fail (first != NULL, FALSE);
-	g_return_val_if_fail (second != NULL, FALSE);
 
-	if (!pk_transaction_db_prepare (tdb, sql, &statement))
-		return FALSE;
+	role_text = pk_role_enum_to_string (role);
+	write = pk_transaction_db_write_new (tdb, PK_TRANSACTION_DB_WRITE_LAST_ACTION, role_text);
+	g_free (write->timespec);
+	write->timespec = pk_iso8601_present ();
+	g_hash_table_insert (tdb->last_action, g_strdup (role_text), g_strdup (write->timespec));
+	pk_transaction_db_schedule (tdb);
+	return TRUE;
+}
 
-	if ((rc = sqlite3_bind_text (statement, 1, first, -1, SQLITE_STATIC)) != SQLITE_OK) {
-		g_warning ("bind text1 error: %d: %s", rc, sqlite3_errmsg (tdb->db));
-		return FALSE;
-	}
+/**
+ * pk_transaction_db_get_list_async:
+ * @tdb: the #PkTransactionDb instance
+ * @limit: the maximum number of transactions, or 0 for all
+ *
+ * Gets the transactions, newest first. The query runs on the writer
+ * thread, after everything that was set before.
+ **/
+void
+pk_transaction_db_get_list_async (PkTransactionDb *tdb,
+				  guint limit,
+				  GCancellable *cancellable,
+				  GAsyncReadyCallback callback,
+				  gpointer user_data)
+{
+	PkTransactionDbWrite *write;
+	g_autoptr(GTask) task = NULL;
 
-	if ((rc = sqlite3_bind_text (statement, 2, second, -1, SQLITE_STATIC)) != SQLITE_OK) {
-		g_warning ("bind text2 error: %d: %s", rc, sqlite3_errmsg (tdb->db));
-		return FALSE;
+	g_return_if_fail (PK_IS_TRANSACTION_DB (tdb));
+
+	task = g_task_new (tdb, cancellable, callback, user_data);
+	g_task_set_source_tag (task, pk_transaction_db_get_list_async);
+	if (tdb->writer == NULL) {
+		g_task_return_pointer (task, NULL, NULL);
+		return;
 	}
+	write = pk_transaction_db_read (tdb, PK_TRANSACTION_DB_READ_LIST, task);
+	write->limit = limit;
+	pk_transaction_db_submit (tdb);
+}
 
-	return pk_transaction_db_step (tdb->db, statement);
+/**
+ * pk_transaction_db_get_list_finish:
+ *
+ * Return value: (element-type PkTransactionPast) (transfer full): the transactions
+ **/
+GList *
+pk_transaction_db_get_list_finish (PkTransactionDb *tdb,
+				   GAsyncResult *res,
+				   GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, tdb), NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static PkTransactionDbWrite *
+pk_transaction_db_write_transaction (PkTransactionDb *tdb, const gchar *tid, PkTransactionDbField field)
+{
+	PkTransactionDbWrite *write;
+	write = pk_transaction_db_write_new (tdb, PK_TRANSACTION_DB_WRITE_TRANSACTION, tid);
+	write->fields |= field;
+	pk_transaction_db_schedule (tdb);
+	return write;
 }
 
 gboolean
 pk_transaction_db_add (PkTransactionDb *tdb, const gchar *tid)
 {
-	g_autofree gchar *timespec = NULL;
-	timespec = pk_iso8601_present ();
+	PkTransactionDbWrite *write;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (tid != NULL, FALSE);
 
-	return pk_transaction_db_set_strings (tdb,
-					      "INSERT INTO transactions (transaction_id, timespec) VALUES (?1, ?2)",
-					      tid,
-					      timespec);
+	write = pk_transaction_db_write_transaction (tdb, tid, PK_TRANSACTION_DB_FIELD_ADD);
+	g_free (write->timespec);
+	write->timespec = pk_iso8601_present ();
+	return TRUE;
 }
 
 gboolean
 pk_transaction_db_set_role (PkTransactionDb *tdb, const gchar *tid, PkRoleEnum role)
 {
-	const gchar *role_text;
-	role_text = pk_role_enum_to_string (role);
+	PkTransactionDbWrite *write;
 
-	return pk_transaction_db_set_strings (tdb,
-					      "UPDATE transactions SET role=?1 WHERE transaction_id=?2",
-					      role_text,
-					      tid);
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (tid != NULL, FALSE);
+
+	write = pk_transaction_db_write_transaction (tdb, tid, PK_TRANSACTION_DB_FIELD_ROLE);
+	write->role = pk_role_enum_to_string (role);
+	return TRUE;
 }
 
 gboolean
 pk_transaction_db_set_uid (PkTransactionDb *tdb, const gchar *tid, guint uid)
 {
-	g_autoptr (sqlite3_stmt) statement = NULL;
-	gint rc = 0;
+	PkTransactionDbWrite *write;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
-	g_return_val_if_fail (tdb->db != NULL, FALSE);
 	g_return_val_if_fail (tid != NULL, FALSE);
 
-	if (!pk_transaction_db_prepare (tdb, "UPDATE transactions SET uid=?1 WHERE transaction_id=?2", &statement))
-		return FALSE;
-
-	if ((rc = sqlite3_bind_int (statement, 1, uid)) != SQLITE_OK) {
-		g_warning ("bind int error: %d: %s", rc, sqlite3_errmsg (tdb->db));
-		return FALSE;
-	}
-
-	if ((rc = sqlite3_bind_text (statement, 2, tid, -1, SQLITE_STATIC)) != SQLITE_OK) {
-		g_warning ("bind text error: %d: %s", rc, sqlite3_errmsg (tdb->db));
-		return FALSE;
-	}
-
-	return pk_transaction_db_step (tdb->db, statement);
+	write = pk_transaction_db_write_transaction (tdb, tid, PK_TRANSACTION_DB_FIELD_UID);
+	write->uid = uid;
+	return TRUE;
 }
 
 gboolean
 pk_transaction_db_set_cmdline (PkTransactionDb *tdb, const gchar *tid, const gchar *cmdline)
 {
-	return pk_transaction_db_set_strings (tdb,
-					      "UPDATE transactions SET cmdline=?1 WHERE transaction_id=?2",
-					      cmdline,
-					      tid);
+	PkTransactionDbWrite *write;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (tid != NULL, FALSE);
+	g_return_val_if_fail (cmdline != NULL, FALSE);
+
+	write = pk_transaction_db_write_transaction (tdb, tid, PK_TRANSACTION_DB_FIELD_CMDLINE);
+	g_free (write->cmdline);
+	write->cmdline = g_strdup (cmdline);
+	return TRUE;
 }
 
 gboolean
 pk_transaction_db_set_data (PkTransactionDb *tdb, const gchar *tid, const gchar *data)
 {
-	return pk_transaction_db_set_strings (tdb,
-					      "UPDATE transactions SET data=?1 WHERE transaction_id=?2",
-					      data,
-					      tid);
+	PkTransactionDbWrite *write;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (tid != NULL, FALSE);
+	g_return_val_if_fail (data != NULL, FALSE);
+
+	write = pk_transaction_db_write_transaction (tdb, tid, PK_TRANSACTION_DB_FIELD_DATA);
+	g_free (write->data);
+	write->data = g_strdup (data);
+	return TRUE;
 }
 
 gboolean
 pk_transaction_db_set_finished (PkTransactionDb *tdb, const gchar *tid, gboolean success, guint runtime)
 {
-	g_autoptr (sqlite3_stmt) statement = NULL;
-	gint rc = 0;
+	PkTransactionDbWrite *write;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
-	g_return_val_if_fail (tdb->db != NULL, FALSE);
 	g_return_val_if_fail (tid != NULL, FALSE);
 
-	if (!pk_transaction_db_prepare (tdb, "UPDATE transactions SET succeeded=?1, duration=?2 WHERE transaction_id=?3",
-					&statement))
-		return FALSE;
-
-	if ((rc = sqlite3_bind_int (statement, 1, success)) != SQLITE_OK) {
-		g_warning ("bind int1 error: %d: %s", rc, sqlite3_errmsg (tdb->db));
-		return FALSE;
-	}
-
-	if ((rc = sqlite3_bind_int (statement, 2, runtime)) != SQLITE_OK) {
-		g_warning ("bind int2 error: %d: %s", rc, sqlite3_errmsg (tdb->db));
-		return FALSE;
-	}
-
-	if ((rc = sqlite3_bind_text (statement, 3, tid, -1, SQLITE_STATIC)) != SQLITE_OK) {
-		g_warning ("bind text error: %d: %s", rc, sqlite3_errmsg (tdb->db));
-		return FALSE;
-	}
-
-	return pk_transaction_db_step (tdb->db, statement);
+	write = pk_transaction_db_write_transaction (tdb, tid, PK_TRANSACTION_DB_FIELD_FINISHED);
+	write->succeeded = success;
+	write->duration = runtime;
+	return TRUE;
 }
 
 gboolean
 pk_transaction_db_print (PkTransactionDb *tdb)
 {
-	const gchar *statement;
-
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 
-	statement = "SELECT transaction_id, timespec, succeeded, duration, role FROM transactions";
-	pk_transaction_db_sql_statement (tdb, statement);
-
+	/* logged by the writer thread once everything before is written */
+	pk_transaction_db_read (tdb, PK_TRANSACTION_DB_READ_PRINT, NULL);
+	pk_transaction_db_submit (tdb);
 	return TRUE;
 }
 
 gboolean
 pk_transaction_db_empty (PkTransactionDb *tdb)
 {
-	const gchar *statement;
-
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 	g_return_val_if_fail (tdb->db != NULL, FALSE);
 
-	statement = "TRUNCATE TABLE transactions;";
-	sqlite3_exec (tdb->db, statement, NULL, NULL, NULL);
+	/* anything still pending for a transaction is moot */
+	for (guint i = 0; i < tdb->pending->len; i++) {
+		PkTransactionDbWrite *write = g_ptr_array_index (tdb->pending, i);
+		if (write->kind == PK_TRANSACTION_DB_WRITE_TRANSACTION)
+			g_ptr_array_remove_index (tdb->pending, i--);
+	}
+	pk_transaction_db_write_new (tdb, PK_TRANSACTION_DB_WRITE_EMPTY, NULL);
+	pk_transaction_db_schedule (tdb);
 	return TRUE;
 }
 
@@ -512,42 +731,10 @@ pk_transaction_db_get_random_hex_string (guint length)
 	return string;
 }
 
-static gboolean
-pk_transaction_db_defer_write_job_count_cb (PkTransactionDb *tdb)
-{
-	gchar *error_msg = NULL;
-	gint rc;
-	g_autofree gchar *statement = NULL;
-
-	/* not loaded! */
-	if (tdb->db == NULL) {
-		g_warning ("PkTransactionDb not loaded");
-		goto out;
-	}
-
-	/* force fsync as we don't want to repeat this number */
-	sqlite3_exec (tdb->db, "PRAGMA synchronous=ON", NULL, NULL, NULL);
-
-	/* save the job count */
-	statement = g_strdup_printf ("UPDATE config SET value = '%i' WHERE key = 'job_count'",
-				     tdb->job_count);
-	rc = sqlite3_exec (tdb->db, statement, NULL, NULL, &error_msg);
-	if (rc != SQLITE_OK) {
-		g_warning ("failed to set job id: %s", error_msg);
-		sqlite3_free (error_msg);
-		goto out;
-	}
-
-	/* turn off fsync */
-	sqlite3_exec (tdb->db, "PRAGMA synchronous=OFF", NULL, NULL, NULL);
-out:
-	tdb->database_save_id = 0;
-	return FALSE;
-}
-
 gchar *
 pk_transaction_db_generate_id (PkTransactionDb *tdb)
 {
+	PkTransactionDbWrite *write;
 	gchar *tid = NULL;
 	g_autofree gchar *rand_str = NULL;
 
@@ -557,12 +744,9 @@ pk_transaction_db_generate_id (PkTransactionDb *tdb)
 
 	/* we don't need to wait for the database write, just do this the
 	 * next time we are idle (but ensure we do this on shutdown) */
-	if (tdb->database_save_id == 0) {
-		tdb->database_save_id =
-			g_idle_add_full (G_PRIORITY_LOW, (GSourceFunc)
-					 pk_transaction_db_defer_write_job_count_cb, tdb, NULL);
-		g_source_set_name_by_id (tdb->database_save_id, "[PkTransactionDb] save");
-	}
+	write = pk_transaction_db_write_new (tdb, PK_TRANSACTION_DB_WRITE_JOB_COUNT, NULL);
+	write->job_count = tdb->job_count;
+	pk_transaction_db_schedule (tdb);
 
 	/* make the tid */
 	rand_str = pk_transaction_db_get_random_hex_string (8);
@@ -570,40 +754,6 @@ pk_transaction_db_generate_id (PkTransactionDb *tdb)
 	return tid;
 }
 
-static gint
-pk_transaction_sqlite_proxy_cb (void *data, gint argc, gchar **argv, gchar **col_name)
-{
-	PkTransactionDbProxyItem *item = (PkTransactionDbProxyItem *) data;
-	gint i;
-
-	g_return_val_if_fail (item != NULL, 0);
-
-	for (i = 0; i < argc; i++) {
-		if (g_strcmp0 (col_name[i], "proxy_http") == 0) {
-			item->proxy_http = g_strdup (argv[i]);
-			item->set = TRUE;
-		} else if (g_strcmp0 (col_name[i], "proxy_https") == 0) {
-			item->proxy_https = g_strdup (argv[i]);
-			item->set = TRUE;
-		} else if (g_strcmp0 (col_name[i], "proxy_ftp") == 0) {
-			item->proxy_ftp = g_strdup (argv[i]);
-			item->set = TRUE;
-		} else if (g_strcmp0 (col_name[i], "proxy_socks") == 0) {
-			item->proxy_socks = g_strdup (argv[i]);
-			item->set = TRUE;
-		} else if (g_strcmp0 (col_name[i], "no_proxy") == 0) {
-			item->no_proxy = g_strdup (argv[i]);
-			item->set = TRUE;
-		} else if (g_strcmp0 (col_name[i], "pac") == 0) {
-			item->pac = g_strdup (argv[i]);
-			item->set = TRUE;
-		} else {
-			g_warning ("%s = %s", col_name[i], argv[i]);
-		}
-	}
-	return 0;
-}
-
 static void
 pk_transaction_db_proxy_item_free (PkTransactionDbProxyItem *item)
 {
@@ -618,37 +768,10 @@ pk_transaction_db_proxy_item_free (PkTransactionDbProxyItem *item)
 	g_free (item);
 }
 
-static gboolean
-pk_transaction_db_is_proxy_set (PkTransactionDb *tdb, guint uid, const gchar *session)
+static gchar *
+pk_transaction_db_proxy_key (guint uid, const gchar *session)
 {
-	gchar *error_msg = NULL;
-	gboolean ret = FALSE;
-	gint rc;
-	PkTransactionDbProxyItem *item;
-	g_autofree gchar *statement = NULL;
-
-	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
-	g_return_val_if_fail (uid != G_MAXUINT, FALSE);
-
-	/* get existing data */
-	item = g_new0 (PkTransactionDbProxyItem, 1);
-	statement = g_strdup_printf ("SELECT proxy_http, proxy_https, proxy_ftp, proxy_socks, no_proxy, pac FROM proxy WHERE uid = '%i' AND session = '%s' LIMIT 1",
-				     uid, session);
-	rc = sqlite3_exec (tdb->db, statement,
-			   pk_transaction_sqlite_proxy_cb,
-			   item,
-			   &error_msg);
-	if (rc != SQLITE_OK) {
-		g_warning ("SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
-		goto out;
-	}
-
-	ret = item->set;
-
-out:
-	pk_transaction_db_proxy_item_free (item);
-	return ret;
+	return g_strdup_printf ("%u:%s", uid, session != NULL ? session : "");
 }
 
 /**
@@ -672,35 +795,19 @@ pk_transaction_db_get_proxy (PkTransactionDb *tdb, guint uid, const gchar *sessi
 			     gchar **no_proxy,
 			     gchar **pac)
 {
-	gchar *error_msg = NULL;
-	gboolean ret = FALSE;
-	gint rc;
 	PkTransactionDbProxyItem *item;
-	g_autofree gchar *statement = NULL;
+	g_autofree gchar *key = NULL;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 	g_return_val_if_fail (uid != G_MAXUINT, FALSE);
 
-	/* get existing data */
-	item = g_new0 (PkTransactionDbProxyItem, 1);
-	statement = g_strdup_printf ("SELECT proxy_http, proxy_https, proxy_ftp, proxy_socks, no_proxy, pac FROM proxy WHERE uid = '%i' AND session = '%s' LIMIT 1",
-				     uid, session);
-	rc = sqlite3_exec (tdb->db, statement,
-			   pk_transaction_sqlite_proxy_cb,
-			   item,
-			   &error_msg);
-	if (rc != SQLITE_OK) {
-		g_warning ("SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
-		goto out;
-	}
+	/* the table is read when loading and then kept up to date */
+	key = pk_transaction_db_proxy_key (uid, session);
+	item = g_hash_table_lookup (tdb->proxies, key);
 
-	/* success, even if we got no data */
-	ret = TRUE;
-
-	/* nothing matched */
-	if (!item->set)
-		goto out;
+	/* nothing matched, which is still success */
+	if (item == NULL)
+		return TRUE;
 
 	/* copy data */
 	if (proxy_http != NULL)
@@ -715,10 +822,26 @@ pk_transaction_db_get_proxy (PkTransactionDb *tdb, guint uid, const gchar *sessi
 		*no_proxy = g_strdup (item->no_proxy);
 	if (pac != NULL)
 		*pac = g_strdup (item->pac);
+	return TRUE;
+}
 
-out:
-	pk_transaction_db_proxy_item_free (item);
-	return ret;
+static PkTransactionDbProxyItem *
+pk_transaction_db_proxy_item_new (const gchar *proxy_http,
+				  const gchar *proxy_https,
+				  const gchar *proxy_ftp,
+				  const gchar *proxy_socks,
+				  const gchar *no_proxy,
+				  const gchar *pac)
+{
+	PkTransactionDbProxyItem *item = g_new0 (PkTransactionDbProxyItem, 1);
+	item->proxy_http = g_strdup (proxy_http);
+	item->proxy_https = g_strdup (proxy_https);
+	item->proxy_ftp = g_strdup (proxy_ftp);
+	item->proxy_socks = g_strdup (proxy_socks);
+	item->no_proxy = g_strdup (no_proxy);
+	item->pac = g_strdup (pac);
+	item->set = TRUE;
+	return item;
 }
 
 /**
@@ -743,99 +866,335 @@ pk_transaction_db_set_proxy (PkTransactionDb *tdb, guint uid,
 			     const gchar *no_proxy,
 			     const gchar *pac)
 {
-	gboolean ret = FALSE;
-	gint rc;
-	sqlite3_stmt *statement = NULL;
-	g_autofree gchar *timespec = NULL;
-	g_autofree gchar *proxy_http_tmp = NULL;
+	PkTransactionDbWrite *write;
+	g_autofree gchar *key = NULL;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 	g_return_val_if_fail (uid != G_MAXUINT, FALSE);
 
-	/* check for previous entries */
-	ret = pk_transaction_db_is_proxy_set (tdb, uid, session);
-	if (ret) {
-		g_debug ("updated proxy %s, %s for uid:%i and session:%s",
-			 proxy_http, proxy_ftp, uid, session);
+	g_debug ("set proxy %s, %s for uid:%i and session:%s", proxy_http, proxy_ftp, uid, session);
+	key = pk_transaction_db_proxy_key (uid, session);
+	g_hash_table_insert (tdb->proxies, g_strdup (key),
+			     pk_transaction_db_proxy_item_new (proxy_http, proxy_https,
+							       proxy_ftp, proxy_socks,
+							       no_proxy, pac));
+
+	/* the writer updates the row, or inserts it if there was none */
+	write = pk_transaction_db_write_new (tdb, PK_TRANSACTION_DB_WRITE_PROXY, key);
+	g_free (write->timespec);
+	g_free (write->session);
+	pk_transaction_db_proxy_item_free (write->proxy);
+	write->timespec = pk_iso8601_present ();
+	write->uid = uid;
+	write->session = g_strdup (session);
+	write->proxy = pk_transaction_db_proxy_item_new (proxy_http, proxy_https,
+							 proxy_ftp, proxy_socks,
+							 no_proxy, pac);
+	pk_transaction_db_schedule (tdb);
+	return TRUE;
+}
 
-		/* prepare statement */
-		rc = sqlite3_prepare_v2 (tdb->db,
-					 "UPDATE proxy SET "
-					 "proxy_http = ?, "
-					 "proxy_https = ?, "
-					 "proxy_ftp = ?, "
-					 "proxy_socks = ?, "
-					 "no_proxy = ?, "
-					 "pac = ? "
-					 "WHERE uid = ? AND session = ?",
-					 -1, &statement, NULL);
+/*
+ * pk_transaction_db_writer_stmt:
+ *
+ * Returns the reset statement @stmt of the writer connection, preparing it
+ * the first time it is used.
+ **/
+static sqlite3_stmt *
+pk_transaction_db_writer_stmt (PkTransactionDb *tdb, PkTransactionDbStmt stmt)
+{
+	if (tdb->writer_stmts[stmt] == NULL) {
+		gint rc = sqlite3_prepare_v2 (tdb->writer_db,
+					      pk_transaction_db_stmt_sql[stmt], -1,
+					      &tdb->writer_stmts[stmt], NULL);
 		if (rc != SQLITE_OK) {
-			g_warning ("failed to prepare statement: %s", sqlite3_errmsg (tdb->db));
-			goto out;
+			g_warning ("failed to prepare statement: %s", sqlite3_errmsg (tdb->writer_db));
+			return NULL;
 		}
+	} else {
+		sqlite3_reset (tdb->writer_stmts[stmt]);
+		sqlite3_clear_bindings (tdb->writer_stmts[stmt]);
+	}
+	return tdb->writer_stmts[stmt];
+}
+
+static void
+pk_transaction_db_writer_step (PkTransactionDb *tdb, sqlite3_stmt *statement)
+{
+	if (sqlite3_step (statement) != SQLITE_DONE)
+		g_warning ("failed to execute statement: %s", sqlite3_errmsg (tdb->writer_db));
+}
+
+static void
+pk_transaction_db_writer_package_history (PkTransactionDb *tdb, PkTransactionDbWrite *write)
+{
+	sqlite3_stmt *statement;
+	sqlite3_stmt *insert;
+	g_autofree gchar *timespec = g_strdup (write->timespec);
+
+	/* the history uses the time the transaction was added */
+	if (timespec == NULL) {
+		statement = pk_transaction_db_writer_stmt (tdb, PK_TRANSACTION_DB_STMT_HISTORY_TIMESPEC);
+		if (statement == NULL)
+			return;
+		sqlite3_bind_text (statement, 1, write->key, -1, SQLITE_STATIC);
+		if (sqlite3_step (statement) != SQLITE_ROW)
+			return;
+		timespec = g_strdup ((const gchar *) sqlite3_column_text (statement, 0));
+	}
+
+	/* replace what was set before */
+	statement = pk_transaction_db_writer_stmt (tdb, PK_TRANSACTION_DB_STMT_HISTORY_DELETE);
+	if (statement == NULL)
+		return;
+	sqlite3_bind_text (statement, 1, write->key, -1, SQLITE_STATIC);
+	pk_transaction_db_writer_step (tdb, statement);
+
+	insert = pk_transaction_db_writer_stmt (tdb, PK_TRANSACTION_DB_STMT_HISTORY_INSERT);
+	if (insert == NULL)
+		return;
+	pk_transaction_db_add_package_history (tdb->writer_db, insert,
+					       write->key, timespec, write->data);
+}
+
+static void
+pk_transaction_db_writer_transaction (PkTransactionDb *tdb, PkTransactionDbWrite *write)
+{
+	sqlite3_stmt *statement;
+	gboolean add = (write->fields & PK_TRANSACTION_DB_FIELD_ADD) > 0;
+
+	statement = pk_transaction_db_writer_stmt (tdb, add ? PK_TRANSACTION_DB_STMT_INSERT :
+								PK_TRANSACTION_DB_STMT_UPDATE);
+	if (statement == NULL)
+		return;
+
+	/* unset columns are bound to NULL, which the update keeps as they were,
+	 * and which a new transaction stores for an unknown uid rather than
+	 * the column default of 0, i.e. root */
+	sqlite3_bind_text (statement, 1, write->key, -1, SQLITE_STATIC);
+	sqlite3_bind_text (statement, 2, write->timespec, -1, SQLITE_STATIC);
+	if (write->fields & PK_TRANSACTION_DB_FIELD_ROLE)
+		sqlite3_bind_text (statement, 3, write->role, -1, SQLITE_STATIC);
+	if (write->fields & PK_TRANSACTION_DB_FIELD_UID)
+		sqlite3_bind_int (statement, 4, write->uid);
+	if (write->fields & PK_TRANSACTION_DB_FIELD_CMDLINE)
+		sqlite3_bind_text (statement, 5, write->cmdline, -1, SQLITE_STATIC);
+	if (write->fields & PK_TRANSACTION_DB_FIELD_DATA)
+		sqlite3_bind_text (statement, 6, write->data, -1, SQLITE_STATIC);
+	if (write->fields & PK_TRANSACTION_DB_FIELD_FINISHED || add)
+		sqlite3_bind_int (statement, 7, write->succeeded ? 1 : 0);
+	if (write->fields & PK_TRANSACTION_DB_FIELD_FINISHED)
+		sqlite3_bind_int (statement, 8, write->duration);
+	pk_transaction_db_writer_step (tdb, statement);
+
+	if (write->fields & PK_TRANSACTION_DB_FIELD_DATA)
+		pk_transaction_db_writer_package_history (tdb, write);
+}
+
+static void
+pk_transaction_db_writer_proxy (PkTransactionDb *tdb, PkTransactionDbWrite *write)
+{
+	PkTransactionDbStmt stmts[] = { PK_TRANSACTION_DB_STMT_PROXY_UPDATE,
+					PK_TRANSACTION_DB_STMT_PROXY_INSERT };
+
+	for (guint i = 0; i < G_N_ELEMENTS (stmts); i++) {
+		sqlite3_stmt *statement = pk_transaction_db_writer_stmt (tdb, stmts[i]);
+		if (statement == NULL)
+			return;
 
 		/* bind data, so that the freeform proxy text cannot be used to inject SQL */
-		sqlite3_bind_text (statement, 1, proxy_http, -1, SQLITE_STATIC);
-		sqlite3_bind_text (statement, 2, proxy_https, -1, SQLITE_STATIC);
-		sqlite3_bind_text (statement, 3, proxy_ftp, -1, SQLITE_STATIC);
-		sqlite3_bind_text (statement, 4, proxy_socks, -1, SQLITE_STATIC);
-		sqlite3_bind_text (statement, 5, no_proxy, -1, SQLITE_STATIC);
-		sqlite3_bind_text (statement, 6, pac, -1, SQLITE_STATIC);
-		sqlite3_bind_int (statement, 7, uid);
-		sqlite3_bind_text (statement, 8, session, -1, SQLITE_STATIC);
-
-		/* execute statement */
-		rc = sqlite3_step (statement);
-		if (rc != SQLITE_DONE) {
-			g_warning ("failed to execute statement: %s", sqlite3_errmsg (tdb->db));
-			goto out;
-		}
-		goto out;
+		sqlite3_bind_text (statement, 1, write->timespec, -1, SQLITE_STATIC);
+		sqlite3_bind_int (statement, 2, write->uid);
+		sqlite3_bind_text (statement, 3, write->session, -1, SQLITE_STATIC);
+		sqlite3_bind_text (statement, 4, write->proxy->proxy_http, -1, SQLITE_STATIC);
+		sqlite3_bind_text (statement, 5, write->proxy->proxy_https, -1, SQLITE_STATIC);
+		sqlite3_bind_text (statement, 6, write->proxy->proxy_ftp, -1, SQLITE_STATIC);
+		sqlite3_bind_text (statement, 7, write->proxy->proxy_socks, -1, SQLITE_STATIC);
+		sqlite3_bind_text (statement, 8, write->proxy->no_proxy, -1, SQLITE_STATIC);
+		sqlite3_bind_text (statement, 9, write->proxy->pac, -1, SQLITE_STATIC);
+		pk_transaction_db_writer_step (tdb, statement);
+
+		/* an existing entry was updated */
+		if (sqlite3_changes (tdb->writer_db) > 0)
+			return;
 	}
+}
 
-	/* insert new entry */
-	timespec = pk_iso8601_present ();
-	g_debug ("set proxy %s, %s for uid:%i and session:%s", proxy_http, proxy_ftp, uid, session);
+static gint
+pk_transaction_db_print_cb (void *data, gint argc, gchar **argv, gchar **col_name)
+{
+	for (gint i = 0; i < argc; i++)
+		g_debug ("%s = %s", col_name[i], argv[i]);
+	return 0;
+}
 
-	/* prepare statement */
-	rc = sqlite3_prepare_v2 (tdb->db,
-				 "INSERT INTO proxy (created, uid, session, "
-				 "proxy_http, "
-				 "proxy_https, "
-				 "proxy_ftp, "
-				 "proxy_socks, "
-				 "no_proxy, "
-				 "pac) "
-				 "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)",
-				 -1, &statement, NULL);
-	if (rc != SQLITE_OK) {
-		g_warning ("failed to prepare statement: %s", sqlite3_errmsg (tdb->db));
-		goto out;
+static void
+pk_transaction_db_writer_read (PkTransactionDb *tdb, PkTransactionDbWrite *read)
+{
+	gchar *error_msg = NULL;
+	sqlite3_stmt *statement;
+	g_autofree gchar *sql = NULL;
+	GList *list = NULL;
+	GPtrArray *array;
+	gint rc;
+
+	switch (read->kind) {
+	case PK_TRANSACTION_DB_READ_LIST:
+		if (read->limit == 0) {
+			sql = g_strdup ("SELECT transaction_id, timespec, succeeded, duration, role, data, uid, cmdline "
+					"FROM transactions ORDER BY timespec DESC");
+		} else {
+			sql = g_strdup_printf ("SELECT transaction_id, timespec, succeeded, duration, role, data, uid, cmdline "
+					       "FROM transactions ORDER BY timespec DESC LIMIT %u", read->limit);
+		}
+		rc = sqlite3_exec (tdb->writer_db, sql, pk_transaction_db_add_transaction_cb, &list, &error_msg);
+		if (rc != SQLITE_OK) {
+			g_warning ("SQL error: %s", error_msg);
+			sqlite3_free (error_msg);
+		}
+		g_task_return_pointer (read->task, list, (GDestroyNotify) pk_transaction_db_list_free);
+		break;
+	case PK_TRANSACTION_DB_READ_HISTORY:
+		array = g_ptr_array_new_with_free_func ((GDestroyNotify) pk_transaction_db_history_item_free);
+		statement = pk_transaction_db_writer_stmt (tdb, PK_TRANSACTION_DB_STMT_HISTORY_SELECT);
+		if (statement == NULL) {
+			g_task_return_pointer (read->task, array, (GDestroyNotify) g_ptr_array_unref);
+			break;
+		}
+		sqlite3_bind_text (statement, 1, read->key, -1, SQLITE_STATIC);
+		sqlite3_bind_int64 (statement, 2, read->limit > 0 ? (gint64) read->limit : -1);
+		while ((rc = sqlite3_step (statement)) == SQLITE_ROW) {
+			PkTransactionDbHistoryItem *item = g_new0 (PkTransactionDbHistoryItem, 1);
+			item->package_id = g_strdup ((const gchar *) sqlite3_column_text (statement, 0));
+			item->info = sqlite3_column_int (statement, 1);
+			item->timestamp = sqlite3_column_int64 (statement, 2);
+			if (sqlite3_column_type (statement, 3) == SQLITE_NULL)
+				item->uid = G_MAXUINT;
+			else
+				item->uid = sqlite3_column_int (statement, 3);
+			g_ptr_array_add (array, item);
+		}
+		if (rc != SQLITE_DONE)
+			g_warning ("SQL error: %s", sqlite3_errmsg (tdb->writer_db));
+		sqlite3_reset (statement);
+		g_task_return_pointer (read->task, array, (GDestroyNotify) g_ptr_array_unref);
+		break;
+	case PK_TRANSACTION_DB_READ_PRINT:
+		rc = sqlite3_exec (tdb->writer_db,
+				   "SELECT transaction_id, timespec, succeeded, duration, role FROM transactions",
+				   pk_transaction_db_print_cb, NULL, &error_msg);
+		if (rc != SQLITE_OK) {
+			g_warning ("SQL error: %s", error_msg);
+			sqlite3_free (error_msg);
+		}
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+}
+
+static void
+pk_transaction_db_writer_batch (PkTransactionDb *tdb, GPtrArray *batch)
+{
+	sqlite3_stmt *statement;
+	gboolean sync_full = FALSE;
+
+	/* force fsync when saving the job count as we don't want to repeat
+	 * this number, everything else can be lost on power failure */
+	for (guint i = 0; i < batch->len; i++) {
+		PkTransactionDbWrite *write = g_ptr_array_index (batch, i);
+		if (write->kind == PK_TRANSACTION_DB_WRITE_JOB_COUNT)
+			sync_full = TRUE;
+	}
+	if (sync_full)
+		sqlite3_exec (tdb->writer_db, "PRAGMA synchronous=FULL", NULL, NULL, NULL);
+
+	sqlite3_exec (tdb->writer_db, "BEGIN", NULL, NULL, NULL);
+	for (guint i = 0; i < batch->len; i++) {
+		PkTransactionDbWrite *write = g_ptr_array_index (batch, i);
+		switch (write->kind) {
+		case PK_TRANSACTION_DB_WRITE_TRANSACTION:
+			pk_transaction_db_writer_transaction (tdb, write);
+			break;
+		case PK_TRANSACTION_DB_WRITE_LAST_ACTION:
+			statement = pk_transaction_db_writer_stmt (tdb, PK_TRANSACTION_DB_STMT_LAST_ACTION);
+			if (statement == NULL)
+				break;
+			sqlite3_bind_text (statement, 1, write->key, -1, SQLITE_STATIC);
+			sqlite3_bind_text (statement, 2, write->timespec, -1, SQLITE_STATIC);
+			pk_transaction_db_writer_step (tdb, statement);
+			break;
+		case PK_TRANSACTION_DB_WRITE_JOB_COUNT:
+			statement = pk_transaction_db_writer_stmt (tdb, PK_TRANSACTION_DB_STMT_JOB_COUNT);
+			if (statement == NULL)
+				break;
+			sqlite3_bind_int (statement, 1, write->job_count);
+			pk_transaction_db_writer_step (tdb, statement);
+			break;
+		case PK_TRANSACTION_DB_WRITE_PROXY:
+			pk_transaction_db_writer_proxy (tdb, write);
+			break;
+		case PK_TRANSACTION_DB_WRITE_EMPTY:
+			statement = pk_transaction_db_writer_stmt (tdb, PK_TRANSACTION_DB_STMT_EMPTY);
+			if (statement == NULL)
+				break;
+			pk_transaction_db_writer_step (tdb, statement);
+			statement = pk_transaction_db_writer_stmt (tdb, PK_TRANSACTION_DB_STMT_HISTORY_EMPTY);
+			if (statement == NULL)
+				break;
+			pk_transaction_db_writer_step (tdb, statement);
+			break;
+		case PK_TRANSACTION_DB_READ_LIST:
+		case PK_TRANSACTION_DB_READ_HISTORY:
+		case PK_TRANSACTION_DB_READ_PRINT:
+			break;
+		default:
+			g_assert_not_reached ();
+		}
+	}
+	if (sqlite3_exec (tdb->writer_db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK) {
+		g_warning ("failed to write %u changes: %s",
+			   batch->len, sqlite3_errmsg (tdb->writer_db));
+		sqlite3_exec (tdb->writer_db, "ROLLBACK", NULL, NULL, NULL);
 	}
 
-	/* bind data, so that the freeform proxy text cannot be used to inject SQL */
-	sqlite3_bind_text (statement, 1, timespec, -1, SQLITE_STATIC);
-	sqlite3_bind_int (statement, 2, uid);
-	sqlite3_bind_text (statement, 3, session, -1, SQLITE_STATIC);
-	sqlite3_bind_text (statement, 4, proxy_http, -1, SQLITE_STATIC);
-	sqlite3_bind_text (statement, 5, proxy_https, -1, SQLITE_STATIC);
-	sqlite3_bind_text (statement, 6, proxy_ftp, -1, SQLITE_STATIC);
-	sqlite3_bind_text (statement, 7, proxy_socks, -1, SQLITE_STATIC);
-	sqlite3_bind_text (statement, 8, no_proxy, -1, SQLITE_STATIC);
-	sqlite3_bind_text (statement, 9, pac, -1, SQLITE_STATIC);
+	if (sync_full)
+		sqlite3_exec (tdb->writer_db, "PRAGMA synchronous=NORMAL", NULL, NULL, NULL);
 
-	/* execute statement */
-	rc = sqlite3_step (statement);
-	if (rc != SQLITE_DONE) {
-		g_warning ("failed to execute statement: %s", sqlite3_errmsg (tdb->db));
-		goto out;
+	/* the reads see everything that was queued with them */
+	for (guint i = 0; i < batch->len; i++) {
+		PkTransactionDbWrite *write = g_ptr_array_index (batch, i);
+		if (write->kind >= PK_TRANSACTION_DB_READ_LIST)
+			pk_transaction_db_writer_read (tdb, write);
 	}
+}
 
-	ret = TRUE;
-out:
-	if (statement != NULL)
-		sqlite3_finalize (statement);
-	return ret;
+static gpointer
+pk_transaction_db_writer_thread (gpointer user_data)
+{
+	PkTransactionDb *tdb = PK_TRANSACTION_DB (user_data);
+	g_autoptr(GPtrArray) batch = NULL;
+
+	batch = g_ptr_array_new_with_free_func ((GDestroyNotify) pk_transaction_db_write_free);
+	g_mutex_lock (&tdb->writer_mutex);
+	for (;;) {
+		while (g_queue_is_empty (&tdb->writes) && !tdb->writer_stop)
+			g_cond_wait (&tdb->writer_cond, &tdb->writer_mutex);
+		if (g_queue_is_empty (&tdb->writes))
+			break;
+
+		/* take everything that was queued, and write it at once */
+		while (!g_queue_is_empty (&tdb->writes))
+			g_ptr_array_add (batch, g_queue_pop_head (&tdb->writes));
+		g_mutex_unlock (&tdb->writer_mutex);
+
+		pk_transaction_db_writer_batch (tdb, batch);
+		g_ptr_array_set_size (batch, 0);
+
+		g_mutex_lock (&tdb->writer_mutex);
+	}
+	g_mutex_unlock (&tdb->writer_mutex);
+	return NULL;
 }
 
 static void
@@ -875,6 +1234,117 @@ pk_transaction_db_execute (PkTransactionDb *tdb,
 	return ret;
 }
 
+static gboolean
+pk_transaction_db_migrate_package_history (PkTransactionDb *tdb, GError **error)
+{
+	gint rc;
+	g_autoptr(sqlite3_stmt) insert = NULL;
+	g_autoptr(sqlite3_stmt) statement = NULL;
+
+	if (!pk_transaction_db_execute (tdb, "BEGIN", error))
+		return FALSE;
+	if (!pk_transaction_db_execute (tdb,
+					"CREATE TABLE package_history (name TEXT, timestamp INTEGER, "
+					"info INTEGER, package_id TEXT, tid TEXT);",
+					error))
+		goto out;
+	if (!pk_transaction_db_execute (tdb,
+					"CREATE INDEX package_history_name ON package_history (name, timestamp);",
+					error))
+		goto out;
+	if (!pk_transaction_db_execute (tdb,
+					"CREATE INDEX package_history_tid ON package_history (tid);",
+					error))
+		goto out;
+
+	rc = sqlite3_prepare_v2 (tdb->db, PK_TRANSACTION_DB_HISTORY_INSERT, -1, &insert, NULL);
+	if (rc == SQLITE_OK) {
+		rc = sqlite3_prepare_v2 (tdb->db,
+					 "SELECT transaction_id, timespec, data FROM transactions "
+					 "WHERE data IS NOT NULL",
+					 -1, &statement, NULL);
+	}
+	if (rc != SQLITE_OK) {
+		g_set_error (error, 1, 0,
+			     "failed to prepare statement: %s", sqlite3_errmsg (tdb->db));
+		goto out;
+	}
+	while ((rc = sqlite3_step (statement)) == SQLITE_ROW) {
+		pk_transaction_db_add_package_history (tdb->db, insert,
+						       (const gchar *) sqlite3_column_text (statement, 0),
+						       (const gchar *) sqlite3_column_text (statement, 1),
+						       (const gchar *) sqlite3_column_text (statement, 2));
+	}
+	if (rc != SQLITE_DONE) {
+		g_set_error (error, 1, 0,
+			     "failed to get transactions: %s", sqlite3_errmsg (tdb->db));
+		goto out;
+	}
+	return pk_transaction_db_execute (tdb, "COMMIT", error);
+out:
+	sqlite3_exec (tdb->db, "ROLLBACK", NULL, NULL, NULL);
+	return FALSE;
+}
+
+static gboolean
+pk_transaction_db_load_caches (PkTransactionDb *tdb, GError **error)
+{
+	gint rc;
+	g_autoptr(sqlite3_stmt) statement = NULL;
+	g_autoptr(sqlite3_stmt) statement_proxy = NULL;
+
+	rc = sqlite3_prepare_v2 (tdb->db, "SELECT role, timespec FROM last_action", -1, &statement, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error, 1, 0,
+			     "failed to prepare statement: %s", sqlite3_errmsg (tdb->db));
+		return FALSE;
+	}
+	while ((rc = sqlite3_step (statement)) == SQLITE_ROW) {
+		const gchar *role = (const gchar *) sqlite3_column_text (statement, 0);
+		const gchar *timespec = (const gchar *) sqlite3_column_text (statement, 1);
+		if (role == NULL || timespec == NULL)
+			continue;
+		g_hash_table_insert (tdb->last_action, g_strdup (role), g_strdup (timespec));
+	}
+	if (rc != SQLITE_DONE) {
+		g_set_error (error, 1, 0,
+			     "failed to get last actions: %s", sqlite3_errmsg (tdb->db));
+		return FALSE;
+	}
+
+	rc = sqlite3_prepare_v2 (tdb->db,
+				 "SELECT uid, session, proxy_http, proxy_https, proxy_ftp, "
+				 "proxy_socks, no_proxy, pac FROM proxy",
+				 -1, &statement_proxy, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error, 1, 0,
+			     "failed to prepare statement: %s", sqlite3_errmsg (tdb->db));
+		return FALSE;
+	}
+	while ((rc = sqlite3_step (statement_proxy)) == SQLITE_ROW) {
+		g_autofree gchar *key = NULL;
+		key = pk_transaction_db_proxy_key (sqlite3_column_int (statement_proxy, 0),
+						   (const gchar *) sqlite3_column_text (statement_proxy, 1));
+
+		/* the first entry wins, just like the old lookup */
+		if (g_hash_table_contains (tdb->proxies, key))
+			continue;
+		g_hash_table_insert (tdb->proxies, g_steal_pointer (&key),
+				     pk_transaction_db_proxy_item_new ((const gchar *) sqlite3_column_text (statement_proxy, 2),
+								       (const gchar *) sqlite3_column_text (statement_proxy, 3),
+								       (const gchar *) sqlite3_column_text (statement_proxy, 4),
+								       (const gchar *) sqlite3_column_text (statement_proxy, 5),
+								       (const gchar *) sqlite3_column_text (statement_proxy, 6),
+								       (const gchar *) sqlite3_column_text (statement_proxy, 7)));
+	}
+	if (rc != SQLITE_DONE) {
+		g_set_error (error, 1, 0,
+			     "failed to get proxies: %s", sqlite3_errmsg (tdb->db));
+		return FALSE;
+	}
+	return TRUE;
+}
+
 gboolean
 pk_transaction_db_load (PkTransactionDb *tdb, GError **error)
 {
@@ -903,8 +1373,9 @@ pk_transaction_db_load (PkTransactionDb *tdb, GError **error)
 		return FALSE;
 	}
 
-	/* we don't need to keep doing fsync */
-	if (!pk_transaction_db_execute (tdb, "PRAGMA synchronous=OFF", error))
+	/* only used on the main thread while loading */
+	sqlite3_busy_timeout (tdb->db, 5000);
+	if (!pk_transaction_db_execute (tdb, "PRAGMA journal_mode=WAL", error))
 		return FALSE;
 
 	/* check transactions */
@@ -970,9 +1441,36 @@ pk_transaction_db_load (PkTransactionDb *tdb, GError **error)
 			return FALSE;
 	}
 
+	/* per-package history, filled from the existing transactions once */
+	if (!pk_transaction_db_execute (tdb, "SELECT * FROM package_history LIMIT 1", &error_local)) {
+		g_debug ("adding table package_history: %s", error_local->message);
+		g_clear_error (&error_local);
+		if (!pk_transaction_db_migrate_package_history (tdb, error))
+			return FALSE;
+	}
+
+	/* keep the small tables in memory so lookups never touch the disk */
+	if (!pk_transaction_db_load_caches (tdb, error))
+		return FALSE;
+
 	/* try to set correct permissions */
 	g_chmod (PK_DB_DIR "/transactions.db", 0644);
 
+	/* all writes are done by a thread with its own connection */
+	rc = sqlite3_open (PK_DB_DIR "/transactions.db", &tdb->writer_db);
+	if (rc != SQLITE_OK) {
+		g_set_error (error,
+			     1, 0,
+			     "Can't open transaction database: %s",
+			     sqlite3_errmsg (tdb->writer_db));
+		sqlite3_close (tdb->writer_db);
+		tdb->writer_db = NULL;
+		return FALSE;
+	}
+	sqlite3_busy_timeout (tdb->writer_db, 5000);
+	sqlite3_exec (tdb->writer_db, "PRAGMA synchronous=NORMAL", NULL, NULL, NULL);
+	tdb->writer = g_thread_new ("pk-transaction-db", pk_transaction_db_writer_thread, tdb);
+
 	/* success */
 	tdb->loaded = TRUE;
 	return TRUE;
@@ -981,6 +1479,13 @@ pk_transaction_db_load (PkTransactionDb *tdb, GError **error)
 static void
 pk_transaction_db_init (PkTransactionDb *tdb)
 {
+	tdb->last_action = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	tdb->proxies = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					      (GDestroyNotify) pk_transaction_db_proxy_item_free);
+	tdb->pending = g_ptr_array_new_with_free_func ((GDestroyNotify) pk_transaction_db_write_free);
+	g_mutex_init (&tdb->writer_mutex);
+	g_cond_init (&tdb->writer_cond);
+	g_queue_init (&tdb->writes);
 }
 
 static void
@@ -991,23 +1496,42 @@ pk_transaction_db_finalize (GObject *object)
 	tdb = PK_TRANSACTION_DB (object);
 	g_return_if_fail (tdb != NULL);
 
-	/* if we shutdown with a deferred database write, then enforce it here */
-	if (tdb->database_save_id != 0) {
-		pk_transaction_db_defer_write_job_count_cb (tdb);
-		g_source_remove (tdb->database_save_id);
+	/* if we shutdown with deferred database writes, then enforce them here */
+	pk_transaction_db_submit (tdb);
+	if (tdb->writer != NULL) {
+		g_mutex_lock (&tdb->writer_mutex);
+		tdb->writer_stop = TRUE;
+		g_cond_broadcast (&tdb->writer_cond);
+		g_mutex_unlock (&tdb->writer_mutex);
+		g_thread_join (tdb->writer);
 	}
+	for (guint i = 0; i < PK_TRANSACTION_DB_STMT_LAST; i++)
+		sqlite3_finalize (tdb->writer_stmts[i]);
 
 	/* close the database */
+	sqlite3_close (tdb->writer_db);
 	sqlite3_close (tdb->db);
 
+	g_ptr_array_unref (tdb->pending);
+	g_hash_table_unref (tdb->last_action);
+	g_hash_table_unref (tdb->proxies);
+	g_mutex_clear (&tdb->writer_mutex);
+	g_cond_clear (&tdb->writer_cond);
+
 	G_OBJECT_CLASS (pk_transaction_db_parent_class)->finalize (object);
 }
 
+static gpointer pk_transaction_db_object = NULL;
+
 PkTransactionDb *
 pk_transaction_db_new (void)
 {
-	PkTransactionDb *tdb;
-	tdb = g_object_new (PK_TYPE_TRANSACTION_DB, NULL);
-	return PK_TRANSACTION_DB (tdb);
+	/* every transaction shares the connection and the writer thread */
+	if (pk_transaction_db_object != NULL) {
+		g_object_ref (pk_transaction_db_object);
+	} else {
+		pk_transaction_db_object = g_object_new (PK_TYPE_TRANSACTION_DB, NULL);
+		g_object_add_weak_pointer (pk_transaction_db_object, &pk_transaction_db_object);
+	}
+	return PK_TRANSACTION_DB (pk_transaction_db_object);
 }
-
@@ -22,7 +22,7 @@
 #ifndef __PK_TRANSACTION_DB_H
 #define __PK_TRANSACTION_DB_H
 
-#include <glib-object.h>
+#include <gio/gio.h>
 #include <packagekit-glib2/pk-enum.h>
 
 G_BEGIN_DECLS
@@ -30,6 +30,14 @@ G_BEGIN_DECLS
 #define PK_TYPE_TRANSACTION_DB		(pk_transaction_db_get_type ())
 G_DECLARE_FINAL_TYPE (PkTransactionDb, pk_transaction_db, PK, TRANSACTION_DB, GObject)
 
+/* a package changed by a transaction that succeeded */
+typedef struct {
+	gchar		*package_id;
+	PkInfoEnum	 info;
+	gint64		 timestamp;
+	guint		 uid;
+} PkTransactionDbHistoryItem;
+
 PkTransactionDb	*pk_transaction_db_new			(void);
 gboolean	 pk_transaction_db_load			(PkTransactionDb	*tdb,
 							 GError			**error);
@@ -53,8 +61,24 @@ gboolean	 pk_transaction_db_set_finished		(PkTransactionDb	*tdb,
 gboolean	 pk_transaction_db_set_data		(PkTransactionDb	*tdb,
 							 const gchar		*tid,
 							 const gchar		*data);
-GList		*pk_transaction_db_get_list		(PkTransactionDb	*tdb,
-							 guint			 limit);
+void		 pk_transaction_db_get_list_async	(PkTransactionDb	*tdb,
+							 guint			 limit,
+							 GCancellable		*cancellable,
+							 GAsyncReadyCallback	 callback,
+							 gpointer		 user_data);
+GList		*pk_transaction_db_get_list_finish	(PkTransactionDb	*tdb,
+							 GAsyncResult		*res,
+							 GError			**error);
+void		 pk_transaction_db_get_package_history_async (PkTransactionDb *tdb,
+							 const gchar		*name,
+							 guint			 limit,
+							 GCancellable		*cancellable,
+							 GAsyncReadyCallback	 callback,
+							 gpointer		 user_data);
+GPtrArray	*pk_transaction_db_get_package_history_finish (PkTransactionDb *tdb,
+							 GAsyncResult		*res,
+							 GError			**error);
+void		 pk_transaction_db_history_item_free	(PkTransactionDbHistoryItem *item);
 gboolean	 pk_transaction_db_action_time_reset	(PkTransactionDb	*tdb,
 							 PkRoleEnum		 role);
 guint		 pk_transaction_db_action_time_since	(PkTransactionDb	*tdb,
@@ -48,6 +48,16 @@ gboolean	 pk_transaction_strvalidate			(const gchar	*textr,
 								 GError		**error);
 gboolean	 pk_transaction_set_tid				(PkTransaction	*transaction,
 								 const gchar	*tid);
+gboolean	 pk_transaction_set_hint			(PkTransaction	*transaction,
+								 const gchar	*key,
+								 const gchar	*value,
+								 GError		**error);
+void		 pk_transaction_package_cb			(PkBackend	*backend,
+								 PkPackage	*item,
+								 PkTransaction	*transaction);
+void		 pk_transaction_error_code_cb			(PkBackendJob	*job,
+								 PkError	*item,
+								 PkTransaction	*transaction);
 
 
 G_END_DECLS
@@ -61,6 +61,9 @@ static void     pk_transaction_dispose		(GObject	    *object);
 
 static gchar *pk_transaction_get_content_type_for_file (const gchar *filename, GError **error);
 static gboolean pk_transaction_is_supported_content_type (PkTransaction *transaction, const gchar *content_type);
+static gboolean pk_transaction_run_role (PkTransaction *transaction);
+static gboolean pk_transaction_batch_has_next (PkTransaction *transaction);
+static void pk_transaction_batch_load_step (PkTransaction *transaction);
 
 #define PK_TRANSACTION_UPDATES_CHANGED_TIMEOUT	100 /* ms */
 
@@ -73,6 +76,12 @@ static gboolean pk_transaction_is_supported_content_type (PkTransaction *transac
 /* maximum number of items that can be resolved in one go */
 #define PK_TRANSACTION_MAX_ITEMS_TO_RESOLVE	10000
 
+/* single Package emissions are batched into Packages signals of this size */
+#define PK_TRANSACTION_PACKAGES_BATCH_MAX	500
+
+/* how long a partial batch of packages may wait before being sent */
+#define PK_TRANSACTION_PACKAGES_BATCH_TIMEOUT	50 /* ms */
+
 struct _PkTransaction
 {
 	GObject			 parent;
@@ -111,6 +120,11 @@ struct _PkTransaction
 	gboolean		 progress_changed;
 	GSource			*progress_timeout_source;  /* (nullable) (owned) */
 
+	/* Batching of single package emissions */
+	GVariantBuilder		*pending_packages;  /* (nullable) (owned) */
+	guint			 pending_packages_len;
+	GSource			*packages_timeout_source;  /* (nullable) (owned) */
+
 	/* needed for gui coldplugging */
 	gchar			*last_package_id;
 	gchar			*tid;
@@ -138,6 +152,8 @@ struct _PkTransaction
 	gchar			*cached_directory;
 	gchar			*cached_cat_id;
 	PkUpgradeKindEnum	 cached_upgrade_kind;
+	GVariant		*cached_batch;  /* (nullable) (owned): a(sv) */
+	guint			 cached_batch_step;
 	GPtrArray		*supported_content_types;
 	guint			 registration_id;
 	GDBusConnection		*connection;
@@ -268,6 +284,128 @@ static void pk_transaction_emit_properties_changed (PkTransaction *transaction,
                                                     GVariant      *first_property_value,
                                                     ...) G_GNUC_NULL_TERMINATED;
 
+static void
+pk_transaction_emit_packages (PkTransaction *transaction,
+			      GVariant *package_array_variant)
+{
+	gboolean emitted = FALSE;
+
+	/* Emit the signal. Grouping multiple package details into a single
+	 * signal reduces the number of signals and hence the amount of context
+	 * switching between packagekitd, dbus-daemon and the client process.
+	 * This results in much improved performance compared to emitting one
+	 * signal per package.
+	 *
+	 * This should not hit the D-Bus limits (maximum array size of 64MB,
+	 * maximum message size of 128MB) until it’s listing on the order of
+	 * 100000 packages. If it does, we fall back below. */
+	if (transaction->client_supports_plural_signals &&
+	    g_dbus_connection_emit_signal (transaction->connection,
+					   NULL,
+					   transaction->tid,
+					   PK_DBUS_INTERFACE_TRANSACTION,
+					   "Packages",
+					   g_variant_new ("(@a(uss))",
+					                  package_array_variant),
+					   NULL))
+		emitted = TRUE;
+
+	if (!emitted) {
+		GVariantIter iter;
+		g_autoptr(GVariant) child = NULL;
+
+		/* Fall back to one signal per package. */
+		g_variant_iter_init (&iter, package_array_variant);
+
+		while ((child = g_variant_iter_next_value (&iter))) {
+			g_dbus_connection_emit_signal (transaction->connection,
+						       NULL,
+						       transaction->tid,
+						       PK_DBUS_INTERFACE_TRANSACTION,
+						       "Package",
+						       child,
+						       NULL);
+			g_clear_pointer (&child, g_variant_unref);
+		}
+	}
+}
+
+/* Emit any single package emissions batched up by
+ * schedule_pending_packages() as one Packages signal.
+ *
+ * This must be called before any other signal is emitted on the transaction,
+ * so that clients see signals in the order the backend sent them.
+ */
+static void
+flush_pending_packages (PkTransaction *transaction)
+{
+	g_autoptr(GVariant) package_array_variant = NULL;
+
+	if (transaction->packages_timeout_source != NULL) {
+		g_source_destroy (transaction->packages_timeout_source);
+		g_clear_pointer (&transaction->packages_timeout_source, g_source_unref);
+	}
+	if (transaction->pending_packages == NULL)
+		return;
+
+	package_array_variant = g_variant_ref_sink (g_variant_builder_end (transaction->pending_packages));
+	g_clear_pointer (&transaction->pending_packages, g_variant_builder_unref);
+	transaction->pending_packages_len = 0;
+	pk_transaction_emit_packages (transaction, package_array_variant);
+}
+
+static gboolean
+packages_timeout_cb (gpointer user_data)
+{
+	PkTransaction *transaction = PK_TRANSACTION (user_data);
+
+	/* The timeout is one-shot: clear our source ref before flushing. */
+	g_clear_pointer (&transaction->packages_timeout_source, g_source_unref);
+	flush_pending_packages (transaction);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Most backends emit packages one at a time, which would cost one D-Bus
+ * signal (and a context switch in the client) per package. For clients that
+ * understand the plural Packages signal, collect them and send them in batches
+ * of PK_TRANSACTION_PACKAGES_BATCH_MAX, or after
+ * PK_TRANSACTION_PACKAGES_BATCH_TIMEOUT if the backend is slower than that.
+ */
+static void
+schedule_pending_packages (PkTransaction *transaction,
+			   guint encoded_value,
+			   const gchar *package_id,
+			   const gchar *summary)
+{
+	if (transaction->pending_packages == NULL)
+		transaction->pending_packages = g_variant_builder_new (G_VARIANT_TYPE ("a(uss)"));
+	g_variant_builder_add (transaction->pending_packages,
+			       "(uss)",
+			       encoded_value,
+			       package_id,
+			       summary);
+
+	if (++transaction->pending_packages_len >= PK_TRANSACTION_PACKAGES_BATCH_MAX) {
+		flush_pending_packages (transaction);
+		return;
+	}
+
+	if (transaction->packages_timeout_source == NULL) {
+		g_autoptr(GSource) source = NULL;
+
+		source = g_timeout_source_new (PK_TRANSACTION_PACKAGES_BATCH_TIMEOUT);
+		g_source_set_callback (source, G_SOURCE_FUNC (packages_timeout_cb), transaction, NULL);
+
+#if GLIB_CHECK_VERSION(2, 70, 0)
+		g_source_set_static_name (source, "PkTransaction packages timeout");
+#endif
+
+		g_source_attach (source, g_main_context_get_thread_default ());
+		transaction->packages_timeout_source = g_steal_pointer (&source);
+	}
+}
+
 static void
 pk_transaction_emit_properties_changed (PkTransaction *transaction,
                                         const gchar   *first_property_name,
@@ -284,6 +422,8 @@ pk_transaction_emit_properties_changed (PkTransaction *transaction,
 	g_variant_builder_init (&invalidated_builder, G_VARIANT_TYPE ("as"));
 	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
 
+	flush_pending_packages (transaction);
+
 	va_start (args, first_property_value);
 
 	for (property_name = first_property_name, property_value = first_property_value;
@@ -475,6 +615,7 @@ pk_transaction_finished_emit (PkTransaction *transaction,
 	g_debug ("emitting finished '%s', %i",
 		 pk_exit_enum_to_string (exit_enum),
 		 time_ms);
+	flush_pending_packages (transaction);
 	g_dbus_connection_emit_signal (transaction->connection,
 				       NULL,
 				       transaction->tid,
@@ -497,6 +638,7 @@ pk_transaction_error_code_emit (PkTransaction *transaction,
 	g_debug ("emitting error-code %s, '%s'",
 		 pk_error_enum_to_string (error_enum),
 		 details);
+	flush_pending_packages (transaction);
 	g_dbus_connection_emit_signal (transaction->connection,
 				       NULL,
 				       transaction->tid,
@@ -585,6 +727,7 @@ pk_transaction_details_cb (PkBackendJob *job,
 		g_variant_builder_add (&builder, "{sv}", "download-size",
 				       g_variant_new_uint64 (size));
 
+	flush_pending_packages (transaction);
 	g_dbus_connection_emit_signal (transaction->connection,
 				       NULL,
 				       transaction->tid,
@@ -594,7 +737,7 @@ pk_transaction_details_cb (PkBackendJob *job,
 				       NULL);
 }
 
-static void
+void
 pk_transaction_error_code_cb (PkBackendJob *job,
 			      PkError *item,
 			      PkTransaction *transaction)
@@ -664,6 +807,7 @@ pk_transaction_files_cb (PkBackendJob *job,
 
 	/* emit */
 	g_debug ("emitting files %s", package_id);
+	flush_pending_packages (transaction);
 	g_dbus_connection_emit_signal (transaction->connection,
 				       NULL,
 				       transaction->tid,
@@ -703,6 +847,7 @@ pk_transaction_category_cb (PkBackendJob *job,
 
 	/* emit */
 	g_debug ("emitting category %s, %s, %s, %s, %s ", parent_id, cat_id, name, summary, icon);
+	flush_pending_packages (transaction);
 	g_dbus_connection_emit_signal (transaction->connection,
 				       NULL,
 				       transaction->tid,
@@ -730,6 +875,7 @@ pk_transaction_item_progress_cb (PkBackendJob *job,
 		 pk_item_progress_get_package_id (item_progress),
 		 pk_status_enum_to_string (pk_item_progress_get_status (item_progress)),
 		 pk_item_progress_get_percentage (item_progress));
+	flush_pending_packages (transaction);
 	g_dbus_connection_emit_signal (transaction->connection,
 				       NULL,
 				       transaction->tid,
@@ -768,6 +914,7 @@ pk_transaction_distro_upgrade_cb (PkBackendJob *job,
 	g_debug ("emitting distro-upgrade %s, %s, %s",
 		 pk_update_state_enum_to_string (state),
 		 name, summary);
+	flush_pending_packages (transaction);
 	g_dbus_connection_emit_signal (transaction->connection,
 				       NULL,
 				       transaction->tid,
@@ -1124,6 +1271,21 @@ pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransacti
 		return;
 	}
 
+	/* run the next step of a batch with the same job */
+	if (exit_enum == PK_EXIT_ENUM_SUCCESS &&
+	    pk_transaction_batch_has_next (transaction)) {
+		transaction->cached_batch_step++;
+		pk_backend_job_reset (job);
+		pk_transaction_batch_load_step (transaction);
+		pk_transaction_run_role (transaction);
+		return;
+	}
+
+	/* a failed step ends the batch early, so send the status that was
+	 * held back while more steps were queued */
+	if (pk_transaction_batch_has_next (transaction))
+		pk_transaction_status_changed_emit (transaction, PK_STATUS_ENUM_FINISHED);
+
 	/* Ensure any pending progress has been emitted and remove the progress
 	 * timer since it’s unlikely to be used again. */
 	unschedule_progress_changed (transaction);
@@ -1245,7 +1407,7 @@ pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransacti
 	pk_transaction_finished_emit (transaction, exit_enum, time_ms);
 }
 
-static void
+void
 pk_transaction_package_cb (PkBackend *backend,
 			   PkPackage *item,
 			   PkTransaction *transaction)
@@ -1322,6 +1484,14 @@ pk_transaction_package_cb (PkBackend *backend,
 	update_severity = pk_package_get_update_severity (item);
 	encoded_value = info | (((guint32) update_severity) << 16);
 
+	if (transaction->client_supports_plural_signals) {
+		schedule_pending_packages (transaction,
+					   encoded_value,
+					   package_id,
+					   summary ? summary : "");
+		return;
+	}
+
 	g_dbus_connection_emit_signal (transaction->connection,
 				       NULL,
 				       transaction->tid,
@@ -1342,7 +1512,6 @@ pk_transaction_packages_cb (PkBackend *backend,
 	g_auto(GVariantBuilder) builder = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("a(uss)"));
 	g_autoptr(GVariant) package_array_variant = NULL;
 	guint n_added_packages = 0;
-	gboolean emitted = FALSE;
 
 	g_return_if_fail (PK_IS_TRANSACTION (transaction));
 	g_return_if_fail (transaction->tid != NULL);
@@ -1433,45 +1602,8 @@ pk_transaction_packages_cb (PkBackend *backend,
 	}
 
 	package_array_variant = g_variant_ref_sink (g_variant_builder_end (&builder));
-
-	/* Emit the signal. Grouping multiple package details into a single
-	 * signal reduces the number of signals and hence the amount of context
-	 * switching between packagekitd, dbus-daemon and the client process.
-	 * This results in much improved performance compared to emitting one
-	 * signal per package.
-	 *
-	 * This should not hit the D-Bus limits (maximum array size of 64MB,
-	 * maximum message size of 128MB) until it’s listing on the order of
-	 * 100000 packages. If it does, we fall back below. */
-	if (transaction->client_supports_plural_signals &&
-	    g_dbus_connection_emit_signal (transaction->connection,
-					   NULL,
-					   transaction->tid,
-					   PK_DBUS_INTERFACE_TRANSACTION,
-					   "Packages",
-					   g_variant_new ("(@a(uss))",
-					                  package_array_variant),
-					   NULL))
-		emitted = TRUE;
-
-	if (!emitted) {
-		GVariantIter iter;
-		g_autoptr(GVariant) child = NULL;
-
-		/* Fall back to one signal per package. */
-		g_variant_iter_init (&iter, package_array_variant);
-
-		while ((child = g_variant_iter_next_value (&iter))) {
-			g_dbus_connection_emit_signal (transaction->connection,
-						       NULL,
-						       transaction->tid,
-						       PK_DBUS_INTERFACE_TRANSACTION,
-						       "Package",
-						       child,
-						       NULL);
-			g_clear_pointer (&child, g_variant_unref);
-		}
-	}
+	flush_pending_packages (transaction);
+	pk_transaction_emit_packages (transaction, package_array_variant);
 }
 
 static void
@@ -1494,6 +1626,7 @@ pk_transaction_repo_detail_cb (PkBackend *backend,
 	description = pk_repo_detail_get_description (item);
 	enabled = pk_repo_detail_get_enabled (item);
 	g_debug ("emitting repo-detail %s, %s, %i", repo_id, description, enabled);
+	flush_pending_packages (transaction);
 	g_dbus_connection_emit_signal (transaction->connection,
 				       NULL,
 				       transaction->tid,
@@ -1543,6 +1676,7 @@ pk_transaction_repo_signature_required_cb (PkBackend *backend,
 		 package_id, repository_name, key_url, key_userid, key_id,
 		 key_fingerprint, key_timestamp,
 		 pk_sig_type_enum_to_string (type));
+	flush_pending_packages (transaction);
 	g_dbus_connection_emit_signal (transaction->connection,
 				       NULL,
 				       transaction->tid,
@@ -1588,6 +1722,7 @@ pk_transaction_eula_required_cb (PkBackend *backend,
 	/* emit */
 	g_debug ("emitting eula-required %s, %s, %s, %s",
 		   eula_id, package_id, vendor_name, license_agreement);
+	flush_pending_packages (transaction);
 	g_dbus_connection_emit_signal (transaction->connection,
 				       NULL,
 				       transaction->tid,
@@ -1631,6 +1766,7 @@ pk_transaction_media_change_required_cb (PkBackend *backend,
 		 pk_media_type_enum_to_string (media_type),
 		 media_id,
 		 media_text);
+	flush_pending_packages (transaction);
 	g_dbus_connection_emit_signal (transaction->connection,
 				       NULL,
 				       transaction->tid,
@@ -1696,6 +1832,7 @@ pk_transaction_require_restart_cb (PkBackend *backend,
 	g_debug ("emitting require-restart %s, '%s'",
 		 pk_restart_enum_to_string (restart),
 		 package_id);
+	flush_pending_packages (transaction);
 	g_dbus_connection_emit_signal (transaction->connection,
 				       NULL,
 				       transaction->tid,
@@ -1707,6 +1844,26 @@ pk_transaction_require_restart_cb (PkBackend *backend,
 				       NULL);
 }
 
+static void
+pk_transaction_solution_cb (PkBackendJob *job,
+			    const gchar *solution_token,
+			    PkTransaction *transaction)
+{
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (transaction->tid != NULL);
+
+	/* emit */
+	g_debug ("emitting solution %s", solution_token);
+	flush_pending_packages (transaction);
+	g_dbus_connection_emit_signal (transaction->connection,
+				       NULL,
+				       transaction->tid,
+				       PK_DBUS_INTERFACE_TRANSACTION,
+				       "Solution",
+				       g_variant_new ("(s)", solution_token),
+				       NULL);
+}
+
 static void
 pk_transaction_status_changed_cb (PkBackendJob *job,
 				  PkStatusEnum status,
@@ -1719,6 +1876,12 @@ pk_transaction_status_changed_cb (PkBackendJob *job,
 	if (status == PK_STATUS_ENUM_WAIT)
 		return;
 
+	/* a batch only finishes after its last step, the finished callback
+	 * sends this if a step fails before */
+	if (status == PK_STATUS_ENUM_FINISHED &&
+	    pk_transaction_batch_has_next (transaction))
+		return;
+
 	/* have we already been marked as finished? */
 	if (transaction->finished) {
 		g_warning ("Already finished, so can't proxy status %s",
@@ -1764,6 +1927,7 @@ pk_transaction_update_detail_cb (PkBackend *backend,
 	issued = pk_update_detail_get_issued (item);
 	updated = pk_update_detail_get_updated (item);
 	g_debug ("emitting update-detail for %s", package_id);
+	flush_pending_packages (transaction);
 	g_dbus_connection_emit_signal (transaction->connection,
 				       NULL,
 				       transaction->tid,
@@ -1852,6 +2016,7 @@ pk_transaction_update_details_cb (PkBackend *backend,
 	}
 
 	update_details_array_variant = g_variant_ref_sink (g_variant_builder_end (&builder));
+	flush_pending_packages (transaction);
 
 	/* Emit the signal. Grouping multiple update details into a single
 	 * signal reduces the number of signals and hence the amount of context
@@ -2130,7 +2295,27 @@ pk_transaction_run (PkTransaction *transaction)
 				  PK_BACKEND_SIGNAL_CATEGORY,
 				  PK_BACKEND_JOB_VFUNC (pk_transaction_category_cb),
 				  transaction);
+	pk_backend_job_set_vfunc (transaction->job,
+				  PK_BACKEND_SIGNAL_SOLUTION,
+				  PK_BACKEND_JOB_VFUNC (pk_transaction_solution_cb),
+				  transaction);
+
+	/* the first step of a batch */
+	if (transaction->cached_batch != NULL)
+		pk_transaction_batch_load_step (transaction);
 
+	return pk_transaction_run_role (transaction);
+}
+
+/*
+ * pk_transaction_run_role:
+ *
+ * Calls into the backend for the role of @transaction, which must already
+ * have been set on the job.
+ **/
+static gboolean
+pk_transaction_run_role (PkTransaction *transaction)
+{
 	/* do the correct action with the cached parameters */
 	switch (transaction->role) {
 	case PK_ROLE_ENUM_DEPENDS_ON:
@@ -2959,7 +3144,9 @@ pk_transaction_set_role (PkTransaction *transaction, PkRoleEnum role)
 }
 
 static void
-pk_transaction_dbus_return (GDBusMethodInvocation *context, const GError *error)
+pk_transaction_dbus_return (PkTransaction *transaction,
+			    GDBusMethodInvocation *context,
+			    const GError *error)
 {
 	/* not set inside the test suite */
 	if (context == NULL) {
@@ -2967,10 +3154,21 @@ pk_transaction_dbus_return (GDBusMethodInvocation *context, const GError *error)
 			g_warning ("context null, and error: %s", error->message);
 		return;
 	}
-	if (error != NULL)
+
+	/* the transaction may already be destroyed after an error */
+	if (error != NULL) {
 		g_dbus_method_invocation_return_gerror (context, error);
-	else
-		g_dbus_method_invocation_return_value (context, NULL);
+		return;
+	}
+
+	/* StartTransaction() returns the new transaction */
+	if (g_strcmp0 (g_dbus_method_invocation_get_interface_name (context),
+		       PK_DBUS_INTERFACE_TRANSACTION) != 0) {
+		g_dbus_method_invocation_return_value (context,
+						       g_variant_new ("(o)", transaction->tid));
+		return;
+	}
+	g_dbus_method_invocation_return_value (context, NULL);
 }
 
 static void
@@ -3014,7 +3212,246 @@ pk_transaction_accept_eula (PkTransaction *transaction,
 	idle_id = g_idle_add ((GSourceFunc) pk_transaction_finished_idle_cb, transaction);
 	g_source_set_name_by_id (idle_id, "[PkTransaction] finished from accept");
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
+}
+
+/* the roles that can be steps of a batch; none of them needs authorization */
+static const struct {
+	const gchar	*method_name;
+	PkRoleEnum	 role;
+} pk_transaction_batch_roles[] = {
+	{ "Resolve",		PK_ROLE_ENUM_RESOLVE },
+	{ "GetDetails",		PK_ROLE_ENUM_GET_DETAILS },
+	{ "GetUpdateDetail",	PK_ROLE_ENUM_GET_UPDATE_DETAIL },
+	{ "GetFiles",		PK_ROLE_ENUM_GET_FILES },
+	{ "DependsOn",		PK_ROLE_ENUM_DEPENDS_ON },
+	{ "RequiredBy",		PK_ROLE_ENUM_REQUIRED_BY },
+};
+
+/*
+ * pk_transaction_check_in_args:
+ *
+ * Checks @parameters against the in arguments of @method_info, for methods
+ * whose parameters GDBus could not check as they were passed in a variant.
+ **/
+static gboolean
+pk_transaction_check_in_args (GDBusMethodInfo *method_info,
+			      GVariant *parameters,
+			      GError **error)
+{
+	g_autoptr(GString) signature = g_string_new ("(");
+
+	for (guint i = 0; method_info->in_args != NULL && method_info->in_args[i] != NULL; i++)
+		g_string_append (signature, method_info->in_args[i]->signature);
+	g_string_append_c (signature, ')');
+	if (g_strcmp0 (g_variant_get_type_string (parameters), signature->str) != 0) {
+		g_set_error (error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_INPUT_INVALID,
+			     "parameters of %s must be %s, not %s",
+			     method_info->name, signature->str,
+			     g_variant_get_type_string (parameters));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static PkRoleEnum
+pk_transaction_batch_get_role (const gchar *method_name)
+{
+	for (guint i = 0; i < G_N_ELEMENTS (pk_transaction_batch_roles); i++) {
+		if (g_strcmp0 (pk_transaction_batch_roles[i].method_name, method_name) == 0)
+			return pk_transaction_batch_roles[i].role;
+	}
+	return PK_ROLE_ENUM_UNKNOWN;
+}
+
+static gboolean
+pk_transaction_batch_has_next (PkTransaction *transaction)
+{
+	if (transaction->cached_batch == NULL)
+		return FALSE;
+	return transaction->cached_batch_step + 1 < g_variant_n_children (transaction->cached_batch);
+}
+
+/*
+ * pk_transaction_batch_check_step:
+ *
+ * Does the same checks as the role method would do for one step of a batch.
+ **/
+static gboolean
+pk_transaction_batch_check_step (PkTransaction *transaction,
+				 const gchar *method_name,
+				 GVariant *params,
+				 GError **error)
+{
+	GDBusMethodInfo *method_info;
+	PkRoleEnum role;
+	guint length;
+	g_autofree gchar **package_ids = NULL;
+
+	role = pk_transaction_batch_get_role (method_name);
+	if (role == PK_ROLE_ENUM_UNKNOWN) {
+		g_set_error (error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+			     "%s cannot be part of a batch", method_name);
+		return FALSE;
+	}
+	if (!pk_backend_is_implemented (transaction->backend, role)) {
+		g_set_error (error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+			     "%s not supported by backend", method_name);
+		return FALSE;
+	}
+	method_info = g_dbus_interface_info_lookup_method (transaction->introspection->interfaces[0],
+							   method_name);
+	if (!pk_transaction_check_in_args (method_info, params, error))
+		return FALSE;
+
+	/* every role of a batch takes a list of packages */
+	if (role == PK_ROLE_ENUM_GET_DETAILS ||
+	    role == PK_ROLE_ENUM_GET_UPDATE_DETAIL ||
+	    role == PK_ROLE_ENUM_GET_FILES)
+		g_variant_get (params, "(^a&s)", &package_ids);
+	else if (role == PK_ROLE_ENUM_RESOLVE)
+		g_variant_get (params, "(t^a&s)", NULL, &package_ids);
+	else
+		g_variant_get (params, "(t^a&sb)", NULL, &package_ids, NULL);
+
+	length = g_strv_length (package_ids);
+	if (length == 0) {
+		g_set_error (error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_INPUT_INVALID,
+			     "Too few items to process");
+		return FALSE;
+	}
+	if (role == PK_ROLE_ENUM_RESOLVE) {
+		if (length > PK_TRANSACTION_MAX_ITEMS_TO_RESOLVE) {
+			g_set_error (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_INPUT_INVALID,
+				     "Too many items to process (%i/%i)",
+				     length, PK_TRANSACTION_MAX_ITEMS_TO_RESOLVE);
+			return FALSE;
+		}
+		for (guint i = 0; i < length; i++) {
+			if (!pk_transaction_strvalidate (package_ids[i], error))
+				return FALSE;
+		}
+	} else if (!pk_package_ids_check (package_ids)) {
+		g_autofree gchar *package_ids_temp = pk_package_ids_to_string (package_ids);
+		g_set_error (error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_PACKAGE_ID_INVALID,
+			     "The package-IDs '%s' are not valid",
+			     package_ids_temp);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * pk_transaction_batch_load_step:
+ *
+ * Sets the role and the cached parameters of @transaction for the current
+ * step of the batch, and tells the client which results follow.
+ **/
+static void
+pk_transaction_batch_load_step (PkTransaction *transaction)
+{
+	const gchar *method_name;
+	PkRoleEnum role;
+	g_autoptr(GVariant) params = NULL;
+
+	g_variant_get_child (transaction->cached_batch,
+			     transaction->cached_batch_step,
+			     "(&sv)", &method_name, &params);
+	role = pk_transaction_batch_get_role (method_name);
+	g_debug ("running step %u of batch: %s",
+		 transaction->cached_batch_step, method_name);
+
+	g_clear_pointer (&transaction->cached_package_ids, g_strfreev);
+	if (role == PK_ROLE_ENUM_GET_DETAILS ||
+	    role == PK_ROLE_ENUM_GET_UPDATE_DETAIL ||
+	    role == PK_ROLE_ENUM_GET_FILES) {
+		g_variant_get (params, "(^as)",
+			       &transaction->cached_package_ids);
+	} else if (role == PK_ROLE_ENUM_RESOLVE) {
+		g_variant_get (params, "(t^as)",
+			       &transaction->cached_filters,
+			       &transaction->cached_package_ids);
+	} else {
+		g_variant_get (params, "(t^asb)",
+			       &transaction->cached_filters,
+			       &transaction->cached_package_ids,
+			       &transaction->cached_force);
+	}
+
+	/* everything emitted from now until the next step belongs to this one */
+	flush_pending_packages (transaction);
+	g_dbus_connection_emit_signal (transaction->connection,
+				       NULL,
+				       transaction->tid,
+				       PK_DBUS_INTERFACE_TRANSACTION,
+				       "BatchStep",
+				       g_variant_new ("(uu)",
+						      transaction->cached_batch_step,
+						      role),
+				       NULL);
+	pk_transaction_set_role (transaction, role);
+	pk_backend_job_set_role (transaction->job, role);
+}
+
+static void
+pk_transaction_batch (PkTransaction *transaction,
+		      GVariant *params,
+		      GDBusMethodInvocation *context)
+{
+	const gchar *method_name;
+	GVariant *step_params;
+	GVariantIter iter;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) steps = NULL;
+
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (transaction->tid != NULL);
+
+	g_variant_get (params, "(@a(sv))", &steps);
+	g_debug ("Batch method called: %" G_GSIZE_FORMAT " steps",
+		 g_variant_n_children (steps));
+
+	if (g_variant_n_children (steps) == 0) {
+		g_set_error (&error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_INPUT_INVALID,
+			     "Too few items to process");
+		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+		goto out;
+	}
+
+	/* check each step now, so a batch never fails half way for bad input */
+	g_variant_iter_init (&iter, steps);
+	while (g_variant_iter_next (&iter, "(&sv)", &method_name, &step_params)) {
+		g_autoptr(GVariant) step_params_owned = step_params;
+
+		if (!pk_transaction_batch_check_step (transaction, method_name,
+						      step_params_owned, &error)) {
+			pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+			goto out;
+		}
+	}
+
+	/* save so we can run later; the role changes with each step */
+	transaction->cached_batch = g_steal_pointer (&steps);
+	transaction->cached_batch_step = 0;
+	g_variant_get_child (transaction->cached_batch, 0, "(&sv)", &method_name, NULL);
+	pk_transaction_set_role (transaction, pk_transaction_batch_get_role (method_name));
+	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
+out:
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 void
@@ -3091,7 +3528,7 @@ pk_transaction_cancel (PkTransaction *transaction,
 		g_debug ("No point trying to cancel a finished transaction, ignoring");
 
 		/* return from async with success */
-		pk_transaction_dbus_return (context, NULL);
+		pk_transaction_dbus_return (transaction, context, NULL);
 		goto out;
 	}
 
@@ -3167,7 +3604,7 @@ skip_uid:
 	/* actually run the method */
 	pk_backend_cancel (transaction->backend, transaction->job);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -3235,7 +3672,7 @@ pk_transaction_download_packages (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_DOWNLOAD_PACKAGES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -3264,7 +3701,7 @@ pk_transaction_get_categories (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_CATEGORIES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -3319,7 +3756,7 @@ pk_transaction_depends_on (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_DEPENDS_ON);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -3369,7 +3806,7 @@ pk_transaction_get_details (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_DETAILS);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -3460,7 +3897,7 @@ pk_transaction_get_details_local (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_DETAILS_LOCAL);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -3551,7 +3988,7 @@ pk_transaction_get_files_local (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_FILES_LOCAL);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -3581,7 +4018,7 @@ pk_transaction_get_distro_upgrades (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_DISTRO_UPGRADES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -3630,7 +4067,7 @@ pk_transaction_get_files (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_FILES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -3665,14 +4102,13 @@ pk_transaction_get_packages (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_PACKAGES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
-pk_transaction_get_old_transactions (PkTransaction *transaction,
-				     GVariant *params,
-				     GDBusMethodInvocation *context)
+pk_transaction_get_old_transactions_cb (GObject *source, GAsyncResult *res, gpointer user_data)
 {
+	g_autoptr(PkTransaction) transaction = PK_TRANSACTION (user_data);
 	const gchar *cmdline;
 	const gchar *data;
 	const gchar *modified;
@@ -3682,21 +4118,14 @@ pk_transaction_get_old_transactions (PkTransaction *transaction,
 	GList *transactions = NULL;
 	guint duration;
 	guint idle_id;
-	guint number;
 	guint uid;
 	PkRoleEnum role;
 	PkTransactionPast *item;
+	g_autoptr(GError) error = NULL;
 
-	g_return_if_fail (PK_IS_TRANSACTION (transaction));
-	g_return_if_fail (transaction->tid != NULL);
-
-	g_variant_get (params, "(u)",
-		       &number);
-
-	g_debug ("GetOldTransactions method called");
-
-	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_OLD_TRANSACTIONS);
-	transactions = pk_transaction_db_get_list (transaction->transaction_db, number);
+	transactions = pk_transaction_db_get_list_finish (PK_TRANSACTION_DB (source), res, &error);
+	if (error != NULL)
+		g_warning ("failed to get old transactions: %s", error->message);
 	for (l = transactions; l != NULL; l = l->next) {
 		item = PK_TRANSACTION_PAST (l->data);
 
@@ -3738,8 +4167,31 @@ pk_transaction_get_old_transactions (PkTransaction *transaction,
 
 	idle_id = g_idle_add ((GSourceFunc) pk_transaction_finished_idle_cb, transaction);
 	g_source_set_name_by_id (idle_id, "[PkTransaction] finished from get-old-transactions");
+}
 
-	pk_transaction_dbus_return (context, NULL);
+static void
+pk_transaction_get_old_transactions (PkTransaction *transaction,
+				     GVariant *params,
+				     GDBusMethodInvocation *context)
+{
+	guint number;
+
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (transaction->tid != NULL);
+
+	g_variant_get (params, "(u)",
+		       &number);
+
+	g_debug ("GetOldTransactions method called");
+
+	/* the history is read off the main thread, the transactions are
+	 * emitted once it is done */
+	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_OLD_TRANSACTIONS);
+	pk_transaction_db_get_list_async (transaction->transaction_db, number, NULL,
+					  pk_transaction_get_old_transactions_cb,
+					  g_object_ref (transaction));
+
+	pk_transaction_dbus_return (transaction, context, NULL);
 }
 
 static void
@@ -3774,7 +4226,7 @@ pk_transaction_get_repo_list (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_REPO_LIST);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -3829,7 +4281,7 @@ pk_transaction_required_by (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_REQUIRED_BY);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -3879,7 +4331,7 @@ pk_transaction_get_update_detail (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_UPDATE_DETAIL);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 void
@@ -3914,7 +4366,7 @@ pk_transaction_get_updates (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_UPDATES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static gchar *
@@ -4051,7 +4503,7 @@ pk_transaction_install_files (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 void
@@ -4119,7 +4571,7 @@ pk_transaction_install_packages (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -4189,7 +4641,7 @@ pk_transaction_install_signature (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -4233,7 +4685,7 @@ pk_transaction_refresh_cache (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -4307,7 +4759,7 @@ pk_transaction_remove_packages (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -4361,7 +4813,7 @@ pk_transaction_repo_enable (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -4419,7 +4871,7 @@ pk_transaction_repo_set_data (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -4479,7 +4931,7 @@ pk_transaction_repo_remove (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -4552,7 +5004,7 @@ pk_transaction_resolve (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_RESOLVE);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 void
@@ -4599,7 +5051,7 @@ pk_transaction_search_details (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_SEARCH_DETAILS);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -4659,7 +5111,7 @@ pk_transaction_search_files (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_SEARCH_FILE);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -4719,7 +5171,7 @@ pk_transaction_search_groups (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_SEARCH_GROUP);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 void
@@ -4766,10 +5218,10 @@ pk_transaction_search_names (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_SEARCH_NAME);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
-static gboolean
+gboolean
 pk_transaction_set_hint (PkTransaction *transaction,
 			 const gchar *key,
 			 const gchar *value,
@@ -4896,6 +5348,19 @@ pk_transaction_set_hint (PkTransaction *transaction,
 		return TRUE;
 	}
 
+	/* solution-token=<token from Solution> */
+	if (g_strcmp0 (key, "solution-token") == 0) {
+		if (value == NULL || value[0] == '\0') {
+			g_set_error_literal (error,
+					     PK_TRANSACTION_ERROR,
+					     PK_TRANSACTION_ERROR_INPUT_INVALID,
+					     "Could not set solution-token to nothing");
+			return FALSE;
+		}
+		pk_backend_job_set_solution_token (transaction->job, value);
+		return TRUE;
+	}
+
 	/* Is the plural Packages signal supported? The key’s value is ignored,
 	 * as clients will only send it if it’s true. */
 	if (g_strcmp0 (key, "supports-plural-signals") == 0) {
@@ -4918,13 +5383,34 @@ pk_transaction_set_hint (PkTransaction *transaction,
 	return TRUE;
 }
 
+static gboolean
+pk_transaction_set_hints_strv (PkTransaction *transaction,
+			       gchar **hints,
+			       GError **error)
+{
+	for (guint i = 0; hints[i] != NULL; i++) {
+		g_auto(GStrv) sections = NULL;
+		sections = g_strsplit (hints[i], "=", 2);
+		if (g_strv_length (sections) != 2) {
+			g_set_error (error, PK_TRANSACTION_ERROR,
+					    PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+					    "Could not parse hint '%s'", hints[i]);
+			return FALSE;
+		}
+		if (!pk_transaction_set_hint (transaction,
+					      sections[0],
+					      sections[1],
+					      error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
 static void
 pk_transaction_set_hints (PkTransaction *transaction,
 			  GVariant *params,
 			  GDBusMethodInvocation *context)
 {
-	gboolean ret;
-	guint i;
 	g_autofree gchar **hints = NULL;
 	g_autoptr(GError) error = NULL;
 	g_autofree gchar *dbg = NULL;
@@ -4936,26 +5422,8 @@ pk_transaction_set_hints (PkTransaction *transaction,
 	dbg = g_strjoinv (", ", (gchar**) hints);
 	g_debug ("SetHints method called: %s", dbg);
 
-	/* parse */
-	for (i = 0; hints[i] != NULL; i++) {
-		g_auto(GStrv) sections = NULL;
-		sections = g_strsplit (hints[i], "=", 2);
-		if (g_strv_length (sections) == 2) {
-			ret = pk_transaction_set_hint (transaction,
-						       sections[0],
-						       sections[1],
-						       &error);
-			if (!ret)
-				goto out;
-		} else {
-			g_set_error (&error, PK_TRANSACTION_ERROR,
-					     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
-					     "Could not parse hint '%s'", hints[i]);
-			goto out;
-		}
-	}
-out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_set_hints_strv (transaction, hints, &error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -5024,7 +5492,7 @@ pk_transaction_update_packages (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -5071,7 +5539,7 @@ pk_transaction_what_provides (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_WHAT_PROVIDES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -5131,7 +5599,7 @@ pk_transaction_upgrade_system (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static void
@@ -5182,7 +5650,7 @@ pk_transaction_repair_system (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 static GVariant *
@@ -5237,6 +5705,12 @@ pk_transaction_get_property (GDBusConnection *connection_, const gchar *sender,
 	return NULL;
 }
 
+static void	pk_transaction_dispatch		(PkTransaction		*transaction,
+						 const gchar		*sender,
+						 const gchar		*method_name,
+						 GVariant		*parameters,
+						 GDBusMethodInvocation	*invocation);
+
 static void
 pk_transaction_method_call (GDBusConnection *connection_, const gchar *sender,
 			    const gchar *object_path, const gchar *interface_name,
@@ -5265,6 +5739,19 @@ pk_transaction_method_call (GDBusConnection *connection_, const gchar *sender,
 		pk_transaction_cancel (transaction, parameters, invocation);
 		return;
 	}
+	pk_transaction_dispatch (transaction, sender, method_name, parameters, invocation);
+}
+
+/*
+ * pk_transaction_dispatch:
+ *
+ * Calls the method that sets the role of a new transaction.
+ **/
+static void
+pk_transaction_dispatch (PkTransaction *transaction, const gchar *sender,
+			 const gchar *method_name, GVariant *parameters,
+			 GDBusMethodInvocation *invocation)
+{
 
 	/* All action methods below must only be invoked once on a new transaction.
 	 * Reject any attempt to re-invoke them after the transaction has been initialized,
@@ -5287,6 +5774,10 @@ pk_transaction_method_call (GDBusConnection *connection_, const gchar *sender,
 		pk_transaction_accept_eula (transaction, parameters, invocation);
 		return;
 	}
+	if (g_strcmp0 (method_name, "Batch") == 0) {
+		pk_transaction_batch (transaction, parameters, invocation);
+		return;
+	}
 	if (g_strcmp0 (method_name, "DownloadPackages") == 0) {
 		pk_transaction_download_packages (transaction, parameters, invocation);
 		return;
@@ -5420,6 +5911,60 @@ pk_transaction_method_call (GDBusConnection *connection_, const gchar *sender,
 					       sender);
 }
 
+/**
+ * pk_transaction_start:
+ * @transaction: a new #PkTransaction
+ * @hints: the hints, as for SetHints()
+ * @method_name: the method that sets the role, e.g. "Resolve"
+ * @parameters: the parameters of @method_name
+ * @invocation: the StartTransaction() invocation
+ *
+ * Applies the hints and calls the role method, so that the transaction can
+ * be started with a single method call on the daemon. The invocation returns
+ * the transaction ID on success.
+ **/
+void
+pk_transaction_start (PkTransaction *transaction,
+		      gchar **hints,
+		      const gchar *method_name,
+		      GVariant *parameters,
+		      GDBusMethodInvocation *invocation)
+{
+	GDBusMethodInfo *method_info;
+	g_autoptr(GError) error = NULL;
+
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (transaction->tid != NULL);
+
+	/* only methods that set the role can be used */
+	method_info = g_dbus_interface_info_lookup_method (transaction->introspection->interfaces[0],
+							   method_name);
+	if (method_info == NULL ||
+	    g_strcmp0 (method_name, "SetHints") == 0 ||
+	    g_strcmp0 (method_name, "Cancel") == 0) {
+		g_set_error (&error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+			     "cannot start a transaction with %s", method_name);
+		goto out;
+	}
+
+	/* GDBus only checked the signature of StartTransaction() */
+	if (!pk_transaction_check_in_args (method_info, parameters, &error))
+		goto out;
+
+	pk_transaction_set_hints_strv (transaction, hints, &error);
+out:
+	if (error != NULL) {
+		g_dbus_method_invocation_return_gerror (invocation, error);
+		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+		return;
+	}
+	pk_transaction_dispatch (transaction,
+				 g_dbus_method_invocation_get_sender (invocation),
+				 method_name, parameters, invocation);
+}
+
 gboolean
 pk_transaction_set_tid (PkTransaction *transaction, const gchar *tid)
 {
@@ -5547,6 +6092,7 @@ pk_transaction_dispose (GObject *object)
 	}
 
 	unschedule_progress_changed (transaction);
+	flush_pending_packages (transaction);
 
 	/* send signal to clients that we are about to be destroyed */
 	if (transaction->connection != NULL) {
@@ -5580,6 +6126,7 @@ pk_transaction_finalize (GObject *object)
 	g_free (transaction->cached_package_id);
 	g_free (transaction->cached_key_id);
 	g_strfreev (transaction->cached_package_ids);
+	g_clear_pointer (&transaction->cached_batch, g_variant_unref);
 	g_free (transaction->cached_transaction_id);
 	g_free (transaction->cached_directory);
 	g_strfreev (transaction->cached_values);
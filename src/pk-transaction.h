@@ -68,6 +68,11 @@ void		 pk_transaction_set_state			(PkTransaction	*transaction,
 								 PkTransactionState state);
 const gchar	*pk_transaction_state_to_string			(PkTransactionState state);
 const gchar	*pk_transaction_get_tid				(PkTransaction	*transaction);
+void		 pk_transaction_start				(PkTransaction	*transaction,
+								 gchar		**hints,
+								 const gchar	*method_name,
+								 GVariant	*parameters,
+								 GDBusMethodInvocation *invocation);
 gboolean	 pk_transaction_is_exclusive			(PkTransaction	*transaction);
 gboolean	 pk_transaction_is_finished_with_lock_required	(PkTransaction *transaction);
 void		 pk_transaction_reset_after_lock_error		(PkTransaction *transaction);
@@ -25,6 +25,7 @@
 #include <glib.h>
 #include <glib-object.h>
 #include <glib/gstdio.h>
+#include <unistd.h>
 
 #include "pk-backend.h"
 #include "pk-backend-spawn.h"
@@ -152,6 +153,39 @@ pk_test_backend_packages_cb (PkBackend *backend, GPtrArray *package_array, gpoin
 	}
 }
 
+#define PK_TEST_BACKEND_JOB_ORDER_COUNT	2000
+
+static guint ordered_packages = 0;
+
+static void
+pk_test_backend_func_ordered (PkBackendJob *job,
+			      GVariant *params,
+			      gpointer user_data)
+{
+	for (guint i = 0; i < PK_TEST_BACKEND_JOB_ORDER_COUNT; i++) {
+		g_autofree gchar *package_id = g_strdup_printf ("pkg%u;1.0;noarch;test", i);
+		pk_backend_job_package (job, PK_INFO_ENUM_AVAILABLE, package_id, "summary");
+	}
+}
+
+static void
+pk_test_backend_ordered_package_cb (PkBackend *backend, PkPackage *package, gpointer user_data)
+{
+	g_autofree gchar *expected = g_strdup_printf ("pkg%u", ordered_packages);
+
+	/* delivered in the order they were emitted */
+	g_assert_cmpstr (pk_package_get_name (package), ==, expected);
+	ordered_packages++;
+}
+
+static void
+pk_test_backend_ordered_finished_cb (PkBackend *backend, PkExitEnum exit, gpointer user_data)
+{
+	/* finished is always delivered last */
+	g_assert_cmpint (ordered_packages, ==, PK_TEST_BACKEND_JOB_ORDER_COUNT);
+	_g_test_loop_quit ();
+}
+
 static void
 pk_test_backend_func (void)
 {
@@ -291,6 +325,28 @@ pk_test_backend_func (void)
 	/* wait for Finished */
 	_g_test_loop_wait (10);
 
+	/* reset */
+	g_object_unref (job);
+	job = pk_backend_job_new (conf);
+	pk_backend_job_set_backend (job, backend);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_PACKAGE,
+				  PK_BACKEND_JOB_VFUNC (pk_test_backend_ordered_package_cb),
+				  NULL);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_FINISHED,
+				  PK_BACKEND_JOB_VFUNC (pk_test_backend_ordered_finished_cb),
+				  NULL);
+
+	/* emit lots of packages, which are delivered in batches */
+	ret = pk_backend_job_thread_create (job,
+					    pk_test_backend_func_ordered,
+					    NULL,
+					    NULL);
+	g_assert_true (ret);
+	_g_test_loop_run_with_timeout (5000);
+	g_assert_cmpint (ordered_packages, ==, PK_TEST_BACKEND_JOB_ORDER_COUNT);
+
 	/* reset */
 	g_object_unref (job);
 	job = pk_backend_job_new (conf);
@@ -491,6 +547,27 @@ pk_test_backend_spawn_func (void)
 	/* test number of packages */
 	g_assert_cmpint (_backend_spawn_number_packages, ==, 2);
 
+	/* test a helper switching to framed records */
+	g_object_unref (job);
+	job = pk_backend_job_new (conf);
+	pk_backend_job_set_backend (job, backend);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_FINISHED,
+				  PK_BACKEND_JOB_VFUNC (pk_test_backend_spawn_finished_cb),
+				  backend_spawn);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_PACKAGE,
+				  PK_BACKEND_JOB_VFUNC (pk_test_backend_spawn_package_cb),
+				  backend_spawn);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_PACKAGES,
+				  PK_BACKEND_JOB_VFUNC (pk_test_backend_spawn_packages_cb),
+				  backend_spawn);
+	ret = pk_backend_spawn_helper (backend_spawn, job, "search-latency.py", "3", "0", "binary", NULL);
+	g_assert_true (ret);
+	_g_test_loop_run_with_timeout (10000);
+	g_assert_cmpint (_backend_spawn_number_packages, ==, 5);
+
 	/* manually unlock as we have no engine */
 	ret = pk_backend_unload (backend);
 	g_assert_true (ret);
@@ -714,6 +791,28 @@ pk_test_spawn_func (void)
 	/* we got another package (and finished) */
 	g_assert_cmpint (stdout_count, ==, 4);
 
+	/* run the dispatcher with a new environment, which it accepts on stdin */
+	g_strfreev (envp);
+	envp = g_strsplit ("NETWORK=FALSE LANG=C.UTF-8 BACKGROUND=TRUE INTERACTIVE=TRUE UID=500", " ", 0);
+	ret = pk_spawn_argv (spawn, argv, envp, PK_SPAWN_ARGV_FLAGS_NONE, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	_g_test_loop_wait (100);
+	g_assert_cmpint (stdout_count, ==, 6);
+	g_assert_cmpint (mexit, ==, PK_SPAWN_EXIT_TYPE_UNKNOWN);
+
+	/* a new locale is only applied by a new instance */
+	g_strfreev (envp);
+	envp = g_strsplit ("NETWORK=FALSE LANG=C BACKGROUND=TRUE INTERACTIVE=TRUE UID=500", " ", 0);
+	ret = pk_spawn_argv (spawn, argv, envp, PK_SPAWN_ARGV_FLAGS_NONE, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	g_assert_cmpint (mexit, ==, PK_SPAWN_EXIT_TYPE_DISPATCHER_CHANGED);
+	mexit = PK_SPAWN_EXIT_TYPE_UNKNOWN;
+	_g_test_loop_wait (4000);
+	g_assert_cmpint (stdout_count, ==, 8);
+	g_assert_true (pk_spawn_is_running (spawn));
+
 	/* see if pk_spawn_exit blocks (required) */
 	g_idle_add (idle_cb, NULL);
 
@@ -737,6 +836,23 @@ pk_test_spawn_func (void)
 	/* ask dispatcher to close (again) */
 	ret = pk_spawn_exit (spawn);
 	g_assert_true (!ret);
+
+	/* start the dispatcher again before it has anything to do */
+	ret = pk_spawn_prestart (spawn, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	g_assert_true (pk_spawn_is_running (spawn));
+
+	/* it is reused for the next command */
+	mexit = PK_SPAWN_EXIT_TYPE_UNKNOWN;
+	ret = pk_spawn_argv (spawn, argv, envp, PK_SPAWN_ARGV_FLAGS_NONE, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	_g_test_loop_wait (4000);
+	g_assert_cmpint (stdout_count, ==, 10);
+	g_assert_cmpint (mexit, ==, PK_SPAWN_EXIT_TYPE_UNKNOWN);
+	ret = pk_spawn_exit (spawn);
+	g_assert_true (ret);
 }
 
 static void
@@ -771,6 +887,173 @@ pk_test_transaction_func (void)
 	g_dbus_node_info_unref (introspection);
 }
 
+typedef struct {
+	GPtrArray	*signals;	/* "Packages:<n>" or the signal name */
+	const gchar	*quit_on;
+} PkTestTransactionSignals;
+
+static void
+pk_test_transaction_signal_cb (GDBusConnection *connection,
+			       const gchar *sender_name,
+			       const gchar *object_path,
+			       const gchar *interface_name,
+			       const gchar *signal_name,
+			       GVariant *parameters,
+			       gpointer user_data)
+{
+	PkTestTransactionSignals *helper = (PkTestTransactionSignals *) user_data;
+
+	if (g_strcmp0 (signal_name, "Packages") == 0) {
+		g_autoptr(GVariant) packages = g_variant_get_child_value (parameters, 0);
+		g_ptr_array_add (helper->signals,
+				 g_strdup_printf ("Packages:%" G_GSIZE_FORMAT,
+						  g_variant_n_children (packages)));
+	} else {
+		g_ptr_array_add (helper->signals, g_strdup (signal_name));
+	}
+	if (g_strcmp0 (signal_name, helper->quit_on) == 0)
+		_g_test_loop_quit ();
+}
+
+static void
+pk_test_transaction_emit_packages (PkTransaction *transaction, guint count)
+{
+	for (guint i = 0; i < count; i++) {
+		g_autoptr(PkPackage) item = pk_package_new ();
+		g_autofree gchar *package_id = NULL;
+		gboolean ret;
+
+		package_id = g_strdup_printf ("test%u;1.0;noarch;local", i);
+		ret = pk_package_set_id (item, package_id, NULL);
+		g_assert_true (ret);
+		pk_package_set_info (item, PK_INFO_ENUM_AVAILABLE);
+		pk_package_set_summary (item, "Test package");
+		pk_transaction_package_cb (NULL, item, transaction);
+	}
+}
+
+static void
+pk_test_transaction_packages_func (void)
+{
+	gboolean ret;
+	gint64 start;
+	guint subscription_id;
+	GError *error = NULL;
+	GDBusNodeInfo *introspection;
+	g_autoptr(GDBusConnection) connection = NULL;
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(GPtrArray) signals = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(PkError) item = NULL;
+	PkTestTransactionSignals helper = { signals, NULL };
+	PkTransaction *transaction;
+
+	introspection = pk_load_introspection (PK_DBUS_INTERFACE_TRANSACTION ".xml", NULL);
+	g_assert_true (introspection != NULL);
+
+	conf = g_key_file_new ();
+	transaction = pk_transaction_new (conf, introspection);
+	g_assert_true (transaction != NULL);
+	ret = pk_transaction_set_tid (transaction, "/1_packages");
+	g_assert_true (ret);
+	ret = pk_transaction_set_hint (transaction, "supports-plural-signals", "true", &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+
+	/* the transaction emits on the shared system bus connection */
+	connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+	g_assert_no_error (error);
+	subscription_id = g_dbus_connection_signal_subscribe (connection,
+							      NULL,
+							      PK_DBUS_INTERFACE_TRANSACTION,
+							      NULL,
+							      "/1_packages",
+							      NULL,
+							      G_DBUS_SIGNAL_FLAGS_NONE,
+							      pk_test_transaction_signal_cb,
+							      &helper,
+							      NULL);
+
+	/* a full batch is sent straight away, and the rest before the error */
+	pk_test_transaction_emit_packages (transaction, 501);
+	item = pk_error_new ();
+	g_object_set (item,
+		      "code", PK_ERROR_ENUM_NO_NETWORK,
+		      "details", "test",
+		      NULL);
+	pk_transaction_error_code_cb (NULL, item, transaction);
+	helper.quit_on = "ErrorCode";
+	_g_test_loop_run_with_timeout (2000);
+	g_assert_cmpint (signals->len, ==, 3);
+	g_assert_cmpstr (g_ptr_array_index (signals, 0), ==, "Packages:500");
+	g_assert_cmpstr (g_ptr_array_index (signals, 1), ==, "Packages:1");
+	g_assert_cmpstr (g_ptr_array_index (signals, 2), ==, "ErrorCode");
+	g_ptr_array_set_size (signals, 0);
+
+	/* a partial batch is sent once the backend goes quiet */
+	start = g_get_monotonic_time ();
+	pk_test_transaction_emit_packages (transaction, 3);
+	helper.quit_on = "Packages";
+	_g_test_loop_run_with_timeout (2000);
+	g_assert_cmpint (g_get_monotonic_time () - start, >=, 50 * G_TIME_SPAN_MILLISECOND);
+	g_assert_cmpint (signals->len, ==, 1);
+	g_assert_cmpstr (g_ptr_array_index (signals, 0), ==, "Packages:3");
+	g_ptr_array_set_size (signals, 0);
+
+	/* anything still pending is sent before the transaction goes away */
+	pk_test_transaction_emit_packages (transaction, 2);
+	g_object_unref (transaction);
+	helper.quit_on = "Destroy";
+	_g_test_loop_run_with_timeout (2000);
+	g_assert_cmpint (signals->len, ==, 2);
+	g_assert_cmpstr (g_ptr_array_index (signals, 0), ==, "Packages:2");
+	g_assert_cmpstr (g_ptr_array_index (signals, 1), ==, "Destroy");
+
+	g_dbus_connection_signal_unsubscribe (connection, subscription_id);
+	g_dbus_node_info_unref (introspection);
+}
+
+static void
+pk_test_transaction_db_result_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GAsyncResult **result = (GAsyncResult **) user_data;
+	*result = g_object_ref (res);
+	_g_test_loop_quit ();
+}
+
+/* the reads are answered by the writer thread, on the main loop */
+static GList *
+pk_test_transaction_db_get_list (PkTransactionDb *tdb, guint limit)
+{
+	GList *list;
+	g_autoptr(GAsyncResult) res = NULL;
+	g_autoptr(GError) error = NULL;
+
+	pk_transaction_db_get_list_async (tdb, limit, NULL,
+					  pk_test_transaction_db_result_cb, &res);
+	_g_test_loop_run_with_timeout (5000);
+	g_assert_nonnull (res);
+	list = pk_transaction_db_get_list_finish (tdb, res, &error);
+	g_assert_no_error (error);
+	return list;
+}
+
+static GPtrArray *
+pk_test_transaction_db_get_package_history (PkTransactionDb *tdb, const gchar *name)
+{
+	GPtrArray *history;
+	g_autoptr(GAsyncResult) res = NULL;
+	g_autoptr(GError) error = NULL;
+
+	pk_transaction_db_get_package_history_async (tdb, name, 0, NULL,
+						     pk_test_transaction_db_result_cb, &res);
+	_g_test_loop_run_with_timeout (5000);
+	g_assert_nonnull (res);
+	history = pk_transaction_db_get_package_history_finish (tdb, res, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (history);
+	return history;
+}
+
 static void
 pk_test_transaction_db_func (void)
 {
@@ -779,6 +1062,10 @@ pk_test_transaction_db_func (void)
 	gboolean ret;
 	gdouble ms;
 	GError *error = NULL;
+	GList *list;
+	GPtrArray *history;
+	PkTransactionPast *item;
+	PkTransactionDbHistoryItem *history_item;
 	g_autoptr(PkTransactionDb) db = NULL;
 	g_autofree gchar *proxy_http = NULL;
 	g_autofree gchar *proxy_ftp = NULL;
@@ -897,6 +1184,62 @@ pk_test_transaction_db_func (void)
 	g_assert_true (ret);
 	g_assert_cmpstr (proxy_http, ==, "127.0.0.1:80");
 	g_assert_cmpstr (proxy_ftp, ==, "127.0.0.1:21");
+
+	/* are the queued updates of a transaction written together */
+	tid = pk_transaction_db_generate_id (db);
+	g_assert_true (pk_transaction_db_add (db, tid));
+	g_assert_true (pk_transaction_db_set_role (db, tid, PK_ROLE_ENUM_INSTALL_PACKAGES));
+	g_assert_true (pk_transaction_db_set_uid (db, tid, 500));
+	g_assert_true (pk_transaction_db_set_data (db, tid,
+						   "installing\thal;0.1.2;i386;fedora\tHardware Layer\n"
+						   "downloading\tglib2;2.14.0;i386;fedora\tThe GLib library"));
+	g_assert_true (pk_transaction_db_set_finished (db, tid, TRUE, 1234));
+	list = pk_test_transaction_db_get_list (db, 1);
+	g_assert_cmpint (g_list_length (list), ==, 1);
+	item = PK_TRANSACTION_PAST (list->data);
+	g_assert_cmpstr (pk_transaction_past_get_id (item), ==, tid);
+	g_assert_cmpint (pk_transaction_past_get_role (item), ==, PK_ROLE_ENUM_INSTALL_PACKAGES);
+	g_assert_cmpint (pk_transaction_past_get_uid (item), ==, 500);
+	g_assert_true (pk_transaction_past_get_succeeded (item));
+	g_assert_cmpint (pk_transaction_past_get_duration (item), ==, 1234);
+	g_list_free_full (list, g_object_unref);
+
+	/* are the changed packages indexed by name */
+	history = pk_test_transaction_db_get_package_history (db, "hal");
+	g_assert_cmpint (history->len, ==, 1);
+	history_item = g_ptr_array_index (history, 0);
+	g_assert_cmpstr (history_item->package_id, ==, "hal;0.1.2;i386;fedora");
+	g_assert_cmpint (history_item->info, ==, PK_INFO_ENUM_INSTALLING);
+	g_assert_cmpint (history_item->uid, ==, 500);
+	g_assert_cmpint (history_item->timestamp, >, 0);
+	g_ptr_array_unref (history);
+	history = pk_test_transaction_db_get_package_history (db, "glib2");
+	g_assert_cmpint (history->len, ==, 0);
+	g_ptr_array_unref (history);
+	g_free (tid);
+
+	/* a transaction without a uid is not attributed to root */
+	tid = pk_transaction_db_generate_id (db);
+	g_assert_true (pk_transaction_db_add (db, tid));
+	g_assert_true (pk_transaction_db_set_role (db, tid, PK_ROLE_ENUM_REMOVE_PACKAGES));
+	g_assert_true (pk_transaction_db_set_data (db, tid,
+						   "removing\tdbus;1.2.3;i386;fedora\tSystem message bus"));
+	g_assert_true (pk_transaction_db_set_finished (db, tid, TRUE, 10));
+	list = pk_test_transaction_db_get_list (db, 0);
+	item = NULL;
+	for (GList *l = list; l != NULL; l = l->next) {
+		if (g_strcmp0 (pk_transaction_past_get_id (l->data), tid) == 0)
+			item = PK_TRANSACTION_PAST (l->data);
+	}
+	g_assert_nonnull (item);
+	g_assert_cmpuint (pk_transaction_past_get_uid (item), ==, G_MAXUINT);
+	g_list_free_full (list, g_object_unref);
+	history = pk_test_transaction_db_get_package_history (db, "dbus");
+	g_assert_cmpint (history->len, ==, 1);
+	history_item = g_ptr_array_index (history, 0);
+	g_assert_cmpuint (history_item->uid, ==, G_MAXUINT);
+	g_ptr_array_unref (history);
+	g_free (tid);
 }
 
 static PkTransactionDb *db = NULL;
@@ -1440,6 +1783,233 @@ pk_test_scheduler_parallel_func (void)
 	g_object_unref (db);
 }
 
+#define PK_TEST_BACKEND_JOB_EMITTED_COUNT	100000
+
+static gsize
+pk_test_get_rss (void)
+{
+	g_autofree gchar *statm = NULL;
+	g_auto(GStrv) fields = NULL;
+
+	if (!g_file_get_contents ("/proc/self/statm", &statm, NULL, NULL))
+		return 0;
+	fields = g_strsplit (statm, " ", -1);
+	if (g_strv_length (fields) < 2)
+		return 0;
+	return g_ascii_strtoull (fields[1], NULL, 10) * sysconf (_SC_PAGESIZE);
+}
+
+static gsize
+pk_test_backend_job_emit_many (GKeyFile *conf, gboolean unique_packages)
+{
+	gsize rss_before = pk_test_get_rss ();
+	gsize rss_after;
+	g_autoptr(PkBackendJob) job = pk_backend_job_new (conf);
+
+	pk_backend_job_set_unique_packages (job, unique_packages);
+	for (guint i = 0; i < PK_TEST_BACKEND_JOB_EMITTED_COUNT; i++) {
+		g_autofree gchar *package_id = NULL;
+		package_id = g_strdup_printf ("package-%u;1.2.3-%u.fc40;x86_64;fedora", i, i % 7);
+		pk_backend_job_package (job, PK_INFO_ENUM_AVAILABLE, package_id,
+					"A reasonably long summary of what this package does");
+	}
+	rss_after = pk_test_get_rss ();
+	return rss_after > rss_before ? rss_after - rss_before : 0;
+}
+
+static void
+pk_test_backend_job_emitted_func (void)
+{
+	g_autoptr(GKeyFile) conf = g_key_file_new ();
+	g_autoptr(GHashTable) legacy = NULL;
+	gsize rss_before;
+	gsize rss_legacy;
+	gsize rss_unique;
+	gsize rss_dedup;
+
+	/* measure from the cheapest to the most expensive, as freed memory is
+	 * not necessarily returned to the system */
+	rss_unique = pk_test_backend_job_emit_many (conf, TRUE);
+	rss_dedup = pk_test_backend_job_emit_many (conf, FALSE);
+
+	/* what the job used to keep: a copy of the ID and a ref on every package */
+	rss_before = pk_test_get_rss ();
+	legacy = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+	for (guint i = 0; i < PK_TEST_BACKEND_JOB_EMITTED_COUNT; i++) {
+		g_autofree gchar *package_id = NULL;
+		PkPackage *item = pk_package_new ();
+		package_id = g_strdup_printf ("package-%u;1.2.3-%u.fc40;x86_64;fedora", i, i % 7);
+		pk_package_set_id (item, package_id, NULL);
+		pk_package_set_summary (item, "A reasonably long summary of what this package does");
+		g_hash_table_insert (legacy, g_strdup (package_id), item);
+	}
+	rss_legacy = pk_test_get_rss ();
+	rss_legacy = rss_legacy > rss_before ? rss_legacy - rss_before : 0;
+
+	g_test_message ("RSS growth for %u emitted packages: unique %" G_GSIZE_FORMAT " KiB, "
+			"deduplicated %" G_GSIZE_FORMAT " KiB, package table %" G_GSIZE_FORMAT " KiB",
+			PK_TEST_BACKEND_JOB_EMITTED_COUNT,
+			rss_unique / 1024, rss_dedup / 1024, rss_legacy / 1024);
+	g_test_minimized_result ((gdouble) rss_dedup / 1024,
+				 "deduplicated emission RSS growth: %" G_GSIZE_FORMAT " KiB",
+				 rss_dedup / 1024);
+	g_assert_cmpuint (rss_unique, <=, rss_dedup);
+}
+
+#define PK_TEST_SPAWN_LATENCY_COUNT	100
+
+typedef struct {
+	guint		 count;
+	gint64		 total;
+	gint64		 max;
+} PkTestSpawnLatency;
+
+static void
+pk_test_spawn_latency_finished_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	_g_test_loop_quit ();
+}
+
+static void
+pk_test_spawn_latency_package_cb (PkBackendJob *job, PkPackage *item, gpointer user_data)
+{
+	PkTestSpawnLatency *latency = user_data;
+	gint64 written;
+	gint64 delta;
+
+	/* the helper puts the time it wrote the line into the summary */
+	written = g_ascii_strtoll (pk_package_get_summary (item), NULL, 10);
+	delta = g_get_monotonic_time () - written;
+	latency->count++;
+	latency->total += delta;
+	latency->max = MAX (latency->max, delta);
+}
+
+static void
+pk_test_spawn_latency_func (void)
+{
+	g_autoptr(GKeyFile) conf = g_key_file_new ();
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkBackendJob) job = NULL;
+	g_autoptr(PkBackendSpawn) backend_spawn = NULL;
+	g_autofree gchar *count = g_strdup_printf ("%u", PK_TEST_SPAWN_LATENCY_COUNT);
+	PkTestSpawnLatency latency = { 0 };
+	gdouble average;
+	gboolean ret;
+
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "test_spawn");
+	backend = pk_backend_new (conf);
+	job = pk_backend_job_new (conf);
+	pk_backend_job_set_backend (job, backend);
+	backend_spawn = pk_backend_spawn_new (conf);
+	ret = pk_backend_spawn_set_name (backend_spawn, "test_spawn");
+	g_assert_true (ret);
+
+	/* measure from the helper writing a line to the job emitting the
+	 * package, which is what gets sent on the bus */
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_FINISHED,
+				  PK_BACKEND_JOB_VFUNC (pk_test_spawn_latency_finished_cb),
+				  NULL);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_PACKAGE,
+				  PK_BACKEND_JOB_VFUNC (pk_test_spawn_latency_package_cb),
+				  &latency);
+	ret = pk_backend_spawn_helper (backend_spawn, job, "search-latency.py", count, NULL);
+	g_assert_true (ret);
+	_g_test_loop_run_with_timeout (10000);
+	g_assert_cmpuint (latency.count, ==, PK_TEST_SPAWN_LATENCY_COUNT);
+
+	average = (gdouble) latency.total / latency.count / 1000;
+	g_test_message ("helper output latency for %u packages: average %.2f ms, max %.2f ms",
+			latency.count, average, (gdouble) latency.max / 1000);
+	g_test_minimized_result (average, "average helper output latency: %.2f ms", average);
+
+	/* manually unlock as we have no engine */
+	ret = pk_backend_unload (backend);
+	g_assert_true (ret);
+}
+
+#define PK_TEST_SPAWN_THROUGHPUT_COUNT	50000
+
+/* from the helper writing as fast as it can to the package vfunc */
+static gdouble
+pk_test_spawn_throughput_helper (GKeyFile *conf,
+				 PkBackend *backend,
+				 PkBackendSpawn *backend_spawn,
+				 const gchar *framing)
+{
+	g_autoptr(PkBackendJob) job = NULL;
+	g_autoptr(GTimer) timer = g_timer_new ();
+	g_autofree gchar *count = g_strdup_printf ("%u", PK_TEST_SPAWN_THROUGHPUT_COUNT);
+	PkTestSpawnLatency latency = { 0 };
+	gdouble elapsed;
+	gboolean ret;
+
+	job = pk_backend_job_new (conf);
+	pk_backend_job_set_backend (job, backend);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_FINISHED,
+				  PK_BACKEND_JOB_VFUNC (pk_test_spawn_latency_finished_cb),
+				  NULL);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_PACKAGE,
+				  PK_BACKEND_JOB_VFUNC (pk_test_spawn_latency_package_cb),
+				  &latency);
+	ret = pk_backend_spawn_helper (backend_spawn, job, "search-latency.py", count, "0", framing, NULL);
+	g_assert_true (ret);
+	_g_test_loop_run_with_timeout (60000);
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_assert_cmpuint (latency.count, ==, PK_TEST_SPAWN_THROUGHPUT_COUNT);
+	g_test_message ("received %u packages from the helper as %s in %.1f ms (%.0f lines/s)",
+			latency.count, framing, elapsed * 1000, latency.count / elapsed);
+	return latency.count / elapsed;
+}
+
+static void
+pk_test_spawn_throughput_func (void)
+{
+	g_autoptr(GKeyFile) conf = g_key_file_new ();
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkBackendJob) job = NULL;
+	g_autoptr(PkBackendSpawn) backend_spawn = NULL;
+	g_autoptr(GTimer) timer = g_timer_new ();
+	gdouble elapsed;
+	gdouble rate;
+	gboolean ret;
+
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "test_spawn");
+	backend = pk_backend_new (conf);
+	job = pk_backend_job_new (conf);
+	pk_backend_job_set_backend (job, backend);
+	backend_spawn = pk_backend_spawn_new (conf);
+	ret = pk_backend_spawn_set_name (backend_spawn, "test_spawn");
+	g_assert_true (ret);
+
+	/* parsing only */
+	for (guint i = 0; i < PK_TEST_SPAWN_THROUGHPUT_COUNT; i++) {
+		g_autofree gchar *line = NULL;
+		line = g_strdup_printf ("package\tavailable\tthroughput-%u;1.0;noarch;test\t"
+					"A reasonably long summary of what this package does", i);
+		ret = pk_backend_spawn_inject_data (backend_spawn, job, line, NULL);
+		g_assert_true (ret);
+	}
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_test_message ("parsed %u package lines in %.1f ms",
+			PK_TEST_SPAWN_THROUGHPUT_COUNT, elapsed * 1000);
+	g_test_minimized_result (elapsed, "parse: %.1f ms", elapsed * 1000);
+
+	/* end to end, as lines and as framed records */
+	rate = pk_test_spawn_throughput_helper (conf, backend, backend_spawn, "text");
+	g_test_maximized_result (rate, "text: %.0f lines/s", rate);
+	rate = pk_test_spawn_throughput_helper (conf, backend, backend_spawn, "binary");
+	g_test_maximized_result (rate, "binary: %.0f records/s", rate);
+
+	/* manually unlock as we have no engine */
+	ret = pk_backend_unload (backend);
+	g_assert_true (ret);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -1451,6 +2021,7 @@ main (int argc, char **argv)
 
 	/* components */
 	g_test_add_func ("/packagekit/transaction", pk_test_transaction_func);
+	g_test_add_func ("/packagekit/transaction-packages", pk_test_transaction_packages_func);
 	g_test_add_func ("/packagekit/dbus", pk_test_dbus_func);
 	g_test_add_func ("/packagekit/spawn", pk_test_spawn_func);
 	g_test_add_func ("/packagekit/scheduler", pk_test_scheduler_func);
@@ -1461,6 +2032,13 @@ main (int argc, char **argv)
 	g_test_add_func ("/packagekit/backend", pk_test_backend_func);
 	g_test_add_func ("/packagekit/backend_spawn", pk_test_backend_spawn_func);
 
+	/* benchmarks, run with -m perf */
+	if (g_test_perf ()) {
+		g_test_add_func ("/packagekit/backend-job/emitted", pk_test_backend_job_emitted_func);
+		g_test_add_func ("/packagekit/spawn/latency", pk_test_spawn_latency_func);
+		g_test_add_func ("/packagekit/spawn/throughput", pk_test_spawn_throughput_func);
+	}
+
 	return g_test_run ();
 }
 
@@ -28,6 +28,7 @@
 
 #include "pk-client.h"
 #include "pk-client-helper.h"
+#include "pk-client-private.h"
 #include "pk-control.h"
 #include "pk-console-private.h"
 #include "pk-offline.h"
@@ -1270,6 +1271,46 @@ pk_test_package_sack_func (void)
 	g_object_unref (sack);
 }
 
+static void
+pk_test_client_solution_func (void)
+{
+	g_autofree gchar *token = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkClient) client = pk_client_new ();
+	g_autoptr(PkResults) results = NULL;
+	g_auto(GStrv) package_ids = pk_package_ids_from_id ("glib2;2.14.0;i386;fedora");
+
+	/* the simulation returns a token for its solution */
+	results = pk_client_install_packages (client,
+					      pk_bitfield_value (PK_TRANSACTION_FLAG_ENUM_SIMULATE),
+					      package_ids, NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (results);
+	g_assert_cmpint (pk_results_get_exit_code (results), ==, PK_EXIT_ENUM_SUCCESS);
+	g_assert_nonnull (pk_results_get_solution_token (results));
+	token = g_strdup (pk_results_get_solution_token (results));
+	g_clear_object (&results);
+
+	/* a new simulation replaces it */
+	results = pk_client_install_packages (client,
+					      pk_bitfield_value (PK_TRANSACTION_FLAG_ENUM_SIMULATE),
+					      package_ids, NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (results);
+	g_assert_cmpstr (pk_results_get_solution_token (results), !=, token);
+	g_free (token);
+	token = g_strdup (pk_results_get_solution_token (results));
+	g_clear_object (&results);
+
+	/* the real transaction presents it */
+	pk_client_set_solution_token (client, token);
+	results = pk_client_install_packages (client, 0, package_ids, NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (results);
+	g_assert_cmpint (pk_results_get_exit_code (results), ==, PK_EXIT_ENUM_SUCCESS);
+	g_assert_null (pk_results_get_solution_token (results));
+}
+
 static void
 pk_test_task_install_packages_cb (GObject *object, GAsyncResult *res, gpointer user_data)
 {
@@ -1554,6 +1595,181 @@ pk_test_transaction_list_func (void)
 	g_object_unref (client);
 }
 
+static void
+pk_test_transaction_batch_signal_cb (GDBusConnection *connection,
+				     const gchar *sender_name,
+				     const gchar *object_path,
+				     const gchar *interface_name,
+				     const gchar *signal_name,
+				     GVariant *parameters,
+				     gpointer user_data)
+{
+	GString *log = user_data;
+	guint index;
+	guint value;
+
+	if (g_strcmp0 (signal_name, "BatchStep") == 0) {
+		g_variant_get (parameters, "(uu)", &index, &value);
+		g_string_append_printf (log, "%u:%s;", index,
+					pk_role_enum_to_string (value));
+	} else if (g_strcmp0 (signal_name, "Package") == 0 ||
+		   g_strcmp0 (signal_name, "Details") == 0) {
+		/* only log the first result of each step */
+		if (!g_str_has_suffix (log->str, ";"))
+			return;
+		g_string_append (log, signal_name);
+	} else if (g_strcmp0 (signal_name, "Finished") == 0) {
+		g_variant_get (parameters, "(uu)", &value, NULL);
+		g_string_append_printf (log, ";%s", pk_exit_enum_to_string (value));
+		_g_test_loop_quit ();
+	}
+}
+
+static void
+pk_test_transaction_batch_func (void)
+{
+	guint signal_id;
+	GVariantBuilder steps;
+	g_autofree gchar *remote_error = NULL;
+	g_autofree gchar *tid = NULL;
+	g_autoptr(GDBusConnection) connection = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GString) log = g_string_new (NULL);
+	g_autoptr(GVariant) value = NULL;
+	const gchar *names[] = { "glib2", NULL };
+	const gchar *package_ids[] = { "powertop;1.8-1.fc8;i386;fedora", NULL };
+
+	connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+	g_assert_no_error (error);
+	value = g_dbus_connection_call_sync (connection,
+					     PK_DBUS_SERVICE,
+					     PK_DBUS_PATH,
+					     PK_DBUS_INTERFACE,
+					     "CreateTransaction",
+					     NULL,
+					     G_VARIANT_TYPE ("(o)"),
+					     G_DBUS_CALL_FLAGS_NONE,
+					     -1, NULL, &error);
+	g_assert_no_error (error);
+	g_variant_get (value, "(o)", &tid);
+	signal_id = g_dbus_connection_signal_subscribe (connection,
+							PK_DBUS_SERVICE,
+							PK_DBUS_INTERFACE_TRANSACTION,
+							NULL,
+							tid,
+							NULL,
+							G_DBUS_SIGNAL_FLAGS_NONE,
+							pk_test_transaction_batch_signal_cb,
+							log, NULL);
+
+	/* only query roles can be batched */
+	g_variant_builder_init (&steps, G_VARIANT_TYPE ("a(sv)"));
+	g_variant_builder_add (&steps, "(sv)", "RepairSystem",
+			       g_variant_new ("(t)", (guint64) 0));
+	g_clear_pointer (&value, g_variant_unref);
+	value = g_dbus_connection_call_sync (connection,
+					     PK_DBUS_SERVICE,
+					     tid,
+					     PK_DBUS_INTERFACE_TRANSACTION,
+					     "Batch",
+					     g_variant_new ("(a(sv))", &steps),
+					     NULL,
+					     G_DBUS_CALL_FLAGS_NONE,
+					     -1, NULL, &error);
+	g_assert_null (value);
+	g_assert_nonnull (error);
+	remote_error = g_dbus_error_get_remote_error (error);
+	g_assert_cmpstr (remote_error, ==, PK_DBUS_INTERFACE_TRANSACTION ".NotSupported");
+	g_clear_error (&error);
+	g_dbus_connection_signal_unsubscribe (connection, signal_id);
+
+	/* the failed transaction is gone, so start again */
+	value = g_dbus_connection_call_sync (connection,
+					     PK_DBUS_SERVICE,
+					     PK_DBUS_PATH,
+					     PK_DBUS_INTERFACE,
+					     "CreateTransaction",
+					     NULL,
+					     G_VARIANT_TYPE ("(o)"),
+					     G_DBUS_CALL_FLAGS_NONE,
+					     -1, NULL, &error);
+	g_assert_no_error (error);
+	g_clear_pointer (&tid, g_free);
+	g_variant_get (value, "(o)", &tid);
+	signal_id = g_dbus_connection_signal_subscribe (connection,
+							PK_DBUS_SERVICE,
+							PK_DBUS_INTERFACE_TRANSACTION,
+							NULL,
+							tid,
+							NULL,
+							G_DBUS_SIGNAL_FLAGS_NONE,
+							pk_test_transaction_batch_signal_cb,
+							log, NULL);
+
+	/* the results of each step follow its BatchStep */
+	g_variant_builder_init (&steps, G_VARIANT_TYPE ("a(sv)"));
+	g_variant_builder_add (&steps, "(sv)", "Resolve",
+			       g_variant_new ("(t^as)", (guint64) 0, names));
+	g_variant_builder_add (&steps, "(sv)", "GetDetails",
+			       g_variant_new ("(^as)", package_ids));
+	g_dbus_connection_call (connection,
+				PK_DBUS_SERVICE,
+				tid,
+				PK_DBUS_INTERFACE_TRANSACTION,
+				"Batch",
+				g_variant_new ("(a(sv))", &steps),
+				NULL,
+				G_DBUS_CALL_FLAGS_NONE,
+				-1, NULL, NULL, NULL);
+	_g_test_loop_run_with_timeout (15000);
+	g_assert_cmpstr (log->str, ==, "0:resolve;Package1:get-details;Details;success");
+
+	g_dbus_connection_signal_unsubscribe (connection, signal_id);
+}
+
+#define PK_TEST_CLIENT_LATENCY_COUNT	100
+
+static void
+pk_test_client_latency_func (void)
+{
+	gdouble average;
+	gdouble max = 0;
+	gdouble total = 0;
+	g_auto(GStrv) package_ids = NULL;
+	g_autoptr(PkClient) client = NULL;
+
+	client = pk_client_new ();
+	package_ids = pk_package_ids_from_id ("glib2");
+
+	/* measure from asking for the transaction until it has finished,
+	 * which is dominated by the round trips to the daemon; the first
+	 * one also sets up the bus connection, so is not counted */
+	for (guint i = 0; i <= PK_TEST_CLIENT_LATENCY_COUNT; i++) {
+		gdouble elapsed;
+		g_autoptr(GError) error = NULL;
+		g_autoptr(PkResults) results = NULL;
+
+		g_test_timer_start ();
+		results = pk_client_resolve (client,
+					     pk_bitfield_value (PK_FILTER_ENUM_NONE),
+					     package_ids,
+					     NULL, NULL, NULL,
+					     &error);
+		elapsed = g_test_timer_elapsed ();
+		g_assert_no_error (error);
+		g_assert_nonnull (results);
+		if (i == 0)
+			continue;
+		max = MAX (max, elapsed);
+		total += elapsed;
+	}
+	average = total * 1000 / PK_TEST_CLIENT_LATENCY_COUNT;
+
+	g_test_message ("resolve latency for %u transactions: average %.2f ms, max %.2f ms",
+			PK_TEST_CLIENT_LATENCY_COUNT, average, max * 1000);
+	g_test_minimized_result (average, "average resolve latency: %.2f ms", average);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -1573,12 +1789,18 @@ main (int argc, char **argv)
 	g_test_add_func ("/packagekit-glib2/client-helper", pk_test_client_helper_func);
 	g_test_add_func ("/packagekit-glib2/client", pk_test_client_func);
 	g_test_add_func ("/packagekit-glib2/client/cancellation", pk_test_client_cancellation_func);
+	g_test_add_func ("/packagekit-glib2/transaction/batch", pk_test_transaction_batch_func);
+	g_test_add_func ("/packagekit-glib2/client/solution", pk_test_client_solution_func);
 	g_test_add_func ("/packagekit-glib2/package-sack", pk_test_package_sack_func);
 	g_test_add_func ("/packagekit-glib2/task", pk_test_task_func);
 	g_test_add_func ("/packagekit-glib2/task-wrapper", pk_test_task_wrapper_func);
 	g_test_add_func ("/packagekit-glib2/task-text", pk_test_task_text_func);
 	g_test_add_func ("/packagekit-glib2/console", pk_test_console_func);
 
+	/* performance tests, only run with -m perf */
+	if (g_test_perf ())
+		g_test_add_func ("/packagekit-glib2/client/latency", pk_test_client_latency_func);
+
 	return g_test_run ();
 }
 
@@ -37,6 +37,8 @@
 #include "pk-package.h"
 #include "pk-package-id.h"
 #include "pk-package-ids.h"
+#include "pk-package-private.h"
+#include "pk-package-sack.h"
 #include "pk-progress-bar.h"
 #include "pk-results.h"
 #include "pk-task-text.h"
@@ -411,6 +413,14 @@ pk_test_package_id_func (void)
 	/* test fail missing first */
 	sections = pk_package_id_split (";0.1.2;i386;data");
 	g_assert_true (sections == NULL);
+
+	/* fuzzy arch */
+	g_assert_true (pk_package_id_equal_fuzzy_arch ("moo;0.1;i386;fedora", "moo;0.1;i686;updates"));
+	g_assert_true (pk_package_id_equal_fuzzy_arch ("moo;0.1;noarch;fedora", "moo;0.1;noarch;"));
+	g_assert_true (!pk_package_id_equal_fuzzy_arch ("moo;0.1;i386;fedora", "moo;0.1;x86_64;fedora"));
+	g_assert_true (!pk_package_id_equal_fuzzy_arch ("moo;0.1;i386;fedora", "moo;0.2;i386;fedora"));
+	g_assert_true (!pk_package_id_equal_fuzzy_arch ("moo;0.1;i386;fedora", "moo2;0.1;i386;fedora"));
+	g_assert_true (!pk_package_id_equal_fuzzy_arch ("moo;0.1;i386;fedora", "moo;0.1"));
 }
 
 static void
@@ -527,6 +537,9 @@ pk_test_package_func (void)
 {
 	gboolean ret;
 	PkPackage *package;
+	PkPackage *package2;
+	PkRoleEnum role;
+	GRefString *tid;
 	const gchar *id;
 	gchar *text;
 	GError *error = NULL;
@@ -582,9 +595,209 @@ pk_test_package_func (void)
 	g_assert_cmpstr (text, ==, "gnome-power-manager;0.1.2;i386;fedora");
 	g_free (text);
 
+	/* get sections of set package */
+	g_assert_cmpstr (pk_package_get_name (package), ==, "gnome-power-manager");
+	g_assert_cmpstr (pk_package_get_version (package), ==, "0.1.2");
+	g_assert_cmpstr (pk_package_get_arch (package), ==, "i386");
+	g_assert_cmpstr (pk_package_get_data (package), ==, "fedora");
+
+	/* sections are shared between packages */
+	package2 = pk_package_new ();
+	ret = pk_package_set_id (package2, "gnome-power-manager;0.1.3;i386;fedora", &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	g_assert_true (pk_package_get_name (package) == pk_package_get_name (package2));
+	g_assert_true (pk_package_get_arch (package) == pk_package_get_arch (package2));
+	g_assert_true (pk_package_get_data (package) == pk_package_get_data (package2));
+	g_assert_cmpstr (pk_package_get_version (package2), ==, "0.1.3");
+
+	/* replace the id */
+	ret = pk_package_set_id (package2, "totem;3.0;x86_64;updates", &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	g_assert_cmpstr (pk_package_get_name (package2), ==, "totem");
+	g_assert_cmpstr (pk_package_get_version (package2), ==, "3.0");
+	g_assert_cmpstr (pk_package_get_arch (package2), ==, "x86_64");
+	g_assert_cmpstr (pk_package_get_data (package2), ==, "updates");
+	g_assert_cmpstr (pk_package_get_name (package), ==, "gnome-power-manager");
+	g_object_unref (package2);
+
+	/* create from a signal, sharing the transaction ID */
+	tid = g_ref_string_new_intern ("/42_abcdef");
+	package2 = pk_package_new_from_signal (PK_INFO_ENUM_AVAILABLE,
+					       PK_INFO_ENUM_SECURITY,
+					       "totem;3.0;x86_64;updates",
+					       "Movie Player",
+					       PK_ROLE_ENUM_GET_UPDATES,
+					       tid,
+					       &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (package2);
+	g_assert_cmpstr (pk_package_get_id (package2), ==, "totem;3.0;x86_64;updates");
+	g_assert_cmpstr (pk_package_get_version (package2), ==, "3.0");
+	g_assert_cmpint (pk_package_get_info (package2), ==, PK_INFO_ENUM_AVAILABLE);
+	g_assert_cmpint (pk_package_get_update_severity (package2), ==, PK_INFO_ENUM_SECURITY);
+	g_assert_cmpstr (pk_package_get_summary (package2), ==, "Movie Player");
+	g_object_get (package2,
+		      "role", &role,
+		      "transaction-id", &text,
+		      NULL);
+	g_assert_cmpint (role, ==, PK_ROLE_ENUM_GET_UPDATES);
+	g_assert_cmpstr (text, ==, "/42_abcdef");
+	g_free (text);
+	g_object_unref (package2);
+
+	/* invalid id */
+	package2 = pk_package_new_from_signal (PK_INFO_ENUM_AVAILABLE,
+					       PK_INFO_ENUM_UNKNOWN,
+					       "totem;3.0;x86_64",
+					       "Movie Player",
+					       PK_ROLE_ENUM_GET_UPDATES,
+					       tid,
+					       &error);
+	g_assert_error (error, 1, 0);
+	g_assert_null (package2);
+	g_clear_error (&error);
+	g_ref_string_release (tid);
+
 	g_object_unref (package);
 }
 
+static gboolean
+pk_test_package_sack_not_i386_cb (PkPackage *package, gpointer user_data)
+{
+	return g_strcmp0 (pk_package_get_arch (package), "i386") != 0;
+}
+
+static void
+pk_test_package_sack_index_func (void)
+{
+	g_autoptr(PkPackageSack) sack = pk_package_sack_new ();
+	g_autoptr(PkPackageSack) available = NULL;
+	g_autoptr(PkPackage) package = NULL;
+	gboolean ret;
+
+	pk_package_sack_add_package_by_id (sack, "foo;1.0;i386;fedora", NULL);
+	pk_package_sack_add_package_by_id (sack, "foo;1.0;x86_64;fedora", NULL);
+	pk_package_sack_add_package_by_id (sack, "bar;2.0;noarch;fedora", NULL);
+	package = pk_package_sack_find_by_id (sack, "foo;1.0;x86_64;fedora");
+	pk_package_set_info (package, PK_INFO_ENUM_INSTALLED);
+	g_clear_object (&package);
+
+	/* find by name and arch, ignoring version and data */
+	package = pk_package_sack_find_by_id_name_arch (sack, "foo;2.0;x86_64;updates");
+	g_assert_nonnull (package);
+	g_assert_cmpstr (pk_package_get_id (package), ==, "foo;1.0;x86_64;fedora");
+	g_clear_object (&package);
+	package = pk_package_sack_find_by_id_name_arch (sack, "foo;1.0;aarch64;fedora");
+	g_assert_null (package);
+	package = pk_package_sack_find_by_id_name_arch (sack, "baz;1.0;i386;fedora");
+	g_assert_null (package);
+
+	/* filter by info, following changes made while in the sack */
+	available = pk_package_sack_filter_by_info (sack, PK_INFO_ENUM_UNKNOWN);
+	g_assert_cmpint (pk_package_sack_get_size (available), ==, 2);
+	g_clear_object (&available);
+	package = pk_package_sack_find_by_id (sack, "bar;2.0;noarch;fedora");
+	g_object_set (package, "info", PK_INFO_ENUM_INSTALLED, NULL);
+	g_clear_object (&package);
+	available = pk_package_sack_filter_by_info (sack, PK_INFO_ENUM_UNKNOWN);
+	g_assert_cmpint (pk_package_sack_get_size (available), ==, 1);
+	g_clear_object (&available);
+
+	/* remove by filter keeps the indices in sync */
+	ret = pk_package_sack_remove_by_filter (sack, pk_test_package_sack_not_i386_cb, NULL);
+	g_assert_true (ret);
+	g_assert_cmpint (pk_package_sack_get_size (sack), ==, 2);
+	package = pk_package_sack_find_by_id_name_arch (sack, "foo;1.0;i386;fedora");
+	g_assert_null (package);
+	package = pk_package_sack_find_by_id_name_arch (sack, "foo;1.0;x86_64;fedora");
+	g_assert_nonnull (package);
+	g_clear_object (&package);
+
+	/* remove by ID */
+	ret = pk_package_sack_remove_package_by_id (sack, "bar;2.0;noarch;fedora");
+	g_assert_true (ret);
+	ret = pk_package_sack_remove_package_by_id (sack, "bar;2.0;noarch;fedora");
+	g_assert_false (ret);
+	package = pk_package_sack_find_by_id_name_arch (sack, "bar;2.0;noarch;fedora");
+	g_assert_null (package);
+	available = pk_package_sack_filter_by_info (sack, PK_INFO_ENUM_INSTALLED);
+	g_assert_cmpint (pk_package_sack_get_size (available), ==, 1);
+	g_clear_object (&available);
+
+	/* clear */
+	pk_package_sack_clear (sack);
+	package = pk_package_sack_find_by_id_name_arch (sack, "foo;1.0;x86_64;fedora");
+	g_assert_null (package);
+}
+
+#define PK_TEST_PACKAGE_SACK_COUNT	100000
+
+static gboolean
+pk_test_package_sack_keep_cb (PkPackage *package, gpointer user_data)
+{
+	guint *idx = user_data;
+	return (*idx)++ % 10 != 0;
+}
+
+static void
+pk_test_package_sack_perf_func (void)
+{
+	g_autoptr(PkPackageSack) sack = pk_package_sack_new ();
+	g_autoptr(PkPackageSack) updating = NULL;
+	g_autoptr(GTimer) timer = g_timer_new ();
+	guint idx = 0;
+	gdouble elapsed;
+
+	for (guint i = 0; i < PK_TEST_PACKAGE_SACK_COUNT; i++) {
+		g_autoptr(PkPackage) package = pk_package_new ();
+		g_autofree gchar *package_id = NULL;
+		package_id = g_strdup_printf ("package-%u;1.2.3-%u.fc40;%s;fedora",
+					      i / 2, i % 7, i % 2 ? "x86_64" : "i686");
+		pk_package_set_id (package, package_id, NULL);
+		pk_package_set_info (package, i % 100 == 0 ? PK_INFO_ENUM_UPDATING :
+							     PK_INFO_ENUM_AVAILABLE);
+		pk_package_sack_add_package (sack, package);
+	}
+	g_test_message ("added %u packages in %.1f ms",
+			PK_TEST_PACKAGE_SACK_COUNT, g_timer_elapsed (timer, NULL) * 1000);
+
+	/* lookups */
+	g_timer_reset (timer);
+	for (guint i = 0; i < PK_TEST_PACKAGE_SACK_COUNT; i++) {
+		g_autoptr(PkPackage) package = NULL;
+		g_autofree gchar *package_id = NULL;
+		package_id = g_strdup_printf ("package-%u;;%s;", i / 2, i % 2 ? "x86_64" : "i686");
+		package = pk_package_sack_find_by_id_name_arch (sack, package_id);
+		g_assert_nonnull (package);
+	}
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_test_message ("%u name+arch lookups in %.1f ms",
+			PK_TEST_PACKAGE_SACK_COUNT, elapsed * 1000);
+	g_test_minimized_result (elapsed, "name+arch lookups: %.1f ms", elapsed * 1000);
+
+	/* filter by a rare info */
+	g_timer_reset (timer);
+	for (guint i = 0; i < 100; i++) {
+		g_clear_object (&updating);
+		updating = pk_package_sack_filter_by_info (sack, PK_INFO_ENUM_UPDATING);
+	}
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_assert_cmpint (pk_package_sack_get_size (updating), ==, PK_TEST_PACKAGE_SACK_COUNT / 100);
+	g_test_message ("100 info filters in %.1f ms", elapsed * 1000);
+	g_test_minimized_result (elapsed, "info filters: %.1f ms", elapsed * 1000);
+
+	/* remove every tenth package */
+	g_timer_reset (timer);
+	pk_package_sack_remove_by_filter (sack, pk_test_package_sack_keep_cb, &idx);
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_assert_cmpint (pk_package_sack_get_size (sack), ==, PK_TEST_PACKAGE_SACK_COUNT / 10 * 9);
+	g_test_message ("removed %u packages by filter in %.1f ms",
+			PK_TEST_PACKAGE_SACK_COUNT / 10, elapsed * 1000);
+	g_test_minimized_result (elapsed, "remove by filter: %.1f ms", elapsed * 1000);
+}
+
 static void
 pk_test_offline_func (void)
 {
@@ -1046,10 +1259,15 @@ main (int argc, char **argv)
 	g_test_add_func ("/packagekit-glib2/package-ids", pk_test_package_ids_func);
 	g_test_add_func ("/packagekit-glib2/results", pk_test_results_func);
 	g_test_add_func ("/packagekit-glib2/package", pk_test_package_func);
+	g_test_add_func ("/packagekit-glib2/package-sack-index", pk_test_package_sack_index_func);
 	g_test_add_func ("/packagekit-glib2/offline", pk_test_offline_func);
 	g_test_add_func ("/packagekit-glib2/offline-upgrade", pk_test_offline_upgrade_func);
 	g_test_add_func ("/packagekit-glib2/object-types", pk_test_object_types_func);
 	g_test_add_func ("/packagekit-glib2/client-helper", pk_test_client_helper_func);
 
+	/* benchmarks, run with -m perf */
+	if (g_test_perf ())
+		g_test_add_func ("/packagekit-glib2/package-sack", pk_test_package_sack_perf_func);
+
 	return g_test_run ();
 }